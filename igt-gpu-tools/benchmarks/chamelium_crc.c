@@ -0,0 +1,115 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file chamelium_crc.c
+ *
+ * This is a test of the speed of the software Chamelium CRC used for
+ * reference frames, against a pass per CRC word over the frame. No
+ * Chamelium or device is needed.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "drmtest.h"
+#include "igt_chamelium.h"
+#include "frame_bench.h"
+
+/* The CRC as one scalar pass over the frame per CRC word */
+static uint32_t xrgb_hash16(const unsigned char *buffer, int width,
+			    int height, int k, int m)
+{
+	unsigned char r, g, b;
+	uint64_t sum = 0;
+	uint64_t count = 0;
+	uint64_t value;
+	int index;
+	int i;
+
+	for (i = 0; i < width * height; i++) {
+		if ((i % m) != k)
+			continue;
+
+		index = i * 4;
+
+		r = buffer[index + 2];
+		g = buffer[index + 1];
+		b = buffer[index + 0];
+
+		value = r | (g << 8) | (b << 16);
+		sum += ++count * value;
+	}
+
+	return ((sum >> 0) ^ (sum >> 16) ^ (sum >> 32) ^ (sum >> 48)) & 0xffff;
+}
+
+static int bench(int width, int height, int reps)
+{
+	struct timespec start, end;
+	unsigned char *buffer;
+	igt_crc_t ref, *crc = NULL;
+	double scalar, fast;
+	size_t i;
+	int n, k;
+
+	buffer = malloc((size_t)width * height * 4);
+	igt_assert(buffer);
+	for (i = 0; i < (size_t)width * height * 4; i++)
+		buffer[i] = rand();
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (n = 0; n < reps; n++)
+		for (k = 0; k < 4; k++)
+			ref.crc[k] = xrgb_hash16(buffer, width, height, 3 - k, 4);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	scalar = frame_bench_elapsed(&start, &end) / reps;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (n = 0; n < reps; n++) {
+		free(crc);
+		crc = chamelium_calculate_xrgb_crc(buffer, width, height);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	fast = frame_bench_elapsed(&start, &end) / reps;
+
+	printf("%dx%d: %.2fms -> %.2fms (%.1fx), crc %04x:%04x:%04x:%04x%s\n",
+	       width, height, 1e3 * scalar, 1e3 * fast, scalar / fast,
+	       crc->crc[0], crc->crc[1], crc->crc[2], crc->crc[3],
+	       memcmp(ref.crc, crc->crc, 4 * sizeof(ref.crc[0])) ?
+	       " MISMATCH" : "");
+
+	k = memcmp(ref.crc, crc->crc, 4 * sizeof(ref.crc[0])) != 0;
+
+	free(crc);
+	free(buffer);
+
+	return k;
+}
+
+int main(int argc, char **argv)
+{
+	return frame_bench_main(argc, argv, 5, bench);
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/** @file chamelium_frame_match.c
+ *
+ * This is a test of the speed of igt_check_analog_frame_match(), used to
+ * compare analog captures with their reference frames, against walking the
+ * frame a column at a time. No Chamelium or device is needed.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <cairo.h>
+#include <gsl/gsl_statistics_double.h>
+#include <gsl/gsl_fit.h>
+
+#include "drmtest.h"
+#include "igt_frame.h"
+#include "frame_bench.h"
+
+/* The comparison walking the frame a column at a time */
+static bool analog_frame_match(cairo_surface_t *reference,
+			       cairo_surface_t *capture)
+{
+	int w, h;
+	static int error_count[3][256][2];
+	double error_average[4][250];
+	double error_trend[250];
+	double c0, c1, cov00, cov01, cov11, sumsq;
+	double correlation;
+	unsigned char *reference_pixels, *capture_pixels;
+	unsigned char *p;
+	unsigned char *q;
+	int diff;
+	int x, y;
+	int i, j;
+
+	w = cairo_image_surface_get_width(reference);
+	h = cairo_image_surface_get_height(reference);
+	reference_pixels = cairo_image_surface_get_data(reference);
+	capture_pixels = cairo_image_surface_get_data(capture);
+
+	memset(error_count, 0, sizeof(error_count));
+	for (x = 0; x < w; x++) {
+		for (y = 0; y < h; y++) {
+			p = &capture_pixels[(x + y * w) * 4];
+			q = &reference_pixels[(x + y * w) * 4];
+
+			for (i = 0; i < 3; i++) {
+				diff = (int) p[i] - q[i];
+				if (diff < 0)
+					diff = -diff;
+
+				error_count[i][q[i]][0] += diff;
+				error_count[i][q[i]][1]++;
+			}
+		}
+	}
+
+	for (i = 0; i < 250; i++) {
+		error_average[0][i] = i;
+
+		for (j = 1; j < 4; j++) {
+			error_average[j][i] = (double) error_count[j-1][i][0] /
+					      error_count[j-1][i][1];
+			if (error_average[j][i] > 60)
+				return false;
+		}
+	}
+
+	for (i = 1; i < 4; i++) {
+		gsl_fit_linear((const double *) &error_average[0], 1,
+			       (const double *) &error_average[i], 1, 250,
+			       &c0, &c1, &cov00, &cov01, &cov11, &sumsq);
+
+		for (j = 0; j < 250; j++)
+			error_trend[j] = c0 + j * c1;
+
+		correlation = gsl_stats_correlation((const double *) &error_trend,
+						    1,
+						    (const double *) &error_average[i],
+						    1, 250);
+		if (correlation < 0.985)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * A capture with an error growing linearly with the value, as through a
+ * DAC-ADC chain, or of the reference shifted by a few pixels.
+ */
+static void make_frames(cairo_surface_t *reference, cairo_surface_t *capture,
+			bool shifted)
+{
+	int w = cairo_image_surface_get_width(reference);
+	int h = cairo_image_surface_get_height(reference);
+	int stride = cairo_image_surface_get_stride(reference);
+	unsigned char *q = cairo_image_surface_get_data(reference);
+	unsigned char *p = cairo_image_surface_get_data(capture);
+	int x, y, i;
+
+	cairo_surface_flush(reference);
+	cairo_surface_flush(capture);
+
+	for (y = 0; y < h; y++) {
+		for (x = 0; x < w; x++) {
+			unsigned char *r = q + y * stride + x * 4;
+
+			for (i = 0; i < 3; i++)
+				r[i] = (x + y + 85 * i + (rand() & 15)) & 0xff;
+			r[3] = 0;
+		}
+	}
+
+	for (y = 0; y < h; y++) {
+		for (x = 0; x < w; x++) {
+			unsigned char *r = q + y * stride + x * 4;
+			unsigned char *c = p + y * stride + x * 4;
+
+			if (shifted) {
+				memcpy(c, q + y * stride + ((x + 7) % w) * 4, 4);
+				continue;
+			}
+
+			for (i = 0; i < 3; i++) {
+				int e = 1 + r[i] / 16 + (rand() & 1);
+				int v = rand() & 1 ? r[i] + e : r[i] - e;
+
+				c[i] = v < 0 ? 0 : v > 255 ? 255 : v;
+			}
+			c[3] = 0;
+		}
+	}
+
+	cairo_surface_mark_dirty(reference);
+	cairo_surface_mark_dirty(capture);
+}
+
+static int bench(int width, int height, int reps)
+{
+	cairo_surface_t *reference, *capture;
+	struct timespec start, end;
+	double column, fast;
+	int ret = 0;
+	int n, k;
+
+	reference = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+					       width, height);
+	capture = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+					     width, height);
+
+	for (k = 0; k < 2; k++) {
+		bool expect = false, match = false;
+
+		make_frames(reference, capture, k);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (n = 0; n < reps; n++)
+			expect = analog_frame_match(reference, capture);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		column = frame_bench_elapsed(&start, &end) / reps;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (n = 0; n < reps; n++)
+			match = igt_check_analog_frame_match(reference, capture);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		fast = frame_bench_elapsed(&start, &end) / reps;
+
+		printf("%dx%d %s: %.2fms -> %.2fms (%.1fx), %s%s\n",
+		       width, height, k ? "shifted" : "analog",
+		       1e3 * column, 1e3 * fast, column / fast,
+		       match ? "match" : "no match",
+		       match != expect ? " MISMATCH" : "");
+
+		ret |= match != expect;
+	}
+
+	cairo_surface_destroy(capture);
+	cairo_surface_destroy(reference);
+
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	return frame_bench_main(argc, argv, 5, bench);
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef FRAME_BENCH_H
+#define FRAME_BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+/*
+ * The command line of the benchmarks timing CPU work on a frame, which
+ * need no device. Each frame size is benchmarked over a number of
+ * repetitions, with the sizes given by -w and -h, or else all of the
+ * common sizes below, and the repetitions by -r.
+ */
+
+static const struct {
+	int width, height;
+} frame_bench_sizes[] = {
+	{ 1920, 1080 },
+	{ 3840, 2160 },
+};
+
+/* In seconds */
+static inline double frame_bench_elapsed(const struct timespec *start,
+					 const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+		1e-9 * (end->tv_nsec - start->tv_nsec);
+}
+
+/*
+ * Runs @bench for every frame size, and returns the or of what it
+ * returned, non-zero when the results didn't match.
+ */
+static inline int frame_bench_main(int argc, char **argv, int reps,
+				   int (*bench)(int width, int height, int reps))
+{
+	int width = 0, height = 0;
+	unsigned int s;
+	int c, ret = 0;
+
+	while ((c = getopt(argc, argv, "w:h:r:")) != -1) {
+		switch (c) {
+		case 'w':
+			width = atoi(optarg);
+			break;
+		case 'h':
+			height = atoi(optarg);
+			break;
+		case 'r':
+			reps = atoi(optarg);
+			if (reps < 1)
+				reps = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-w width -h height] [-r repetitions]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	if (width > 0 && height > 0)
+		return bench(width, height, reps);
+
+	for (s = 0; s < sizeof(frame_bench_sizes) / sizeof(frame_bench_sizes[0]); s++)
+		ret |= bench(frame_bench_sizes[s].width,
+			     frame_bench_sizes[s].height, reps);
+
+	return ret;
+}
+
+#endif /* FRAME_BENCH_H */
@@ -35,25 +35,27 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/prctl.h>
 #include <sys/time.h>
 #include <time.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "drm.h"
 #include "ioctl_wrappers.h"
 #include "drmtest.h"
 #include "intel_io.h"
 #include "igt_stats.h"
+#include "sw_sync.h"
+#include "gem_exec_trace.h"
 
-enum {
-	ADD_BO = 0,
-	DEL_BO,
-	ADD_CTX,
-	DEL_CTX,
-	EXEC,
-	WAIT,
-};
+#define LOCAL_I915_EXEC_FENCE_OUT (1 << 17)
+
+static bool threaded;
+static double pace;
+static bool fences;
 
+/* Version 1 trace commands, following their type byte */
 struct trace_add_bo {
 	uint32_t handle;
 	uint64_t size;
@@ -91,12 +93,109 @@ struct trace_wait {
 	uint32_t handle;
 } __attribute__((packed));
 
-static uint32_t hars_petruska_f54_1_random(void)
-{
-	static uint32_t state = 0x12345678;
+/* A decoded command of either trace version, still using the traced handles */
+struct trace_cmd {
+	uint8_t cmd;
+	uint64_t seqno;
+	uint64_t timestamp; /* 0 if not recorded */
+	uint32_t handle;
+	uint64_t size;
+	uint64_t flags;
+	uint32_t context;
+	uint32_t count;
+	uint32_t max_objects;
+	struct drm_i915_gem_exec_object2 *objects;
+};
+
+struct v1_cursor {
+	uint8_t *ptr, *end;
+	uint64_t seqno;
+};
+
+/* Position in the blocks of one stream of a version 2 trace */
+struct stream_cursor {
+	uint32_t stream;
+	uint8_t *base;
+	uint64_t *blocks;
+	unsigned int nr_blocks, block;
+	uint8_t *data, *ptr, *end;
+	uint32_t remaining;
+	uint32_t last_handle;
+	uint64_t seqno; /* of the next command, UINT64_MAX once done */
+	uint64_t timestamp;
+	uint8_t cmd;
+};
+
+struct trace_file {
+	uint8_t *base;
+	size_t size;
+	unsigned int version;
+
+	struct v1_cursor v1;
+
+	struct stream_cursor *streams;
+	unsigned int nr_streams;
+	uint32_t max_bo;
+	uint32_t max_ctx;
+	bool indexed;
+};
+
+struct replay {
+	int fd;
+	long nop, range;
+	int error; /* Set from any stream thread, accessed atomically */
+
+	/* Recorded time of the first command, and when its replay started */
+	uint64_t trace_start;
+	uint64_t start;
+
+	igt_stats_t submit, complete, late;
+
+	uint32_t *bo, *ctx;
+	unsigned int num_bo, num_ctx;
+
+	/* Progress of each stream when replaying them from separate threads */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	unsigned int waiters;
+	uint64_t *next;
+	unsigned int nr_streams;
+};
+
+#define MAX_INFLIGHT 1024
+
+/* Per submitting thread, merged into the replay totals at the end */
+struct exec_state {
+	uint32_t prng;
+	igt_stats_t submit, complete, late;
+
+	/* Output fences of the execbufs not yet seen completed, oldest first */
+	struct {
+		int fence;
+		uint64_t submit;
+	} inflight[MAX_INFLIGHT];
+	unsigned int head, tail;
+};
+
+#define DECODE_AHEAD 256
 
+/* Commands decoded ahead of submission, filled by the decoder thread */
+struct decode_ring {
+	struct trace_file *trace;
+	struct trace_cmd slot[DECODE_AHEAD];
+	unsigned int head, tail;
+	int status; /* 1 while decoding, 0 at the end of the trace, -1 on error */
+	bool stop;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	unsigned int waiters;
+};
+
+static uint32_t hars_petruska_f54_1_random(uint32_t *state)
+{
 #define rol(x,k) ((x << k) | (x >> (32-k)))
-	return state = (state ^ rol (state, 5) ^ rol (state, 24)) + 0x37798849;
+	return *state = (*state ^ rol (*state, 5) ^ rol (*state, 24)) + 0x37798849;
 #undef rol
 }
 
@@ -105,6 +204,14 @@ static double elapsed(const struct timespec *start, const struct timespec *end)
 	return 1e3*(end->tv_sec - start->tv_sec) + 1e-6*(end->tv_nsec - start->tv_nsec);
 }
 
+static uint64_t gettime_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 static uint32_t __gem_context_create_local(int fd)
 {
 	struct drm_i915_gem_context_create arg = {};
@@ -112,23 +219,324 @@ static uint32_t __gem_context_create_local(int fd)
 	return arg.ctx_id;
 }
 
-static double replay(const char *filename, long nop, long range)
+static struct drm_i915_gem_exec_object2 *
+cmd_objects(struct trace_cmd *c, uint32_t count)
 {
-	struct timespec t_start, t_end;
-	struct drm_i915_gem_execbuffer2 eb = {};
-	const struct trace_version {
-		uint32_t magic;
-		uint32_t version;
-	} *tv;
-	const uint32_t bbe = 0xa << 23;
-	struct drm_i915_gem_exec_object2 *exec_objects = NULL;
-	uint32_t *bo, *ctx;
-	int num_bo, num_ctx;
-	int max_objects = 0;
+	/*
+	 * Leave room for the nop batch appended at submission. Every slot
+	 * of the decode ring has its own array, so only grow it as far as
+	 * the commands decoded into it need.
+	 */
+	if (count >= c->max_objects) {
+		free(c->objects);
+
+		c->max_objects = ALIGN(count + 1, 16);
+		c->objects = malloc(c->max_objects * sizeof(*c->objects));
+		assert(c->objects);
+	}
+
+	c->count = count;
+	return c->objects;
+}
+
+static int decode_v1(struct v1_cursor *cur, struct trace_cmd *c)
+{
+	uint8_t *ptr = cur->ptr;
+
+	if (ptr >= cur->end)
+		return 0;
+
+	c->cmd = *ptr++;
+	c->seqno = cur->seqno++;
+	c->timestamp = 0;
+
+	switch (c->cmd) {
+	case ADD_BO:
+		{
+			struct trace_add_bo *t = (void *)ptr;
+			ptr = (void *)(t + 1);
+
+			c->handle = t->handle;
+			c->size = t->size;
+			break;
+		}
+	case DEL_BO:
+	case ADD_CTX:
+	case DEL_CTX:
+	case WAIT:
+		{
+			struct trace_del_bo *t = (void *)ptr;
+			ptr = (void *)(t + 1);
+
+			c->handle = t->handle;
+			break;
+		}
+	case EXEC:
+		{
+			struct trace_exec *t = (void *)ptr;
+			struct drm_i915_gem_exec_object2 *obj;
+			ptr = (void *)(t + 1);
+
+			c->flags = t->flags;
+			c->context = t->context;
+			obj = cmd_objects(c, t->object_count);
+
+			for (uint32_t i = 0; i < c->count; i++) {
+				struct trace_exec_object *to = (void *)ptr;
+				ptr = (void *)(to + 1);
+
+				obj[i].handle = to->handle;
+				obj[i].alignment = to->alignment;
+				obj[i].offset = to->offset;
+				obj[i].flags = to->flags;
+				obj[i].rsvd1 = to->rsvd1;
+				obj[i].rsvd2 = to->rsvd2;
+
+				obj[i].relocation_count = to->relocation_count;
+				obj[i].relocs_ptr = (uintptr_t)ptr;
+
+				ptr += sizeof(struct drm_i915_gem_relocation_entry) * to->relocation_count;
+			}
+			break;
+		}
+	default:
+		fprintf(stderr, "Unknown cmd: %x\n", c->cmd);
+		return -1;
+	}
+
+	if (ptr > cur->end)
+		return -1;
+
+	cur->ptr = ptr;
+	return 1;
+}
+
+/* Reads the type and sequence number of the next command of the stream */
+static int cursor_next(struct stream_cursor *cur)
+{
+	uint64_t gap;
+
+	if (!cur->remaining) {
+		struct trace_block *b;
+
+		if (cur->block == cur->nr_blocks) {
+			cur->seqno = UINT64_MAX;
+			return 0;
+		}
+
+		b = (void *)(cur->base + cur->blocks[cur->block++]);
+		cur->data = cur->ptr = (uint8_t *)(b + 1);
+		cur->end = cur->ptr + b->length;
+		cur->remaining = b->count;
+		cur->last_handle = 0;
+		cur->seqno = b->seqno - 1;
+		cur->timestamp = b->timestamp;
+	}
+
+	if (cur->ptr >= cur->end)
+		return -1;
+
+	cur->cmd = *cur->ptr++;
+	cur->ptr = (uint8_t *)trace_get_varint(cur->ptr, cur->end, &gap);
+	if (!cur->ptr)
+		return -1;
+
+	cur->seqno += gap + 1;
+
+	cur->ptr = (uint8_t *)trace_get_varint(cur->ptr, cur->end, &gap);
+	if (!cur->ptr)
+		return -1;
+
+	cur->timestamp += gap;
+	cur->remaining--;
+	return 1;
+}
+
+static int decode_v2(struct stream_cursor *cur, struct trace_cmd *c)
+{
+	const uint8_t *ptr = cur->ptr, *end = cur->end;
+	uint64_t v;
+
+#define get(x) do { \
+	ptr = trace_get_varint(ptr, end, &v); \
+	if (!ptr) \
+		return -1; \
+	(x) = v; \
+} while (0)
+#define get_handle(x) do { \
+	ptr = trace_get_handle(ptr, end, &cur->last_handle, &(x)); \
+	if (!ptr) \
+		return -1; \
+} while (0)
+
+	c->cmd = cur->cmd;
+	c->seqno = cur->seqno;
+	c->timestamp = cur->timestamp;
+
+	switch (c->cmd) {
+	case ADD_BO:
+		get_handle(c->handle);
+		get(c->size);
+		break;
+	case DEL_BO:
+	case WAIT:
+		get_handle(c->handle);
+		break;
+	case ADD_CTX:
+	case DEL_CTX:
+		get(c->handle);
+		break;
+	case EXEC:
+		{
+			struct drm_i915_gem_exec_object2 *obj;
+			uint32_t count;
+
+			get(count);
+			get(c->flags);
+			c->context = cur->stream - 1;
+			obj = cmd_objects(c, count);
+
+			for (uint32_t i = 0; i < count; i++) {
+				get_handle(obj[i].handle);
+				get(obj[i].relocation_count);
+				get(obj[i].alignment);
+				get(obj[i].offset);
+				get(obj[i].flags);
+				get(obj[i].rsvd1);
+				get(obj[i].rsvd2);
+
+				if (obj[i].relocation_count)
+					ptr = cur->data +
+					      ALIGN(ptr - cur->data, TRACE_ALIGN);
+				obj[i].relocs_ptr = (uintptr_t)ptr;
+				ptr += sizeof(struct drm_i915_gem_relocation_entry) * obj[i].relocation_count;
+				if (ptr > end)
+					return -1;
+			}
+			break;
+		}
+	default:
+		fprintf(stderr, "Unknown cmd: %x\n", c->cmd);
+		return -1;
+	}
+#undef get_handle
+#undef get
+
+	cur->ptr = (uint8_t *)ptr;
+	return cursor_next(cur) < 0 ? -1 : 1;
+}
+
+/* Decodes the next command in the original order of the trace */
+static int decode(struct trace_file *t, struct trace_cmd *c)
+{
+	struct stream_cursor *next = NULL;
+
+	if (t->version == 1)
+		return decode_v1(&t->v1, c);
+
+	for (unsigned int i = 0; i < t->nr_streams; i++) {
+		if (!next || t->streams[i].seqno < next->seqno)
+			next = &t->streams[i];
+	}
+	if (!next || next->seqno == UINT64_MAX)
+		return 0;
+
+	return decode_v2(next, c);
+}
+
+static struct stream_cursor *
+get_stream(struct trace_file *t, uint32_t stream)
+{
+	struct stream_cursor *cur;
+
+	for (unsigned int i = 0; i < t->nr_streams; i++) {
+		if (t->streams[i].stream == stream)
+			return &t->streams[i];
+	}
+
+	t->streams = realloc(t->streams, (t->nr_streams + 1) * sizeof(*cur));
+	assert(t->streams);
+	cur = &t->streams[t->nr_streams++];
+	memset(cur, 0, sizeof(*cur));
+	cur->stream = stream;
+	cur->base = t->base;
+
+	return cur;
+}
+
+static int add_block(struct trace_file *t, uint64_t offset)
+{
+	struct trace_block *b = (void *)(t->base + offset);
+	struct stream_cursor *cur;
+
+	if (offset + sizeof(*b) > t->size ||
+	    offset + sizeof(*b) + b->length > t->size)
+		return -1;
+
+	cur = get_stream(t, b->stream);
+	if (!(cur->nr_blocks & (cur->nr_blocks - 1))) {
+		cur->blocks = realloc(cur->blocks,
+				      2 * (cur->nr_blocks + 1) * sizeof(*cur->blocks));
+		assert(cur->blocks);
+	}
+	cur->blocks[cur->nr_blocks++] = offset;
+
+	return 0;
+}
+
+/*
+ * Splits the blocks of a version 2 trace into their streams, using the index
+ * if the trace was closed, or by walking the block headers otherwise.
+ */
+static int load_streams(struct trace_file *t)
+{
+	const struct trace_header *h = (void *)t->base;
+
+	if (h->index && h->index + sizeof(struct trace_index) <= t->size) {
+		const struct trace_index *index = (void *)(t->base + h->index);
+
+		if (h->index + sizeof(*index) +
+		    index->nr_blocks * sizeof(index->block[0]) > t->size)
+			return -1;
+
+		for (uint32_t i = 0; i < index->nr_blocks; i++) {
+			if (add_block(t, index->block[i]))
+				return -1;
+		}
+
+		t->max_bo = index->max_bo;
+		t->max_ctx = index->max_ctx;
+		t->indexed = true;
+	} else {
+		uint64_t offset = sizeof(*h);
+
+		/* A truncated final block is dropped */
+		while (offset + sizeof(struct trace_block) <= t->size) {
+			const struct trace_block *b = (void *)(t->base + offset);
+
+			if (add_block(t, offset))
+				break;
+
+			offset += sizeof(*b) + b->length;
+		}
+	}
+
+	for (unsigned int i = 0; i < t->nr_streams; i++) {
+		if (cursor_next(&t->streams[i]) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int open_trace(const char *filename, struct trace_file *t)
+{
+	const struct trace_header *h;
 	struct stat st;
-	uint8_t *ptr, *end;
 	int fd;
 
+	memset(t, 0, sizeof(*t));
+
 	fd = open(filename, O_RDONLY);
 	if (fd < 0)
 		return -1;
@@ -138,169 +546,585 @@ static double replay(const char *filename, long nop, long range)
 		return -1;
 	}
 
-	ptr = mmap(0, st.st_size, PROT_WRITE, MAP_PRIVATE, fd, 0);
+	t->base = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
 	close(fd);
 
-	if (ptr == MAP_FAILED)
+	if (t->base == MAP_FAILED)
 		return -1;
 
-	madvise(ptr, st.st_size, MADV_SEQUENTIAL);
-	end = ptr + st.st_size;
+	madvise(t->base, st.st_size, MADV_SEQUENTIAL);
+	t->size = st.st_size;
 
-	tv = (struct trace_version *)ptr;
-	if (tv->magic != 0xdeadbeef) {
+	h = (void *)t->base;
+	if (t->size < 2 * sizeof(uint32_t) || h->magic != TRACE_MAGIC) {
 		fprintf(stderr, "%s: invalid magic\n", filename);
 		return -1;
 	}
-	if (tv->version != 1) {
+
+	t->version = h->version;
+	switch (t->version) {
+	case 1:
+		t->v1.ptr = t->base + 2 * sizeof(uint32_t);
+		t->v1.end = t->base + t->size;
+		return 0;
+	case 2:
+		if (t->size < sizeof(*h) || load_streams(t)) {
+			fprintf(stderr, "%s: corrupt trace\n", filename);
+			return -1;
+		}
+		return 0;
+	default:
 		fprintf(stderr, "%s: unhandled version %d\n",
-			filename, tv->version);
+			filename, t->version);
 		return -1;
 	}
-	ptr = (void *)(tv + 1);
+}
 
-	ctx = calloc(1024, sizeof(*ctx));
-	num_ctx = 1024;
+static void grow_table(uint32_t **table, unsigned int *num,
+		       uint32_t handle, unsigned int align)
+{
+	int new;
 
-	bo = calloc(4096, sizeof(*bo));
-	num_bo = 4096;
+	if (handle < *num)
+		return;
 
-	fd = drm_open_driver(DRIVER_INTEL);
-	if (nop > 0) {
-		bo[0] = gem_create(fd, nop + range);
-		gem_write(fd, bo[0], nop + range - sizeof(bbe),
-			  &bbe, sizeof(bbe));
-		range *= 2;
-		range -= 64;
-	} else {
-		bo[0] = gem_create(fd, 4096);
-		gem_write(fd, bo[0], 0, &bbe, sizeof(bbe));
+	new = ALIGN(handle + 1, align);
+	*table = realloc(*table, sizeof(**table) * new);
+	assert(*table);
+	memset(*table + *num, 0, sizeof(**table) * (new - *num));
+	*num = new;
+}
+
+static uint32_t lookup(const uint32_t *table, unsigned int num, uint32_t handle)
+{
+	return handle < num ? table[handle] : 0;
+}
+
+static void exec_state_init(struct exec_state *es, uint32_t seed)
+{
+	memset(es, 0, sizeof(*es));
+	es->prng = seed;
+	igt_stats_init(&es->submit);
+	igt_stats_init(&es->complete);
+	igt_stats_init(&es->late);
+}
+
+static void retire(struct exec_state *es, bool wait)
+{
+	while (es->head != es->tail) {
+		unsigned int idx = es->head % MAX_INFLIGHT;
+		int fence = es->inflight[idx].fence;
+		uint64_t ts;
+		int status;
+
+		if (wait)
+			sync_fence_wait(fence, -1);
+
+		status = sync_fence_timestamp(fence, &ts);
+		if (status == SW_SYNC_FENCE_STATUS_ACTIVE && !wait)
+			break;
+
+		/* Fences that failed have no completion time to record */
+		if (status == SW_SYNC_FENCE_STATUS_SIGNALED)
+			igt_stats_push(&es->complete,
+				       ts - es->inflight[idx].submit);
+		close(fence);
+		es->head++;
 	}
+}
 
-	clock_gettime(CLOCK_MONOTONIC, &t_start);
-	do switch (*ptr++) {
+static void track(struct exec_state *es, int fence, uint64_t submit)
+{
+	unsigned int idx;
+
+	retire(es, false);
+	if (es->tail - es->head == MAX_INFLIGHT) {
+		sync_fence_wait(es->inflight[es->head % MAX_INFLIGHT].fence, -1);
+		retire(es, false);
+	}
+
+	idx = es->tail++ % MAX_INFLIGHT;
+	es->inflight[idx].fence = fence;
+	es->inflight[idx].submit = submit;
+}
+
+static void merge_stats(igt_stats_t *dst, igt_stats_t *src)
+{
+	igt_stats_push_array(dst, src->values_u64, src->n_values);
+	igt_stats_fini(src);
+}
+
+static void exec_state_fini(struct replay *r, struct exec_state *es)
+{
+	retire(es, true);
+
+	pthread_mutex_lock(&r->lock);
+	merge_stats(&r->submit, &es->submit);
+	merge_stats(&r->complete, &es->complete);
+	merge_stats(&r->late, &es->late);
+	pthread_mutex_unlock(&r->lock);
+}
+
+/*
+ * Sleeps until the command is due, with the recorded intervals scaled by
+ * the pacing factor.
+ */
+static uint64_t wait_until_due(struct replay *r, const struct trace_cmd *c)
+{
+	uint64_t due, now;
+	struct timespec ts;
+
+	due = r->start + (c->timestamp - r->trace_start) * pace;
+	now = gettime_ns();
+	if (now >= due)
+		return now - due;
+
+	ts.tv_sec = due / 1000000000ULL;
+	ts.tv_nsec = due % 1000000000ULL;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL))
+		;
+
+	now = gettime_ns();
+	return now > due ? now - due : 0;
+}
+
+static int execute(struct replay *r, struct trace_cmd *c, struct exec_state *es)
+{
+	uint64_t late = 0;
+
+	if (pace > 0 && c->timestamp)
+		late = wait_until_due(r, c);
+
+	switch (c->cmd) {
 	case ADD_BO:
+		grow_table(&r->bo, &r->num_bo, c->handle, 4096);
+		r->bo[c->handle] = gem_create(r->fd, c->size);
+		break;
+
+	case DEL_BO:
+		assert(c->handle && c->handle < r->num_bo && r->bo[c->handle]);
+		gem_close(r->fd, r->bo[c->handle]);
+		r->bo[c->handle] = 0;
+		break;
+
+	case ADD_CTX:
+		grow_table(&r->ctx, &r->num_ctx, c->handle, 1024);
+		r->ctx[c->handle] = __gem_context_create_local(r->fd);
+		break;
+
+	case DEL_CTX:
+		assert(c->handle < r->num_ctx && r->ctx[c->handle]);
+		gem_context_destroy(r->fd, r->ctx[c->handle]);
+		r->ctx[c->handle] = 0;
+		break;
+
+	case EXEC:
 		{
-			struct trace_add_bo *t = (void *)ptr;
-			ptr = (void *)(t + 1);
+			struct drm_i915_gem_exec_object2 *obj = c->objects;
+			struct drm_i915_gem_execbuffer2 eb = {
+				.buffers_ptr = (uintptr_t)obj,
+				.buffer_count = c->count,
+				.flags = c->flags,
+				.rsvd1 = lookup(r->ctx, r->num_ctx, c->context),
+			};
+			uint64_t submit;
 
-			if (t->handle >= num_bo) {
-				int new_bo = ALIGN(t->handle, 4096);
-				bo = realloc(bo, sizeof(*bo)*new_bo);
-				memset(bo + num_bo, 0, sizeof(*bo)*(new_bo - num_bo));
-				num_bo = new_bo;
+			for (uint32_t i = 0; i < eb.buffer_count; i++) {
+				obj[i].handle = lookup(r->bo, r->num_bo, obj[i].handle);
+
+				if (!(eb.flags & I915_EXEC_HANDLE_LUT)) {
+					struct drm_i915_gem_relocation_entry *relocs =
+						(void *)(uintptr_t)obj[i].relocs_ptr;
+					for (uint32_t j = 0; j < obj[i].relocation_count; j++)
+						relocs[j].target_handle =
+							lookup(r->bo, r->num_bo,
+							       relocs[j].target_handle);
+				}
+			}
+
+			memset(&obj[eb.buffer_count], 0, sizeof(*obj));
+			obj[eb.buffer_count++].handle = r->bo[0];
+
+			if (r->nop > 0) {
+				eb.batch_start_offset = hars_petruska_f54_1_random(&es->prng);
+				eb.batch_start_offset =
+					((uint64_t)eb.batch_start_offset * r->range) >> 32;
+				eb.batch_start_offset = ALIGN(eb.batch_start_offset, 64);
+			}
+
+			if (pace > 0 && c->timestamp)
+				igt_stats_push(&es->late, late);
+
+			submit = gettime_ns();
+			if (fences) {
+				eb.flags |= LOCAL_I915_EXEC_FENCE_OUT;
+				gem_execbuf_wr(r->fd, &eb);
+			} else {
+				gem_execbuf(r->fd, &eb);
 			}
+			igt_stats_push(&es->submit, gettime_ns() - submit);
 
-			bo[t->handle] = gem_create(fd, t->size);
+			if (fences)
+				track(es, eb.rsvd2 >> 32, submit);
 			break;
 		}
-	case DEL_BO:
-		{
-			struct trace_del_bo *t = (void *)ptr;
-			ptr = (void *)(t + 1);
 
-			assert(t->handle && t->handle < num_bo && bo[t->handle]);
-			gem_close(fd, bo[t->handle]);
-			bo[t->handle] = 0;
+	case WAIT:
+		assert(c->handle && c->handle < r->num_bo && r->bo[c->handle]);
+		gem_wait(r->fd, r->bo[c->handle], NULL);
+		break;
+
+	default:
+		fprintf(stderr, "Unknown cmd: %x\n", c->cmd);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void ring_wait(struct decode_ring *ring, bool (*cond)(struct decode_ring *))
+{
+	pthread_mutex_lock(&ring->lock);
+	__atomic_add_fetch(&ring->waiters, 1, __ATOMIC_SEQ_CST);
+	while (!cond(ring))
+		pthread_cond_wait(&ring->cond, &ring->lock);
+	ring->waiters--;
+	pthread_mutex_unlock(&ring->lock);
+}
+
+static void ring_wake(struct decode_ring *ring)
+{
+	if (__atomic_load_n(&ring->waiters, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&ring->lock);
+		pthread_cond_broadcast(&ring->cond);
+		pthread_mutex_unlock(&ring->lock);
+	}
+}
+
+static bool ring_has_space(struct decode_ring *ring)
+{
+	return ring->tail - __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) <
+	       DECODE_AHEAD || __atomic_load_n(&ring->stop, __ATOMIC_SEQ_CST);
+}
+
+static bool ring_has_cmd(struct decode_ring *ring)
+{
+	return __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) != ring->head ||
+	       __atomic_load_n(&ring->status, __ATOMIC_SEQ_CST) <= 0;
+}
+
+static void *decoder(void *data)
+{
+	struct decode_ring *ring = data;
+	int ret;
+
+	do {
+		if (!ring_has_space(ring))
+			ring_wait(ring, ring_has_space);
+		if (__atomic_load_n(&ring->stop, __ATOMIC_SEQ_CST))
 			break;
-		}
-	case ADD_CTX:
-		{
-			struct trace_add_ctx *t = (void *)ptr;
-			ptr = (void *)(t + 1);
 
-			if (t->handle >= num_ctx) {
-				int new_ctx = ALIGN(t->handle, 1024);
-				ctx = realloc(ctx, sizeof(*ctx)*new_ctx);
-				memset(ctx + num_ctx, 0, sizeof(*ctx)*(new_ctx - num_ctx));
-				num_ctx = new_ctx;
-			}
+		ret = decode(ring->trace,
+			     &ring->slot[ring->tail % DECODE_AHEAD]);
+		if (ret > 0)
+			__atomic_store_n(&ring->tail, ring->tail + 1,
+					 __ATOMIC_SEQ_CST);
+		else
+			__atomic_store_n(&ring->status, ret, __ATOMIC_SEQ_CST);
 
-			ctx[t->handle] = __gem_context_create_local(fd);
+		ring_wake(ring);
+	} while (ret > 0);
+
+	return NULL;
+}
+
+/*
+ * Replays the trace in its original order, with the commands decoded ahead
+ * on a separate thread.
+ */
+static int replay_ordered(struct replay *r, struct trace_file *t)
+{
+	struct decode_ring *ring;
+	struct exec_state *es;
+	pthread_t thread;
+	int ret = 0;
+
+	es = malloc(sizeof(*es));
+	assert(es);
+	exec_state_init(es, 0x12345678);
+
+	ring = calloc(1, sizeof(*ring));
+	assert(ring);
+	ring->trace = t;
+	ring->status = 1;
+	pthread_mutex_init(&ring->lock, NULL);
+	pthread_cond_init(&ring->cond, NULL);
+
+	if (pthread_create(&thread, NULL, decoder, ring))
+		return -1;
+
+	for (;;) {
+		struct trace_cmd *c;
+
+		if (!ring_has_cmd(ring))
+			ring_wait(ring, ring_has_cmd);
+
+		if (__atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) == ring->head) {
+			ret = ring->status;
 			break;
 		}
-	case DEL_CTX:
-		{
-			struct trace_del_ctx *t = (void *)ptr;
-			ptr = (void *)(t + 1);
 
-			assert(t->handle < num_ctx && ctx[t->handle]);
-			gem_context_destroy(fd, ctx[t->handle]);
-			ctx[t->handle] = 0;
+		c = &ring->slot[ring->head % DECODE_AHEAD];
+		if (execute(r, c, es)) {
+			ret = -1;
 			break;
 		}
-	case EXEC:
-		{
-			struct trace_exec *t = (void *)ptr;
-			ptr = (void *)(t + 1);
 
-			eb.buffer_count = t->object_count;
-			eb.flags = t->flags;
-			eb.rsvd1 = ctx[t->context];
+		__atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_SEQ_CST);
+		ring_wake(ring);
+	}
 
-			if (eb.buffer_count >= max_objects) {
-				free(exec_objects);
+	if (ret) {
+		__atomic_store_n(&ring->stop, true, __ATOMIC_SEQ_CST);
+		ring_wake(ring);
+	}
+	pthread_join(thread, NULL);
 
-				max_objects = ALIGN(eb.buffer_count + 1, 4096);
+	for (unsigned int i = 0; i < DECODE_AHEAD; i++)
+		free(ring->slot[i].objects);
+	free(ring);
 
-				exec_objects = malloc(max_objects*sizeof(*exec_objects));
-				eb.buffers_ptr = (uintptr_t)exec_objects;
-			}
+	exec_state_fini(r, es);
+	free(es);
 
-			for (uint32_t i = 0; i < eb.buffer_count; i++) {
-				struct trace_exec_object *to = (void *)ptr;
-				ptr = (void *)(to + 1);
+	return ret;
+}
 
-				exec_objects[i].handle = bo[to->handle];
-				exec_objects[i].alignment = to->alignment;
-				exec_objects[i].offset = to->offset;
-				exec_objects[i].flags = to->flags;
-				exec_objects[i].rsvd1 = to->rsvd1;
-				exec_objects[i].rsvd2 = to->rsvd2;
+struct stream_thread {
+	pthread_t thread;
+	struct replay *replay;
+	struct trace_file *trace;
+	unsigned int idx;
+};
 
-				exec_objects[i].relocation_count = to->relocation_count;
-				exec_objects[i].relocs_ptr = (uintptr_t)ptr;
+/*
+ * Buffer and context management and waits (stream 0) only run once every
+ * context stream has caught up with them, while a context only waits for
+ * stream 0 and never for other contexts.
+ */
+static bool stream_ready(struct replay *r, unsigned int idx, uint64_t seqno)
+{
+	if (idx)
+		return __atomic_load_n(&r->next[0], __ATOMIC_SEQ_CST) > seqno;
 
-				if (!(eb.flags & I915_EXEC_HANDLE_LUT)) {
-					struct drm_i915_gem_relocation_entry *relocs =
-						(struct drm_i915_gem_relocation_entry *)ptr;
-					for (uint32_t j = 0; j < to->relocation_count; j++)
-						relocs[j].target_handle = bo[relocs[j].target_handle];
-				}
+	for (unsigned int i = 1; i < r->nr_streams; i++) {
+		if (__atomic_load_n(&r->next[i], __ATOMIC_SEQ_CST) <= seqno)
+			return false;
+	}
 
-				ptr += sizeof(struct drm_i915_gem_relocation_entry) * to->relocation_count;
-			}
+	return true;
+}
 
-			((struct drm_i915_gem_exec_object2 *)
-			 memset(&exec_objects[eb.buffer_count++], 0,
-				sizeof(*exec_objects)))->handle = bo[0];
+static void stream_wait(struct replay *r, unsigned int idx, uint64_t seqno)
+{
+	if (stream_ready(r, idx, seqno))
+		return;
+
+	pthread_mutex_lock(&r->lock);
+	__atomic_add_fetch(&r->waiters, 1, __ATOMIC_SEQ_CST);
+	while (!stream_ready(r, idx, seqno))
+		pthread_cond_wait(&r->cond, &r->lock);
+	r->waiters--;
+	pthread_mutex_unlock(&r->lock);
+}
 
-			if (nop > 0) {
-				eb.batch_start_offset = hars_petruska_f54_1_random();
-				eb.batch_start_offset =
-					((uint64_t)eb.batch_start_offset * range) >> 32;
-				eb.batch_start_offset = ALIGN(eb.batch_start_offset, 64);
-			}
-			gem_execbuf(fd, &eb);
+static void stream_advance(struct replay *r, unsigned int idx, uint64_t seqno)
+{
+	__atomic_store_n(&r->next[idx], seqno, __ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&r->waiters, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&r->lock);
+		pthread_cond_broadcast(&r->cond);
+		pthread_mutex_unlock(&r->lock);
+	}
+}
+
+static void *stream_replay(void *data)
+{
+	struct stream_thread *st = data;
+	struct replay *r = st->replay;
+	struct stream_cursor *cur = &st->trace->streams[st->idx];
+	struct trace_cmd c = {};
+	struct exec_state *es;
+
+	es = malloc(sizeof(*es));
+	assert(es);
+	exec_state_init(es, 0x12345678 + st->idx);
+
+	while (cur->seqno != UINT64_MAX &&
+	       !__atomic_load_n(&r->error, __ATOMIC_SEQ_CST)) {
+		stream_wait(r, st->idx, cur->seqno);
+
+		if (decode_v2(cur, &c) < 0 || execute(r, &c, es)) {
+			__atomic_store_n(&r->error, -1, __ATOMIC_SEQ_CST);
 			break;
 		}
 
-	case WAIT:
-		{
-			struct trace_wait *t = (void *)ptr;
-			ptr = (void *)(t + 1);
+		stream_advance(r, st->idx, cur->seqno);
+	}
 
-			assert(t->handle && t->handle < num_bo && bo[t->handle]);
-			gem_wait(fd, bo[t->handle], NULL);
-			break;
+	stream_advance(r, st->idx, UINT64_MAX);
+	free(c.objects);
+
+	exec_state_fini(r, es);
+	free(es);
+
+	return NULL;
+}
+
+/*
+ * Replays every context of an indexed trace from its own thread, so that
+ * contexts are only ordered against the buffer and context management.
+ */
+static int replay_threaded(struct replay *r, struct trace_file *t)
+{
+	struct stream_thread *threads;
+	struct stream_cursor *cur;
+	unsigned int i;
+
+	/* Stream 0 goes first, execbufs of the default context are stream 1 */
+	cur = get_stream(t, 0);
+	if (!cur->nr_blocks)
+		cur->seqno = UINT64_MAX;
+	i = cur - t->streams;
+	if (i) {
+		struct stream_cursor tmp = t->streams[0];
+
+		t->streams[0] = t->streams[i];
+		t->streams[i] = tmp;
+	}
+
+	/* The tables are sized upfront so that threads never resize them */
+	grow_table(&r->bo, &r->num_bo, t->max_bo, 4096);
+	grow_table(&r->ctx, &r->num_ctx, t->max_ctx, 1024);
+
+	r->nr_streams = t->nr_streams;
+	r->next = calloc(r->nr_streams, sizeof(*r->next));
+	threads = calloc(r->nr_streams, sizeof(*threads));
+	assert(r->next && threads);
+	for (i = 0; i < r->nr_streams; i++)
+		r->next[i] = t->streams[i].seqno;
+
+	for (i = 0; i < r->nr_streams; i++) {
+		threads[i].replay = r;
+		threads[i].trace = t;
+		threads[i].idx = i;
+		if (pthread_create(&threads[i].thread, NULL,
+				   stream_replay, &threads[i])) {
+			__atomic_store_n(&r->error, -1, __ATOMIC_SEQ_CST);
+			stream_advance(r, i, UINT64_MAX);
 		}
+	}
 
-	default:
-		fprintf(stderr, "Unknown cmd: %x\n", *ptr);
+	for (i = 0; i < r->nr_streams; i++) {
+		if (threads[i].thread)
+			pthread_join(threads[i].thread, NULL);
+	}
+
+	free(threads);
+	free(r->next);
+
+	return r->error;
+}
+
+static void print_stats(const char *filename, const char *name,
+			igt_stats_t *stats)
+{
+	double q1, q2, q3;
+
+	if (!stats->n_values)
+		return;
+
+	igt_stats_get_quartiles(stats, &q1, &q2, &q3);
+	printf("%s: %s [us]: min %.1f, q1 %.1f, median %.1f, q3 %.1f, max %.1f, mean %.1f (%u execbufs)\n",
+	       filename, name,
+	       igt_stats_get_min(stats) / 1e3, q1 / 1e3, q2 / 1e3, q3 / 1e3,
+	       igt_stats_get_max(stats) / 1e3,
+	       igt_stats_get_mean(stats) / 1e3,
+	       stats->n_values);
+}
+
+static double replay(const char *filename, long nop, long range)
+{
+	struct timespec t_start, t_end;
+	const uint32_t bbe = 0xa << 23;
+	bool per_context = threaded;
+	struct trace_file t;
+	struct replay r = {
+		.nop = nop,
+		.range = range,
+		.trace_start = UINT64_MAX,
+	};
+	int ret;
+
+	if (open_trace(filename, &t))
 		return -1;
-	} while (ptr < end);
+
+	if (per_context && !t.indexed) {
+		fprintf(stderr,
+			"%s: no index, replaying contexts in trace order\n",
+			filename);
+		per_context = false;
+	}
+
+	for (unsigned int i = 0; i < t.nr_streams; i++) {
+		if (t.streams[i].seqno != UINT64_MAX &&
+		    t.streams[i].timestamp < r.trace_start)
+			r.trace_start = t.streams[i].timestamp;
+	}
+	if (pace > 0 && t.version < 2)
+		fprintf(stderr,
+			"%s: no timestamps, replaying as fast as possible\n",
+			filename);
+	else if (pace > 0)
+		prctl(PR_SET_TIMERSLACK, 1); /* inherited by the stream threads */
+
+	pthread_mutex_init(&r.lock, NULL);
+	pthread_cond_init(&r.cond, NULL);
+	igt_stats_init(&r.submit);
+	igt_stats_init(&r.complete);
+	igt_stats_init(&r.late);
+
+	grow_table(&r.ctx, &r.num_ctx, 0, 1024);
+	grow_table(&r.bo, &r.num_bo, 0, 4096);
+
+	r.fd = drm_open_driver(DRIVER_INTEL);
+	if (nop > 0) {
+		r.bo[0] = gem_create(r.fd, nop + range);
+		gem_write(r.fd, r.bo[0], nop + range - sizeof(bbe),
+			  &bbe, sizeof(bbe));
+		r.range *= 2;
+		r.range -= 64;
+	} else {
+		r.bo[0] = gem_create(r.fd, 4096);
+		gem_write(r.fd, r.bo[0], 0, &bbe, sizeof(bbe));
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	r.start = t_start.tv_sec * 1000000000ULL + t_start.tv_nsec;
+	if (per_context)
+		ret = replay_threaded(&r, &t);
+	else
+		ret = replay_ordered(&r, &t);
 	clock_gettime(CLOCK_MONOTONIC, &t_end);
 
+	if (ret)
+		return -1;
+
+	print_stats(filename, "execbuf ioctl", &r.submit);
+	print_stats(filename, "submit to completion", &r.complete);
+	print_stats(filename, "late submission", &r.late);
+
 	return elapsed(&t_start, &t_end);
 }
 
@@ -374,7 +1198,7 @@ int main(int argc, char **argv)
 	results = mmap(NULL, ALIGN(argc*sizeof(double), 4096),
 		       PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
 
-	while ((c = getopt(argc, argv, "d:n:r:")) != -1) {
+	while ((c = getopt(argc, argv, "d:n:r:tP:l")) != -1) {
 		switch (c) {
 		case 'd':
 			delay = atoi(optarg);
@@ -389,6 +1213,15 @@ int main(int argc, char **argv)
 			if (range > 0)
 				range = ALIGN(range, 4096);
 			break;
+		case 't':
+			threaded = true;
+			break;
+		case 'P':
+			pace = atof(optarg);
+			break;
+		case 'l':
+			fences = true;
+			break;
 		default:
 			break;
 		}
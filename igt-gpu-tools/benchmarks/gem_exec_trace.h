@@ -0,0 +1,150 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEM_EXEC_TRACE_H
+#define GEM_EXEC_TRACE_H
+
+#include <stdint.h>
+
+/*
+ * Trace format shared by the gem_exec_tracer preload library and the
+ * gem_exec_trace replayer.
+ *
+ * Version 1 is a flat stream of packed commands following the version
+ * header.
+ *
+ * Version 2 splits the commands into streams: stream 0 carries the buffer
+ * and context management and the waits, and every context gets its own
+ * stream of execbufs (stream = context id + 1). Each stream is written as a
+ * sequence of blocks, and every command carries a global sequence number so
+ * that the original order can be recovered by merging the streams. When the
+ * trace is closed an index of all blocks is appended and its offset stored in
+ * the header; a trace without an index can still be replayed by walking the
+ * block headers.
+ *
+ * Within a block a command is its type byte, followed by the varint gap to
+ * the sequence number of the previous command in the block, the varint
+ * nanoseconds elapsed since that command was issued, and its payload of
+ * varints. Times are CLOCK_MONOTONIC, and the first command of a block is
+ * issued at the timestamp of the block. Buffer handles are zigzag encoded as
+ * the difference to the previous handle in the block, so that blocks can be
+ * decoded independently. Relocation entries of an execbuf object are stored
+ * verbatim after the object, padded to 8 bytes from the start of the block so
+ * that they can be handed to the kernel straight from the mapped trace. Blocks
+ * are padded to 8 bytes as well.
+ */
+
+#define TRACE_MAGIC 0xdeadbeef
+#define TRACE_VERSION 2
+
+enum {
+	ADD_BO = 0,
+	DEL_BO,
+	ADD_CTX,
+	DEL_CTX,
+	EXEC,
+	WAIT,
+};
+
+struct trace_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t index; /* offset of struct trace_index, 0 if missing */
+} __attribute__((packed));
+
+struct trace_block {
+	uint32_t stream;
+	uint32_t length; /* of the encoded commands following the header */
+	uint32_t count; /* number of commands */
+	uint32_t pad;
+	uint64_t seqno; /* of the first command */
+	uint64_t timestamp; /* of the first command, in ns */
+} __attribute__((packed));
+
+struct trace_index {
+	uint64_t nr_cmds;
+	uint32_t nr_streams;
+	uint32_t nr_blocks;
+	uint32_t max_bo;
+	uint32_t max_ctx;
+	uint64_t block[]; /* file offsets of all blocks, in file order */
+} __attribute__((packed));
+
+#define TRACE_BLOCK_SIZE (64 << 10)
+#define TRACE_VARINT_MAX 10
+#define TRACE_ALIGN 8
+
+static inline uint8_t *trace_put_varint(uint8_t *ptr, uint64_t v)
+{
+	while (v >= 0x80) {
+		*ptr++ = v | 0x80;
+		v >>= 7;
+	}
+	*ptr++ = v;
+
+	return ptr;
+}
+
+static inline const uint8_t *
+trace_get_varint(const uint8_t *ptr, const uint8_t *end, uint64_t *v)
+{
+	unsigned int shift = 0;
+
+	*v = 0;
+	while (ptr < end && shift < 64) {
+		uint8_t b = *ptr++;
+
+		*v |= (uint64_t)(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return ptr;
+
+		shift += 7;
+	}
+
+	return NULL;
+}
+
+static inline uint8_t *
+trace_put_handle(uint8_t *ptr, uint32_t *last, uint32_t handle)
+{
+	int64_t delta = (int64_t)handle - *last;
+
+	*last = handle;
+
+	return trace_put_varint(ptr, ((uint64_t)delta << 1) ^ (delta >> 63));
+}
+
+static inline const uint8_t *
+trace_get_handle(const uint8_t *ptr, const uint8_t *end,
+		 uint32_t *last, uint32_t *handle)
+{
+	uint64_t v;
+
+	ptr = trace_get_varint(ptr, end, &v);
+	if (ptr)
+		*handle = *last += (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+
+	return ptr;
+}
+
+#endif /* GEM_EXEC_TRACE_H */
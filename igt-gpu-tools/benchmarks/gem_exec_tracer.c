@@ -37,89 +37,46 @@
 #include <dlfcn.h>
 #include <i915_drm.h>
 #include <pthread.h>
+#include <time.h>
 
 #include "intel_aub.h"
 #include "intel_chipset.h"
+#include "gem_exec_trace.h"
 
 static int (*libc_close)(int fd);
 static int (*libc_ioctl)(int fd, unsigned long request, void *argp);
 
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
+struct trace_stream {
+	uint32_t stream;
+	uint32_t count;
+	uint64_t seqno;
+	uint64_t last;
+	uint64_t timestamp;
+	uint64_t last_time;
+	uint32_t last_handle;
+	size_t len, size;
+	uint8_t *data;
+};
+
 struct trace {
 	int fd;
 	FILE *file;
 	struct trace *next;
-} *traces;
 
-#define DRM_MAJOR 226
+	uint64_t seqno;
+	uint32_t max_bo;
+	uint32_t max_ctx;
 
-enum {
-	ADD_BO = 0,
-	DEL_BO,
-	ADD_CTX,
-	DEL_CTX,
-	EXEC,
-	WAIT,
-};
+	struct trace_stream *streams;
+	unsigned int nr_streams;
 
-static struct trace_verion {
-	uint32_t magic;
-	uint32_t version;
-} version = {
-	.magic = 0xdeadbeef,
-	.version = 1
-};
+	uint64_t *blocks;
+	unsigned int nr_blocks, max_blocks;
+} *traces;
 
-struct trace_add_bo {
-	uint8_t cmd;
-	uint32_t handle;
-	uint64_t size;
-} __attribute__((packed));
-struct trace_del_bo {
-	uint8_t cmd;
-	uint32_t handle;
-}__attribute__((packed));
-
-struct trace_add_ctx {
-	uint8_t cmd;
-	uint32_t handle;
-} __attribute__((packed));
-struct trace_del_ctx {
-	uint8_t cmd;
-	uint32_t handle;
-}__attribute__((packed));
-
-struct trace_exec {
-	uint8_t cmd;
-	uint32_t object_count;
-	uint64_t flags;
-	uint32_t context;
-}__attribute__((packed));
-
-struct trace_exec_object {
-	uint32_t handle;
-	uint32_t relocation_count;
-	uint64_t alignment;
-	uint64_t offset;
-	uint64_t flags;
-	uint64_t rsvd1;
-	uint64_t rsvd2;
-}__attribute__((packed));
-
-struct trace_exec_relocation {
-	uint32_t target_handle;
-	uint32_t delta;
-	uint64_t offset;
-	uint64_t presumed_offset;
-	uint32_t read_domains;
-	uint32_t write_domain;
-}__attribute__((packed));
-
-struct trace_wait {
-	uint8_t cmd;
-	uint32_t handle;
-} __attribute__((packed));
+#define DRM_MAJOR 226
 
 static void __attribute__ ((format(__printf__, 2, 3)))
 fail_if(int cond, const char *format, ...)
@@ -139,6 +96,139 @@ fail_if(int cond, const char *format, ...)
 #define LOCAL_I915_EXEC_FENCE_IN              (1<<16)
 #define LOCAL_I915_EXEC_FENCE_OUT             (1<<17)
 
+static void
+trace_flush_stream(struct trace *trace, struct trace_stream *s)
+{
+	struct trace_block b = {
+		.stream = s->stream,
+		.length = s->len,
+		.count = s->count,
+		.seqno = s->seqno,
+		.timestamp = s->timestamp,
+	};
+
+	if (!s->count)
+		return;
+
+	while (s->len & (TRACE_ALIGN - 1))
+		s->data[s->len++] = 0;
+	b.length = s->len;
+
+	if (trace->nr_blocks == trace->max_blocks) {
+		trace->max_blocks = trace->max_blocks ? 2 * trace->max_blocks : 256;
+		trace->blocks = realloc(trace->blocks,
+					trace->max_blocks * sizeof(*trace->blocks));
+		fail_if(!trace->blocks, "out of memory for the trace index\n");
+	}
+	trace->blocks[trace->nr_blocks++] = ftello(trace->file);
+
+	fwrite(&b, sizeof(b), 1, trace->file);
+	fwrite(s->data, s->len, 1, trace->file);
+	fflush(trace->file);
+
+	s->len = 0;
+	s->count = 0;
+	s->last_handle = 0;
+}
+
+/*
+ * Starts a command of at most len bytes on the stream and returns where its
+ * payload goes. Called with the trace file locked.
+ */
+static uint8_t *
+trace_begin(struct trace *trace, struct trace_stream **ps, uint32_t stream,
+	    uint8_t cmd, size_t len)
+{
+	struct trace_stream *s = NULL;
+	struct timespec ts;
+	uint64_t now;
+	uint8_t *ptr;
+	unsigned int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+	for (i = 0; i < trace->nr_streams; i++) {
+		if (trace->streams[i].stream == stream) {
+			s = &trace->streams[i];
+			break;
+		}
+	}
+	if (!s) {
+		trace->streams = realloc(trace->streams,
+					 (trace->nr_streams + 1) * sizeof(*s));
+		fail_if(!trace->streams, "out of memory for trace streams\n");
+		s = &trace->streams[trace->nr_streams++];
+		memset(s, 0, sizeof(*s));
+		s->stream = stream;
+	}
+
+	len += 1 + 2 * TRACE_VARINT_MAX + TRACE_ALIGN;
+	if (s->len + len > s->size) {
+		if (s->len + len > TRACE_BLOCK_SIZE)
+			trace_flush_stream(trace, s);
+
+		if (len > s->size) {
+			s->size = len > TRACE_BLOCK_SIZE ? len : TRACE_BLOCK_SIZE;
+			s->data = realloc(s->data, s->size);
+			fail_if(!s->data, "out of memory for trace blocks\n");
+		}
+	}
+
+	ptr = s->data + s->len;
+	*ptr++ = cmd;
+	if (!s->count) {
+		s->seqno = trace->seqno;
+		s->timestamp = now;
+		ptr = trace_put_varint(ptr, 0);
+		ptr = trace_put_varint(ptr, 0);
+	} else {
+		ptr = trace_put_varint(ptr, trace->seqno - s->last - 1);
+		ptr = trace_put_varint(ptr, now - s->last_time);
+	}
+	s->last_time = now;
+
+	*ps = s;
+	return ptr;
+}
+
+static void
+trace_end(struct trace *trace, struct trace_stream *s, uint8_t *ptr)
+{
+	s->len = ptr - s->data;
+	s->count++;
+	s->last = trace->seqno++;
+
+	if (s->len >= TRACE_BLOCK_SIZE)
+		trace_flush_stream(trace, s);
+}
+
+static void
+trace_handle(struct trace *trace, uint32_t stream, uint8_t cmd,
+	     uint32_t handle, uint64_t size)
+{
+	struct trace_stream *s;
+	uint8_t *ptr;
+
+	flockfile(trace->file);
+
+	ptr = trace_begin(trace, &s, stream, cmd, 2 * TRACE_VARINT_MAX);
+	if (cmd == ADD_CTX || cmd == DEL_CTX) {
+		ptr = trace_put_varint(ptr, handle);
+		if (handle > trace->max_ctx)
+			trace->max_ctx = handle;
+	} else {
+		ptr = trace_put_handle(ptr, &s->last_handle, handle);
+		if (handle > trace->max_bo)
+			trace->max_bo = handle;
+	}
+	if (cmd == ADD_BO)
+		ptr = trace_put_varint(ptr, size);
+	trace_end(trace, s, ptr);
+
+	funlockfile(trace->file);
+}
+
 static void
 trace_exec(struct trace *trace,
 	   const struct drm_i915_gem_execbuffer2 *execbuffer2)
@@ -146,42 +236,61 @@ trace_exec(struct trace *trace,
 #define to_ptr(T, x) ((T *)(uintptr_t)(x))
 	const struct drm_i915_gem_exec_object2 *exec_objects =
 		to_ptr(typeof(*exec_objects), execbuffer2->buffers_ptr);
+	uint32_t context = execbuffer2->rsvd1;
+	struct trace_stream *s;
+	size_t len;
+	uint8_t *ptr;
 
 	fail_if(execbuffer2->flags & (LOCAL_I915_EXEC_FENCE_IN | LOCAL_I915_EXEC_FENCE_OUT),
 		"fences not supported yet\n");
 
+	len = 2 * TRACE_VARINT_MAX;
+	for (uint32_t i = 0; i < execbuffer2->buffer_count; i++)
+		len += 7 * TRACE_VARINT_MAX + TRACE_ALIGN +
+		       exec_objects[i].relocation_count *
+		       sizeof(struct drm_i915_gem_relocation_entry);
+
 	flockfile(trace->file);
-	{
-		struct trace_exec t = {
-			EXEC,
-			execbuffer2->buffer_count,
-			execbuffer2->flags,
-			execbuffer2->rsvd1,
-		};
-		fwrite(&t, sizeof(t), 1, trace->file);
-	}
+
+	ptr = trace_begin(trace, &s, context + 1, EXEC, len);
+	ptr = trace_put_varint(ptr, execbuffer2->buffer_count);
+	ptr = trace_put_varint(ptr, execbuffer2->flags);
 
 	for (uint32_t i = 0; i < execbuffer2->buffer_count; i++) {
 		const struct drm_i915_gem_exec_object2 *obj = &exec_objects[i];
-		const struct drm_i915_gem_relocation_entry *relocs =
-			to_ptr(typeof(*relocs), obj->relocs_ptr);
-		{
-			struct trace_exec_object t = {
-				obj->handle,
-				obj->relocation_count,
-				obj->alignment,
-				obj->offset,
-				obj->flags,
-				obj->rsvd1,
-				obj->rsvd2
-			};
-			fwrite(&t, sizeof(t), 1, trace->file);
+		size_t sz = obj->relocation_count *
+			    sizeof(struct drm_i915_gem_relocation_entry);
+
+		ptr = trace_put_handle(ptr, &s->last_handle, obj->handle);
+		ptr = trace_put_varint(ptr, obj->relocation_count);
+		ptr = trace_put_varint(ptr, obj->alignment);
+		ptr = trace_put_varint(ptr, obj->offset);
+		ptr = trace_put_varint(ptr, obj->flags);
+		ptr = trace_put_varint(ptr, obj->rsvd1);
+		ptr = trace_put_varint(ptr, obj->rsvd2);
+
+		if (sz) {
+			while ((ptr - s->data) & (TRACE_ALIGN - 1))
+				*ptr++ = 0;
+			memcpy(ptr, to_ptr(void, obj->relocs_ptr), sz);
+			ptr += sz;
 		}
-		fwrite(relocs, sizeof(*relocs), obj->relocation_count,
-		       trace->file);
+
+		if (obj->handle > trace->max_bo)
+			trace->max_bo = obj->handle;
 	}
 
-	fflush(trace->file);
+	trace_end(trace, s, ptr);
+	if (context > trace->max_ctx)
+		trace->max_ctx = context;
+
+	/*
+	 * Write out every execbuf, along with the commands it depends on,
+	 * so that a crash or kill of the traced process loses none of them.
+	 */
+	for (unsigned int i = 0; i < trace->nr_streams; i++)
+		trace_flush_stream(trace, &trace->streams[i]);
+
 	funlockfile(trace->file);
 #undef to_ptr
 }
@@ -189,36 +298,66 @@ trace_exec(struct trace *trace,
 static void
 trace_wait(struct trace *trace, uint32_t handle)
 {
-	struct trace_wait t = { WAIT, handle };
-	fwrite(&t, sizeof(t), 1, trace->file);
+	trace_handle(trace, 0, WAIT, handle, 0);
 }
 
 static void
 trace_add(struct trace *trace, uint32_t handle, uint64_t size)
 {
-	struct trace_add_bo t = { ADD_BO, handle, size };
-	fwrite(&t, sizeof(t), 1, trace->file);
+	trace_handle(trace, 0, ADD_BO, handle, size);
 }
 
 static void
 trace_del(struct trace *trace, uint32_t handle)
 {
-	struct trace_del_bo t = { DEL_BO, handle };
-	fwrite(&t, sizeof(t), 1, trace->file);
+	trace_handle(trace, 0, DEL_BO, handle, 0);
 }
 
 static void
 trace_add_context(struct trace *trace, uint32_t handle)
 {
-	struct trace_add_ctx t = { ADD_CTX, handle };
-	fwrite(&t, sizeof(t), 1, trace->file);
+	trace_handle(trace, 0, ADD_CTX, handle, 0);
 }
 
 static void
 trace_del_context(struct trace *trace, uint32_t handle)
 {
-	struct trace_del_ctx t = { DEL_CTX, handle };
-	fwrite(&t, sizeof(t), 1, trace->file);
+	trace_handle(trace, 0, DEL_CTX, handle, 0);
+}
+
+static void
+trace_close(struct trace *trace)
+{
+	struct trace_header header = {
+		.magic = TRACE_MAGIC,
+		.version = TRACE_VERSION,
+	};
+	struct trace_index index = {
+		.nr_cmds = trace->seqno,
+		.nr_streams = trace->nr_streams,
+		.max_bo = trace->max_bo,
+		.max_ctx = trace->max_ctx,
+	};
+	unsigned int i;
+
+	for (i = 0; i < trace->nr_streams; i++) {
+		trace_flush_stream(trace, &trace->streams[i]);
+		free(trace->streams[i].data);
+	}
+	free(trace->streams);
+
+	index.nr_blocks = trace->nr_blocks;
+	header.index = ftello(trace->file);
+	fwrite(&index, sizeof(index), 1, trace->file);
+	fwrite(trace->blocks, sizeof(*trace->blocks), trace->nr_blocks,
+	       trace->file);
+	free(trace->blocks);
+
+	fseeko(trace->file, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, trace->file);
+
+	fclose(trace->file);
+	free(trace);
 }
 
 int
@@ -230,8 +369,7 @@ close(int fd)
 	for (p = &traces; (t = *p); p = &t->next) {
 		if (t->fd == fd) {
 			*p = t->next;
-			fclose(t->file);
-			free(t);
+			trace_close(t);
 			break;
 		}
 	}
@@ -299,6 +437,10 @@ ioctl(int fd, unsigned long request, ...)
 		}
 	}
 	if (!t) {
+		struct trace_header header = {
+			.magic = TRACE_MAGIC,
+			.version = TRACE_VERSION,
+		};
 		char filename[80];
 
 		if (!is_i915(fd)) {
@@ -306,7 +448,7 @@ ioctl(int fd, unsigned long request, ...)
 			goto untraced;
 		}
 
-		t = malloc(sizeof(*t));
+		t = calloc(1, sizeof(*t));
 		if (!t) {
 			pthread_mutex_unlock(&mutex);
 			return -ENOMEM;
@@ -316,7 +458,7 @@ ioctl(int fd, unsigned long request, ...)
 		t->file = fopen(filename, "w+");
 		t->fd = fd;
 
-		if (!fwrite(&version, sizeof(version), 1, t->file)) {
+		if (!fwrite(&header, sizeof(header), 1, t->file)) {
 			pthread_mutex_unlock(&mutex);
 			fclose(t->file);
 			free(t);
@@ -417,3 +559,17 @@ init(void)
 	fail_if(libc_close == NULL || libc_ioctl == NULL,
 		"failed to get libc ioctl or close\n");
 }
+
+static void __attribute__ ((destructor))
+fini(void)
+{
+	struct trace *t;
+
+	/* Complete the traces of the fds left open at exit */
+	pthread_mutex_lock(&mutex);
+	while ((t = traces)) {
+		traces = t->next;
+		trace_close(t);
+	}
+	pthread_mutex_unlock(&mutex);
+}
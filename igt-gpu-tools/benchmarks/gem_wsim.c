@@ -40,6 +40,8 @@
 #include <assert.h>
 #include <limits.h>
 #include <pthread.h>
+#include <sched.h>
+#include <getopt.h>
 
 
 #include "intel_chipset.h"
@@ -93,6 +95,20 @@ struct deps
 	int *list;
 };
 
+/*
+ * With --simulate requests retire in order on each context and engine, so
+ * a timeline of seqnos per context and engine is enough to track them.
+ */
+struct sim_timeline {
+	uint32_t submitted;
+	uint32_t completed;
+};
+
+struct sim_fence {
+	struct sim_timeline *tl;
+	uint32_t seqno;
+};
+
 struct w_arg {
 	char *filename;
 	char *desc;
@@ -121,15 +137,19 @@ struct w_step
 
 	/* Implementation details */
 	unsigned int idx;
-	struct igt_list rq_link;
+	unsigned int rq_slot;
 	unsigned int request;
 	unsigned int preempt_us;
+	struct sim_fence sim_fence;
 
 	struct drm_i915_gem_execbuffer2 eb;
+	uint64_t eb_flags[NUM_ENGINES];
 	struct drm_i915_gem_exec_object2 *obj;
 	struct drm_i915_gem_relocation_entry reloc[4];
 	unsigned long bb_sz;
 	uint32_t bb_handle;
+	enum intel_engine_id bb_engine;
+	bool bb_idle;
 	uint32_t *mapped_batch;
 	uint32_t *seqno_value;
 	uint32_t *seqno_address;
@@ -143,6 +163,43 @@ struct w_step
 
 DECLARE_EWMA(uint64_t, rt, 4, 2)
 
+/*
+ * Log-linear latency histogram with 2^LAT_SUB_BITS buckets per power of two,
+ * giving about 3% precision over nanoseconds to minutes.
+ */
+#define LAT_SUB_BITS	5
+#define LAT_MAX_BITS	38
+#define LAT_BUCKETS	((LAT_MAX_BITS - LAT_SUB_BITS + 1) << LAT_SUB_BITS)
+
+struct latency_hist {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+	uint32_t bucket[LAT_BUCKETS];
+};
+
+/*
+ * Owned by the client thread and only merged once all clients have finished.
+ * Batch steps record submit to complete latency, period steps how late they
+ * started the next iteration.
+ */
+struct latency_stats {
+	struct latency_hist engine[NUM_ENGINES];
+	struct latency_hist *step;
+	unsigned long *dropped;
+
+	/* Submitted batches whose out fence is yet to be read. */
+	struct latency_request {
+		int fence;
+		unsigned int step;
+		enum intel_engine_id engine;
+		uint64_t submit;
+	} *inflight;
+	unsigned int nr_inflight;
+	unsigned int max_inflight;
+};
+
 struct workload
 {
 	unsigned int id;
@@ -182,8 +239,22 @@ struct workload
 	unsigned long qd_sum[NUM_ENGINES];
 	unsigned long nr_bb[NUM_ENGINES];
 
-	struct igt_list requests[NUM_ENGINES];
-	unsigned int nrequest[NUM_ENGINES];
+	int cpu;
+	unsigned long nr_submit;
+	uint64_t cpu_ns;
+
+	/*
+	 * Most recent submission of each step per engine, oldest first.
+	 * Resubmitting a step leaves a stale slot behind, which is skipped
+	 * and reclaimed once it reaches either end of the ring.
+	 */
+	struct request_ring {
+		struct w_step **slot;
+		unsigned int size;
+		unsigned int head;
+		unsigned int tail;
+		unsigned int count;
+	} requests[NUM_ENGINES];
 
 	struct workload *global_wrk;
 	const struct workload_balancer *global_balancer;
@@ -200,11 +271,29 @@ struct workload
 		int fd;
 		bool first;
 		unsigned int num_engines;
-		unsigned int engine_map[5];
+		unsigned int engine_map[NUM_ENGINES];
 		uint64_t t_prev;
 		uint64_t prev[5];
 		double busy[5];
 	} busy_balancer;
+
+	struct latency_stats *latency;
+
+	struct sim_client {
+		unsigned int state;
+		unsigned int count;
+		unsigned int step;
+		enum intel_engine_id engine;
+		int throttle;
+		int qd_throttle;
+		bool last_sync;
+		uint32_t cur_seqno;
+		uint64_t wake;
+		uint64_t repeat_start;
+		uint64_t t_end;
+		struct sim_timeline sw_timeline;
+		struct sim_timeline *timelines;
+	} sim;
 };
 
 static const unsigned int nop_calibration_us = 1000;
@@ -214,6 +303,7 @@ static unsigned int context_vcs_rr;
 
 static int verbose = 1;
 static int fd;
+static bool simulate;
 
 #define SWAPVCS		(1<<0)
 #define SEQNO		(1<<1)
@@ -225,6 +315,7 @@ static int fd;
 #define HEARTBEAT	(1<<7)
 #define GLOBAL_BALANCE	(1<<8)
 #define DEPSYNC		(1<<9)
+#define LATENCY		(1<<10)
 
 #define SEQNO_IDX(engine) ((engine) * 16)
 #define SEQNO_OFFSET(engine) (SEQNO_IDX(engine) * sizeof(uint32_t))
@@ -687,7 +778,7 @@ clone_workload(struct workload *_wrk)
 	memcpy(wrk->steps, _wrk->steps, sizeof(struct w_step) * wrk->nr_steps);
 
 	/* Check if we need a sw sync timeline. */
-	for (i = 0; i < wrk->nr_steps; i++) {
+	for (i = 0; !simulate && i < wrk->nr_steps; i++) {
 		if (wrk->steps[i].type == SW_FENCE) {
 			wrk->sync_timeline = sw_sync_timeline_create();
 			igt_assert(wrk->sync_timeline >= 0);
@@ -695,12 +786,87 @@ clone_workload(struct workload *_wrk)
 		}
 	}
 
-	for (i = 0; i < NUM_ENGINES; i++)
-		igt_list_init(&wrk->requests[i]);
+	for (i = 0; i < NUM_ENGINES; i++) {
+		struct request_ring *ring = &wrk->requests[i];
+
+		ring->size = roundup_power_of_two(2 * wrk->nr_steps);
+		ring->slot = calloc(ring->size, sizeof(*ring->slot));
+		igt_assert(ring->slot);
+	}
 
 	return wrk;
 }
 
+static bool
+request_live(struct workload *wrk, enum intel_engine_id engine,
+	     unsigned int idx)
+{
+	struct request_ring *ring = &wrk->requests[engine];
+	struct w_step *w = ring->slot[idx & (ring->size - 1)];
+
+	return w->request == engine && w->rq_slot == idx;
+}
+
+static struct w_step *
+request_first(struct workload *wrk, enum intel_engine_id engine)
+{
+	struct request_ring *ring = &wrk->requests[engine];
+
+	return ring->slot[ring->head & (ring->size - 1)];
+}
+
+static struct w_step *
+request_last(struct workload *wrk, enum intel_engine_id engine)
+{
+	struct request_ring *ring = &wrk->requests[engine];
+
+	return ring->slot[(ring->tail - 1) & (ring->size - 1)];
+}
+
+static void request_del(struct workload *wrk, struct w_step *w)
+{
+	enum intel_engine_id engine = w->request;
+	struct request_ring *ring = &wrk->requests[engine];
+
+	w->request = -1;
+	ring->count--;
+
+	while (ring->head != ring->tail && !request_live(wrk, engine, ring->head))
+		ring->head++;
+	while (ring->head != ring->tail &&
+	       !request_live(wrk, engine, ring->tail - 1))
+		ring->tail--;
+}
+
+static void
+request_add(struct workload *wrk, struct w_step *w, enum intel_engine_id engine)
+{
+	struct request_ring *ring = &wrk->requests[engine];
+
+	if (w->request != -1)
+		request_del(wrk, w);
+
+	if (ring->tail - ring->head == ring->size) {
+		struct w_step **slot;
+		unsigned int i;
+
+		slot = calloc(2 * ring->size, sizeof(*slot));
+		igt_assert(slot);
+		for (i = ring->head; i != ring->tail; i++)
+			slot[i & (2 * ring->size - 1)] =
+				ring->slot[i & (ring->size - 1)];
+
+		free(ring->slot);
+		ring->slot = slot;
+		ring->size *= 2;
+	}
+
+	ring->slot[ring->tail & (ring->size - 1)] = w;
+	w->rq_slot = ring->tail++;
+	w->request = engine;
+	ring->count++;
+}
+
 #define rounddown(x, y) (x - (x%y))
 #ifndef PAGE_SIZE
 #define PAGE_SIZE (4096)
@@ -849,7 +1015,7 @@ eb_update_flags(struct w_step *w, enum intel_engine_id engine,
 	w->eb.flags |= I915_EXEC_NO_RELOC;
 
 	igt_assert(w->emit_fence <= 0);
-	if (w->emit_fence)
+	if (w->emit_fence || (flags & LATENCY))
 		w->eb.flags |= LOCAL_I915_EXEC_FENCE_OUT;
 }
 
@@ -916,11 +1082,18 @@ alloc_step_batch(struct workload *wrk, struct w_step *w, unsigned int flags)
 	w->eb.buffer_count = j + 1;
 	w->eb.rsvd1 = wrk->ctx_list[w->context].id;
 
+	for (i = 0; i < NUM_ENGINES; i++) {
+		eb_update_flags(w, i, flags);
+		w->eb_flags[i] = w->eb.flags;
+	}
+	w->bb_engine = NUM_ENGINES;
+	w->bb_idle = true;
+
 	if (flags & SWAPVCS && engine == VCS1)
 		engine = VCS2;
 	else if (flags & SWAPVCS && engine == VCS2)
 		engine = VCS1;
-	eb_update_flags(w, engine, flags);
+	w->eb.flags = w->eb_flags[engine];
 #ifdef DEBUG
 	printf("%u: %u:|", w->idx, w->eb.buffer_count);
 	for (i = 0; i <= j; i++)
@@ -946,13 +1119,27 @@ prepare_workload(unsigned int id, struct workload *wrk, unsigned int flags)
 	if (flags & INITVCSRR)
 		wrk->vcs_rr = id & 1;
 
+	if (flags & LATENCY) {
+		wrk->latency = calloc(1, sizeof(*wrk->latency));
+		igt_assert(wrk->latency);
+		wrk->latency->step = calloc(wrk->nr_steps,
+					    sizeof(*wrk->latency->step));
+		igt_assert(wrk->latency->step);
+		wrk->latency->dropped = calloc(wrk->nr_steps,
+					       sizeof(*wrk->latency->dropped));
+		igt_assert(wrk->latency->dropped);
+	}
+
 	if (flags & GLOBAL_BALANCE) {
 		int ret = pthread_mutex_init(&wrk->mutex, NULL);
 		igt_assert(ret == 0);
 	}
 
 	if (flags & SEQNO) {
-		if (!(flags & GLOBAL_BALANCE) || id == 0) {
+		if (simulate && (!(flags & GLOBAL_BALANCE) || id == 0)) {
+			wrk->status_page = calloc(1024, sizeof(uint32_t));
+			igt_assert(wrk->status_page);
+		} else if (!(flags & GLOBAL_BALANCE) || id == 0) {
 			uint32_t handle;
 
 			handle = gem_create(fd, 4096);
@@ -985,7 +1172,13 @@ prepare_workload(unsigned int id, struct workload *wrk, unsigned int flags)
 		if (!wrk->ctx_list[w->context].id) {
 			struct drm_i915_gem_context_create arg = {};
 
-			drmIoctl(fd, DRM_IOCTL_I915_GEM_CONTEXT_CREATE, &arg);
+			if (simulate) {
+				arg.ctx_id = w->context + 1;
+				wrk->ctx_list[w->context].priority = wrk->prio;
+			} else {
+				drmIoctl(fd, DRM_IOCTL_I915_GEM_CONTEXT_CREATE,
+					 &arg);
+			}
 			igt_assert(arg.ctx_id);
 
 			wrk->ctx_list[w->context].id = arg.ctx_id;
@@ -998,7 +1191,7 @@ prepare_workload(unsigned int id, struct workload *wrk, unsigned int flags)
 				ctx_vcs ^= 1;
 			}
 
-			if (wrk->prio) {
+			if (wrk->prio && !simulate) {
 				struct drm_i915_gem_context_param param = {
 					.ctx_id = arg.ctx_id,
 					.param = I915_CONTEXT_PARAM_PRIORITY,
@@ -1041,6 +1234,17 @@ prepare_workload(unsigned int id, struct workload *wrk, unsigned int flags)
 		}
 	}
 
+	/*
+	 * Simulated engines track requests per context and engine, plus one
+	 * set of timelines for the heartbeats on the default context.
+	 */
+	if (simulate) {
+		wrk->sim.timelines = calloc((wrk->nr_ctxs + 1) * NUM_ENGINES,
+					    sizeof(*wrk->sim.timelines));
+		igt_assert(wrk->sim.timelines);
+		return;
+	}
+
 	/*
 	 * Allocate batch buffers.
 	 */
@@ -1069,6 +1273,164 @@ static int elapsed_us(const struct timespec *start, const struct timespec *end)
 	return elapsed(start, end) * 1e6;
 }
 
+static uint64_t gettime_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned int latency_bucket(uint64_t v)
+{
+	unsigned int e;
+
+	if (v < (1 << LAT_SUB_BITS))
+		return v;
+
+	v = min(v, (1ULL << LAT_MAX_BITS) - 1);
+	e = igt_fls(v) - 1;
+
+	return ((e - LAT_SUB_BITS + 1) << LAT_SUB_BITS) +
+	       (v >> (e - LAT_SUB_BITS)) - (1 << LAT_SUB_BITS);
+}
+
+/* Highest value which falls into the bucket. */
+static uint64_t latency_bucket_value(unsigned int idx)
+{
+	unsigned int e, sub;
+
+	if (idx < (1 << LAT_SUB_BITS))
+		return idx;
+
+	e = (idx >> LAT_SUB_BITS) + LAT_SUB_BITS - 1;
+	sub = idx & ((1 << LAT_SUB_BITS) - 1);
+
+	return ((((1ULL << LAT_SUB_BITS) + sub + 1)) << (e - LAT_SUB_BITS)) - 1;
+}
+
+static void latency_add(struct latency_hist *h, uint64_t v)
+{
+	if (!h->count || v < h->min)
+		h->min = v;
+	if (v > h->max)
+		h->max = v;
+
+	h->count++;
+	h->sum += v;
+	h->bucket[latency_bucket(v)]++;
+}
+
+static void latency_merge(struct latency_hist *dst,
+			  const struct latency_hist *src)
+{
+	unsigned int i;
+
+	if (!src->count)
+		return;
+
+	if (!dst->count || src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+
+	dst->count += src->count;
+	dst->sum += src->sum;
+	for (i = 0; i < LAT_BUCKETS; i++)
+		dst->bucket[i] += src->bucket[i];
+}
+
+static uint64_t latency_percentile(const struct latency_hist *h, double pct)
+{
+	double rank = h->count * pct / 100;
+	uint64_t target = rank, total = 0;
+	unsigned int i;
+
+	if (!h->count)
+		return 0;
+
+	if (target < rank || !target)
+		target++;
+
+	for (i = 0; i < LAT_BUCKETS - 1; i++) {
+		total += h->bucket[i];
+		if (total >= target)
+			break;
+	}
+
+	return clamp(latency_bucket_value(i), h->min, h->max);
+}
+
+static void
+record_latency(struct workload *wrk, unsigned int step,
+	       enum intel_engine_id engine, uint64_t ns)
+{
+	latency_add(&wrk->latency->step[step], ns);
+	latency_add(&wrk->latency->engine[engine], ns);
+}
+
+static void
+track_latency(struct workload *wrk, struct w_step *w,
+	      enum intel_engine_id engine, uint64_t submit, int fence)
+{
+	struct latency_stats *lat = wrk->latency;
+
+	if (lat->nr_inflight == lat->max_inflight) {
+		lat->max_inflight = max(2 * lat->max_inflight, 64u);
+		lat->inflight = realloc(lat->inflight,
+					lat->max_inflight *
+					sizeof(*lat->inflight));
+		igt_assert(lat->inflight);
+	}
+
+	lat->inflight[lat->nr_inflight++] = (struct latency_request) {
+		.fence = fence,
+		.step = w->idx,
+		.engine = engine,
+		.submit = submit,
+	};
+}
+
+/*
+ * Reads the signal time of completed batches from their out fences, so the
+ * latency does not depend on when we get around to looking. Unless waiting,
+ * the scan for an engine stops at the first batch still executing on it.
+ */
+static void retire_latency(struct workload *wrk, bool wait)
+{
+	struct latency_stats *lat = wrk->latency;
+	unsigned int busy = 0, i, j;
+
+	for (i = j = 0; i < lat->nr_inflight; i++) {
+		struct latency_request *rq = &lat->inflight[i];
+		uint64_t ts;
+		int status;
+
+		if (busy & (1 << rq->engine)) {
+			lat->inflight[j++] = *rq;
+			continue;
+		}
+
+		if (wait)
+			sync_fence_wait(rq->fence, -1);
+
+		status = sync_fence_timestamp(rq->fence, &ts);
+		if (status == SW_SYNC_FENCE_STATUS_ACTIVE && !wait) {
+			busy |= 1 << rq->engine;
+			lat->inflight[j++] = *rq;
+			continue;
+		}
+
+		if (status == SW_SYNC_FENCE_STATUS_SIGNALED)
+			record_latency(wrk, rq->step, rq->engine,
+				       ts > rq->submit ? ts - rq->submit : 0);
+		close(rq->fence);
+	}
+
+	lat->nr_inflight = j;
+}
+
 static enum intel_engine_id get_vcs_engine(unsigned int n)
 {
 	const enum intel_engine_id vcs_engines[2] = { VCS1, VCS2 };
@@ -1125,6 +1487,213 @@ current_gpu_seqno(struct workload *wrk, enum intel_engine_id engine)
        return read_status_page(wrk, SEQNO_IDX(engine));
 }
 
+/*
+ * Simulated engines
+ *
+ * With --simulate no device is used. Each engine is a queue executing one
+ * request at a time in virtual time, picking the highest priority runnable
+ * request and switching away from it at its next arbitration point when a
+ * higher priority one becomes runnable. Completing requests write their
+ * seqnos and timestamps to the status page just like the batches do on the
+ * GPU, so the balancers see the same state as on real hardware.
+ */
+
+#define SIM_TIMESTAMP_NS 80 /* Roughly the 12.5MHz CS timestamp. */
+
+struct sim_request {
+	struct igt_list link;
+	struct workload *wrk;
+	struct w_step *w;
+	enum intel_engine_id engine;
+	enum intel_engine_id ring;
+	struct sim_fence fence;
+	unsigned int flags;
+	int prio;
+	uint32_t seqno;
+	uint32_t submitted;
+	uint64_t submit;
+	uint64_t duration;
+	uint64_t executed;
+	uint64_t preempt;
+	unsigned int nr_deps;
+	struct sim_fence deps[];
+};
+
+static struct sim_engine {
+	struct igt_list queue;
+	struct sim_request *active;
+	uint64_t start;
+	uint64_t next;
+	uint64_t busy;
+	unsigned int scale;
+} sim_engines[NUM_ENGINES];
+
+static uint64_t sim_now;
+static uint64_t sim_submit_ns = 10000;
+
+static uint32_t sim_timestamp(void)
+{
+	return sim_now / SIM_TIMESTAMP_NS;
+}
+
+static bool sim_fence_done(const struct sim_fence *f)
+{
+	return !f->tl || (int32_t)(f->tl->completed - f->seqno) >= 0;
+}
+
+static enum intel_engine_id
+sim_ring(enum intel_engine_id engine, unsigned int flags)
+{
+	/* A plain BSD submission goes to one VCS engine per file. */
+	if (engine == VCS)
+		engine = VCS1;
+	else if (engine == VCS2 && (flags & VCS2REMAP))
+		engine = BCS;
+
+	return engine;
+}
+
+static uint64_t sim_engine_busy(enum intel_engine_id ring)
+{
+	struct sim_engine *e = &sim_engines[ring];
+
+	return e->busy + (e->active ? sim_now - e->start : 0);
+}
+
+static uint32_t *sim_status_page(struct workload *wrk)
+{
+	if (wrk->flags & GLOBAL_BALANCE)
+		return wrk->global_wrk->status_page;
+	else
+		return wrk->status_page;
+}
+
+static struct sim_request *
+sim_request_create(struct workload *wrk, enum intel_engine_id engine,
+		   unsigned int ctx, unsigned int nr_deps)
+{
+	enum intel_engine_id ring = sim_ring(engine, wrk->flags);
+	struct sim_timeline *tl = &wrk->sim.timelines[ctx * NUM_ENGINES + ring];
+	struct sim_request *rq;
+
+	rq = calloc(1, sizeof(*rq) + nr_deps * sizeof(rq->deps[0]));
+	igt_assert(rq);
+
+	rq->wrk = wrk;
+	rq->engine = engine;
+	rq->ring = ring;
+	rq->fence.tl = tl;
+	rq->fence.seqno = ++tl->submitted;
+	rq->submitted = sim_timestamp();
+	rq->submit = sim_now;
+
+	return rq;
+}
+
+static void sim_request_submit(struct sim_request *rq)
+{
+	igt_list_add_tail(&rq->link, &sim_engines[rq->ring].queue);
+}
+
+static bool sim_request_ready(const struct sim_request *rq)
+{
+	unsigned int i;
+
+	if (rq->fence.tl->completed + 1 != rq->fence.seqno)
+		return false;
+
+	for (i = 0; i < rq->nr_deps; i++) {
+		if (!sim_fence_done(&rq->deps[i]))
+			return false;
+	}
+
+	return true;
+}
+
+static void sim_request_retire(struct sim_request *rq)
+{
+	uint32_t *status = sim_status_page(rq->wrk);
+	const unsigned int idx = SEQNO_IDX(rq->engine);
+
+	if (status) {
+		if (rq->flags & SEQNO)
+			status[idx] = rq->seqno;
+		if (rq->flags & RT) {
+			status[idx + 1] = rq->submitted;
+			status[idx + 2] = sim_timestamp();
+		}
+		if (rq->flags & (RT | HEARTBEAT))
+			status[idx + 3] = rq->seqno;
+	}
+
+	rq->fence.tl->completed = rq->fence.seqno;
+
+	if (rq->w && (rq->wrk->flags & LATENCY))
+		record_latency(rq->wrk, rq->w->idx, rq->engine,
+			       sim_now - rq->submit);
+
+	igt_list_del(&rq->link);
+	free(rq);
+}
+
+static struct sim_request *sim_engine_select(struct sim_engine *e)
+{
+	struct sim_request *rq, *best = NULL;
+
+	igt_list_for_each(rq, &e->queue, link) {
+		if (rq == e->active || (best && rq->prio <= best->prio))
+			continue;
+
+		if (sim_request_ready(rq))
+			best = rq;
+	}
+
+	return best;
+}
+
+static void sim_engine_schedule(struct sim_engine *e)
+{
+	struct sim_request *rq = sim_engine_select(e);
+	struct sim_request *active;
+	uint64_t pos, arb;
+
+	if (!e->active) {
+		e->next = ~0ULL;
+		if (!rq)
+			return;
+
+		e->active = rq;
+		e->start = sim_now;
+	}
+
+	active = e->active;
+	e->next = e->start + active->duration - active->executed;
+
+	/* Switch to a higher priority request at the next arbitration point. */
+	if (!rq || rq->prio <= active->prio || !active->preempt)
+		return;
+
+	pos = active->executed + sim_now - e->start;
+	arb = DIV_ROUND_UP(pos, active->preempt) * active->preempt;
+	if (arb < active->duration)
+		e->next = e->start + arb - active->executed;
+}
+
+static void sim_engine_advance(struct sim_engine *e)
+{
+	struct sim_request *rq = e->active;
+
+	if (!rq || e->next > sim_now)
+		return;
+
+	e->busy += sim_now - e->start;
+	e->active = NULL;
+
+	rq->executed += sim_now - e->start;
+	if (rq->executed >= rq->duration)
+		sim_request_retire(rq);
+}
+
 struct workload_balancer {
 	unsigned int id;
 	const char *name;
@@ -1402,8 +1971,20 @@ get_pmu_stats(const struct workload_balancer *b, struct workload *wrk)
 	uint64_t val[7];
 	unsigned int i;
 
-	igt_assert_eq(read(bb->fd, val, sizeof(val)),
-		      (2 + bb->num_engines) * sizeof(uint64_t));
+	if (simulate) {
+		val[1] = sim_now;
+		for (i = 0; i < NUM_ENGINES; i++) {
+			if (i != VCS)
+				val[2 + bb->engine_map[i]] = sim_engine_busy(i);
+		}
+	} else {
+		igt_assert_eq(read(bb->fd, val, sizeof(val)),
+			      (2 + bb->num_engines) * sizeof(uint64_t));
+	}
+
+	/* Simulated clients can balance several times in the same instant. */
+	if (!bb->first && val[1] == bb->t_prev)
+		return;
 
 	if (!bb->first) {
 		for (i = 0; i < bb->num_engines; i++) {
@@ -1460,6 +2041,13 @@ busy_init(const struct workload_balancer *balancer, struct workload *wrk)
 	bb->first = true;
 	bb->fd = -1;
 
+	if (simulate) {
+		for (d = &engines[0]; d->id != VCS; d++)
+			bb->engine_map[d->id] = bb->num_engines++;
+
+		return 0;
+	}
+
 	for (d = &engines[0]; d->id != VCS; d++) {
 		int pfd;
 
@@ -1621,10 +2209,8 @@ static const struct workload_balancer global_balancer = {
 static void
 update_bb_seqno(struct w_step *w, enum intel_engine_id engine, uint32_t seqno)
 {
-	gem_set_domain(fd, w->bb_handle,
-		       I915_GEM_DOMAIN_WC, I915_GEM_DOMAIN_WC);
-
-	w->reloc[0].delta = SEQNO_OFFSET(engine);
+	if (engine != w->bb_engine)
+		w->reloc[0].delta = SEQNO_OFFSET(engine);
 
 	*w->seqno_value = seqno;
 	*w->seqno_address = w->reloc[0].presumed_offset + w->reloc[0].delta;
@@ -1637,12 +2223,11 @@ update_bb_seqno(struct w_step *w, enum intel_engine_id engine, uint32_t seqno)
 static void
 update_bb_rt(struct w_step *w, enum intel_engine_id engine, uint32_t seqno)
 {
-	gem_set_domain(fd, w->bb_handle,
-		       I915_GEM_DOMAIN_WC, I915_GEM_DOMAIN_WC);
-
-	w->reloc[1].delta = SEQNO_OFFSET(engine) + sizeof(uint32_t);
-	w->reloc[2].delta = SEQNO_OFFSET(engine) + 2 * sizeof(uint32_t);
-	w->reloc[3].delta = SEQNO_OFFSET(engine) + 3 * sizeof(uint32_t);
+	if (engine != w->bb_engine) {
+		w->reloc[1].delta = SEQNO_OFFSET(engine) + sizeof(uint32_t);
+		w->reloc[2].delta = SEQNO_OFFSET(engine) + 2 * sizeof(uint32_t);
+		w->reloc[3].delta = SEQNO_OFFSET(engine) + 3 * sizeof(uint32_t);
+	}
 
 	*w->latch_value = seqno;
 	*w->latch_address = w->reloc[3].presumed_offset + w->reloc[3].delta;
@@ -1659,7 +2244,8 @@ update_bb_rt(struct w_step *w, enum intel_engine_id engine, uint32_t seqno)
 	}
 }
 
-static void w_sync_to(struct workload *wrk, struct w_step *w, int target)
+static struct w_step *
+get_sync_target(struct workload *wrk, int target)
 {
 	if (target < 0)
 		target = wrk->nr_steps + target;
@@ -1674,7 +2260,22 @@ static void w_sync_to(struct workload *wrk, struct w_step *w, int target)
 	igt_assert(target < wrk->nr_steps);
 	igt_assert(wrk->steps[target].type == BATCH);
 
-	gem_sync(fd, wrk->steps[target].obj[0].handle);
+	return &wrk->steps[target];
+}
+
+/*
+ * Waits for the last submission of a batch step. Once it has completed the
+ * batch can be rewritten for the next one without a set-domain round trip.
+ */
+static void w_step_sync(struct w_step *w)
+{
+	gem_sync(fd, w->obj[0].handle);
+	w->bb_idle = true;
+}
+
+static void w_sync_to(struct workload *wrk, struct w_step *w, int target)
+{
+	w_step_sync(get_sync_target(wrk, target));
 }
 
 static uint32_t *get_status_cs(struct workload *wrk)
@@ -1785,14 +2386,23 @@ do_eb(struct workload *wrk, struct w_step *w, enum intel_engine_id engine,
       unsigned int flags)
 {
 	uint32_t seqno = new_seqno(wrk, engine);
+	uint64_t submit = 0;
 	unsigned int i;
 
-	eb_update_flags(w, engine, flags);
+	w->eb.flags = w->eb_flags[engine];
 
-	if (flags & SEQNO)
-		update_bb_seqno(w, engine, seqno);
-	if (flags & RT)
-		update_bb_rt(w, engine, seqno);
+	if (flags & (SEQNO | RT)) {
+		if (!w->bb_idle)
+			gem_set_domain(fd, w->bb_handle,
+				       I915_GEM_DOMAIN_WC, I915_GEM_DOMAIN_WC);
+
+		if (flags & SEQNO)
+			update_bb_seqno(w, engine, seqno);
+		if (flags & RT)
+			update_bb_rt(w, engine, seqno);
+
+		w->bb_engine = engine;
+	}
 
 	w->eb.batch_start_offset =
 		ALIGN(w->bb_sz - get_bb_sz(get_duration(w)),
@@ -1810,14 +2420,28 @@ do_eb(struct workload *wrk, struct w_step *w, enum intel_engine_id engine,
 		w->eb.rsvd2 = wrk->steps[tgt].emit_fence;
 	}
 
+	if (flags & LATENCY)
+		submit = gettime_ns();
+
 	if (w->eb.flags & LOCAL_I915_EXEC_FENCE_OUT)
 		gem_execbuf_wr(fd, &w->eb);
 	else
 		gem_execbuf(fd, &w->eb);
+	w->bb_idle = false;
+	wrk->nr_submit++;
 
 	if (w->eb.flags & LOCAL_I915_EXEC_FENCE_OUT) {
-		w->emit_fence = w->eb.rsvd2 >> 32;
-		igt_assert(w->emit_fence > 0);
+		int fence = w->eb.rsvd2 >> 32;
+
+		igt_assert(fence > 0);
+		if (w->emit_fence) {
+			w->emit_fence = fence;
+			if (flags & LATENCY)
+				fence = dup(fence);
+		}
+
+		if (flags & LATENCY)
+			track_latency(wrk, w, engine, submit, fence);
 	}
 }
 
@@ -1839,7 +2463,7 @@ static bool sync_deps(struct workload *wrk, struct w_step *w)
 		igt_assert(dep_idx >= 0 && dep_idx < w->idx);
 		igt_assert(wrk->steps[dep_idx].type == BATCH);
 
-		gem_sync(fd, wrk->steps[dep_idx].obj[0].handle);
+		w_step_sync(&wrk->steps[dep_idx]);
 
 		synced = true;
 	}
@@ -1847,10 +2471,28 @@ static bool sync_deps(struct workload *wrk, struct w_step *w)
 	return synced;
 }
 
+static void print_workload_stats(struct workload *wrk, double t, int count)
+{
+	printf("%c%u: %.3fs elapsed (%d cycles, %.3f workloads/s).",
+	       wrk->background ? ' ' : '*', wrk->id,
+	       t, count, count / t);
+	if (wrk->balancer)
+		printf(" %lu (%lu + %lu) total VCS batches.",
+		       wrk->nr_bb[VCS], wrk->nr_bb[VCS1], wrk->nr_bb[VCS2]);
+	if (wrk->balancer && wrk->balancer->get_qd)
+		printf(" Average queue depths %.3f, %.3f.",
+		       (double)wrk->qd_sum[VCS1] / wrk->nr_bb[VCS],
+		       (double)wrk->qd_sum[VCS2] / wrk->nr_bb[VCS]);
+	if (!simulate && wrk->nr_submit)
+		printf(" %.1fus CPU per batch.",
+		       wrk->cpu_ns / 1e3 / wrk->nr_submit);
+	putchar('\n');
+}
+
 static void *run_workload(void *data)
 {
 	struct workload *wrk = (struct workload *)data;
-	struct timespec t_start, t_end;
+	struct timespec t_start, t_end, cpu_start, cpu_end;
 	struct w_step *w;
 	bool last_sync = false;
 	int throttle = -1;
@@ -1859,6 +2501,7 @@ static void *run_workload(void *data)
 	int i;
 
 	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
 
 	hars_petruska_f54_1_random_seed((wrk->flags & SYNCEDCLIENTS) ?
 					0 : wrk->id);
@@ -1887,6 +2530,11 @@ static void *run_workload(void *data)
 					if (verbose > 1)
 						printf("%u: Dropped period @ %u/%u (%dus late)!\n",
 						       wrk->id, count, i, do_sleep);
+					if (wrk->flags & LATENCY) {
+						wrk->latency->dropped[i]++;
+						latency_add(&wrk->latency->step[i],
+							    -do_sleep * 1000ULL);
+					}
 					continue;
 				}
 			} else if (w->type == SYNC) {
@@ -1894,7 +2542,7 @@ static void *run_workload(void *data)
 
 				igt_assert(s_idx >= 0 && s_idx < i);
 				igt_assert(wrk->steps[s_idx].type == BATCH);
-				gem_sync(fd, wrk->steps[s_idx].obj[0].handle);
+				w_step_sync(&wrk->steps[s_idx]);
 				continue;
 			} else if (w->type == THROTTLE) {
 				throttle = w->throttle;
@@ -1938,6 +2586,17 @@ static void *run_workload(void *data)
 
 			if (do_sleep || w->type == PERIOD) {
 				usleep(do_sleep);
+
+				if (w->type == PERIOD && (wrk->flags & LATENCY)) {
+					struct timespec now;
+					int late;
+
+					clock_gettime(CLOCK_MONOTONIC, &now);
+					late = elapsed_us(&wrk->repeat_start, &now) -
+					       w->period;
+					latency_add(&wrk->latency->step[i],
+						    max(late, 0) * 1000ULL);
+				}
 				continue;
 			}
 
@@ -1963,35 +2622,27 @@ static void *run_workload(void *data)
 
 			do_eb(wrk, w, engine, wrk->flags);
 
-			if (w->request != -1) {
-				igt_list_del(&w->rq_link);
-				wrk->nrequest[w->request]--;
-			}
-			w->request = engine;
-			igt_list_add_tail(&w->rq_link, &wrk->requests[engine]);
-			wrk->nrequest[engine]++;
+			if (wrk->flags & LATENCY)
+				retire_latency(wrk, false);
+
+			request_add(wrk, w, engine);
 
 			if (!wrk->run)
 				break;
 
 			if (w->sync) {
-				gem_sync(fd, w->obj[0].handle);
+				w_step_sync(w);
 				last_sync = true;
 			}
 
 			if (qd_throttle > 0) {
-				while (wrk->nrequest[engine] > qd_throttle) {
-					struct w_step *s;
-
-					s = igt_list_first_entry(&wrk->requests[engine],
-								 s, rq_link);
+				while (wrk->requests[engine].count > qd_throttle) {
+					struct w_step *s = request_first(wrk, engine);
 
-					gem_sync(fd, s->obj[0].handle);
+					w_step_sync(s);
 					last_sync = true;
 
-					s->request = -1;
-					igt_list_del(&s->rq_link);
-					wrk->nrequest[engine]--;
+					request_del(wrk, s);
 				}
 			}
 		}
@@ -2015,32 +2666,375 @@ static void *run_workload(void *data)
 	}
 
 	for (i = 0; i < NUM_ENGINES; i++) {
-		if (!wrk->nrequest[i])
-			continue;
-
-		w = igt_list_last_entry(&wrk->requests[i], w, rq_link);
-		gem_sync(fd, w->obj[0].handle);
+		if (wrk->requests[i].count)
+			w_step_sync(request_last(wrk, i));
 	}
 
 	clock_gettime(CLOCK_MONOTONIC, &t_end);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+	wrk->cpu_ns = elapsed(&cpu_start, &cpu_end) * 1e9;
+
+	if (wrk->flags & LATENCY)
+		retire_latency(wrk, true);
+
+	if (wrk->print_stats)
+		print_workload_stats(wrk, elapsed(&t_start, &t_end), count);
+
+	return NULL;
+}
+
+static void sim_init_status_page(struct workload *wrk, unsigned int flags)
+{
+	struct sim_request *rq;
+	int engine;
+
+	if (!wrk->status_page)
+		return;
 
-	if (wrk->print_stats) {
-		double t = elapsed(&t_start, &t_end);
-
-		printf("%c%u: %.3fs elapsed (%d cycles, %.3f workloads/s).",
-		       wrk->background ? ' ' : '*', wrk->id,
-		       t, count, count / t);
-		if (wrk->balancer)
-			printf(" %lu (%lu + %lu) total VCS batches.",
-			       wrk->nr_bb[VCS], wrk->nr_bb[VCS1], wrk->nr_bb[VCS2]);
-		if (wrk->balancer && wrk->balancer->get_qd)
-			printf(" Average queue depths %.3f, %.3f.",
-			       (double)wrk->qd_sum[VCS1] / wrk->nr_bb[VCS],
-			       (double)wrk->qd_sum[VCS2] / wrk->nr_bb[VCS]);
+	for (engine = 0; engine < NUM_ENGINES; engine++) {
+		rq = sim_request_create(wrk, engine, wrk->nr_ctxs, 0);
+		rq->seqno = new_seqno(wrk, engine);
+		rq->flags = SEQNO | HEARTBEAT;
+		if (flags & INIT_CLOCKS)
+			rq->flags |= RT;
+		rq->duration = SIM_TIMESTAMP_NS;
+		sim_request_submit(rq);
+	}
+}
+
+static void
+sim_do_eb(struct workload *wrk, struct w_step *w, enum intel_engine_id engine)
+{
+	struct sim_request *rq;
+	unsigned int i, n = 0;
+
+	rq = sim_request_create(wrk, engine, w->context,
+				1 + w->data_deps.nr + w->fence_deps.nr);
+
+	/* The batch writes its own object so waits for the previous write. */
+	rq->deps[n++] = w->sim_fence;
+
+	for (i = 0; i < w->data_deps.nr; i++) {
+		if (w->data_deps.list[i])
+			rq->deps[n++] =
+				wrk->steps[w->idx + w->data_deps.list[i]].sim_fence;
+	}
+
+	for (i = 0; i < w->fence_deps.nr; i++)
+		rq->deps[n++] =
+			wrk->steps[w->idx + w->fence_deps.list[i]].sim_fence;
+
+	rq->w = w;
+	rq->nr_deps = n;
+	rq->seqno = new_seqno(wrk, engine);
+	rq->flags = wrk->flags & (SEQNO | RT);
+	rq->prio = wrk->ctx_list[w->context].priority;
+	rq->duration = (uint64_t)get_duration(w) * 1000 *
+		       sim_engines[rq->ring].scale / 100;
+	rq->preempt = (uint64_t)w->preempt_us * 1000;
+
+	w->sim_fence = rq->fence;
+
+	sim_request_submit(rq);
+}
+
+enum sim_state {
+	SIM_ITERATION,
+	SIM_STEP,
+	SIM_THROTTLE,
+	SIM_SYNC,
+	SIM_QD_THROTTLE,
+	SIM_DRAIN,
+	SIM_DONE,
+};
+
+/*
+ * Advances a simulated client by one step of run_workload(). Returns false
+ * if the client has to wait for a request to complete before it can make
+ * further progress.
+ */
+static bool sim_client_step(struct workload *wrk)
+{
+	struct sim_client *c = &wrk->sim;
+	struct w_step *w = &wrk->steps[c->step];
+	unsigned int i;
+
+	switch (c->state) {
+	case SIM_ITERATION:
+		if (!wrk->run || (!wrk->background && c->count >= wrk->repeat)) {
+			c->state = SIM_DRAIN;
+			return true;
+		}
+
+		/* Keep virtual time moving for workloads without batches. */
+		if (c->count && c->repeat_start == sim_now) {
+			c->wake = sim_now + sim_submit_ns;
+			return true;
+		}
+
+		c->cur_seqno = wrk->sync_seqno;
+		c->repeat_start = sim_now;
+		c->step = 0;
+		c->state = SIM_STEP;
+		return true;
+
+	case SIM_STEP:
+		if (!wrk->run || c->step == wrk->nr_steps) {
+			c->sw_timeline.completed +=
+				wrk->nr_steps - (c->cur_seqno - wrk->sync_seqno);
+			wrk->sync_seqno += wrk->nr_steps;
+			c->count++;
+			c->state = SIM_ITERATION;
+			return true;
+		}
+		break;
+
+	case SIM_THROTTLE:
+		if (c->throttle > 0 &&
+		    !sim_fence_done(&get_sync_target(wrk, (int)c->step -
+						     c->throttle)->sim_fence))
+			return false;
+
+		sim_do_eb(wrk, w, c->engine);
+
+		request_add(wrk, w, c->engine);
+
+		c->wake = sim_now + sim_submit_ns;
+		c->state = wrk->run ? SIM_SYNC : SIM_STEP;
+		return true;
+
+	case SIM_SYNC:
+		if (w->sync) {
+			if (!sim_fence_done(&w->sim_fence))
+				return false;
+			c->last_sync = true;
+		}
+
+		c->state = SIM_QD_THROTTLE;
+		return true;
+
+	case SIM_QD_THROTTLE:
+		while (c->qd_throttle > 0 &&
+		       wrk->requests[c->engine].count > c->qd_throttle) {
+			struct w_step *s = request_first(wrk, c->engine);
+
+			if (!sim_fence_done(&s->sim_fence))
+				return false;
+			c->last_sync = true;
+
+			request_del(wrk, s);
+		}
+
+		c->step++;
+		c->state = SIM_STEP;
+		return true;
+
+	case SIM_DRAIN:
+		for (i = 0; i < NUM_ENGINES; i++) {
+			if (wrk->requests[i].count &&
+			    !sim_fence_done(&request_last(wrk, i)->sim_fence))
+				return false;
+		}
+
+		c->t_end = sim_now;
+		c->state = SIM_DONE;
+		return true;
+
+	default:
+		return false;
+	}
+
+	if (w->type == DELAY) {
+		c->wake = sim_now + w->delay * 1000ULL;
+	} else if (w->type == PERIOD) {
+		int do_sleep = w->period -
+			       (int)((sim_now - c->repeat_start) / 1000);
+
+		if (do_sleep < 0) {
+			if (verbose > 1)
+				printf("%u: Dropped period @ %u/%u (%dus late)!\n",
+				       wrk->id, c->count, c->step, do_sleep);
+			if (wrk->flags & LATENCY) {
+				wrk->latency->dropped[c->step]++;
+				latency_add(&wrk->latency->step[c->step],
+					    sim_now - c->repeat_start -
+					    w->period * 1000ULL);
+			}
+		} else {
+			c->wake = c->repeat_start + w->period * 1000ULL;
+			if (wrk->flags & LATENCY)
+				latency_add(&wrk->latency->step[c->step], 0);
+		}
+	} else if (w->type == SYNC) {
+		unsigned int s_idx = c->step + w->target;
+
+		igt_assert(s_idx >= 0 && s_idx < c->step);
+		igt_assert(wrk->steps[s_idx].type == BATCH);
+		if (!sim_fence_done(&wrk->steps[s_idx].sim_fence))
+			return false;
+	} else if (w->type == THROTTLE) {
+		c->throttle = w->throttle;
+	} else if (w->type == QD_THROTTLE) {
+		c->qd_throttle = w->throttle;
+	} else if (w->type == SW_FENCE) {
+		w->sim_fence.tl = &c->sw_timeline;
+		w->sim_fence.seqno = c->cur_seqno + w->idx;
+	} else if (w->type == SW_FENCE_SIGNAL) {
+		int tgt = w->idx + w->target;
+
+		igt_assert(tgt >= 0 && tgt < c->step);
+		igt_assert(wrk->steps[tgt].type == SW_FENCE);
+		c->cur_seqno += wrk->steps[tgt].idx;
+		c->sw_timeline.completed += c->cur_seqno - wrk->sync_seqno;
+	} else if (w->type == CTX_PRIORITY) {
+		wrk->ctx_list[w->context].priority = w->priority;
+	}
+
+	if (w->type != BATCH) {
+		c->step++;
+		return true;
+	}
+
+	c->engine = w->engine;
+
+	if ((wrk->flags & DEPSYNC) && c->engine == VCS) {
+		c->last_sync = false;
+		for (i = 0; i < w->data_deps.nr; i++) {
+			struct w_step *dep;
+
+			if (!w->data_deps.list[i])
+				continue;
+
+			dep = &wrk->steps[w->idx + w->data_deps.list[i]];
+			if (!sim_fence_done(&dep->sim_fence))
+				return false;
+			c->last_sync = true;
+		}
+	}
+
+	if (c->last_sync && (wrk->flags & HEARTBEAT))
+		sim_init_status_page(wrk, 0);
+
+	c->last_sync = false;
+
+	wrk->nr_bb[c->engine]++;
+	if (c->engine == VCS && wrk->balancer) {
+		c->engine = wrk->balancer->balance(wrk->balancer, wrk, w);
+		wrk->nr_bb[c->engine]++;
+	}
+
+	c->state = SIM_THROTTLE;
+	return true;
+}
+
+/*
+ * Runs all clients against the simulated engines in virtual time. Returns
+ * the virtual time taken in seconds, or a negative value if the clients can
+ * no longer make progress.
+ */
+static double
+simulate_workloads(struct workload **w, unsigned int clients, int master)
+{
+	unsigned int i, done = 0;
+	uint64_t t_end;
+
+	hars_petruska_f54_1_random_seed(0);
+
+	for (i = 0; i < clients; i++) {
+		w[i]->sim.state = SIM_ITERATION;
+		w[i]->sim.throttle = -1;
+		w[i]->sim.qd_throttle = -1;
+		sim_init_status_page(w[i], INIT_ALL);
+	}
+
+	for (;;) {
+		uint64_t next = ~0ULL;
+		bool progress;
+
+		for (i = 0; i < NUM_ENGINES; i++)
+			sim_engine_advance(&sim_engines[i]);
+
+		do {
+			progress = false;
+
+			for (i = 0; i < clients; i++) {
+				struct sim_client *c = &w[i]->sim;
+
+				while (c->state != SIM_DONE &&
+				       c->wake <= sim_now &&
+				       sim_client_step(w[i])) {
+					progress = true;
+
+					if (c->state != SIM_DONE)
+						continue;
+
+					if (w[i]->print_stats)
+						print_workload_stats(w[i],
+								     c->t_end / 1e9,
+								     c->count);
+
+					if ((int)i == master) {
+						unsigned int j;
+
+						for (j = 0; j < clients; j++)
+							w[j]->run = false;
+					}
+
+					done++;
+				}
+			}
+		} while (progress);
+
+		if (done == clients)
+			break;
+
+		for (i = 0; i < NUM_ENGINES; i++) {
+			sim_engine_schedule(&sim_engines[i]);
+			next = min(next, sim_engines[i].next);
+		}
+
+		for (i = 0; i < clients; i++) {
+			if (w[i]->sim.state != SIM_DONE &&
+			    w[i]->sim.wake > sim_now)
+				next = min(next, w[i]->sim.wake);
+		}
+
+		if (next == ~0ULL)
+			return -1;
+
+		sim_now = next;
+	}
+
+	if (verbose > 1) {
+		printf("Engine busyness:");
+		for (i = 0; i < NUM_ENGINES; i++) {
+			if (i != VCS)
+				printf(" %s %.1f%%", ring_str_map[i],
+				       sim_now ? 100.0 * sim_engine_busy(i) / sim_now : 0.);
+		}
 		putchar('\n');
 	}
 
-	return NULL;
+	/* Let the requests still queued complete to account their latency. */
+	t_end = sim_now;
+	while (w[0]->flags & LATENCY) {
+		uint64_t next = ~0ULL;
+
+		for (i = 0; i < NUM_ENGINES; i++)
+			sim_engine_advance(&sim_engines[i]);
+
+		for (i = 0; i < NUM_ENGINES; i++) {
+			sim_engine_schedule(&sim_engines[i]);
+			next = min(next, sim_engines[i].next);
+		}
+
+		if (next == ~0ULL)
+			break;
+
+		sim_now = next;
+	}
+
+	return t_end / 1e9;
 }
 
 static void fini_workload(struct workload *wrk)
@@ -2049,6 +3043,169 @@ static void fini_workload(struct workload *wrk)
 	free(wrk);
 }
 
+enum report_format {
+	REPORT_TEXT,
+	REPORT_JSON,
+	REPORT_CSV,
+};
+
+static const char *report_format_str[] = {
+	[REPORT_TEXT] = "text",
+	[REPORT_JSON] = "json",
+	[REPORT_CSV] = "csv",
+};
+
+static const double report_pct[] = { 50, 90, 99, 99.9 };
+
+static void
+print_report_row(enum report_format format, bool first, int id, int step,
+		 const char *type, const char *engine, unsigned long dropped,
+		 const struct latency_hist *h)
+{
+	const double mean = h->count ? (double)h->sum / h->count : 0;
+	unsigned int i;
+
+	switch (format) {
+	case REPORT_TEXT:
+		if (first) {
+			printf("%-8s %-5s %-6s %-6s %7s %8s %10s %10s",
+			       "workload", "step", "type", "engine",
+			       "dropped", "count", "min(us)", "mean(us)");
+			for (i = 0; i < ARRAY_SIZE(report_pct); i++)
+				printf(" %9gth", report_pct[i]);
+			printf(" %10s\n", "max(us)");
+		}
+
+		if (id < 0)
+			printf("%-8s %-5s", "all", "-");
+		else
+			printf("%-8d %-5d", id, step);
+		printf(" %-6s %-6s %7lu %8"PRIu64" %10.1f %10.1f",
+		       type, engine ?: "-", dropped, h->count,
+		       h->min / 1e3, mean / 1e3);
+		for (i = 0; i < ARRAY_SIZE(report_pct); i++)
+			printf(" %11.1f",
+			       latency_percentile(h, report_pct[i]) / 1e3);
+		printf(" %10.1f\n", h->max / 1e3);
+		break;
+
+	case REPORT_CSV:
+		if (first) {
+			printf("workload,step,type,engine,dropped,count,min_us,mean_us");
+			for (i = 0; i < ARRAY_SIZE(report_pct); i++)
+				printf(",p%g_us", report_pct[i]);
+			printf(",max_us\n");
+		}
+
+		if (id < 0)
+			printf("all,,");
+		else
+			printf("%d,%d,", id, step);
+		printf("%s,%s,%lu,%"PRIu64",%.3f,%.3f",
+		       type, engine ?: "", dropped, h->count,
+		       h->min / 1e3, mean / 1e3);
+		for (i = 0; i < ARRAY_SIZE(report_pct); i++)
+			printf(",%.3f", latency_percentile(h, report_pct[i]) / 1e3);
+		printf(",%.3f\n", h->max / 1e3);
+		break;
+
+	case REPORT_JSON:
+		printf("%s\t\t{ ", first ? "" : ",\n");
+		if (id < 0)
+			printf("\"workload\": \"all\", \"step\": null, ");
+		else
+			printf("\"workload\": %d, \"step\": %d, ", id, step);
+		printf("\"type\": \"%s\", ", type);
+		if (engine)
+			printf("\"engine\": \"%s\", ", engine);
+		else
+			printf("\"engine\": null, ");
+		printf("\"dropped\": %lu, \"count\": %"PRIu64", \"min_us\": %.3f, \"mean_us\": %.3f",
+		       dropped, h->count, h->min / 1e3, mean / 1e3);
+		for (i = 0; i < ARRAY_SIZE(report_pct); i++)
+			printf(", \"p%g_us\": %.3f", report_pct[i],
+			       latency_percentile(h, report_pct[i]) / 1e3);
+		printf(", \"max_us\": %.3f }", h->max / 1e3);
+		break;
+	}
+}
+
+/*
+ * Merges the latency statistics of all clients, per step of each workload
+ * given on the command line and per engine, and prints them.
+ */
+static void
+print_report(enum report_format format, struct workload **w,
+	     unsigned int clients, struct workload **wrk,
+	     unsigned int nr_w_args, double t)
+{
+	struct latency_hist *engine, *step;
+	unsigned long *dropped;
+	bool first = true;
+	unsigned int i, j, a;
+
+	engine = calloc(NUM_ENGINES, sizeof(*engine));
+	igt_assert(engine);
+
+	for (i = 0; i < clients; i++) {
+		for (j = 0; j < NUM_ENGINES; j++)
+			latency_merge(&engine[j], &w[i]->latency->engine[j]);
+	}
+
+	if (format == REPORT_JSON)
+		printf("{\n\t\"elapsed_s\": %.6f,\n\t\"workloads_per_s\": %.3f,\n\t\"latency\": [\n",
+		       t, clients * w[0]->repeat / t);
+
+	for (a = 0; a < nr_w_args; a++) {
+		step = calloc(wrk[a]->nr_steps, sizeof(*step));
+		dropped = calloc(wrk[a]->nr_steps, sizeof(*dropped));
+		igt_assert(step && dropped);
+
+		for (i = 0; i < clients; i++) {
+			if ((nr_w_args > 1 ? i : 0) != a)
+				continue;
+
+			for (j = 0; j < wrk[a]->nr_steps; j++) {
+				latency_merge(&step[j], &w[i]->latency->step[j]);
+				dropped[j] += w[i]->latency->dropped[j];
+			}
+		}
+
+		for (j = 0; j < wrk[a]->nr_steps; j++) {
+			struct w_step *s = &wrk[a]->steps[j];
+
+			if (s->type == BATCH)
+				print_report_row(format, first, a, j, "batch",
+						 ring_str_map[s->engine], 0,
+						 &step[j]);
+			else if (s->type == PERIOD)
+				print_report_row(format, first, a, j, "period",
+						 NULL, dropped[j], &step[j]);
+			else
+				continue;
+
+			first = false;
+		}
+
+		free(dropped);
+		free(step);
+	}
+
+	for (j = 0; j < NUM_ENGINES; j++) {
+		if (!engine[j].count)
+			continue;
+
+		print_report_row(format, first, -1, -1, "engine",
+				 ring_str_map[j], 0, &engine[j]);
+		first = false;
+	}
+
+	if (format == REPORT_JSON)
+		printf("\n\t]\n}\n");
+
+	free(engine);
+}
+
 static unsigned long calibrate_nop(unsigned int tolerance_pct)
 {
 	const uint32_t bbe = 0xa << 23;
@@ -2141,7 +3298,20 @@ static void print_help(void)
 "                  clients.\n"
 "  -G              Global load balancing - a single load balancer will be shared\n"
 "                  between all clients and there will be a single seqno domain.\n"
-"  -d              Sync between data dependencies in userspace."
+"  -d              Sync between data dependencies in userspace.\n"
+"  --simulate[=<engine>=<pct>,...,submit=<us>]\n"
+"                  Run against simulated engines in virtual time instead of\n"
+"                  the GPU. No device or nop calibration is needed. Batch\n"
+"                  durations can be scaled per engine by a percentage, and\n"
+"                  the CPU time spent per submitted batch can be set\n"
+"                  (default 10us).\n"
+"  --report=<text|json|csv>\n"
+"                  Track the submit to completion latency of every batch and\n"
+"                  how late periods start, and print per step and per engine\n"
+"                  latency percentiles and dropped periods at exit.\n"
+"  --pin[=<cpu>,...]\n"
+"                  Pin client threads round-robin to the given CPUs, or to\n"
+"                  the CPUs the process is allowed to run on."
 	);
 }
 
@@ -2212,6 +3382,116 @@ static const struct workload_balancer *find_balancer_by_id(unsigned int id)
 	return NULL;
 }
 
+static int parse_simulate(const char *_spec)
+{
+	char *spec = _spec ? strdup(_spec) : NULL;
+	char *token, *tctx = NULL, *tstart = spec;
+	int ret = -1;
+	unsigned int i;
+
+	for (i = 0; i < NUM_ENGINES; i++) {
+		igt_list_init(&sim_engines[i].queue);
+		sim_engines[i].scale = 100;
+	}
+
+	while (spec && (token = strtok_r(tstart, ",", &tctx)) != NULL) {
+		char *sep = strchr(token, '=');
+		char *endptr = NULL;
+		long value;
+
+		tstart = NULL;
+
+		if (!sep)
+			goto out;
+		*sep = 0;
+
+		value = strtol(sep + 1, &endptr, 0);
+		if (value <= 0 || value >= INT_MAX || *endptr)
+			goto out;
+
+		if (!strcasecmp(token, "submit")) {
+			sim_submit_ns = value * 1000;
+			continue;
+		}
+
+		for (i = 0; i < NUM_ENGINES; i++) {
+			if (!strcasecmp(token, ring_str_map[i]))
+				break;
+		}
+		if (i == NUM_ENGINES)
+			goto out;
+
+		if (i == VCS)
+			sim_engines[VCS1].scale = sim_engines[VCS2].scale = value;
+		else
+			sim_engines[i].scale = value;
+	}
+
+	ret = 0;
+out:
+	free(spec);
+
+	return ret;
+}
+
+static int parse_pin(const char *_spec, cpu_set_t *cpus)
+{
+	char *spec = _spec ? strdup(_spec) : NULL;
+	char *token, *tctx = NULL, *tstart = spec;
+	int ret = -1;
+
+	CPU_ZERO(cpus);
+
+	if (!spec)
+		return sched_getaffinity(0, sizeof(*cpus), cpus);
+
+	while ((token = strtok_r(tstart, ",", &tctx)) != NULL) {
+		char *endptr = NULL;
+		long cpu;
+
+		tstart = NULL;
+
+		cpu = strtol(token, &endptr, 0);
+		if (cpu < 0 || cpu >= CPU_SETSIZE || *endptr)
+			goto out;
+
+		CPU_SET(cpu, cpus);
+	}
+
+	if (CPU_COUNT(cpus))
+		ret = 0;
+out:
+	free(spec);
+
+	return ret;
+}
+
+static int pin_cpu(const cpu_set_t *cpus, unsigned int n)
+{
+	int cpu;
+
+	n %= CPU_COUNT(cpus);
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, cpus) && !n--)
+			break;
+	}
+
+	return cpu;
+}
+
+static void bind_cpu(pthread_attr_t *attr, int cpu)
+{
+	cpu_set_t mask;
+
+	if (cpu < 0)
+		return;
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+
+	pthread_attr_setaffinity_np(attr, sizeof(mask), &mask);
+}
+
 static void init_clocks(void)
 {
 	struct timespec t_start, t_end;
@@ -2260,24 +3540,57 @@ int main(int argc, char **argv)
 	struct w_arg *w_args = NULL;
 	unsigned int tolerance_pct = 1;
 	const struct workload_balancer *balancer = NULL;
+	static const struct option long_options[] = {
+		{ "simulate", optional_argument, NULL, 0x100 },
+		{ "report", required_argument, NULL, 0x101 },
+		{ "pin", optional_argument, NULL, 0x102 },
+		{ NULL, 0, NULL, 0 }
+	};
+	int report = -1;
+	bool pin = false;
+	cpu_set_t pin_cpus;
 	char *endptr = NULL;
 	int prio = 0;
 	double t;
 	int i, c;
 
-	/*
-	 * Open the device via the low-level API so we can do the GPU quiesce
-	 * manually as close as possible in time to the start of the workload.
-	 * This minimizes the gap in engine utilization tracking when observed
-	 * via external tools like trace.pl.
-	 */
-	fd = __drm_open_driver(DRIVER_INTEL);
-	igt_require(fd);
-
-	init_clocks();
-
-	while ((c = getopt(argc, argv, "hqv2RSHxGdc:n:r:w:W:a:t:b:p:")) != -1) {
+	while ((c = getopt_long(argc, argv, "hqv2RSHxGdc:n:r:w:W:a:t:b:p:",
+				long_options, NULL)) != -1) {
 		switch (c) {
+		case 0x100:
+			simulate = true;
+			if (parse_simulate(optarg)) {
+				if (verbose)
+					fprintf(stderr,
+						"Invalid simulation parameters '%s'!\n",
+						optarg);
+				return 1;
+			}
+			break;
+		case 0x101:
+			for (i = 0; i < ARRAY_SIZE(report_format_str); i++) {
+				if (!strcasecmp(optarg, report_format_str[i]))
+					report = i;
+			}
+			if (report < 0) {
+				if (verbose)
+					fprintf(stderr,
+						"Unknown report format '%s'!\n",
+						optarg);
+				return 1;
+			}
+			flags |= LATENCY;
+			break;
+		case 0x102:
+			if (parse_pin(optarg, &pin_cpus)) {
+				if (verbose)
+					fprintf(stderr,
+						"Invalid CPU list '%s'!\n",
+						optarg);
+				return 1;
+			}
+			pin = true;
+			break;
 		case 'W':
 			if (master_workload >= 0) {
 				if (verbose)
@@ -2351,10 +3664,8 @@ int main(int argc, char **argv)
 
 			if (i >= 0) {
 				balancer = find_balancer_by_id(i);
-				if (balancer) {
-					igt_assert(intel_gen(intel_get_drm_devid(fd)) >= balancer->min_gen);
+				if (balancer)
 					flags |= BALANCE | balancer->flags;
-				}
 			}
 
 			if (!balancer) {
@@ -2379,7 +3690,25 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
-	if (!nop_calibration) {
+	if (!simulate) {
+		/*
+		 * Open the device via the low-level API so we can do the GPU
+		 * quiesce manually as close as possible in time to the start
+		 * of the workload. This minimizes the gap in engine
+		 * utilization tracking when observed via external tools like
+		 * trace.pl.
+		 */
+		fd = __drm_open_driver(DRIVER_INTEL);
+		igt_require(fd);
+
+		init_clocks();
+
+		if (balancer)
+			igt_assert(intel_gen(intel_get_drm_devid(fd)) >=
+				   balancer->min_gen);
+	}
+
+	if (!nop_calibration && !simulate) {
 		if (verbose > 1)
 			printf("Calibrating nop delay with %u%% tolerance...\n",
 				tolerance_pct);
@@ -2459,8 +3788,11 @@ int main(int argc, char **argv)
 		clients = nr_w_args;
 
 	if (verbose > 1) {
-		printf("Using %lu nop calibration for %uus delay.\n",
-		       nop_calibration, nop_calibration_us);
+		if (simulate)
+			printf("Simulating engines in virtual time.\n");
+		else
+			printf("Using %lu nop calibration for %uus delay.\n",
+			       nop_calibration, nop_calibration_us);
 		printf("%u client%s.\n", clients, clients > 1 ? "s" : "");
 		if (flags & SWAPVCS)
 			printf("Swapping VCS rings between clients.\n");
@@ -2498,6 +3830,7 @@ int main(int argc, char **argv)
 		w[i]->background = master_workload >= 0 && i != master_workload;
 		w[i]->print_stats = verbose > 1 ||
 				    (verbose > 0 && master_workload == i);
+		w[i]->cpu = pin ? pin_cpu(&pin_cpus, i) : -1;
 
 		prepare_workload(i, w[i], flags_);
 
@@ -2513,15 +3846,33 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (simulate) {
+		t = simulate_workloads(w, clients, master_workload);
+		if (t < 0) {
+			if (verbose)
+				fprintf(stderr,
+					"Simulated workloads cannot make progress!\n");
+			return 1;
+		}
+
+		goto out;
+	}
+
 	gem_quiescent_gpu(fd);
 
 	clock_gettime(CLOCK_MONOTONIC, &t_start);
 
 	for (i = 0; i < clients; i++) {
+		pthread_attr_t attr;
 		int ret;
 
-		ret = pthread_create(&w[i]->thread, NULL, run_workload, w[i]);
+		pthread_attr_init(&attr);
+		bind_cpu(&attr, w[i]->cpu);
+
+		ret = pthread_create(&w[i]->thread, &attr, run_workload, w[i]);
 		igt_assert_eq(ret, 0);
+
+		pthread_attr_destroy(&attr);
 	}
 
 	if (master_workload >= 0) {
@@ -2543,9 +3894,24 @@ int main(int argc, char **argv)
 	clock_gettime(CLOCK_MONOTONIC, &t_end);
 
 	t = elapsed(&t_start, &t_end);
-	if (verbose)
-		printf("%.3fs elapsed (%.3f workloads/s)\n",
-		       t, clients * repeat / t);
+out:
+	if (verbose) {
+		unsigned long nr_submit = 0;
+		uint64_t cpu_ns = 0;
+
+		for (i = 0; i < clients; i++) {
+			nr_submit += w[i]->nr_submit;
+			cpu_ns += w[i]->cpu_ns;
+		}
+
+		printf("%.3fs elapsed (%.3f workloads/s)", t, clients * repeat / t);
+		if (nr_submit)
+			printf(", %.1fus CPU per batch", cpu_ns / 1e3 / nr_submit);
+		putchar('\n');
+	}
+
+	if (report >= 0)
+		print_report(report, w, clients, wrk, nr_w_args, t);
 
 	for (i = 0; i < clients; i++)
 		fini_workload(w[i]);
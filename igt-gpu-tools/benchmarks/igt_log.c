@@ -0,0 +1,131 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/** @file igt_log.c
+ *
+ * This is a test of the cost of logging with igt_log() from several
+ * threads, of messages kept in the log buffer but not printed, as a test
+ * logs its debug messages. No device is needed.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "igt_core.h"
+
+struct worker {
+	pthread_t thread;
+	int id;
+	long count;
+};
+
+static pthread_barrier_t barrier;
+
+static double elapsed(const struct timespec *start,
+		      const struct timespec *end)
+{
+	return 1e9 * (end->tv_sec - start->tv_sec) +
+		(end->tv_nsec - start->tv_nsec);
+}
+
+static void *worker(void *arg)
+{
+	struct worker *w = arg;
+	long n;
+
+	pthread_barrier_wait(&barrier);
+
+	for (n = 0; n < w->count; n++)
+		igt_debug("worker %d: message %ld of %ld\n",
+			  w->id, n, w->count);
+
+	return NULL;
+}
+
+static double bench(int num_threads, long count)
+{
+	struct timespec start, end;
+	struct worker *workers;
+	int n;
+
+	workers = calloc(num_threads, sizeof(*workers));
+	pthread_barrier_init(&barrier, NULL, num_threads + 1);
+
+	for (n = 0; n < num_threads; n++) {
+		workers[n].id = n;
+		workers[n].count = count;
+		pthread_create(&workers[n].thread, NULL, worker, &workers[n]);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pthread_barrier_wait(&barrier);
+	for (n = 0; n < num_threads; n++)
+		pthread_join(workers[n].thread, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	pthread_barrier_destroy(&barrier);
+	free(workers);
+
+	/* The time for each thread to log a message */
+	return elapsed(&start, &end) / count;
+}
+
+int main(int argc, char **argv)
+{
+	long count = 1000000;
+	int num_threads = 0;
+	int c, n;
+
+	while ((c = getopt(argc, argv, "t:n:")) != -1) {
+		switch (c) {
+		case 't':
+			num_threads = atoi(optarg);
+			break;
+		case 'n':
+			count = atol(optarg);
+			if (count < 1)
+				count = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-t threads] [-n messages per thread]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	if (num_threads > 0) {
+		printf("%d threads: %.0fns\n",
+		       num_threads, bench(num_threads, count));
+		return 0;
+	}
+
+	for (n = 1; n <= 2 * sysconf(_SC_NPROCESSORS_ONLN); n *= 2)
+		printf("%d threads: %.0fns\n", n, bench(n, count));
+
+	return 0;
+}
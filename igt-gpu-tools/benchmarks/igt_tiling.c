@@ -0,0 +1,187 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/** @file igt_tiling.c
+ *
+ * This is a test of the speed of tiling, detiling and filling a framebuffer
+ * on the CPU with igt_tiling, against computing the address of every pixel.
+ * No device is needed.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "drmtest.h"
+#include "igt_tiling.h"
+#include "i915_drm.h"
+#include "intel_batchbuffer.h"
+#include "frame_bench.h"
+
+static const struct {
+	const char *name;
+	uint32_t tiling;
+	uint32_t swizzle;
+} layouts[] = {
+	{ "linear", I915_TILING_NONE, I915_BIT_6_SWIZZLE_NONE },
+	{ "X", I915_TILING_X, I915_BIT_6_SWIZZLE_NONE },
+	{ "X swizzled", I915_TILING_X, I915_BIT_6_SWIZZLE_9_10 },
+	{ "Y", I915_TILING_Y, I915_BIT_6_SWIZZLE_NONE },
+	{ "Y swizzled", I915_TILING_Y, I915_BIT_6_SWIZZLE_9 },
+	{ "Yf", I915_TILING_Yf, I915_BIT_6_SWIZZLE_NONE },
+};
+
+enum op {
+	FILL,
+	TO_TILED,
+	FROM_TILED,
+};
+
+static const char *op_names[] = { "fill", "to tiled", "from tiled" };
+
+/* What the callers did before, one pixel at a time */
+static void per_pixel(const struct igt_tiling *t, enum op op,
+		      uint8_t *tiled, uint8_t *linear, uint32_t linear_stride,
+		      int width, int height, uint32_t color)
+{
+	int x, y;
+
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++) {
+			uint8_t *pixel = tiled + igt_tiling_offset(t, x, y);
+			uint8_t *l = linear + y * linear_stride + x * t->cpp;
+
+			switch (op) {
+			case FILL:
+				memcpy(pixel, &color, t->cpp);
+				break;
+			case TO_TILED:
+				memcpy(pixel, l, t->cpp);
+				break;
+			case FROM_TILED:
+				memcpy(l, pixel, t->cpp);
+				break;
+			}
+		}
+	}
+}
+
+static void spans(const struct igt_tiling *t, enum op op,
+		  uint8_t *tiled, uint8_t *linear, uint32_t linear_stride,
+		  int width, int height, uint32_t color)
+{
+	switch (op) {
+	case FILL:
+		igt_tiling_fill(t, tiled, color, 0, 0, width, height);
+		break;
+	case TO_TILED:
+		igt_tiling_to_tiled(t, tiled, linear, linear_stride,
+				    0, 0, width, height);
+		break;
+	case FROM_TILED:
+		igt_tiling_from_tiled(t, linear, linear_stride, tiled,
+				      0, 0, width, height);
+		break;
+	}
+}
+
+static int bench_layout(int l, int width, int height, int reps)
+{
+	uint32_t linear_stride = width * 4, stride;
+	uint8_t *tiled, *tiled_ref, *linear, *linear_ref;
+	struct timespec start, end;
+	struct igt_tiling t;
+	size_t size;
+	int op, n, mismatch, ret = 0;
+
+	stride = linear_stride;
+	if (layouts[l].tiling != I915_TILING_NONE) {
+		igt_tiling_init(&t, layouts[l].tiling, layouts[l].swizzle,
+				32, 0);
+		stride = ALIGN(linear_stride, t.tile_width);
+	}
+	igt_tiling_init(&t, layouts[l].tiling, layouts[l].swizzle, 32, stride);
+	size = (size_t)stride * ALIGN(height, t.tile_height);
+
+	tiled = malloc(size);
+	tiled_ref = malloc(size);
+	linear = malloc((size_t)linear_stride * height);
+	linear_ref = malloc((size_t)linear_stride * height);
+
+	for (n = 0; n < size; n++)
+		tiled[n] = tiled_ref[n] = n * 7;
+	for (n = 0; n < linear_stride * height; n++)
+		linear[n] = linear_ref[n] = n * 13;
+
+	for (op = FILL; op <= FROM_TILED; op++) {
+		double old_ms, new_ms;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (n = 0; n < reps; n++)
+			per_pixel(&t, op, tiled_ref, linear_ref, linear_stride,
+				  width, height, 0xc0ffee);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		old_ms = 1e3 * frame_bench_elapsed(&start, &end) / reps;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (n = 0; n < reps; n++)
+			spans(&t, op, tiled, linear, linear_stride,
+			      width, height, 0xc0ffee);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		new_ms = 1e3 * frame_bench_elapsed(&start, &end) / reps;
+
+		mismatch = memcmp(tiled, tiled_ref, size) ||
+			memcmp(linear, linear_ref,
+			       (size_t)linear_stride * height);
+
+		printf("%dx%d %s %s: %.2fms per pixel, %.2fms (%.1fx)%s\n",
+		       width, height, layouts[l].name, op_names[op],
+		       old_ms, new_ms, old_ms / new_ms,
+		       mismatch ? " MISMATCH" : "");
+		ret |= mismatch;
+	}
+
+	free(linear_ref);
+	free(linear);
+	free(tiled_ref);
+	free(tiled);
+
+	return ret;
+}
+
+static int bench(int width, int height, int reps)
+{
+	int l, ret = 0;
+
+	for (l = 0; l < ARRAY_SIZE(layouts); l++)
+		ret |= bench_layout(l, width, height, reps);
+
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	return frame_bench_main(argc, argv, 10, bench);
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file kms_fb_convert.c
+ *
+ * This is a test of the throughput of the CPU side framebuffer format
+ * conversions in igt_fb, comparing the SIMD paths with the float path.
+ * No device is needed, the conversions run on plain memory.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "drmtest.h"
+#include "igt_aux.h"
+#include "igt_fb.h"
+#include "frame_bench.h"
+
+static const struct {
+	uint32_t format;
+	const char *name;
+} formats[] = {
+	{ DRM_FORMAT_NV12, "NV12" },
+	{ DRM_FORMAT_YUYV, "YUYV" },
+	{ DRM_FORMAT_UYVY, "UYVY" },
+};
+
+static void *init_fb(struct igt_fb *fb, uint32_t format,
+		     int width, int height)
+{
+	void *ptr;
+
+	memset(fb, 0, sizeof(*fb));
+	fb->drm_format = format;
+	fb->width = width;
+	fb->height = height;
+	fb->color_encoding = IGT_COLOR_YCBCR_BT709;
+	fb->color_range = IGT_COLOR_YCBCR_LIMITED_RANGE;
+
+	switch (format) {
+	case DRM_FORMAT_NV12:
+		fb->num_planes = 2;
+		fb->strides[0] = fb->strides[1] = ALIGN(width, 64);
+		fb->offsets[1] = fb->strides[0] * height;
+		fb->size = fb->offsets[1] + fb->strides[1] * ((height + 1) / 2);
+		break;
+	case DRM_FORMAT_XRGB8888:
+		fb->num_planes = 1;
+		fb->strides[0] = ALIGN(width * 4, 64);
+		fb->size = fb->strides[0] * height;
+		break;
+	default:
+		fb->num_planes = 1;
+		fb->strides[0] = ALIGN((width + 1) / 2 * 4, 64);
+		fb->size = fb->strides[0] * height;
+		break;
+	}
+
+	ptr = malloc(fb->size);
+	igt_assert(ptr);
+
+	return ptr;
+}
+
+static double run(struct igt_fb *dst, void *dst_ptr,
+		  struct igt_fb *src, void *src_ptr, int reps)
+{
+	struct timespec start, end;
+	int n;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (n = 0; n < reps; n++)
+		igt_fb_convert_buffer(dst, dst_ptr, src, src_ptr);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return reps * dst->width * dst->height / frame_bench_elapsed(&start, &end) / 1e6;
+}
+
+static int max_diff(const uint8_t *a, const uint8_t *b, uint64_t size)
+{
+	int diff = 0;
+	uint64_t i;
+
+	for (i = 0; i < size; i++)
+		diff = max(diff, abs(a[i] - b[i]));
+
+	return diff;
+}
+
+static void bench_format(uint32_t format, const char *name,
+			 int width, int height, int reps)
+{
+	struct igt_fb rgb, yuv;
+	uint8_t *rgb_ptr, *yuv_ptr, *ref_ptr;
+	double to_yuv[2], to_rgb[2];
+	int to_yuv_diff, to_rgb_diff;
+	uint64_t i;
+	int simd;
+
+	rgb_ptr = init_fb(&rgb, DRM_FORMAT_XRGB8888, width, height);
+	yuv_ptr = init_fb(&yuv, format, width, height);
+	ref_ptr = malloc(max(rgb.size, yuv.size));
+	igt_assert(ref_ptr);
+
+	for (i = 0; i < rgb.size; i++)
+		rgb_ptr[i] = rand();
+	memset(yuv_ptr, 0, yuv.size);
+
+	/* Float path first, its output is the reference */
+	for (simd = 0; simd < 2; simd++) {
+		if (simd)
+			unsetenv("IGT_FB_NO_SIMD");
+		else
+			setenv("IGT_FB_NO_SIMD", "1", 1);
+
+		to_yuv[simd] = run(&yuv, yuv_ptr, &rgb, rgb_ptr, reps);
+		if (!simd)
+			memcpy(ref_ptr, yuv_ptr, yuv.size);
+	}
+	to_yuv_diff = max_diff(ref_ptr, yuv_ptr, yuv.size);
+
+	for (simd = 0; simd < 2; simd++) {
+		if (simd)
+			unsetenv("IGT_FB_NO_SIMD");
+		else
+			setenv("IGT_FB_NO_SIMD", "1", 1);
+
+		to_rgb[simd] = run(&rgb, rgb_ptr, &yuv, yuv_ptr, reps);
+		if (!simd)
+			memcpy(ref_ptr, rgb_ptr, rgb.size);
+	}
+	to_rgb_diff = max_diff(ref_ptr, rgb_ptr, rgb.size);
+
+	printf("%s %dx%d: XRGB8888->%s %.1f -> %.1f Mpix/s (max diff %d), "
+	       "%s->XRGB8888 %.1f -> %.1f Mpix/s (max diff %d)\n",
+	       name, width, height,
+	       name, to_yuv[0], to_yuv[1], to_yuv_diff,
+	       name, to_rgb[0], to_rgb[1], to_rgb_diff);
+
+	free(ref_ptr);
+	free(yuv_ptr);
+	free(rgb_ptr);
+}
+
+static int bench(int width, int height, int reps)
+{
+	unsigned int f;
+
+	for (f = 0; f < ARRAY_SIZE(formats); f++)
+		bench_format(formats[f].format, formats[f].name,
+			     width, height, reps);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	return frame_bench_main(argc, argv, 5, bench);
+}
@@ -41,6 +41,7 @@
 #include "igt_kms.h"
 #include "igt_pm.h"
 #include "igt_stats.h"
+#include "igt_tiling.h"
 #ifdef HAVE_CHAMELIUM
 #include "igt_chamelium.h"
 #endif
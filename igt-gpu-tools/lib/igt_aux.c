@@ -36,6 +36,7 @@
 #include <string.h>
 #include <sys/mman.h>
 #include <signal.h>
+#include <pthread.h>
 #include <pciaccess.h>
 #include <stdlib.h>
 #include <time.h>
@@ -682,6 +683,94 @@ void igt_print_activity(void)
 	igt_interactive_info(".");
 }
 
+/**
+ * igt_bands_count:
+ * @size: total amount of work
+ * @min_band_size: smallest amount of work worth a band of its own
+ * @max_bands: upper limit on the number of bands
+ *
+ * Returns: The number of bands to split @size units of work into for
+ * igt_bands_run(), at most one per online cpu and at least one.
+ */
+int igt_bands_count(size_t size, size_t min_band_size, int max_bands)
+{
+	long bands = min(sysconf(_SC_NPROCESSORS_ONLN), (long)max_bands);
+
+	return max(min((size_t)bands, size / min_band_size), (size_t)1);
+}
+
+struct igt_band {
+	void (*fn)(int band, void *arg);
+	void *arg;
+	int band;
+	bool started;
+	pthread_t thread;
+};
+
+static void *igt_band_thread(void *data)
+{
+	struct igt_band *band = data;
+
+	band->fn(band->band, band->arg);
+
+	return NULL;
+}
+
+/**
+ * igt_bands_run:
+ * @fn: function doing the work of one band
+ * @num_bands: number of bands
+ * @arg: argument passed to @fn
+ *
+ * Calls @fn for every band from 0 to @num_bands - 1, with each band but
+ * the first on a thread of its own, and returns once all of them are
+ * done. The first band, and any band no thread could be created for,
+ * runs on the calling thread.
+ *
+ * The threads block all signals, which are left for the test's own
+ * threads. Since igt_assert() and friends only work on the test's own
+ * threads, @fn must not use them.
+ */
+void igt_bands_run(void (*fn)(int band, void *arg), int num_bands, void *arg)
+{
+	struct igt_band *bands;
+	sigset_t all, old;
+	int n;
+
+	if (num_bands <= 1) {
+		if (num_bands == 1)
+			fn(0, arg);
+		return;
+	}
+
+	bands = calloc(num_bands, sizeof(*bands));
+	igt_assert(bands);
+
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+
+	for (n = 1; n < num_bands; n++) {
+		bands[n].fn = fn;
+		bands[n].arg = arg;
+		bands[n].band = n;
+		bands[n].started = !pthread_create(&bands[n].thread, NULL,
+						   igt_band_thread, &bands[n]);
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	fn(0, arg);
+
+	for (n = 1; n < num_bands; n++) {
+		if (bands[n].started)
+			pthread_join(bands[n].thread, NULL);
+		else
+			fn(n, arg);
+	}
+
+	free(bands);
+}
+
 static int autoresume_delay;
 
 static const char *suspend_state_name[] = {
@@ -115,6 +115,8 @@ void igt_permute_array(void *array, unsigned size,
 						 unsigned j));
 void igt_progress(const char *header, uint64_t i, uint64_t total);
 void igt_print_activity(void);
+int igt_bands_count(size_t size, size_t min_band_size, int max_bands);
+void igt_bands_run(void (*fn)(int band, void *arg), int num_bands, void *arg);
 bool igt_check_boolean_env_var(const char *env_var, bool default_value);
 
 bool igt_aub_dump_enabled(void);
@@ -42,6 +42,7 @@
 #include "igt_list.h"
 #include "igt_kms.h"
 #include "igt_rc.h"
+#include "igt_x86.h"
 
 /**
  * SECTION:igt_chamelium
@@ -1246,54 +1247,223 @@ int chamelium_get_frame_limit(struct chamelium *chamelium,
 	return ret;
 }
 
-static uint32_t chamelium_xrgb_hash16(const unsigned char *buffer, int width,
-				      int height, int k, int m)
+/*
+ * The Chamelium CRC splits the pixels into 4 interleaved lanes, pixel i
+ * going to lane i % 4, and sums the pixel values of each lane weighted
+ * by their 1-based index within the lane, modulo 2^64. All 4 lanes are
+ * summed in a single pass, with the frame split into bands that are
+ * summed in parallel. Each band starts at a known index within the
+ * lanes, so its sums just add to the others.
+ */
+#define CRC_LANES 4
+#define CRC_MAX_THREADS 16
+#define CRC_MIN_BAND_QUADS (64 * 1024)
+
+static inline uint64_t xrgb_hash_value(uint32_t pixel)
 {
-	unsigned char r, g, b;
-	uint64_t sum = 0;
-	uint64_t count = 0;
-	uint64_t value;
-	uint32_t hash;
-	int index;
-	int i;
+	/* r | g << 8 | b << 16 */
+	return ((pixel >> 16) & 0xff) | (pixel & 0xff00) | ((pixel & 0xff) << 16);
+}
 
-	for (i=0; i < width * height; i++) {
-		if ((i % m) != k)
-			continue;
+/* Sums num_quads groups of 4 pixels, the first one having index count */
+static void xrgb_hash_quads(const uint32_t *pixels, size_t num_quads,
+			    uint32_t count, uint64_t sum[CRC_LANES])
+{
+	size_t q;
+	int k;
+
+	for (q = 0; q < num_quads; q++, count++)
+		for (k = 0; k < CRC_LANES; k++)
+			sum[k] += (uint64_t)count * xrgb_hash_value(pixels[q * CRC_LANES + k]);
+}
+
+#if defined(__x86_64__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("ssse3")
+
+#include <tmmintrin.h>
+
+static void xrgb_hash_quads_ssse3(const uint32_t *pixels, size_t num_quads,
+				  uint32_t count, uint64_t sum[CRC_LANES])
+{
+	/* One pixel value per 64 bit lane, pixels 0-1 and 2-3 */
+	const __m128i lo_mask = _mm_setr_epi8(2, 1, 0, -1, -1, -1, -1, -1,
+					      6, 5, 4, -1, -1, -1, -1, -1);
+	const __m128i hi_mask = _mm_setr_epi8(10, 9, 8, -1, -1, -1, -1, -1,
+					      14, 13, 12, -1, -1, -1, -1, -1);
+	const __m128i one = _mm_set1_epi64x(1);
+	__m128i lo = _mm_loadu_si128((__m128i *)&sum[0]);
+	__m128i hi = _mm_loadu_si128((__m128i *)&sum[2]);
+	__m128i c = _mm_set1_epi64x(count);
+	size_t q;
+
+	for (q = 0; q < num_quads; q++) {
+		__m128i p = _mm_loadu_si128((const __m128i *)&pixels[q * CRC_LANES]);
+
+		lo = _mm_add_epi64(lo, _mm_mul_epu32(_mm_shuffle_epi8(p, lo_mask), c));
+		hi = _mm_add_epi64(hi, _mm_mul_epu32(_mm_shuffle_epi8(p, hi_mask), c));
+		c = _mm_add_epi64(c, one);
+	}
+
+	_mm_storeu_si128((__m128i *)&sum[0], lo);
+	_mm_storeu_si128((__m128i *)&sum[2], hi);
+}
+
+#pragma GCC pop_options
 
-		index = i * 4;
+#pragma GCC push_options
+#pragma GCC target("avx2")
 
-		r = buffer[index + 2];
-		g = buffer[index + 1];
-		b = buffer[index + 0];
+#include <immintrin.h>
 
-		value = r | (g << 8) | (b << 16);
-		sum += ++count * value;
+static void xrgb_hash_quads_avx2(const uint32_t *pixels, size_t num_quads,
+				 uint32_t count, uint64_t sum[CRC_LANES])
+{
+	const __m128i mask = _mm_setr_epi8(2, 1, 0, -1, 6, 5, 4, -1,
+					   10, 9, 8, -1, 14, 13, 12, -1);
+	const __m256i two = _mm256_set1_epi64x(2);
+	__m256i acc0 = _mm256_loadu_si256((__m256i *)sum);
+	__m256i acc1 = _mm256_setzero_si256();
+	__m256i c0 = _mm256_set1_epi64x(count);
+	__m256i c1 = _mm256_set1_epi64x((uint64_t)count + 1);
+	size_t q;
+
+	/* Two quads at a time, to keep two multiplies in flight */
+	for (q = 0; q + 2 <= num_quads; q += 2) {
+		__m128i p0 = _mm_loadu_si128((const __m128i *)&pixels[q * CRC_LANES]);
+		__m128i p1 = _mm_loadu_si128((const __m128i *)&pixels[(q + 1) * CRC_LANES]);
+		__m256i v0 = _mm256_cvtepu32_epi64(_mm_shuffle_epi8(p0, mask));
+		__m256i v1 = _mm256_cvtepu32_epi64(_mm_shuffle_epi8(p1, mask));
+
+		acc0 = _mm256_add_epi64(acc0, _mm256_mul_epu32(v0, c0));
+		acc1 = _mm256_add_epi64(acc1, _mm256_mul_epu32(v1, c1));
+		c0 = _mm256_add_epi64(c0, two);
+		c1 = _mm256_add_epi64(c1, two);
 	}
 
-	hash = ((sum >> 0) ^ (sum >> 16) ^ (sum >> 32) ^ (sum >> 48)) & 0xffff;
+	_mm256_storeu_si256((__m256i *)sum, _mm256_add_epi64(acc0, acc1));
+
+	xrgb_hash_quads(pixels + q * CRC_LANES, num_quads - q, count + q, sum);
+}
+
+#pragma GCC pop_options
+
+static void (*xrgb_hash_quads_func(void))(const uint32_t *, size_t,
+					   uint32_t, uint64_t *)
+{
+	unsigned features = igt_x86_features();
+
+	if (features & AVX2)
+		return xrgb_hash_quads_avx2;
+	if (features & SSSE3)
+		return xrgb_hash_quads_ssse3;
+
+	return xrgb_hash_quads;
+}
+#else
+static void (*xrgb_hash_quads_func(void))(const uint32_t *, size_t,
+					   uint32_t, uint64_t *)
+{
+	return xrgb_hash_quads;
+}
+#endif
+
+struct xrgb_hash_bands {
+	void (*hash)(const uint32_t *pixels, size_t num_quads,
+		     uint32_t count, uint64_t sum[CRC_LANES]);
+	const uint32_t *pixels;
+	size_t num_quads, band_quads;
+	uint64_t sum[CRC_MAX_THREADS][CRC_LANES];
+};
+
+static void xrgb_hash_band(int band, void *data)
+{
+	struct xrgb_hash_bands *bands = data;
+	size_t first_quad = min(band * bands->band_quads, bands->num_quads);
+	uint64_t sum[CRC_LANES] = {};
+
+	/* Summed on the stack, the bands' sums share cachelines */
+	bands->hash(bands->pixels + first_quad * CRC_LANES,
+		    min(bands->band_quads, bands->num_quads - first_quad),
+		    first_quad + 1, sum);
+	memcpy(bands->sum[band], sum, sizeof(sum));
+}
 
-	return hash;
+static void chamelium_xrgb_hash(const uint32_t *pixels, size_t num_pixels,
+				uint64_t sum[CRC_LANES])
+{
+	struct xrgb_hash_bands bands = {
+		.hash = xrgb_hash_quads_func(),
+		.pixels = pixels,
+		.num_quads = num_pixels / CRC_LANES,
+	};
+	size_t num_quads = bands.num_quads, i;
+	int num_bands, n, k;
+
+	num_bands = igt_bands_count(num_quads, CRC_MIN_BAND_QUADS,
+				    CRC_MAX_THREADS);
+	bands.band_quads = DIV_ROUND_UP(num_quads, num_bands);
+
+	igt_bands_run(xrgb_hash_band, num_bands, &bands);
+
+	memset(sum, 0, CRC_LANES * sizeof(*sum));
+	for (n = 0; n < num_bands; n++)
+		for (k = 0; k < CRC_LANES; k++)
+			sum[k] += bands.sum[n][k];
+
+	/* The pixels after the last full quad */
+	for (i = num_quads * CRC_LANES; i < num_pixels; i++)
+		sum[i % CRC_LANES] += (uint64_t)(num_quads + 1) *
+			xrgb_hash_value(pixels[i]);
 }
 
-static void chamelium_do_calculate_fb_crc(cairo_surface_t *fb_surface,
-					  igt_crc_t *out)
+static void chamelium_do_calculate_fb_crc(const unsigned char *buffer,
+					  int w, int h, igt_crc_t *out)
 {
-	unsigned char *buffer;
-	int n = 4;
-	int w, h;
-	int i, j;
-
-	buffer = cairo_image_surface_get_data(fb_surface);
-	w = cairo_image_surface_get_width(fb_surface);
-	h = cairo_image_surface_get_height(fb_surface);
-
-	for (i = 0; i < n; i++) {
-		j = n - i - 1;
-		out->crc[i] = chamelium_xrgb_hash16(buffer, w, h, j, n);
+	uint64_t sum[CRC_LANES];
+	int i;
+
+	chamelium_xrgb_hash((const uint32_t *)buffer, (size_t)w * h, sum);
+
+	/* The lanes are reported last to first */
+	for (i = 0; i < CRC_LANES; i++) {
+		uint64_t s = sum[CRC_LANES - i - 1];
+
+		out->crc[i] = (s ^ (s >> 16) ^ (s >> 32) ^ (s >> 48)) & 0xffff;
 	}
 
-	out->n_words = n;
+	out->n_words = CRC_LANES;
+}
+
+static void chamelium_do_calculate_surface_crc(cairo_surface_t *fb_surface,
+					       igt_crc_t *out)
+{
+	chamelium_do_calculate_fb_crc(cairo_image_surface_get_data(fb_surface),
+				      cairo_image_surface_get_width(fb_surface),
+				      cairo_image_surface_get_height(fb_surface),
+				      out);
+}
+
+/**
+ * chamelium_calculate_xrgb_crc:
+ * @buffer: The XRGB8888 pixels to calculate the CRC for
+ * @width: The width of the frame in @buffer
+ * @height: The height of the frame in @buffer
+ *
+ * Calculates the CRC for the frame in @buffer, using the Chamelium's CRC
+ * algorithm. The rows of the frame are expected to be packed, with no
+ * padding between them.
+ *
+ * Returns: The calculated CRC
+ */
+igt_crc_t *chamelium_calculate_xrgb_crc(const void *buffer, int width,
+					int height)
+{
+	igt_crc_t *ret = calloc(1, sizeof(igt_crc_t));
+
+	chamelium_do_calculate_fb_crc(buffer, width, height, ret);
+
+	return ret;
 }
 
 /**
@@ -1314,7 +1484,7 @@ igt_crc_t *chamelium_calculate_fb_crc(int fd, struct igt_fb *fb)
 	/* Get the cairo surface for the framebuffer */
 	fb_surface = igt_get_cairo_surface(fd, fb);
 
-	chamelium_do_calculate_fb_crc(fb_surface, ret);
+	chamelium_do_calculate_surface_crc(fb_surface, ret);
 
 	return ret;
 }
@@ -1325,7 +1495,7 @@ static void *chamelium_calculate_fb_crc_async_work(void *data)
 
 	fb_crc = (struct chamelium_fb_crc_async_data *) data;
 
-	chamelium_do_calculate_fb_crc(fb_crc->fb_surface, fb_crc->ret);
+	chamelium_do_calculate_surface_crc(fb_crc->fb_surface, fb_crc->ret);
 
 	return NULL;
 }
@@ -96,6 +96,8 @@ struct chamelium_frame_dump *chamelium_port_dump_pixels(struct chamelium *chamel
 							int x, int y,
 							int w, int h);
 igt_crc_t *chamelium_calculate_fb_crc(int fd, struct igt_fb *fb);
+igt_crc_t *chamelium_calculate_xrgb_crc(const void *buffer, int width,
+					int height);
 struct chamelium_fb_crc_async_data *chamelium_calculate_fb_crc_async_start(int fd,
 									   struct igt_fb *fb);
 igt_crc_t *chamelium_calculate_fb_crc_async_finish(struct chamelium_fb_crc_async_data *fb_crc);
@@ -292,11 +292,24 @@ static int igt_exitcode = IGT_EXIT_SUCCESS;
 static const char *command_str;
 
 static char* igt_log_domain_filter;
+
+/*
+ * The last lines logged, dumped when the test fails. Lines are numbered
+ * from head and copied into their entry without taking locks or
+ * allocating, so that any thread, or a signal handler, can log. The seqno
+ * of an entry is odd while its line is written, and 2 * (number + 1) of
+ * the line it holds otherwise, so that a reader can tell when a line was
+ * overwritten while it was being copied.
+ */
+#define LOG_BUFFER_ENTRIES 256
+#define LOG_LINE_MAX 1024
 static struct {
-	char *entries[256];
-	uint8_t start, end;
+	struct {
+		unsigned long seqno;
+		char line[LOG_LINE_MAX];
+	} entries[LOG_BUFFER_ENTRIES];
+	unsigned long head, start;
 } log_buffer;
-static pthread_mutex_t log_buffer_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 GKeyFile *igt_key_file;
 
@@ -309,57 +322,96 @@ const char *igt_test_name(void)
 	return command_str;
 }
 
-static void _igt_log_buffer_append(char *line)
+static void _igt_log_buffer_append(const char *line, size_t len)
 {
-	pthread_mutex_lock(&log_buffer_mutex);
+	unsigned long n, seqno;
+	typeof(*log_buffer.entries) *entry;
 
-	free(log_buffer.entries[log_buffer.end]);
-	log_buffer.entries[log_buffer.end] = line;
-	log_buffer.end++;
-	if (log_buffer.end == log_buffer.start)
-		log_buffer.start++;
+	n = __atomic_fetch_add(&log_buffer.head, 1, __ATOMIC_RELAXED);
+	entry = &log_buffer.entries[n % LOG_BUFFER_ENTRIES];
+
+	/* Leave the entry to a writer that is still busy or lapped us */
+	seqno = __atomic_load_n(&entry->seqno, __ATOMIC_RELAXED);
+	if (seqno & 1 || seqno > 2 * n ||
+	    !__atomic_compare_exchange_n(&entry->seqno, &seqno, 2 * n + 1,
+					 false, __ATOMIC_ACQUIRE,
+					 __ATOMIC_RELAXED))
+		return;
+	__atomic_thread_fence(__ATOMIC_RELEASE);
 
-	pthread_mutex_unlock(&log_buffer_mutex);
+	if (len < sizeof(entry->line)) {
+		memcpy(entry->line, line, len);
+		entry->line[len] = '\0';
+	} else {
+		/* Truncate, but keep the end of the line */
+		bool newline = line[len - 1] == '\n';
+
+		len = sizeof(entry->line) - 1;
+		memcpy(entry->line, line, len);
+		if (newline)
+			entry->line[len - 1] = '\n';
+		entry->line[len] = '\0';
+	}
+
+	__atomic_store_n(&entry->seqno, 2 * (n + 1), __ATOMIC_RELEASE);
 }
 
-static void _igt_log_buffer_reset(void)
+static bool _igt_log_buffer_get(unsigned long n, char *line)
 {
-	pthread_mutex_lock(&log_buffer_mutex);
+	typeof(*log_buffer.entries) *entry;
+	unsigned long seqno = 2 * (n + 1);
 
-	log_buffer.start = log_buffer.end = 0;
+	entry = &log_buffer.entries[n % LOG_BUFFER_ENTRIES];
+	if (__atomic_load_n(&entry->seqno, __ATOMIC_ACQUIRE) != seqno)
+		return false;
+
+	memcpy(line, entry->line, sizeof(entry->line));
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	return __atomic_load_n(&entry->seqno, __ATOMIC_RELAXED) == seqno;
+}
+
+/* The number of the oldest line still in the buffer */
+static unsigned long _igt_log_buffer_first(unsigned long head)
+{
+	if (head - log_buffer.start > LOG_BUFFER_ENTRIES)
+		return head - LOG_BUFFER_ENTRIES;
+
+	return log_buffer.start;
+}
 
-	pthread_mutex_unlock(&log_buffer_mutex);
+static void _igt_log_buffer_reset(void)
+{
+	log_buffer.start = __atomic_load_n(&log_buffer.head, __ATOMIC_ACQUIRE);
 }
 
 static void _igt_log_buffer_dump(void)
 {
-	uint8_t i;
+	char line[LOG_LINE_MAX];
+	unsigned long n, head;
 
 	if (in_subtest)
 		fprintf(stderr, "Subtest %s failed.\n", in_subtest);
 	else
 		fprintf(stderr, "Test %s failed.\n", command_str);
 
-	if (log_buffer.start == log_buffer.end) {
+	head = __atomic_load_n(&log_buffer.head, __ATOMIC_ACQUIRE);
+	if (log_buffer.start == head) {
 		fprintf(stderr, "No log.\n");
 		return;
 	}
 
-	pthread_mutex_lock(&log_buffer_mutex);
 	fprintf(stderr, "**** DEBUG ****\n");
 
-	i = log_buffer.start;
-	do {
-		char *last_line = log_buffer.entries[i];
-		fprintf(stderr, "%s", last_line);
-		i++;
-	} while (i != log_buffer.start && i != log_buffer.end);
+	for (n = _igt_log_buffer_first(head); n != head; n++) {
+		if (_igt_log_buffer_get(n, line))
+			fprintf(stderr, "%s", line);
+	}
 
 	/* reset the buffer */
-	log_buffer.start = log_buffer.end = 0;
+	log_buffer.start = head;
 
 	fprintf(stderr, "****  END  ****\n");
-	pthread_mutex_unlock(&log_buffer_mutex);
 }
 
 /**
@@ -373,17 +425,14 @@ static void _igt_log_buffer_dump(void)
  */
 void igt_log_buffer_inspect(igt_buffer_log_handler_t check, void *data)
 {
-	uint8_t i;
-	pthread_mutex_lock(&log_buffer_mutex);
+	char line[LOG_LINE_MAX];
+	unsigned long n, head;
 
-	i = log_buffer.start;
-	do {
-		if (check(log_buffer.entries[i], data))
+	head = __atomic_load_n(&log_buffer.head, __ATOMIC_ACQUIRE);
+	for (n = _igt_log_buffer_first(head); n != head; n++) {
+		if (_igt_log_buffer_get(n, line) && check(line, data))
 			break;
-		i++;
-	} while (i != log_buffer.start && i != log_buffer.end);
-
-	pthread_mutex_unlock(&log_buffer_mutex);
+	}
 }
 
 void igt_kmsg(const char *format, ...)
@@ -2136,7 +2185,7 @@ void igt_log(const char *domain, enum igt_log_level level, const char *format, .
 void igt_vlog(const char *domain, enum igt_log_level level, const char *format, va_list args)
 {
 	FILE *file;
-	char *line, *formatted_line;
+	char buf[LOG_LINE_MAX], *line, *formatted_line = buf;
 	const char *program_name;
 	const char *igt_log_level_str[] = {
 		"DEBUG",
@@ -2146,6 +2195,9 @@ void igt_vlog(const char *domain, enum igt_log_level level, const char *format,
 		"NONE"
 	};
 	static bool line_continuation = false;
+	size_t prefix = 0;
+	va_list copy;
+	int len;
 
 	assert(format);
 
@@ -2158,23 +2210,38 @@ void igt_vlog(const char *domain, enum igt_log_level level, const char *format,
 	if (list_subtests && level <= IGT_LOG_WARN)
 		return;
 
-	if (vasprintf(&line, format, args) == -1)
+	if (!line_continuation) {
+		len = snprintf(buf, sizeof(buf), "(%s:%d) %s%s%s: ",
+			       program_name, getpid(),
+			       (domain) ? domain : "", (domain) ? "-" : "",
+			       igt_log_level_str[level]);
+		if (len < 0)
+			return;
+		prefix = min((size_t)len, sizeof(buf) - 1);
+	}
+
+	/* Format on the stack, only overlong lines need the heap */
+	va_copy(copy, args);
+	len = vsnprintf(buf + prefix, sizeof(buf) - prefix, format, copy);
+	va_end(copy);
+	if (len < 0)
 		return;
 
-	if (line_continuation) {
-		formatted_line = strdup(line);
+	if (prefix + len >= sizeof(buf)) {
+		formatted_line = malloc(prefix + len + 1);
 		if (!formatted_line)
-			goto out;
-	} else if (asprintf(&formatted_line, "(%s:%d) %s%s%s: %s", program_name,
-		     getpid(), (domain) ? domain : "", (domain) ? "-" : "",
-		     igt_log_level_str[level], line) == -1) {
-		goto out;
+			return;
+
+		memcpy(formatted_line, buf, prefix);
+		vsnprintf(formatted_line + prefix, len + 1, format, args);
 	}
+	line = formatted_line + prefix;
 
-	line_continuation = line[strlen(line) - 1] != '\n';
+	if (len)
+		line_continuation = line[len - 1] != '\n';
 
 	/* append log buffer */
-	_igt_log_buffer_append(formatted_line);
+	_igt_log_buffer_append(formatted_line, prefix + len);
 
 	/* check print log level */
 	if (igt_log_level > level)
@@ -2201,13 +2268,13 @@ void igt_vlog(const char *domain, enum igt_log_level level, const char *format,
 	/* prepend all except information messages with process, domain and log
 	 * level information */
 	if (level != IGT_LOG_INFO)
-		fwrite(formatted_line, sizeof(char), strlen(formatted_line),
-		       file);
+		fwrite(formatted_line, sizeof(char), prefix + len, file);
 	else
-		fwrite(line, sizeof(char), strlen(line), file);
+		fwrite(line, sizeof(char), len, file);
 
 out:
-	free(line);
+	if (formatted_line != buf)
+		free(formatted_line);
 }
 
 static const char *timeout_op;
@@ -29,8 +29,10 @@
 #include "drmtest.h"
 #include "intel_batchbuffer.h"
 #include "intel_chipset.h"
+#include "igt_aux.h"
 #include "igt_core.h"
 #include "igt_fb.h"
+#include "igt_tiling.h"
 #include "ioctl_wrappers.h"
 #include "i830_reg.h"
 
@@ -98,151 +100,6 @@ const char *igt_draw_get_method_name(enum igt_draw_method method)
 	}
 }
 
-static unsigned long swizzle_bit(unsigned int bit, unsigned long offset)
-{
-	return (offset & (1ul << bit)) >> (bit - 6);
-}
-
-static int swizzle_addr(unsigned long addr, int swizzle)
-{
-	switch (swizzle) {
-	case I915_BIT_6_SWIZZLE_NONE:
-		return addr;
-	case I915_BIT_6_SWIZZLE_9:
-		return addr ^ swizzle_bit(9, addr);
-	case I915_BIT_6_SWIZZLE_9_10:
-		return addr ^ swizzle_bit(9, addr) ^ swizzle_bit(10, addr);
-	case I915_BIT_6_SWIZZLE_9_11:
-		return addr ^ swizzle_bit(9, addr) ^ swizzle_bit(11, addr);
-	case I915_BIT_6_SWIZZLE_9_10_11:
-		return (addr ^
-			swizzle_bit(9, addr) ^
-			swizzle_bit(10, addr) ^
-			swizzle_bit(11, addr));
-
-	case I915_BIT_6_SWIZZLE_UNKNOWN:
-	case I915_BIT_6_SWIZZLE_9_17:
-	case I915_BIT_6_SWIZZLE_9_10_17:
-	default:
-		/* If we hit this case, we need to implement support for the
-		 * appropriate swizzling method. */
-		igt_require(false);
-		return addr;
-	}
-}
-
-static int tile(int x, int y, uint32_t x_tile_size, uint32_t y_tile_size,
-		uint32_t line_size, bool xmajor)
-{
-	int tile_size, tiles_per_line, x_tile_n, y_tile_n, tile_off, pos;
-	int tile_n, x_tile_off, y_tile_off;
-
-	tiles_per_line = line_size / x_tile_size;
-	tile_size = x_tile_size * y_tile_size;
-
-	x_tile_n = x / x_tile_size;
-	y_tile_n = y / y_tile_size;
-	tile_n = y_tile_n * tiles_per_line + x_tile_n;
-
-	x_tile_off = x % x_tile_size;
-	y_tile_off = y % y_tile_size;
-
-	if (xmajor)
-		tile_off = y_tile_off * x_tile_size + x_tile_off;
-	else
-		tile_off = x_tile_off * y_tile_size + y_tile_off;
-
-	pos = tile_n * tile_size + tile_off;
-
-	return pos;
-}
-
-static void untile(int tiled_pos, int x_tile_size, int y_tile_size,
-		   uint32_t line_size, bool xmajor, int *x, int *y)
-{
-	int tile_n, tile_off, tiles_per_line;
-	int x_tile_off, y_tile_off;
-	int x_tile_n, y_tile_n;
-	int tile_size;
-
-	tile_size = x_tile_size * y_tile_size;
-	tiles_per_line = line_size / x_tile_size;
-
-	tile_n = tiled_pos / tile_size;
-	tile_off = tiled_pos % tile_size;
-
-	if (xmajor) {
-		y_tile_off = tile_off / x_tile_size;
-		x_tile_off = tile_off % x_tile_size;
-	} else {
-		y_tile_off = tile_off % y_tile_size;
-		x_tile_off = tile_off / y_tile_size;
-	}
-
-	x_tile_n = tile_n % tiles_per_line;
-	y_tile_n = tile_n / tiles_per_line;
-
-	*x = (x_tile_n * x_tile_size + x_tile_off);
-	*y = y_tile_n * y_tile_size + y_tile_off;
-}
-
-static int linear_x_y_to_xtiled_pos(int x, int y, uint32_t stride, int swizzle,
-				    int bpp)
-{
-	int pos;
-	int pixel_size = bpp / 8;
-
-	x *= pixel_size;
-	pos = tile(x, y, 512, 8, stride, true);
-	pos = swizzle_addr(pos, swizzle);
-	return pos / pixel_size;
-}
-
-static int linear_x_y_to_ytiled_pos(int x, int y, uint32_t stride, int swizzle,
-				    int bpp)
-{
-	int ow_tile_n, pos;
-	int ow_size = 16;
-	int pixel_size = bpp / 8;
-
-	/* We have an Y tiling of OWords, so use the tile() function to get the
-	 * OW number, then adjust to the fact that the OW may have more than one
-	 * pixel. */
-	x *= pixel_size;
-	ow_tile_n = tile(x / ow_size, y, 128 / ow_size, 32,
-			 stride / ow_size, false);
-	pos = ow_tile_n * ow_size + (x % ow_size);
-	pos = swizzle_addr(pos, swizzle);
-	return pos / pixel_size;
-}
-
-static void xtiled_pos_to_x_y_linear(int tiled_pos, uint32_t stride,
-				     int swizzle, int bpp, int *x, int *y)
-{
-	int pixel_size = bpp / 8;
-
-	tiled_pos = swizzle_addr(tiled_pos, swizzle);
-
-	untile(tiled_pos, 512, 8, stride, true, x, y);
-	*x /= pixel_size;
-}
-
-static void ytiled_pos_to_x_y_linear(int tiled_pos, uint32_t stride,
-				     int swizzle, int bpp, int *x, int *y)
-{
-	int ow_tile_n;
-	int ow_size = 16;
-	int pixel_size = bpp / 8;
-
-	tiled_pos = swizzle_addr(tiled_pos, swizzle);
-
-	ow_tile_n = tiled_pos / ow_size;
-	untile(ow_tile_n, 128 / ow_size, 32, stride / ow_size, false, x, y);
-	*x *= ow_size;
-	*x += tiled_pos % ow_size;
-	*x /= pixel_size;
-}
-
 static void set_pixel(void *_ptr, int index, uint32_t color, int bpp)
 {
 	if (bpp == 16) {
@@ -301,25 +158,10 @@ static void draw_rect_ptr_tiled(void *ptr, uint32_t stride, uint32_t tiling,
 				int swizzle, struct rect *rect, uint32_t color,
 				int bpp)
 {
-	int x, y, pos;
+	struct igt_tiling t;
 
-	for (y = rect->y; y < rect->y + rect->h; y++) {
-		for (x = rect->x; x < rect->x + rect->w; x++) {
-			switch (tiling) {
-			case I915_TILING_X:
-				pos = linear_x_y_to_xtiled_pos(x, y, stride,
-							       swizzle, bpp);
-				break;
-			case I915_TILING_Y:
-				pos = linear_x_y_to_ytiled_pos(x, y, stride,
-							       swizzle, bpp);
-				break;
-			default:
-				igt_assert(false);
-			}
-			set_pixel(ptr, pos, color, bpp);
-		}
-	}
+	igt_tiling_init(&t, tiling, swizzle, bpp, stride);
+	igt_tiling_fill(&t, ptr, color, rect->x, rect->y, rect->w, rect->h);
 }
 
 static void draw_rect_mmap_cpu(int fd, struct buf_data *buf, struct rect *rect,
@@ -426,61 +268,48 @@ static void draw_rect_pwrite_tiled(int fd, struct buf_data *buf,
 				   uint32_t tiling, struct rect *rect,
 				   uint32_t color, uint32_t swizzle)
 {
-	int i;
-	int tiled_pos, x, y, pixel_size;
-	uint8_t tmp[4096];
-	int tmp_used = 0, tmp_size;
-	bool flush_tmp = false;
-	int tmp_start_pos = 0;
-	int pixels_written = 0;
+	struct igt_tiling t;
+	int pixel_size, first_tile, n_tiles, tile_y;
+	uint32_t offset, size;
+	uint8_t *tmp;
 
 	/* We didn't implement suport for the older tiling methods yet. */
 	igt_require(intel_gen(intel_get_drm_devid(fd)) >= 5);
 
-	pixel_size = buf->bpp / 8;
-	tmp_size = sizeof(tmp) / pixel_size;
+	if (rect->w <= 0 || rect->h <= 0)
+		return;
 
-	/* Instead of doing one pwrite per pixel, we try to group the maximum
-	 * amount of consecutive pixels we can in a single pwrite: that's why we
-	 * use the "tmp" variables. */
-	for (i = 0; i < tmp_size; i++)
-		set_pixel(tmp, i, color, buf->bpp);
+	igt_tiling_init(&t, tiling, swizzle, buf->bpp, buf->stride);
+	pixel_size = buf->bpp / 8;
 
-	for (tiled_pos = 0; tiled_pos < buf->size; tiled_pos += pixel_size) {
-		switch (tiling) {
-		case I915_TILING_X:
-			xtiled_pos_to_x_y_linear(tiled_pos, buf->stride,
-						 swizzle, buf->bpp, &x, &y);
-			break;
-		case I915_TILING_Y:
-			ytiled_pos_to_x_y_linear(tiled_pos, buf->stride,
-						 swizzle, buf->bpp, &x, &y);
-			break;
-		default:
-			igt_assert(false);
-		}
-
-		if (x >= rect->x && x < rect->x + rect->w &&
-		    y >= rect->y && y < rect->y + rect->h) {
-			if (tmp_used == 0)
-				tmp_start_pos = tiled_pos;
-			tmp_used++;
-		} else {
-			flush_tmp = true;
-		}
-
-		if (tmp_used == tmp_size || (flush_tmp && tmp_used > 0) ||
-		    tiled_pos + pixel_size >= buf->size) {
-			gem_write(fd, buf->handle, tmp_start_pos, tmp,
-				  tmp_used * pixel_size);
-			flush_tmp = false;
-			pixels_written += tmp_used;
-			tmp_used = 0;
-
-			if (pixels_written == rect->w * rect->h)
-				break;
-		}
+	/* The tiles covered by each row of tiles of the rectangle are
+	 * contiguous, so instead of doing one pwrite per run of pixels we read
+	 * them, draw the rectangle into them as into a surface just as wide
+	 * and write them back in one go. */
+	first_tile = rect->x * pixel_size / t.tile_width;
+	n_tiles = ((rect->x + rect->w) * pixel_size - 1) / t.tile_width -
+		  first_tile + 1;
+	size = n_tiles * 4096;
+	igt_tiling_init(&t, tiling, swizzle, buf->bpp, n_tiles * t.tile_width);
+
+	tmp = malloc(size);
+	igt_assert(tmp);
+
+	for (tile_y = rect->y / t.tile_height * t.tile_height;
+	     tile_y < rect->y + rect->h; tile_y += t.tile_height) {
+		int y0 = max(rect->y, tile_y);
+		int y1 = min(rect->y + rect->h, tile_y + (int)t.tile_height);
+
+		offset = tile_y * buf->stride + first_tile * 4096;
+
+		gem_read(fd, buf->handle, offset, tmp, size);
+		igt_tiling_fill(&t, tmp, color,
+				rect->x - first_tile * t.tile_width / pixel_size,
+				y0 - tile_y, rect->w, y1 - y0);
+		gem_write(fd, buf->handle, offset, tmp, size);
 	}
+
+	free(tmp);
 }
 
 static void draw_rect_pwrite(int fd, struct buf_data *buf,
@@ -37,6 +37,7 @@
 #include "igt_fb.h"
 #include "igt_kms.h"
 #include "igt_matrix.h"
+#include "igt_tiling.h"
 #include "igt_x86.h"
 #include "ioctl_wrappers.h"
 #include "intel_batchbuffer.h"
@@ -1296,12 +1297,67 @@ static void blitcopy(const struct igt_fb *dst_fb,
 	}
 }
 
+/*
+ * The blitter can only tile with the fast copy of gen9+, on older platforms
+ * the fb is (de)tiled on the CPU through a CPU mapping instead.
+ */
+static bool use_cpu_tiling(const struct igt_fb *fb)
+{
+	return intel_gen(intel_get_drm_devid(fb->fd)) < 9;
+}
+
+static void cpu_tiling_copy(struct igt_fb *fb, struct fb_blit_linear *linear,
+			    bool to_tiled)
+{
+	uint32_t tiling, swizzle;
+	struct igt_tiling t;
+	uint8_t *map;
+
+	igt_require(gem_get_tiling(fb->fd, fb->gem_handle, &tiling, &swizzle));
+
+	gem_set_domain(fb->fd, fb->gem_handle, I915_GEM_DOMAIN_CPU,
+		       to_tiled ? I915_GEM_DOMAIN_CPU : 0);
+	map = gem_mmap__cpu(fb->fd, fb->gem_handle, 0, fb->size,
+			    PROT_READ | (to_tiled ? PROT_WRITE : 0));
+
+	for (int i = 0; i < fb->num_planes; i++) {
+		igt_tiling_init(&t, igt_fb_mod_to_tiling(fb->tiling), swizzle,
+				fb->plane_bpp[i], fb->strides[i]);
+
+		if (to_tiled)
+			igt_tiling_to_tiled(&t, map + fb->offsets[i],
+					    linear->map + linear->fb.offsets[i],
+					    linear->fb.strides[i], 0, 0,
+					    fb->plane_width[i],
+					    fb->plane_height[i]);
+		else
+			igt_tiling_from_tiled(&t,
+					      linear->map + linear->fb.offsets[i],
+					      linear->fb.strides[i],
+					      map + fb->offsets[i], 0, 0,
+					      fb->plane_width[i],
+					      fb->plane_height[i]);
+	}
+
+	if (to_tiled)
+		gem_sw_finish(fb->fd, fb->gem_handle);
+
+	gem_munmap(map, fb->size);
+}
+
 static void free_linear_mapping(struct fb_blit_upload *blit)
 {
 	int fd = blit->fd;
 	struct igt_fb *fb = blit->fb;
 	struct fb_blit_linear *linear = &blit->linear;
 
+	if (use_cpu_tiling(fb)) {
+		cpu_tiling_copy(fb, linear, true);
+		gem_munmap(linear->map, linear->fb.size);
+		gem_close(fd, linear->fb.gem_handle);
+		return;
+	}
+
 	gem_munmap(linear->map, linear->fb.size);
 	gem_set_domain(fd, linear->fb.gem_handle,
 		       I915_GEM_DOMAIN_GTT, 0);
@@ -1339,6 +1395,17 @@ static void setup_linear_mapping(int fd, struct igt_fb *fb, struct fb_blit_linea
 
 	igt_assert(linear->fb.gem_handle > 0);
 
+	if (use_cpu_tiling(fb)) {
+		gem_set_domain(fd, linear->fb.gem_handle,
+			       I915_GEM_DOMAIN_CPU, I915_GEM_DOMAIN_CPU);
+		linear->map = gem_mmap__cpu(fd, linear->fb.gem_handle, 0,
+					    linear->fb.size,
+					    PROT_READ | PROT_WRITE);
+
+		cpu_tiling_copy(fb, linear, false);
+		return;
+	}
+
 	/* Copy fb content to linear BO */
 	gem_set_domain(fd, linear->fb.gem_handle,
 			I915_GEM_DOMAIN_GTT, 0);
@@ -1452,6 +1519,7 @@ struct fb_convert_blit_upload {
 
 	struct igt_fb shadow_fb;
 	uint8_t *shadow_ptr;
+	uint8_t *shadow_copy;
 };
 
 static void *igt_fb_create_cairo_shadow_buffer(int fd,
@@ -1627,7 +1695,7 @@ static void convert_nv12_to_rgb24(struct fb_convert *cvt)
 			rgb[1] = igt_matrix_transform(&m, &yuv[1]);
 
 			write_rgb(&rgb24[j * 8 + 0], &rgb[0]);
-			write_rgb(&rgb24[j * 8 + 4], &rgb[0]);
+			write_rgb(&rgb24[j * 8 + 4], &rgb[1]);
 		}
 
 		if (cvt->dst.fb->width & 1) {
@@ -1699,7 +1767,7 @@ static void convert_rgb24_to_nv12(struct fb_convert *cvt)
 			struct igt_vec4 yuv[2];
 
 			read_rgb(&rgb[0], &rgb24[j * 8 + 0]);
-			read_rgb(&rgb[2], &rgb24[j * 8 + 0 + rgb24_stride]);
+			read_rgb(&rgb[1], &rgb24[j * 8 + 0 + rgb24_stride]);
 
 			yuv[0] = igt_matrix_transform(&m, &rgb[0]);
 			yuv[1] = igt_matrix_transform(&m, &rgb[1]);
@@ -1891,6 +1959,522 @@ static void convert_rgb24_to_yuyv(struct fb_convert *cvt)
 	}
 }
 
+/*
+ * Fixed point versions of the YCbCr conversions above, used on CPUs
+ * with SSE4.1 or AVX2. The matrices are scaled by 2^16, which keeps
+ * every component within 1 of the float conversion. Setting
+ * IGT_FB_NO_SIMD in the environment forces the float conversion.
+ */
+#define FIXED_SHIFT 16
+
+struct fixed_mat {
+	int32_t c[3][4];
+};
+
+struct yuv_kernels {
+	/* u and v have one sample per two pixels */
+	void (*yuv_to_rgb24)(const struct fixed_mat *m, uint32_t *rgb24,
+			     const uint8_t *y, const uint8_t *u,
+			     const uint8_t *v, int width);
+	/* u and v are stored unshifted, so they can be averaged */
+	void (*rgb24_to_yuv)(const struct fixed_mat *m, uint8_t *y,
+			     int32_t *u, int32_t *v,
+			     const uint32_t *rgb24, int width);
+};
+
+static struct fixed_mat fixed_matrix(const struct igt_mat4 *m, bool round)
+{
+	struct fixed_mat ret;
+	int i, j;
+
+	for (i = 0; i < 3; i++) {
+		for (j = 0; j < 4; j++)
+			ret.c[i][j] = lrintf(m->d[m(i, j)] * (1 << FIXED_SHIFT));
+
+		/* write_rgb() rounds, the YCbCr components are truncated */
+		if (round)
+			ret.c[i][3] += 1 << (FIXED_SHIFT - 1);
+	}
+
+	return ret;
+}
+
+static inline int32_t fixed_dot(const struct fixed_mat *m, int row,
+				int a, int b, int c)
+{
+	return m->c[row][0] * a + m->c[row][1] * b + m->c[row][2] * c +
+		m->c[row][3];
+}
+
+static inline uint8_t fixed_to_u8(int32_t val, int shift)
+{
+	return clamp(val >> shift, 0, 255);
+}
+
+static void yuv_to_rgb24_tail(const struct fixed_mat *m, uint32_t *rgb24,
+			      const uint8_t *y, const uint8_t *u,
+			      const uint8_t *v, int start, int width)
+{
+	int j;
+
+	for (j = start; j < width; j++) {
+		uint8_t r = fixed_to_u8(fixed_dot(m, 0, y[j], u[j / 2], v[j / 2]),
+					FIXED_SHIFT);
+		uint8_t g = fixed_to_u8(fixed_dot(m, 1, y[j], u[j / 2], v[j / 2]),
+					FIXED_SHIFT);
+		uint8_t b = fixed_to_u8(fixed_dot(m, 2, y[j], u[j / 2], v[j / 2]),
+					FIXED_SHIFT);
+
+		rgb24[j] = (rgb24[j] & 0xff000000) | r << 16 | g << 8 | b;
+	}
+}
+
+static void rgb24_to_yuv_tail(const struct fixed_mat *m, uint8_t *y,
+			      int32_t *u, int32_t *v,
+			      const uint32_t *rgb24, int start, int width)
+{
+	int j;
+
+	for (j = start; j < width; j++) {
+		int r = (rgb24[j] >> 16) & 0xff;
+		int g = (rgb24[j] >> 8) & 0xff;
+		int b = rgb24[j] & 0xff;
+
+		y[j] = fixed_to_u8(fixed_dot(m, 0, r, g, b), FIXED_SHIFT);
+		u[j] = fixed_dot(m, 1, r, g, b);
+		v[j] = fixed_dot(m, 2, r, g, b);
+	}
+}
+
+#if defined(__x86_64__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+
+#include <smmintrin.h>
+
+static inline __m128i fixed_dot_sse41(const __m128i k[4],
+				      __m128i a, __m128i b, __m128i c)
+{
+	__m128i sum = _mm_add_epi32(_mm_mullo_epi32(a, k[0]),
+				    _mm_mullo_epi32(b, k[1]));
+
+	sum = _mm_add_epi32(sum, _mm_mullo_epi32(c, k[2]));
+
+	return _mm_add_epi32(sum, k[3]);
+}
+
+static inline __m128i fixed_to_u8_sse41(__m128i val)
+{
+	val = _mm_srai_epi32(val, FIXED_SHIFT);
+	val = _mm_max_epi32(val, _mm_setzero_si128());
+
+	return _mm_min_epi32(val, _mm_set1_epi32(255));
+}
+
+static void yuv_to_rgb24_sse41(const struct fixed_mat *m, uint32_t *rgb24,
+			       const uint8_t *y, const uint8_t *u,
+			       const uint8_t *v, int width)
+{
+	const __m128i x_mask = _mm_set1_epi32(0xff000000);
+	__m128i k[3][4];
+	int i, j;
+
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 4; j++)
+			k[i][j] = _mm_set1_epi32(m->c[i][j]);
+
+	/* 4 pixels at a time, sharing 2 chroma samples */
+	for (j = 0; j + 4 <= width; j += 4) {
+		__m128i Y, U, V, R, G, B, X;
+		uint32_t y4;
+		uint16_t u2, v2;
+
+		memcpy(&y4, &y[j], sizeof(y4));
+		memcpy(&u2, &u[j / 2], sizeof(u2));
+		memcpy(&v2, &v[j / 2], sizeof(v2));
+
+		Y = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(y4));
+		U = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(u2));
+		V = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(v2));
+		U = _mm_unpacklo_epi32(U, U);
+		V = _mm_unpacklo_epi32(V, V);
+
+		R = fixed_to_u8_sse41(fixed_dot_sse41(k[0], Y, U, V));
+		G = fixed_to_u8_sse41(fixed_dot_sse41(k[1], Y, U, V));
+		B = fixed_to_u8_sse41(fixed_dot_sse41(k[2], Y, U, V));
+
+		X = _mm_and_si128(_mm_loadu_si128((__m128i *)&rgb24[j]), x_mask);
+		X = _mm_or_si128(X, _mm_slli_epi32(R, 16));
+		X = _mm_or_si128(X, _mm_slli_epi32(G, 8));
+		X = _mm_or_si128(X, B);
+		_mm_storeu_si128((__m128i *)&rgb24[j], X);
+	}
+
+	yuv_to_rgb24_tail(m, rgb24, y, u, v, j, width);
+}
+
+static void rgb24_to_yuv_sse41(const struct fixed_mat *m, uint8_t *y,
+			       int32_t *u, int32_t *v,
+			       const uint32_t *rgb24, int width)
+{
+	const __m128i mask = _mm_set1_epi32(0xff);
+	__m128i k[3][4];
+	int i, j;
+
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 4; j++)
+			k[i][j] = _mm_set1_epi32(m->c[i][j]);
+
+	for (j = 0; j + 4 <= width; j += 4) {
+		__m128i P, R, G, B, Y;
+		uint32_t y4;
+
+		P = _mm_loadu_si128((const __m128i *)&rgb24[j]);
+		R = _mm_and_si128(_mm_srli_epi32(P, 16), mask);
+		G = _mm_and_si128(_mm_srli_epi32(P, 8), mask);
+		B = _mm_and_si128(P, mask);
+
+		Y = fixed_to_u8_sse41(fixed_dot_sse41(k[0], R, G, B));
+		Y = _mm_packus_epi16(_mm_packs_epi32(Y, Y), Y);
+		y4 = _mm_cvtsi128_si32(Y);
+		memcpy(&y[j], &y4, sizeof(y4));
+
+		_mm_storeu_si128((__m128i *)&u[j], fixed_dot_sse41(k[1], R, G, B));
+		_mm_storeu_si128((__m128i *)&v[j], fixed_dot_sse41(k[2], R, G, B));
+	}
+
+	rgb24_to_yuv_tail(m, y, u, v, rgb24, j, width);
+}
+
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+#include <immintrin.h>
+
+static inline __m256i fixed_dot_avx2(const __m256i k[4],
+				     __m256i a, __m256i b, __m256i c)
+{
+	__m256i sum = _mm256_add_epi32(_mm256_mullo_epi32(a, k[0]),
+				       _mm256_mullo_epi32(b, k[1]));
+
+	sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(c, k[2]));
+
+	return _mm256_add_epi32(sum, k[3]);
+}
+
+static inline __m256i fixed_to_u8_avx2(__m256i val)
+{
+	val = _mm256_srai_epi32(val, FIXED_SHIFT);
+	val = _mm256_max_epi32(val, _mm256_setzero_si256());
+
+	return _mm256_min_epi32(val, _mm256_set1_epi32(255));
+}
+
+static void yuv_to_rgb24_avx2(const struct fixed_mat *m, uint32_t *rgb24,
+			      const uint8_t *y, const uint8_t *u,
+			      const uint8_t *v, int width)
+{
+	const __m256i x_mask = _mm256_set1_epi32(0xff000000);
+	const __m256i dup = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+	__m256i k[3][4];
+	int i, j;
+
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 4; j++)
+			k[i][j] = _mm256_set1_epi32(m->c[i][j]);
+
+	/* 8 pixels at a time, sharing 4 chroma samples */
+	for (j = 0; j + 8 <= width; j += 8) {
+		__m256i Y, U, V, R, G, B, X;
+		uint32_t u4, v4;
+
+		memcpy(&u4, &u[j / 2], sizeof(u4));
+		memcpy(&v4, &v[j / 2], sizeof(v4));
+
+		Y = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)&y[j]));
+		U = _mm256_cvtepu8_epi32(_mm_cvtsi32_si128(u4));
+		V = _mm256_cvtepu8_epi32(_mm_cvtsi32_si128(v4));
+		U = _mm256_permutevar8x32_epi32(U, dup);
+		V = _mm256_permutevar8x32_epi32(V, dup);
+
+		R = fixed_to_u8_avx2(fixed_dot_avx2(k[0], Y, U, V));
+		G = fixed_to_u8_avx2(fixed_dot_avx2(k[1], Y, U, V));
+		B = fixed_to_u8_avx2(fixed_dot_avx2(k[2], Y, U, V));
+
+		X = _mm256_and_si256(_mm256_loadu_si256((__m256i *)&rgb24[j]), x_mask);
+		X = _mm256_or_si256(X, _mm256_slli_epi32(R, 16));
+		X = _mm256_or_si256(X, _mm256_slli_epi32(G, 8));
+		X = _mm256_or_si256(X, B);
+		_mm256_storeu_si256((__m256i *)&rgb24[j], X);
+	}
+
+	yuv_to_rgb24_tail(m, rgb24, y, u, v, j, width);
+}
+
+static void rgb24_to_yuv_avx2(const struct fixed_mat *m, uint8_t *y,
+			      int32_t *u, int32_t *v,
+			      const uint32_t *rgb24, int width)
+{
+	const __m256i mask = _mm256_set1_epi32(0xff);
+	__m256i k[3][4];
+	int i, j;
+
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 4; j++)
+			k[i][j] = _mm256_set1_epi32(m->c[i][j]);
+
+	for (j = 0; j + 8 <= width; j += 8) {
+		__m256i P, R, G, B, Y;
+		__m128i Y8;
+
+		P = _mm256_loadu_si256((const __m256i *)&rgb24[j]);
+		R = _mm256_and_si256(_mm256_srli_epi32(P, 16), mask);
+		G = _mm256_and_si256(_mm256_srli_epi32(P, 8), mask);
+		B = _mm256_and_si256(P, mask);
+
+		Y = fixed_to_u8_avx2(fixed_dot_avx2(k[0], R, G, B));
+		Y8 = _mm_packs_epi32(_mm256_castsi256_si128(Y),
+				     _mm256_extracti128_si256(Y, 1));
+		Y8 = _mm_packus_epi16(Y8, Y8);
+		_mm_storel_epi64((__m128i *)&y[j], Y8);
+
+		_mm256_storeu_si256((__m256i *)&u[j], fixed_dot_avx2(k[1], R, G, B));
+		_mm256_storeu_si256((__m256i *)&v[j], fixed_dot_avx2(k[2], R, G, B));
+	}
+
+	rgb24_to_yuv_tail(m, y, u, v, rgb24, j, width);
+}
+
+#pragma GCC pop_options
+
+static const struct yuv_kernels yuv_kernels_sse41 = {
+	.yuv_to_rgb24 = yuv_to_rgb24_sse41,
+	.rgb24_to_yuv = rgb24_to_yuv_sse41,
+};
+
+static const struct yuv_kernels yuv_kernels_avx2 = {
+	.yuv_to_rgb24 = yuv_to_rgb24_avx2,
+	.rgb24_to_yuv = rgb24_to_yuv_avx2,
+};
+
+static const struct yuv_kernels *yuv_kernels(void)
+{
+	unsigned features;
+
+	if (getenv("IGT_FB_NO_SIMD"))
+		return NULL;
+
+	features = igt_x86_features();
+	if (features & AVX2)
+		return &yuv_kernels_avx2;
+	if (features & SSE4_1)
+		return &yuv_kernels_sse41;
+
+	return NULL;
+}
+#else
+static const struct yuv_kernels *yuv_kernels(void)
+{
+	return NULL;
+}
+#endif
+
+static void convert_nv12_to_rgb24_fixed(struct fb_convert *cvt,
+					const struct yuv_kernels *k)
+{
+	int i, j;
+	const uint8_t *y, *uv;
+	uint8_t *rgb24 = cvt->dst.ptr;
+	unsigned int rgb24_stride = cvt->dst.fb->strides[0];
+	unsigned int planar_stride = cvt->src.fb->strides[0];
+	struct igt_mat4 mat = igt_ycbcr_to_rgb_matrix(cvt->src.fb->color_encoding,
+						      cvt->src.fb->color_range);
+	struct fixed_mat m = fixed_matrix(&mat, true);
+	int width = cvt->dst.fb->width, chroma_width = (width + 1) / 2;
+	uint8_t *buf, *u, *v;
+
+	igt_assert(cvt->src.fb->drm_format == DRM_FORMAT_NV12 &&
+		   cvt->dst.fb->drm_format == DRM_FORMAT_XRGB8888);
+
+	buf = convert_src_get(cvt);
+	y = buf + cvt->src.fb->offsets[0];
+	uv = buf + cvt->src.fb->offsets[1];
+
+	u = malloc(2 * chroma_width);
+	igt_assert(u);
+	v = u + chroma_width;
+
+	for (i = 0; i < cvt->dst.fb->height; i++) {
+		/* Each chroma row is shared by two rows of pixels */
+		if (!(i & 1)) {
+			for (j = 0; j < chroma_width; j++) {
+				u[j] = uv[j * 2 + 0];
+				v[j] = uv[j * 2 + 1];
+			}
+			uv += planar_stride;
+		}
+
+		k->yuv_to_rgb24(&m, (uint32_t *)rgb24, y, u, v, width);
+
+		rgb24 += rgb24_stride;
+		y += planar_stride;
+	}
+
+	free(u);
+	convert_src_put(cvt, buf);
+}
+
+static void convert_rgb24_to_nv12_fixed(struct fb_convert *cvt,
+					const struct yuv_kernels *k)
+{
+	int i, j;
+	uint8_t *y = cvt->dst.ptr + cvt->dst.fb->offsets[0];
+	uint8_t *uv = cvt->dst.ptr + cvt->dst.fb->offsets[1];
+	const uint8_t *rgb24 = cvt->src.ptr;
+	unsigned rgb24_stride = cvt->src.fb->strides[0];
+	unsigned planar_stride = cvt->dst.fb->strides[0];
+	struct igt_mat4 mat = igt_rgb_to_ycbcr_matrix(cvt->dst.fb->color_encoding,
+						      cvt->dst.fb->color_range);
+	struct fixed_mat m = fixed_matrix(&mat, false);
+	int width = cvt->dst.fb->width, chroma_width = (width + 1) / 2;
+	int32_t *u, *v, *u2, *v2;
+
+	igt_assert(cvt->src.fb->drm_format == DRM_FORMAT_XRGB8888 &&
+		   cvt->dst.fb->drm_format == DRM_FORMAT_NV12);
+
+	u = malloc(4 * width * sizeof(*u));
+	igt_assert(u);
+	v = u + width;
+	u2 = v + width;
+	v2 = u2 + width;
+
+	for (i = 0; i < cvt->dst.fb->height; i += 2) {
+		k->rgb24_to_yuv(&m, y, u, v, (const uint32_t *)rgb24, width);
+
+		if (i + 1 < cvt->dst.fb->height) {
+			k->rgb24_to_yuv(&m, y + planar_stride, u2, v2,
+					(const uint32_t *)(rgb24 + rgb24_stride),
+					width);
+
+			/* Same chroma siting as convert_rgb24_to_nv12() */
+			for (j = 0; j < chroma_width; j++) {
+				uv[j * 2 + 0] = fixed_to_u8(u[j * 2] + u2[j * 2],
+							    FIXED_SHIFT + 1);
+				uv[j * 2 + 1] = fixed_to_u8(v[j * 2] + v2[j * 2],
+							    FIXED_SHIFT + 1);
+			}
+		} else {
+			/* Last row cannot be interpolated between 2 pixels */
+			for (j = 0; j < chroma_width; j++) {
+				uv[j * 2 + 0] = fixed_to_u8(u[j * 2], FIXED_SHIFT);
+				uv[j * 2 + 1] = fixed_to_u8(v[j * 2], FIXED_SHIFT);
+			}
+		}
+
+		rgb24 += 2 * rgb24_stride;
+		y += 2 * planar_stride;
+		uv += planar_stride;
+	}
+
+	free(u);
+}
+
+static void convert_yuyv_to_rgb24_fixed(struct fb_convert *cvt,
+					const struct yuv_kernels *k)
+{
+	int i, j;
+	const uint8_t *yuyv;
+	uint8_t *rgb24 = cvt->dst.ptr;
+	unsigned int rgb24_stride = cvt->dst.fb->strides[0];
+	unsigned int yuyv_stride = cvt->src.fb->strides[0];
+	struct igt_mat4 mat = igt_ycbcr_to_rgb_matrix(cvt->src.fb->color_encoding,
+						      cvt->src.fb->color_range);
+	struct fixed_mat m = fixed_matrix(&mat, true);
+	const unsigned char *swz = yuyv_swizzle(cvt->src.fb->drm_format);
+	int width = cvt->dst.fb->width, chroma_width = (width + 1) / 2;
+	uint8_t *buf, *y, *u, *v;
+
+	buf = convert_src_get(cvt);
+	yuyv = buf;
+
+	y = malloc(width + 2 * chroma_width);
+	igt_assert(y);
+	u = y + width;
+	v = u + chroma_width;
+
+	for (i = 0; i < cvt->dst.fb->height; i++) {
+		for (j = 0; j < width / 2; j++) {
+			y[j * 2 + 0] = yuyv[j * 4 + swz[0]];
+			y[j * 2 + 1] = yuyv[j * 4 + swz[2]];
+			u[j] = yuyv[j * 4 + swz[1]];
+			v[j] = yuyv[j * 4 + swz[3]];
+		}
+
+		if (width & 1) {
+			y[j * 2 + 0] = yuyv[j * 4 + swz[0]];
+			u[j] = yuyv[j * 4 + swz[1]];
+			v[j] = yuyv[j * 4 + swz[3]];
+		}
+
+		k->yuv_to_rgb24(&m, (uint32_t *)rgb24, y, u, v, width);
+
+		rgb24 += rgb24_stride;
+		yuyv += yuyv_stride;
+	}
+
+	free(y);
+	convert_src_put(cvt, buf);
+}
+
+static void convert_rgb24_to_yuyv_fixed(struct fb_convert *cvt,
+					const struct yuv_kernels *k)
+{
+	int i, j;
+	uint8_t *yuyv = cvt->dst.ptr;
+	const uint8_t *rgb24 = cvt->src.ptr;
+	unsigned rgb24_stride = cvt->src.fb->strides[0];
+	unsigned yuyv_stride = cvt->dst.fb->strides[0];
+	struct igt_mat4 mat = igt_rgb_to_ycbcr_matrix(cvt->dst.fb->color_encoding,
+						      cvt->dst.fb->color_range);
+	struct fixed_mat m = fixed_matrix(&mat, false);
+	const unsigned char *swz = yuyv_swizzle(cvt->dst.fb->drm_format);
+	int width = cvt->dst.fb->width;
+	int32_t *u, *v;
+	uint8_t *y;
+
+	u = malloc(2 * width * sizeof(*u));
+	y = malloc(width);
+	igt_assert(u && y);
+	v = u + width;
+
+	for (i = 0; i < cvt->dst.fb->height; i++) {
+		k->rgb24_to_yuv(&m, y, u, v, (const uint32_t *)rgb24, width);
+
+		for (j = 0; j < width / 2; j++) {
+			yuyv[j * 4 + swz[0]] = y[j * 2 + 0];
+			yuyv[j * 4 + swz[2]] = y[j * 2 + 1];
+			yuyv[j * 4 + swz[1]] = fixed_to_u8(u[j * 2] + u[j * 2 + 1],
+							   FIXED_SHIFT + 1);
+			yuyv[j * 4 + swz[3]] = fixed_to_u8(v[j * 2] + v[j * 2 + 1],
+							   FIXED_SHIFT + 1);
+		}
+
+		if (width & 1) {
+			yuyv[j * 4 + swz[0]] = y[j * 2 + 0];
+			yuyv[j * 4 + swz[1]] = fixed_to_u8(u[j * 2], FIXED_SHIFT);
+			yuyv[j * 4 + swz[3]] = fixed_to_u8(v[j * 2], FIXED_SHIFT);
+		}
+
+		rgb24 += rgb24_stride;
+		yuyv += yuyv_stride;
+	}
+
+	free(y);
+	free(u);
+}
+
 static void convert_pixman(struct fb_convert *cvt)
 {
 	pixman_format_code_t src_pixman = drm_format_to_pixman(cvt->src.fb->drm_format);
@@ -1926,8 +2510,37 @@ static void convert_pixman(struct fb_convert *cvt)
 	convert_src_put(cvt, src_ptr);
 }
 
-static void fb_convert(struct fb_convert *cvt)
+/* Whether fb_convert_band() can convert from @src to @dst */
+static bool fb_convert_supported(uint32_t src, uint32_t dst)
+{
+	uint32_t yuv;
+
+	if (drm_format_to_pixman(src) != PIXMAN_invalid &&
+	    drm_format_to_pixman(dst) != PIXMAN_invalid)
+		return true;
+	else if (dst == DRM_FORMAT_XRGB8888)
+		yuv = src;
+	else if (src == DRM_FORMAT_XRGB8888)
+		yuv = dst;
+	else
+		return false;
+
+	switch (yuv) {
+	case DRM_FORMAT_NV12:
+	case DRM_FORMAT_YUYV:
+	case DRM_FORMAT_YVYU:
+	case DRM_FORMAT_UYVY:
+	case DRM_FORMAT_VYUY:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void fb_convert_band(struct fb_convert *cvt)
 {
+	const struct yuv_kernels *k = yuv_kernels();
+
 	if ((drm_format_to_pixman(cvt->src.fb->drm_format) != PIXMAN_invalid) &&
 	    (drm_format_to_pixman(cvt->dst.fb->drm_format) != PIXMAN_invalid)) {
 		convert_pixman(cvt);
@@ -1935,32 +2548,207 @@ static void fb_convert(struct fb_convert *cvt)
 	} else if (cvt->dst.fb->drm_format == DRM_FORMAT_XRGB8888) {
 		switch (cvt->src.fb->drm_format) {
 		case DRM_FORMAT_NV12:
-			convert_nv12_to_rgb24(cvt);
+			if (k)
+				convert_nv12_to_rgb24_fixed(cvt, k);
+			else
+				convert_nv12_to_rgb24(cvt);
 			return;
 		case DRM_FORMAT_YUYV:
 		case DRM_FORMAT_YVYU:
 		case DRM_FORMAT_UYVY:
 		case DRM_FORMAT_VYUY:
-			convert_yuyv_to_rgb24(cvt);
+			if (k)
+				convert_yuyv_to_rgb24_fixed(cvt, k);
+			else
+				convert_yuyv_to_rgb24(cvt);
 			return;
 		}
 	} else if (cvt->src.fb->drm_format == DRM_FORMAT_XRGB8888) {
 		switch (cvt->dst.fb->drm_format) {
 		case DRM_FORMAT_NV12:
-			convert_rgb24_to_nv12(cvt);
+			if (k)
+				convert_rgb24_to_nv12_fixed(cvt, k);
+			else
+				convert_rgb24_to_nv12(cvt);
 			return;
 		case DRM_FORMAT_YUYV:
 		case DRM_FORMAT_YVYU:
 		case DRM_FORMAT_UYVY:
 		case DRM_FORMAT_VYUY:
-			convert_rgb24_to_yuyv(cvt);
+			if (k)
+				convert_rgb24_to_yuyv_fixed(cvt, k);
+			else
+				convert_rgb24_to_yuyv(cvt);
 			return;
 		}
 	}
+}
+
+/*
+ * Conversions are split into horizontal bands, which are converted in
+ * parallel with igt_bands_run().
+ */
+#define FB_CONVERT_MAX_THREADS 16
+#define FB_CONVERT_MIN_BAND_ROWS 32
+
+struct fb_convert_band {
+	struct fb_convert cvt;
+	struct igt_fb dst_fb;
+	struct igt_fb src_fb;
+};
+
+static void fb_convert_band_work(int band, void *data)
+{
+	struct fb_convert_band *bands = data;
+
+	fb_convert_band(&bands[band].cvt);
+}
+
+static void band_init(struct fb_convert_buf *band, struct igt_fb *band_fb,
+		      const struct fb_convert_buf *buf, const struct box *box)
+{
+	const struct igt_fb *fb = buf->fb;
+	int i;
+
+	*band_fb = *fb;
+	band_fb->width = box->width;
+	band_fb->height = box->height;
+
+	band->fb = band_fb;
+	band->ptr = buf->ptr + box->y * fb->strides[0] +
+		box->x * fb_plane_bpp(fb, 0) / 8;
+	band->slow_reads = false;
+
+	/* The other planes are relative to the first one */
+	for (i = 1; i < fb_num_planes(fb); i++) {
+		bool subsampled = fb->drm_format == DRM_FORMAT_NV12;
+		int plane_x = subsampled ? box->x / 2 : box->x;
+		int plane_y = subsampled ? box->y / 2 : box->y;
+
+		band_fb->offsets[i] = fb->offsets[i] -
+			(band->ptr - buf->ptr) +
+			plane_y * fb->strides[i] +
+			plane_x * fb_plane_bpp(fb, i) / 8;
+	}
+}
+
+/*
+ * Converts the pixels inside @rect only. The rectangle must start on
+ * an even row and column, so no chroma sample is split.
+ */
+static void fb_convert_rect(struct fb_convert *cvt, const struct box *rect)
+{
+	struct fb_convert_band *bands;
+	struct fb_convert whole = *cvt;
+	int num_bands, band_rows, i;
 
-	igt_assert_f(false,
+	igt_assert(!(rect->x & 1) && !(rect->y & 1));
+
+	/* The bands are converted on threads which can't fail the test */
+	igt_assert_f(fb_convert_supported(cvt->src.fb->drm_format,
+					  cvt->dst.fb->drm_format),
 		     "Conversion not implemented (from format 0x%x to 0x%x)\n",
 		     cvt->src.fb->drm_format, cvt->dst.fb->drm_format);
+
+	/* Read the source once here, not once per band */
+	whole.src.ptr = convert_src_get(cvt);
+	whole.src.slow_reads = false;
+
+	num_bands = igt_bands_count(rect->height, FB_CONVERT_MIN_BAND_ROWS,
+				    FB_CONVERT_MAX_THREADS);
+
+	/* Bands start on even rows, for the NV12 chroma rows */
+	band_rows = max(ALIGN(DIV_ROUND_UP(rect->height, num_bands), 2), 2);
+	num_bands = DIV_ROUND_UP(rect->height, band_rows);
+
+	bands = calloc(num_bands, sizeof(*bands));
+	igt_assert(bands);
+
+	for (i = 0; i < num_bands; i++) {
+		struct box box;
+
+		box_init(&box, rect->x, rect->y + i * band_rows, rect->width,
+			 min(band_rows, rect->height - i * band_rows));
+
+		band_init(&bands[i].cvt.dst, &bands[i].dst_fb, &whole.dst, &box);
+		band_init(&bands[i].cvt.src, &bands[i].src_fb, &whole.src, &box);
+	}
+
+	igt_bands_run(fb_convert_band_work, num_bands, bands);
+
+	free(bands);
+	convert_src_put(cvt, whole.src.ptr);
+}
+
+static void fb_convert(struct fb_convert *cvt)
+{
+	struct box rect;
+
+	box_init(&rect, 0, 0, cvt->dst.fb->width, cvt->dst.fb->height);
+	fb_convert_rect(cvt, &rect);
+}
+
+/*
+ * Cairo doesn't tell what it has drawn, so the damage is found by
+ * comparing the shadow buffer with a copy taken when it was created.
+ * Each run of damaged row pairs becomes one box covering the damaged
+ * columns of the run. Columns are aligned to 4 pixels, which keeps
+ * chroma samples whole and the rows of every format 4 byte aligned
+ * for pixman.
+ */
+static int shadow_damage(const struct igt_fb *shadow, const uint8_t *ptr,
+			 const uint8_t *copy, struct box **boxes)
+{
+	struct box *box = NULL;
+	int num_boxes = 0;
+	int x0, x1, y, row;
+
+	*boxes = NULL;
+
+	for (y = 0; y < shadow->height; y += 2) {
+		x0 = shadow->width;
+		x1 = 0;
+
+		for (row = y; row < min(y + 2, shadow->height); row++) {
+			const uint32_t *a = (const uint32_t *)(ptr + row * shadow->strides[0]);
+			const uint32_t *b = (const uint32_t *)(copy + row * shadow->strides[0]);
+			int left, right;
+
+			if (!memcmp(a, b, shadow->width * 4))
+				continue;
+
+			for (left = 0; a[left] == b[left]; left++)
+				;
+			for (right = shadow->width; a[right - 1] == b[right - 1]; right--)
+				;
+
+			x0 = min(x0, left);
+			x1 = max(x1, right);
+		}
+
+		if (x0 >= x1) {
+			box = NULL;
+			continue;
+		}
+
+		x0 &= ~3;
+		x1 = min(ALIGN(x1, 4), shadow->width);
+
+		if (box) {
+			x0 = min(x0, box->x);
+			x1 = max(x1, box->x + box->width);
+			box_init(box, x0, box->y, x1 - x0,
+				 min(y + 2, shadow->height) - box->y);
+			continue;
+		}
+
+		*boxes = realloc(*boxes, (num_boxes + 1) * sizeof(**boxes));
+		igt_assert(*boxes);
+		box = &(*boxes)[num_boxes++];
+		box_init(box, x0, y, x1 - x0, min(y + 2, shadow->height) - y);
+	}
+
+	return num_boxes;
 }
 
 static void destroy_cairo_surface__convert(void *arg)
@@ -1979,7 +2767,21 @@ static void destroy_cairo_surface__convert(void *arg)
 		},
 	};
 
-	fb_convert(&cvt);
+	if (blit->shadow_copy) {
+		struct box *boxes;
+		int i, num_boxes;
+
+		/* Only convert back what was drawn */
+		num_boxes = shadow_damage(&blit->shadow_fb, blit->shadow_ptr,
+					  blit->shadow_copy, &boxes);
+		for (i = 0; i < num_boxes; i++)
+			fb_convert_rect(&cvt, &boxes[i]);
+
+		free(boxes);
+		free(blit->shadow_copy);
+	} else {
+		fb_convert(&cvt);
+	}
 	igt_fb_destroy_cairo_shadow_buffer(&blit->shadow_fb, blit->shadow_ptr);
 
 	if (blit->base.linear.fb.gem_handle)
@@ -2026,6 +2828,11 @@ static void create_cairo_surface__convert(int fd, struct igt_fb *fb)
 	cvt.src.fb = &blit->base.linear.fb;
 	fb_convert(&cvt);
 
+	/* Kept to find what cairo draws, see shadow_damage() */
+	blit->shadow_copy = malloc(blit->shadow_fb.size);
+	if (blit->shadow_copy)
+		memcpy(blit->shadow_copy, blit->shadow_ptr, blit->shadow_fb.size);
+
 	fb->cairo_surface =
 		cairo_image_surface_create_for_data(blit->shadow_ptr,
 						    CAIRO_FORMAT_RGB24,
@@ -2188,7 +2995,6 @@ void igt_remove_fb(int fd, struct igt_fb *fb)
 unsigned int igt_fb_convert(struct igt_fb *dst, struct igt_fb *src,
 			    uint32_t dst_fourcc)
 {
-	struct fb_convert cvt = { };
 	void *dst_ptr, *src_ptr;
 	int fb_id;
 
@@ -2202,11 +3008,7 @@ unsigned int igt_fb_convert(struct igt_fb *dst, struct igt_fb *src,
 	dst_ptr = igt_fb_map_buffer(dst->fd, dst);
 	igt_assert(dst_ptr);
 
-	cvt.dst.ptr = dst_ptr;
-	cvt.dst.fb = dst;
-	cvt.src.ptr = src_ptr;
-	cvt.src.fb = src;
-	fb_convert(&cvt);
+	igt_fb_convert_buffer(dst, dst_ptr, src, src_ptr);
 
 	igt_fb_unmap_buffer(dst, dst_ptr);
 	igt_fb_unmap_buffer(src, src_ptr);
@@ -2214,6 +3016,36 @@ unsigned int igt_fb_convert(struct igt_fb *dst, struct igt_fb *src,
 	return fb_id;
 }
 
+/**
+ * igt_fb_convert_buffer:
+ * @dst: pointer to the #igt_fb structure describing @dst_ptr
+ * @dst_ptr: pointer to the buffer that will store the conversion result
+ * @src: pointer to the #igt_fb structure describing @src_ptr
+ * @src_ptr: pointer to the buffer with the frame we convert
+ *
+ * This will convert the linear frame in @src_ptr to the format of @dst,
+ * storing the result in @dst_ptr. Unlike igt_fb_convert() nothing is
+ * allocated, the buffers only need to be laid out like @src and @dst
+ * describe.
+ */
+void igt_fb_convert_buffer(struct igt_fb *dst, void *dst_ptr,
+			   struct igt_fb *src, void *src_ptr)
+{
+	struct fb_convert cvt = {
+		.dst	= {
+			.ptr	= dst_ptr,
+			.fb	= dst,
+		},
+
+		.src	= {
+			.ptr	= src_ptr,
+			.fb	= src,
+		},
+	};
+
+	fb_convert(&cvt);
+}
+
 /**
  * igt_bpp_depth_to_drm_format:
  * @bpp: desired bits per pixel
@@ -27,13 +27,19 @@
 #include "config.h"
 
 #include <fcntl.h>
-#include <pixman.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <cairo.h>
 #include <gsl/gsl_statistics_double.h>
 #include <gsl/gsl_fit.h>
 
 #include "igt_frame.h"
 #include "igt_core.h"
+#include "igt_aux.h"
+#include "igt_x86.h"
 
 /**
  * SECTION:igt_frame
@@ -139,6 +145,219 @@ void igt_write_compared_frames_to_png(cairo_surface_t *reference,
 	close(fd);
 }
 
+/*
+ * The absolute error of each channel of the capture is collected per value
+ * of that channel in the reference, walking both frames row by row. The
+ * rows are split into bands that are collected on separate threads and
+ * added up at the end.
+ *
+ * Within a band the error sum and the pixel count of a value share one
+ * 64 bit word, the count in the upper half, so that each channel of a
+ * pixel costs a single add. Even and odd pixels go to separate words, as
+ * flat areas of the frame would otherwise make every add depend on the
+ * previous one. The words are flushed to the totals before the error sums
+ * can carry into the counts.
+ */
+#define ANALOG_MAX_THREADS 16
+#define ANALOG_MIN_BAND_PIXELS (256 * 1024)
+#define ANALOG_FLUSH_PIXELS (1 << 23) /* 255 * 2^23 < 2^32 */
+#define ANALOG_ONE (1ull << 32)
+
+typedef uint64_t analog_acc_t[2][3][256];
+
+struct analog_error {
+	uint64_t sum[3][256];
+	uint64_t count[3][256];
+};
+
+static inline void analog_error_add(analog_acc_t acc, int x,
+				    const uint8_t *q, const uint8_t *d)
+{
+	int i;
+
+	for (i = 0; i < 3; i++)
+		acc[x & 1][i][q[i]] += ANALOG_ONE | d[i];
+}
+
+static void analog_error_row(const uint8_t *p, const uint8_t *q, int w,
+			     analog_acc_t acc)
+{
+	uint8_t d[3];
+	int x, i;
+
+	for (x = 0; x < w; x++, p += 4, q += 4) {
+		for (i = 0; i < 3; i++)
+			d[i] = p[i] > q[i] ? p[i] - q[i] : q[i] - p[i];
+
+		analog_error_add(acc, x, q, d);
+	}
+}
+
+#if defined(__x86_64__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+
+#include <smmintrin.h>
+
+static void analog_error_row_sse41(const uint8_t *p, const uint8_t *q, int w,
+				   analog_acc_t acc)
+{
+	uint8_t d[16] __attribute__((aligned(16)));
+	int x, k;
+
+	/* |p - q| for 4 pixels at a time */
+	for (x = 0; x + 4 <= w; x += 4, p += 16, q += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)p);
+		__m128i b = _mm_loadu_si128((const __m128i *)q);
+
+		_mm_store_si128((__m128i *)d,
+				_mm_sub_epi8(_mm_max_epu8(a, b),
+					     _mm_min_epu8(a, b)));
+
+		for (k = 0; k < 4; k++)
+			analog_error_add(acc, x + k, q + 4 * k, d + 4 * k);
+	}
+
+	analog_error_row(p, q, w - x, acc);
+}
+
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+#include <immintrin.h>
+
+static void analog_error_row_avx2(const uint8_t *p, const uint8_t *q, int w,
+				  analog_acc_t acc)
+{
+	uint8_t d[32] __attribute__((aligned(32)));
+	int x, k;
+
+	/* |p - q| for 8 pixels at a time */
+	for (x = 0; x + 8 <= w; x += 8, p += 32, q += 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)p);
+		__m256i b = _mm256_loadu_si256((const __m256i *)q);
+
+		_mm256_store_si256((__m256i *)d,
+				   _mm256_sub_epi8(_mm256_max_epu8(a, b),
+						   _mm256_min_epu8(a, b)));
+
+		for (k = 0; k < 8; k++)
+			analog_error_add(acc, x + k, q + 4 * k, d + 4 * k);
+	}
+
+	analog_error_row(p, q, w - x, acc);
+}
+
+#pragma GCC pop_options
+
+static void (*analog_error_row_func(void))(const uint8_t *, const uint8_t *,
+					    int, analog_acc_t)
+{
+	unsigned features = igt_x86_features();
+
+	if (features & AVX2)
+		return analog_error_row_avx2;
+	if (features & SSE4_1)
+		return analog_error_row_sse41;
+
+	return analog_error_row;
+}
+#else
+static void (*analog_error_row_func(void))(const uint8_t *, const uint8_t *,
+					    int, analog_acc_t)
+{
+	return analog_error_row;
+}
+#endif
+
+struct analog_error_bands {
+	void (*row)(const uint8_t *p, const uint8_t *q, int w,
+		    analog_acc_t acc);
+	const uint8_t *capture, *reference;
+	int capture_stride, reference_stride;
+	int width, height, band_rows;
+	struct analog_error *errors;
+};
+
+static void analog_error_flush(analog_acc_t acc, struct analog_error *error)
+{
+	int i, v;
+
+	for (i = 0; i < 3; i++) {
+		for (v = 0; v < 256; v++) {
+			uint64_t a = acc[0][i][v] + acc[1][i][v];
+
+			error->sum[i][v] += (uint32_t)a;
+			error->count[i][v] += a >> 32;
+		}
+	}
+
+	memset(acc, 0, sizeof(analog_acc_t));
+}
+
+static void analog_error_band(int band, void *data)
+{
+	struct analog_error_bands *bands = data;
+	int first_row = min(band * bands->band_rows, bands->height);
+	int last_row = min(first_row + bands->band_rows, bands->height);
+	analog_acc_t acc = {};
+	size_t pending = 0;
+	int y;
+
+	for (y = first_row; y < last_row; y++) {
+		if (pending + bands->width > ANALOG_FLUSH_PIXELS) {
+			analog_error_flush(acc, &bands->errors[band]);
+			pending = 0;
+		}
+
+		bands->row(bands->capture + (size_t)y * bands->capture_stride,
+			   bands->reference + (size_t)y * bands->reference_stride,
+			   bands->width, acc);
+		pending += bands->width;
+	}
+
+	analog_error_flush(acc, &bands->errors[band]);
+}
+
+static void analog_error_collect(cairo_surface_t *reference,
+				 cairo_surface_t *capture,
+				 struct analog_error *error)
+{
+	struct analog_error_bands bands = {
+		.row = analog_error_row_func(),
+		.capture = cairo_image_surface_get_data(capture),
+		.reference = cairo_image_surface_get_data(reference),
+		.capture_stride = cairo_image_surface_get_stride(capture),
+		.reference_stride = cairo_image_surface_get_stride(reference),
+		.width = cairo_image_surface_get_width(reference),
+		.height = cairo_image_surface_get_height(reference),
+	};
+	int num_bands, n, i, v;
+
+	num_bands = igt_bands_count((size_t)bands.width * bands.height,
+				    ANALOG_MIN_BAND_PIXELS, ANALOG_MAX_THREADS);
+	bands.band_rows = DIV_ROUND_UP(bands.height, num_bands);
+
+	bands.errors = calloc(num_bands, sizeof(*bands.errors));
+	igt_assert(bands.errors);
+
+	igt_bands_run(analog_error_band, num_bands, &bands);
+
+	memset(error, 0, sizeof(*error));
+	for (n = 0; n < num_bands; n++) {
+		for (i = 0; i < 3; i++) {
+			for (v = 0; v < 256; v++) {
+				error->sum[i][v] += bands.errors[n].sum[i][v];
+				error->count[i][v] += bands.errors[n].count[i][v];
+			}
+		}
+	}
+
+	free(bands.errors);
+}
+
 /**
  * igt_check_analog_frame_match:
  * @reference: The reference cairo surface
@@ -169,60 +388,27 @@ void igt_write_compared_frames_to_png(cairo_surface_t *reference,
 bool igt_check_analog_frame_match(cairo_surface_t *reference,
 				  cairo_surface_t *capture)
 {
-	pixman_image_t *reference_src, *capture_src;
-	int w, h;
-	int error_count[3][256][2] = { 0 };
+	struct analog_error *error;
 	double error_average[4][250];
 	double error_trend[250];
 	double c0, c1, cov00, cov01, cov11, sumsq;
 	double correlation;
-	unsigned char *reference_pixels, *capture_pixels;
-	unsigned char *p;
-	unsigned char *q;
 	bool match = true;
-	int diff;
-	int x, y;
 	int i, j;
 
-	w = cairo_image_surface_get_width(reference);
-	h = cairo_image_surface_get_height(reference);
-
-	reference_src = pixman_image_create_bits(
-	    PIXMAN_x8r8g8b8, w, h,
-	    (void*)cairo_image_surface_get_data(reference),
-	    cairo_image_surface_get_stride(reference));
-	reference_pixels = (unsigned char *) pixman_image_get_data(reference_src);
-
-	capture_src = pixman_image_create_bits(
-	    PIXMAN_x8r8g8b8, w, h,
-	    (void*)cairo_image_surface_get_data(capture),
-	    cairo_image_surface_get_stride(capture));
-	capture_pixels = (unsigned char *) pixman_image_get_data(capture_src);
+	error = malloc(sizeof(*error));
+	igt_assert(error);
 
 	/* Collect the absolute error for each color value */
-	for (x = 0; x < w; x++) {
-		for (y = 0; y < h; y++) {
-			p = &capture_pixels[(x + y * w) * 4];
-			q = &reference_pixels[(x + y * w) * 4];
-
-			for (i = 0; i < 3; i++) {
-				diff = (int) p[i] - q[i];
-				if (diff < 0)
-					diff = -diff;
-
-				error_count[i][q[i]][0] += diff;
-				error_count[i][q[i]][1]++;
-			}
-		}
-	}
+	analog_error_collect(reference, capture, error);
 
 	/* Calculate the average absolute error for each color value */
 	for (i = 0; i < 250; i++) {
 		error_average[0][i] = i;
 
 		for (j = 1; j < 4; j++) {
-			error_average[j][i] = (double) error_count[j-1][i][0] /
-					      error_count[j-1][i][1];
+			error_average[j][i] = (double) error->sum[j-1][i] /
+					      error->count[j-1][i];
 
 			if (error_average[j][i] > 60) {
 				igt_warn("Error average too high (%f)\n",
@@ -262,8 +448,7 @@ bool igt_check_analog_frame_match(cairo_surface_t *reference,
 	}
 
 complete:
-	pixman_image_unref(reference_src);
-	pixman_image_unref(capture_src);
+	free(error);
 
 	return match;
 }
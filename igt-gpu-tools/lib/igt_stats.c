@@ -31,7 +31,9 @@
 
 #define U64_MAX         ((uint64_t)~0ULL)
 
-#define sorted_value(stats, i) (stats->is_float ? stats->sorted_f[i] : stats->sorted_u64[i])
+#define sorted_value(stats, i) (stats->is_histogram ? \
+				igt_stats_histogram_value(stats, i) : \
+				stats->is_float ? stats->sorted_f[i] : stats->sorted_u64[i])
 #define unsorted_value(stats, i) (stats->is_float ? stats->values_f[i] : stats->values_u64[i])
 
 /**
@@ -64,6 +66,11 @@
  *
  *	igt_stats_fini(&stats);
  * ]|
+ *
+ * When too many samples are expected to keep them all around, for instance
+ * over a long running latency measurement, igt_stats_init_histogram() makes
+ * @stats count the samples in a histogram of bounded size instead, at the
+ * cost of a small and bounded error on the quantiles.
  */
 
 static unsigned int get_new_capacity(int need)
@@ -83,6 +90,9 @@ static void igt_stats_ensure_capacity(igt_stats_t *stats,
 	unsigned int new_n_values = stats->n_values + n_additional_values;
 	unsigned int new_capacity;
 
+	if (stats->is_histogram)
+		return;
+
 	if (new_n_values <= stats->capacity)
 		return;
 
@@ -137,6 +147,124 @@ void igt_stats_init_with_size(igt_stats_t *stats, unsigned int capacity)
 	stats->range[1] = -HUGE_VAL;
 }
 
+static unsigned int igt_stats_histogram_size(unsigned int bits)
+{
+	return (65 - bits) << bits;
+}
+
+/*
+ * Values below 2^(bits + 1) get their own bucket, above that a bucket holds
+ * all the values with the same bits + 1 leading bits.
+ */
+static unsigned int igt_stats_histogram_bucket(unsigned int bits,
+					       uint64_t value)
+{
+	unsigned int shift = 0;
+
+	if (value >> (bits + 1))
+		shift = 63 - __builtin_clzll(value) - bits;
+
+	return (shift << bits) + (value >> shift);
+}
+
+static double igt_stats_histogram_bucket_value(igt_stats_t *stats,
+					       unsigned int idx)
+{
+	unsigned int bits = stats->histogram_bits;
+	unsigned int shift;
+	double value;
+
+	if (idx < 2u << bits)
+		return idx;
+
+	/* the middle of the bucket, which bounds the relative error */
+	shift = (idx >> bits) - 1;
+	value = (uint64_t)(idx - (shift << bits)) << shift;
+	value += ((1ull << shift) - 1) / 2.;
+
+	if (value < stats->min)
+		return stats->min;
+	if (value > stats->max)
+		return stats->max;
+
+	return value;
+}
+
+/* Sum of the values of ranks first to last, inclusive, in sorted order */
+static double igt_stats_histogram_sum(igt_stats_t *stats,
+				      unsigned int first, unsigned int last)
+{
+	uint64_t seen = 0;
+	double sum = 0.;
+	unsigned int idx;
+
+	for (idx = 0; seen <= last; idx++) {
+		uint64_t count = stats->histogram[idx];
+		uint64_t lo, hi;
+
+		if (!count)
+			continue;
+
+		lo = seen > first ? seen : first;
+		hi = seen + count - 1 < last ? seen + count - 1 : last;
+		if (lo <= hi)
+			sum += (hi - lo + 1) *
+				igt_stats_histogram_bucket_value(stats, idx);
+
+		seen += count;
+	}
+
+	return sum;
+}
+
+static double igt_stats_histogram_value(igt_stats_t *stats, unsigned int i)
+{
+	return igt_stats_histogram_sum(stats, i, i);
+}
+
+/**
+ * igt_stats_init_histogram:
+ * @stats: An #igt_stats_t instance
+ * @precision: Number of leading bits kept of each value, from 1 to 16
+ *
+ * Like igt_stats_init() but instead of storing every data sample, @stats only
+ * counts them in a log-linear histogram. Pushing a value is then O(1) and the
+ * memory used does not grow with the number of samples, which suits long
+ * running measurements. Per-thread instances can be combined with
+ * igt_stats_merge().
+ *
+ * Values below 2^(@precision + 1) are counted exactly. Larger values share
+ * a bucket with all the values having the same @precision + 1 leading bits
+ * and are taken to be the middle of that bucket, so that the median,
+ * quartiles, interquartile mean and the estimators derived from them are
+ * within a relative error of 2^-(@precision + 1) of their exact values, e.g.
+ * 0.4% for a precision of 7. The minimum, maximum, mean and variance are
+ * computed exactly.
+ *
+ * The histogram takes (65 - @precision) * 2^@precision counters of 8 bytes,
+ * 58KiB for a precision of 7. Only integer values can be pushed, and
+ * #igt_stats_t.values_u64 is not available.
+ *
+ * igt_stats_fini() must be called once finished with @stats.
+ */
+void igt_stats_init_histogram(igt_stats_t *stats, unsigned int precision)
+{
+	igt_assert(precision >= 1 && precision <= 16);
+
+	memset(stats, 0, sizeof(*stats));
+
+	stats->is_histogram = true;
+	stats->histogram_bits = precision;
+	stats->histogram = calloc(igt_stats_histogram_size(precision),
+				  sizeof(*stats->histogram));
+	igt_assert(stats->histogram);
+
+	stats->min = U64_MAX;
+	stats->max = 0;
+	stats->range[0] = HUGE_VAL;
+	stats->range[1] = -HUGE_VAL;
+}
+
 /**
  * igt_stats_fini:
  * @stats: An #igt_stats_t instance
@@ -147,6 +275,7 @@ void igt_stats_fini(igt_stats_t *stats)
 {
 	free(stats->values_u64);
 	free(stats->sorted_u64);
+	free(stats->histogram);
 }
 
 
@@ -212,9 +341,21 @@ void igt_stats_push(igt_stats_t *stats, uint64_t value)
 		return;
 	}
 
-	igt_stats_ensure_capacity(stats, 1);
+	if (stats->is_histogram) {
+		double delta = value - stats->mean;
+
+		stats->histogram[igt_stats_histogram_bucket(stats->histogram_bits,
+							    value)]++;
+		stats->n_values++;
+
+		/* Welford's running mean and sum of squared differences */
+		stats->mean += delta / stats->n_values;
+		stats->m2 += delta * (value - stats->mean);
+	} else {
+		igt_stats_ensure_capacity(stats, 1);
 
-	stats->values_u64[stats->n_values++] = value;
+		stats->values_u64[stats->n_values++] = value;
+	}
 
 	stats->mean_variance_valid = false;
 	stats->sorted_array_valid = false;
@@ -231,10 +372,13 @@ void igt_stats_push(igt_stats_t *stats, uint64_t value)
  * @value: An floating point
  *
  * Adds a new value to the @stats dataset and converts the igt_stats from
- * an integer collection to a floating point one.
+ * an integer collection to a floating point one. This is not supported by
+ * the histogram of igt_stats_init_histogram().
  */
 void igt_stats_push_float(igt_stats_t *stats, double value)
 {
+	igt_assert(!stats->is_histogram);
+
 	igt_stats_ensure_capacity(stats, 1);
 
 	if (!stats->is_float) {
@@ -276,6 +420,57 @@ void igt_stats_push_array(igt_stats_t *stats,
 		igt_stats_push(stats, values[i]);
 }
 
+/**
+ * igt_stats_merge:
+ * @stats: An #igt_stats_t instance
+ * @other: An #igt_stats_t instance to add to @stats
+ *
+ * Adds all the data points of @other to the @stats dataset, e.g. to combine
+ * the results of several threads. @other is left untouched.
+ *
+ * The histogram of igt_stats_init_histogram() can only be merged into one of
+ * the same precision, which is O(1) in the number of data points.
+ */
+void igt_stats_merge(igt_stats_t *stats, const igt_stats_t *other)
+{
+	unsigned int i, n_values;
+	double delta;
+
+	if (!other->is_histogram) {
+		for (i = 0; i < other->n_values; i++) {
+			if (other->is_float)
+				igt_stats_push_float(stats, other->values_f[i]);
+			else
+				igt_stats_push(stats, other->values_u64[i]);
+		}
+		return;
+	}
+
+	igt_assert(stats->is_histogram);
+	igt_assert_eq(stats->histogram_bits, other->histogram_bits);
+
+	if (!other->n_values)
+		return;
+
+	/* Chan et al. pairwise combination of the mean and variance */
+	n_values = stats->n_values + other->n_values;
+	delta = other->mean - stats->mean;
+	stats->mean += delta * other->n_values / n_values;
+	stats->m2 += other->m2 +
+		delta * delta * stats->n_values * other->n_values / n_values;
+
+	for (i = 0; i < igt_stats_histogram_size(stats->histogram_bits); i++)
+		stats->histogram[i] += other->histogram[i];
+	stats->n_values = n_values;
+
+	stats->mean_variance_valid = false;
+
+	if (other->min < stats->min)
+		stats->min = other->min;
+	if (other->max > stats->max)
+		stats->max = other->max;
+}
+
 /**
  * igt_stats_get_min:
  * @stats: An #igt_stats_t instance
@@ -338,9 +533,58 @@ static int cmp_f(const void *pa, const void *pb)
 	return 0;
 }
 
+/*
+ * LSD radix sort a byte at a time, skipping the bytes all values share. On
+ * large datasets this is several times faster than qsort().
+ */
+static void radix_sort_u64(uint64_t *values, unsigned int n_values)
+{
+	uint64_t *src = values, *dst, *tmp;
+	unsigned int count[8][256] = {};
+	unsigned int i, b;
+
+	tmp = n_values > 256 ? malloc(sizeof(*tmp) * n_values) : NULL;
+	if (!tmp) {
+		qsort(values, n_values, sizeof(*values), cmp_u64);
+		return;
+	}
+
+	for (i = 0; i < n_values; i++)
+		for (b = 0; b < 8; b++)
+			count[b][(values[i] >> (8 * b)) & 0xff]++;
+
+	dst = tmp;
+	for (b = 0; b < 8; b++) {
+		unsigned int *offset = count[b];
+		unsigned int sum = 0;
+		uint64_t *swap;
+
+		if (offset[(src[0] >> (8 * b)) & 0xff] == n_values)
+			continue;
+
+		for (i = 0; i < 256; i++) {
+			unsigned int c = offset[i];
+
+			offset[i] = sum;
+			sum += c;
+		}
+
+		for (i = 0; i < n_values; i++)
+			dst[offset[(src[i] >> (8 * b)) & 0xff]++] = src[i];
+
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	if (src != values)
+		memcpy(values, src, sizeof(*values) * n_values);
+	free(tmp);
+}
+
 static void igt_stats_ensure_sorted_values(igt_stats_t *stats)
 {
-	if (stats->sorted_array_valid)
+	if (stats->sorted_array_valid || stats->is_histogram)
 		return;
 
 	if (!stats->sorted_u64) {
@@ -358,8 +602,11 @@ static void igt_stats_ensure_sorted_values(igt_stats_t *stats)
 	memcpy(stats->sorted_u64, stats->values_u64,
 	       sizeof(*stats->values_u64) * stats->n_values);
 
-	qsort(stats->sorted_u64, stats->n_values, sizeof(*stats->values_u64),
-	      stats->is_float ? cmp_f : cmp_u64);
+	if (stats->is_float)
+		qsort(stats->sorted_f, stats->n_values,
+		      sizeof(*stats->values_f), cmp_f);
+	else
+		radix_sort_u64(stats->sorted_u64, stats->n_values);
 
 	stats->sorted_array_valid = true;
 }
@@ -495,11 +742,17 @@ static void igt_stats_knuth_mean_variance(igt_stats_t *stats)
 	if (stats->mean_variance_valid)
 		return;
 
-	for (i = 0; i < stats->n_values; i++) {
-		double delta = unsorted_value(stats, i) - mean;
+	if (stats->is_histogram) {
+		/* already kept up to date by igt_stats_push() */
+		mean = stats->mean;
+		m2 = stats->m2;
+	} else {
+		for (i = 0; i < stats->n_values; i++) {
+			double delta = unsorted_value(stats, i) - mean;
 
-		mean += delta / (i + 1);
-		m2 += delta * (unsorted_value(stats, i) - mean);
+			mean += delta / (i + 1);
+			m2 += delta * (unsorted_value(stats, i) - mean);
+		}
 	}
 
 	stats->mean = mean;
@@ -573,9 +826,14 @@ double igt_stats_get_iqm(igt_stats_t *stats)
 	q1 = (stats->n_values + 3) / 4;
 	q3 = 3 * stats->n_values / 4;
 
-	mean = 0;
-	for (i = 0; i <= q3 - q1; i++)
-		mean += (sorted_value(stats, q1 + i) - mean) / (i + 1);
+	if (stats->is_histogram) {
+		i = q3 - q1 + 1;
+		mean = igt_stats_histogram_sum(stats, q1, q3) / i;
+	} else {
+		mean = 0;
+		for (i = 0; i <= q3 - q1; i++)
+			mean += (sorted_value(stats, q1 + i) - mean) / (i + 1);
+	}
 
 	if (stats->n_values % 4) {
 		double rem = .5 * (stats->n_values % 4) / 4;
@@ -49,10 +49,14 @@ typedef struct {
 	unsigned int is_population  : 1;
 	unsigned int mean_variance_valid : 1;
 	unsigned int sorted_array_valid : 1;
+	unsigned int is_histogram : 1;
+	unsigned int histogram_bits;
 
 	uint64_t min, max;
 	double range[2];
-	double mean, variance;
+	double mean, variance, m2;
+
+	uint64_t *histogram;
 
 	union {
 		uint64_t *sorted_u64;
@@ -62,6 +66,7 @@ typedef struct {
 
 void igt_stats_init(igt_stats_t *stats);
 void igt_stats_init_with_size(igt_stats_t *stats, unsigned int capacity);
+void igt_stats_init_histogram(igt_stats_t *stats, unsigned int precision);
 void igt_stats_fini(igt_stats_t *stats);
 bool igt_stats_is_population(igt_stats_t *stats);
 void igt_stats_set_population(igt_stats_t *stats, bool full_population);
@@ -69,6 +74,7 @@ void igt_stats_push(igt_stats_t *stats, uint64_t value);
 void igt_stats_push_float(igt_stats_t *stats, double value);
 void igt_stats_push_array(igt_stats_t *stats,
 			  const uint64_t *values, unsigned int n_values);
+void igt_stats_merge(igt_stats_t *stats, const igt_stats_t *other);
 uint64_t igt_stats_get_min(igt_stats_t *stats);
 uint64_t igt_stats_get_max(igt_stats_t *stats);
 uint64_t igt_stats_get_range(igt_stats_t *stats);
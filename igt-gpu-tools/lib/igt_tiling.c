@@ -0,0 +1,434 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "drmtest.h"
+#include "igt_aux.h"
+#include "igt_core.h"
+#include "igt_tiling.h"
+#include "i915_drm.h"
+#include "intel_batchbuffer.h"
+
+/**
+ * SECTION:igt_tiling
+ * @short_description: CPU tiling and detiling of surfaces
+ * @title: Tiling
+ * @include: igt.h
+ *
+ * This library converts rectangles of pixels between a linear buffer and a
+ * surface in one of the tiled layouts of the GPU, X, Y and Yf tiling, on the
+ * CPU. The bit 6 swizzling the memory controller applies to X and Y tiled
+ * surfaces on some platforms is taken into account.
+ *
+ * All tiles are 4KiB. Within a tile every address bit comes from either the
+ * horizontal byte offset or the line of the pixel, as listed in a table for
+ * each layout. From it, igt_tiling_init() computes where every span of
+ * contiguous bytes of a tile line lands in the tile, so that a line of pixels
+ * is then copied a span at a time instead of computing the address of every
+ * pixel.
+ *
+ * |[
+ *	struct igt_tiling t;
+ *
+ *	igt_tiling_init(&t, I915_TILING_Y, swizzle, 32, stride);
+ *	igt_tiling_from_tiled(&t, linear, width * 4, tiled,
+ *			      0, 0, width, height);
+ * ]|
+ */
+
+#define TILE_SHIFT 12
+
+/*
+ * Address bits of a tile from the lowest up, taken in order from the bits of
+ * the horizontal byte offset within the tile (x) or of the line (y).
+ *
+ * Yf is the 4KiB standard swizzle: 64 byte blocks of 16 bytes by 4 lines,
+ * then alternating x and y bits, with the tile kept at 16 to 128 pixels wide
+ * depending on the pixel size.
+ */
+static const struct {
+	uint32_t tiling;
+	int bpp; /* 0 for any */
+	const char *bits;
+} layouts[] = {
+	{ I915_TILING_X, 0, "xxxxxxxxxyyy" },
+	{ I915_TILING_Y, 0, "xxxxyyyyyxxx" },
+	{ I915_TILING_Yf, 8, "xxxxyyxyxyyy" },
+	{ I915_TILING_Yf, 16, "xxxxyyxyxyxy" },
+	{ I915_TILING_Yf, 32, "xxxxyyxyxyxy" },
+	{ I915_TILING_Yf, 64, "xxxxyyxyxyxx" },
+	{ I915_TILING_Yf, 128, "xxxxyyxyxyxx" },
+};
+
+static unsigned long swizzle_bit(unsigned int bit, unsigned long offset)
+{
+	return (offset & (1ul << bit)) >> (bit - 6);
+}
+
+static unsigned long swizzle_addr(unsigned long addr, uint32_t swizzle)
+{
+	switch (swizzle) {
+	case I915_BIT_6_SWIZZLE_NONE:
+		return addr;
+	case I915_BIT_6_SWIZZLE_9:
+		return addr ^ swizzle_bit(9, addr);
+	case I915_BIT_6_SWIZZLE_9_10:
+		return addr ^ swizzle_bit(9, addr) ^ swizzle_bit(10, addr);
+	case I915_BIT_6_SWIZZLE_9_11:
+		return addr ^ swizzle_bit(9, addr) ^ swizzle_bit(11, addr);
+	case I915_BIT_6_SWIZZLE_9_10_11:
+		return (addr ^
+			swizzle_bit(9, addr) ^
+			swizzle_bit(10, addr) ^
+			swizzle_bit(11, addr));
+
+	case I915_BIT_6_SWIZZLE_UNKNOWN:
+	case I915_BIT_6_SWIZZLE_9_17:
+	case I915_BIT_6_SWIZZLE_9_10_17:
+	default:
+		/* If we hit this case, we need to implement support for the
+		 * appropriate swizzling method. */
+		igt_require(false);
+		return addr;
+	}
+}
+
+/* Scatters the bits of x and y into a tile address following @bits */
+static unsigned long tile_addr(const char *bits, unsigned int x,
+			       unsigned int y)
+{
+	unsigned long addr = 0;
+	unsigned int i;
+
+	for (i = 0; bits[i]; i++) {
+		if (bits[i] == 'x') {
+			addr |= (unsigned long)(x & 1) << i;
+			x >>= 1;
+		} else {
+			addr |= (unsigned long)(y & 1) << i;
+			y >>= 1;
+		}
+	}
+
+	return addr;
+}
+
+/**
+ * igt_tiling_init:
+ * @t: the #igt_tiling to initialize
+ * @tiling: I915_TILING_NONE, I915_TILING_X, I915_TILING_Y or I915_TILING_Yf
+ * @swizzle: I915_BIT_6_SWIZZLE_* mode of the surface, as returned by
+ *	     gem_get_tiling()
+ * @bpp: bits per pixel
+ * @stride: stride of the surface in bytes, a multiple of the tile width
+ *
+ * Computes the layout of a surface for the other igt_tiling functions. Swizzle
+ * modes depending on bit 17 of the physical address can not be handled on the
+ * CPU, and make the test skip.
+ */
+void igt_tiling_init(struct igt_tiling *t, uint32_t tiling, uint32_t swizzle,
+		     int bpp, uint32_t stride)
+{
+	const char *bits = NULL;
+	unsigned int row, span, i;
+
+	igt_assert(bpp >= 8 && bpp % 8 == 0);
+
+	memset(t, 0, sizeof(*t));
+	t->tiling = tiling;
+	t->stride = stride;
+	t->cpp = bpp / 8;
+
+	if (tiling == I915_TILING_NONE) {
+		t->tile_width = stride;
+		t->tile_height = 1;
+		return;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(layouts); i++) {
+		if (layouts[i].tiling == tiling &&
+		    (!layouts[i].bpp || layouts[i].bpp == bpp)) {
+			bits = layouts[i].bits;
+			break;
+		}
+	}
+	igt_assert_f(bits, "tiling %u at %d bpp\n", tiling, bpp);
+	igt_assert(swizzle == I915_BIT_6_SWIZZLE_NONE ||
+		   tiling != I915_TILING_Yf);
+
+	for (i = 0; bits[i]; i++) {
+		if (bits[i] == 'x')
+			t->tile_width_shift++;
+		else
+			t->tile_height_shift++;
+	}
+	igt_assert_eq(t->tile_width_shift + t->tile_height_shift, TILE_SHIFT);
+
+	t->tile_width = 1 << t->tile_width_shift;
+	t->tile_height = 1 << t->tile_height_shift;
+	igt_assert(stride % t->tile_width == 0);
+
+	/* The lowest bits of the line offset are contiguous in memory */
+	while (bits[t->span_shift] == 'x')
+		t->span_shift++;
+
+	/* and swizzling flips bit 6, splitting larger spans */
+	if (swizzle != I915_BIT_6_SWIZZLE_NONE && t->span_shift > 6)
+		t->span_shift = 6;
+
+	t->spans_shift = t->tile_width_shift - t->span_shift;
+	igt_assert(t->tile_height << t->spans_shift <= ARRAY_SIZE(t->span));
+
+	for (row = 0; row < t->tile_height; row++) {
+		for (span = 0; span < 1 << t->spans_shift; span++) {
+			unsigned long addr;
+
+			addr = tile_addr(bits, span << t->span_shift, row);
+			t->span[row << t->spans_shift | span] =
+				swizzle_addr(addr, swizzle);
+		}
+	}
+}
+
+/**
+ * igt_tiling_offset:
+ * @t: layout of the surface
+ * @x: horizontal position in pixels
+ * @y: line
+ *
+ * Returns: The offset in bytes of the pixel at (@x, @y) within the surface.
+ */
+size_t igt_tiling_offset(const struct igt_tiling *t, int x, int y)
+{
+	unsigned int xb = x * t->cpp;
+
+	if (t->tiling == I915_TILING_NONE)
+		return (size_t)y * t->stride + xb;
+
+	return ((size_t)(y >> t->tile_height_shift) * t->stride <<
+		t->tile_height_shift) +
+		((size_t)(xb >> t->tile_width_shift) << TILE_SHIFT) +
+		t->span[(y & (t->tile_height - 1)) << t->spans_shift |
+			((xb >> t->span_shift) &
+			 ((1 << t->spans_shift) - 1))] +
+		(xb & ((1 << t->span_shift) - 1));
+}
+
+enum tiling_op {
+	TO_TILED,
+	FROM_TILED,
+	FILL,
+};
+
+/*
+ * The helpers below are inlined into every operation and span size, so
+ * that whole spans are copied with memcpy() of a constant size, which the
+ * compiler turns into a few vector moves.
+ */
+static inline __attribute__((always_inline)) void
+tiling_row(const struct igt_tiling *t, uint8_t *tile_row,
+	   const uint16_t *spans, uint8_t *linear,
+	   unsigned int xb, unsigned int end,
+	   const enum tiling_op op, const unsigned int span_shift)
+{
+	const unsigned int span = 1u << span_shift;
+	const unsigned int mask = (1u << t->spans_shift) - 1;
+
+	while (xb < end) {
+		unsigned int off = xb & (span - 1);
+		unsigned int len = min(span - off, end - xb);
+		uint8_t *tiled;
+
+		tiled = tile_row +
+			((size_t)(xb >> t->tile_width_shift) << TILE_SHIFT) +
+			spans[(xb >> span_shift) & mask] + off;
+
+		if (len == span) {
+			if (op == FROM_TILED)
+				memcpy(linear, tiled, span);
+			else
+				memcpy(tiled, linear, span);
+		} else {
+			if (op == FROM_TILED)
+				memcpy(linear, tiled, len);
+			else
+				memcpy(tiled, linear, len);
+		}
+
+		if (op != FILL)
+			linear += len;
+		xb += len;
+	}
+}
+
+static inline __attribute__((always_inline)) void
+tiling_rect(const struct igt_tiling *t, uint8_t *tiled,
+	    uint8_t *linear, uint32_t linear_stride,
+	    int x, int y, int w, int h,
+	    const enum tiling_op op, const unsigned int span_shift)
+{
+	size_t tile_row_size = (size_t)t->stride << t->tile_height_shift;
+	unsigned int xb = x * t->cpp, end = (x + w) * t->cpp;
+	int row;
+
+	for (row = y; row < y + h; row++) {
+		tiling_row(t, tiled + (row >> t->tile_height_shift) * tile_row_size,
+			   t->span + ((row & (t->tile_height - 1)) <<
+				      t->spans_shift),
+			   linear, xb, end, op, span_shift);
+
+		if (op != FILL)
+			linear += linear_stride;
+	}
+}
+
+static inline __attribute__((always_inline)) void
+tiling_copy(const struct igt_tiling *t, uint8_t *tiled,
+	    uint8_t *linear, uint32_t linear_stride,
+	    int x, int y, int w, int h, const enum tiling_op op)
+{
+	if (w <= 0 || h <= 0)
+		return;
+
+	/* the spans of X tiling, of X tiling with swizzling, and the rest */
+	switch (t->span_shift) {
+	case 9:
+		tiling_rect(t, tiled, linear, linear_stride, x, y, w, h, op, 9);
+		break;
+	case 6:
+		tiling_rect(t, tiled, linear, linear_stride, x, y, w, h, op, 6);
+		break;
+	case 4:
+		tiling_rect(t, tiled, linear, linear_stride, x, y, w, h, op, 4);
+		break;
+	default:
+		tiling_rect(t, tiled, linear, linear_stride, x, y, w, h, op,
+			    t->span_shift);
+		break;
+	}
+}
+
+/**
+ * igt_tiling_to_tiled:
+ * @t: layout of the destination surface
+ * @dst: the destination surface
+ * @src: linear source pixels
+ * @src_stride: stride of @src in bytes
+ * @x: horizontal position of the rectangle in @dst, in pixels
+ * @y: vertical position of the rectangle in @dst
+ * @w: width of the rectangle in pixels
+ * @h: height of the rectangle
+ *
+ * Copies @w by @h pixels from @src into the rectangle at (@x, @y) of @dst.
+ */
+void igt_tiling_to_tiled(const struct igt_tiling *t, void *dst,
+			 const void *src, uint32_t src_stride,
+			 int x, int y, int w, int h)
+{
+	int row;
+
+	if (t->tiling == I915_TILING_NONE) {
+		for (row = 0; row < h; row++)
+			memcpy((uint8_t *)dst + igt_tiling_offset(t, x, y + row),
+			       (const uint8_t *)src + (size_t)row * src_stride,
+			       (size_t)w * t->cpp);
+		return;
+	}
+
+	tiling_copy(t, dst, (uint8_t *)src, src_stride, x, y, w, h, TO_TILED);
+}
+
+/**
+ * igt_tiling_from_tiled:
+ * @t: layout of the source surface
+ * @dst: linear destination pixels
+ * @dst_stride: stride of @dst in bytes
+ * @src: the source surface
+ * @x: horizontal position of the rectangle in @src, in pixels
+ * @y: vertical position of the rectangle in @src
+ * @w: width of the rectangle in pixels
+ * @h: height of the rectangle
+ *
+ * Copies the @w by @h pixels at (@x, @y) of @src to @dst.
+ */
+void igt_tiling_from_tiled(const struct igt_tiling *t,
+			   void *dst, uint32_t dst_stride, const void *src,
+			   int x, int y, int w, int h)
+{
+	int row;
+
+	if (t->tiling == I915_TILING_NONE) {
+		for (row = 0; row < h; row++)
+			memcpy((uint8_t *)dst + (size_t)row * dst_stride,
+			       (const uint8_t *)src +
+			       igt_tiling_offset(t, x, y + row),
+			       (size_t)w * t->cpp);
+		return;
+	}
+
+	tiling_copy(t, (uint8_t *)src, dst, dst_stride, x, y, w, h, FROM_TILED);
+}
+
+/**
+ * igt_tiling_fill:
+ * @t: layout of the destination surface
+ * @dst: the destination surface
+ * @color: value of the pixels, truncated to the pixel size
+ * @x: horizontal position of the rectangle in @dst, in pixels
+ * @y: vertical position of the rectangle in @dst
+ * @w: width of the rectangle in pixels
+ * @h: height of the rectangle
+ *
+ * Sets all the pixels of the rectangle at (@x, @y) of @dst to @color. Only
+ * pixels of 1, 2, 4 or 8 bytes are supported.
+ */
+void igt_tiling_fill(const struct igt_tiling *t, void *dst, uint64_t color,
+		     int x, int y, int w, int h)
+{
+	uint8_t pattern[512];
+	size_t len, n;
+	unsigned int i;
+	int row;
+
+	igt_assert(t->cpp <= 8 && !(t->cpp & (t->cpp - 1)));
+
+	for (i = 0; i < sizeof(pattern); i += t->cpp)
+		memcpy(pattern + i, &color, t->cpp);
+
+	if (t->tiling == I915_TILING_NONE) {
+		for (row = 0; row < h; row++) {
+			uint8_t *line = (uint8_t *)dst +
+				igt_tiling_offset(t, x, y + row);
+
+			for (len = (size_t)w * t->cpp; len; len -= n) {
+				n = min(len, sizeof(pattern));
+				memcpy(line, pattern, n);
+				line += n;
+			}
+		}
+		return;
+	}
+
+	tiling_copy(t, dst, pattern, 0, x, y, w, h, FILL);
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef __IGT_TILING_H__
+#define __IGT_TILING_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * igt_tiling:
+ * @tiling: the I915_TILING_* layout of the surface
+ * @stride: surface stride in bytes
+ * @cpp: bytes per pixel
+ * @tile_width: width of a tile in bytes, the stride for untiled surfaces
+ * @tile_height: height of a tile in lines, 1 for untiled surfaces
+ *
+ * Describes how the pixels of a surface are laid out in memory, see
+ * igt_tiling_init().
+ */
+struct igt_tiling {
+	uint32_t tiling;
+	uint32_t stride;
+	unsigned int cpp;
+	unsigned int tile_width;
+	unsigned int tile_height;
+
+	/*< private >*/
+	unsigned int tile_width_shift, tile_height_shift;
+	unsigned int span_shift, spans_shift;
+	uint16_t span[256];
+};
+
+void igt_tiling_init(struct igt_tiling *t, uint32_t tiling, uint32_t swizzle,
+		     int bpp, uint32_t stride);
+size_t igt_tiling_offset(const struct igt_tiling *t, int x, int y);
+void igt_tiling_to_tiled(const struct igt_tiling *t, void *dst,
+			 const void *src, uint32_t src_stride,
+			 int x, int y, int w, int h);
+void igt_tiling_from_tiled(const struct igt_tiling *t,
+			   void *dst, uint32_t dst_stride, const void *src,
+			   int x, int y, int w, int h);
+void igt_tiling_fill(const struct igt_tiling *t, void *dst, uint64_t color,
+		     int x, int y, int w, int h);
+
+#endif /* __IGT_TILING_H__ */
@@ -221,6 +221,29 @@ int sync_fence_status(int fence)
 	return fence_info.status;
 }
 
+/*
+ * Like sync_fence_status(), but also returns the CLOCK_MONOTONIC time in
+ * nanoseconds at which a signaled fence was signaled.
+ */
+int sync_fence_timestamp(int fence, uint64_t *timestamp)
+{
+	struct sync_fence_info fence_info;
+	struct sync_file_info file_info = {
+		.sync_fence_info = to_user_pointer(&fence_info),
+		.num_fences = 1,
+	};
+
+	if (ioctl(fence, SYNC_IOC_FILE_INFO, &file_info))
+		return -errno;
+
+	if (file_info.num_fences != 1)
+		return -EINVAL;
+
+	*timestamp = fence_info.timestamp_ns;
+
+	return fence_info.status;
+}
+
 static void modprobe(const char *driver)
 {
 	igt_kmod_load(driver, NULL);
@@ -22,6 +22,8 @@
  *
  */
 
+#include <stdlib.h>
+
 #include "igt_core.h"
 #include "igt_stats.h"
 
@@ -228,6 +230,190 @@ static void test_reallocation(void)
 	igt_stats_fini(&stats);
 }
 
+static uint64_t xorshift64(uint64_t *x)
+{
+	*x ^= *x << 13;
+	*x ^= *x >> 7;
+	*x ^= *x << 17;
+
+	return *x;
+}
+
+static void assert_within(double value, double ref, double error)
+{
+	igt_assert_f(fabs(value - ref) <= error * ref,
+		     "%f not within %g of %f\n", value, error, ref);
+}
+
+/*
+ * Below 2^(precision + 1) the histogram counts the values exactly, so it must
+ * agree with the array.
+ */
+static void test_histogram_exact(void)
+{
+	static const uint64_t s1[] =
+		{ 47, 49, 6, 7, 15, 36, 39, 40, 41, 42, 43 };
+	igt_stats_t stats, ref;
+	double q1, q2, q3;
+	double r1, r2, r3;
+
+	igt_stats_init(&ref);
+	igt_stats_init_histogram(&stats, 5);
+	igt_stats_push_array(&ref, s1, ARRAY_SIZE(s1));
+	igt_stats_push_array(&stats, s1, ARRAY_SIZE(s1));
+
+	igt_assert_eq(stats.n_values, ARRAY_SIZE(s1));
+	igt_assert(igt_stats_get_min(&stats) == 6);
+	igt_assert(igt_stats_get_max(&stats) == 49);
+
+	igt_stats_get_quartiles(&ref, &r1, &r2, &r3);
+	igt_stats_get_quartiles(&stats, &q1, &q2, &q3);
+	igt_assert_eq_double(q1, r1);
+	igt_assert_eq_double(q2, r2);
+	igt_assert_eq_double(q3, r3);
+	assert_within(igt_stats_get_iqm(&stats), igt_stats_get_iqm(&ref), 1e-12);
+	assert_within(igt_stats_get_mean(&stats),
+		      igt_stats_get_mean(&ref), 1e-12);
+	assert_within(igt_stats_get_variance(&stats),
+		      igt_stats_get_variance(&ref), 1e-12);
+
+	igt_stats_fini(&stats);
+	igt_stats_fini(&ref);
+}
+
+static void test_histogram_error(void)
+{
+	const unsigned int precision = 7;
+	const double error = 1. / (2 << precision);
+	igt_stats_t stats, ref;
+	uint64_t x = 1;
+	double q1, q2, q3;
+	double r1, r2, r3;
+	unsigned int i;
+
+	igt_stats_init(&ref);
+	igt_stats_init_histogram(&stats, precision);
+
+	/* spread over many powers of two */
+	for (i = 0; i < 10001; i++) {
+		uint64_t v = xorshift64(&x) >> (24 + i % 32);
+
+		igt_stats_push(&ref, v);
+		igt_stats_push(&stats, v);
+	}
+
+	igt_assert(igt_stats_get_min(&stats) == igt_stats_get_min(&ref));
+	igt_assert(igt_stats_get_max(&stats) == igt_stats_get_max(&ref));
+	assert_within(igt_stats_get_mean(&stats),
+		      igt_stats_get_mean(&ref), 1e-12);
+	assert_within(igt_stats_get_std_deviation(&stats),
+		      igt_stats_get_std_deviation(&ref), 1e-9);
+
+	igt_stats_get_quartiles(&ref, &r1, &r2, &r3);
+	igt_stats_get_quartiles(&stats, &q1, &q2, &q3);
+	assert_within(q1, r1, error);
+	assert_within(q2, r2, error);
+	assert_within(q3, r3, error);
+	assert_within(igt_stats_get_iqm(&stats), igt_stats_get_iqm(&ref), error);
+	assert_within(igt_stats_get_trimean(&stats),
+		      igt_stats_get_trimean(&ref), error);
+
+	igt_stats_fini(&stats);
+	igt_stats_fini(&ref);
+}
+
+static void test_histogram_merge(void)
+{
+	igt_stats_t stats, part[3];
+	uint64_t x = 1;
+	unsigned int i;
+
+	igt_stats_init_histogram(&stats, 7);
+	for (i = 0; i < ARRAY_SIZE(part); i++)
+		igt_stats_init_histogram(&part[i], 7);
+
+	for (i = 0; i < 3000; i++) {
+		uint64_t v = xorshift64(&x) >> (32 + i % 3);
+
+		igt_stats_push(&stats, v);
+		igt_stats_push(&part[i % 3], v);
+	}
+
+	igt_stats_merge(&part[0], &part[1]);
+	igt_stats_merge(&part[0], &part[2]);
+
+	igt_assert_eq(part[0].n_values, stats.n_values);
+	igt_assert(igt_stats_get_min(&part[0]) == igt_stats_get_min(&stats));
+	igt_assert(igt_stats_get_max(&part[0]) == igt_stats_get_max(&stats));
+	igt_assert_eq_double(igt_stats_get_median(&part[0]),
+			     igt_stats_get_median(&stats));
+	igt_assert_eq_double(igt_stats_get_iqm(&part[0]),
+			     igt_stats_get_iqm(&stats));
+	assert_within(igt_stats_get_mean(&part[0]),
+		      igt_stats_get_mean(&stats), 1e-12);
+	assert_within(igt_stats_get_variance(&part[0]),
+		      igt_stats_get_variance(&stats), 1e-9);
+
+	for (i = 0; i < ARRAY_SIZE(part); i++)
+		igt_stats_fini(&part[i]);
+	igt_stats_fini(&stats);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	const uint64_t *p1 = a, *p2 = b;
+
+	return *p1 < *p2 ? -1 : *p1 > *p2;
+}
+
+/*
+ * More than 256 values are sorted a byte at a time, check the quartiles of
+ * such sets against qsort(), with the values differing in all of their
+ * bytes, in their low bytes only, and in their high bytes only.
+ */
+static void test_quartiles_large(void)
+{
+	const unsigned int n = 1001;
+	const struct {
+		unsigned int shift;
+		uint64_t mask;
+	} sets[] = {
+		{ 0, ~0ull },
+		{ 40, ~0ull },
+		{ 0, ~0xffffull },
+		{ 0, 0xff00ff00ff00ff00ull },
+	};
+	uint64_t *ref = malloc(n * sizeof(*ref));
+	uint64_t x = 1;
+	unsigned int i, j;
+
+	igt_assert(ref);
+
+	for (j = 0; j < ARRAY_SIZE(sets); j++) {
+		igt_stats_t stats;
+		double q1, q2, q3;
+
+		igt_stats_init(&stats);
+		for (i = 0; i < n; i++) {
+			ref[i] = (xorshift64(&x) >> sets[j].shift) & sets[j].mask;
+			igt_stats_push(&stats, ref[i]);
+		}
+		qsort(ref, n, sizeof(*ref), cmp_u64);
+
+		/* With 1001 values, Tukey's hinges are all data points */
+		igt_stats_get_quartiles(&stats, &q1, &q2, &q3);
+		igt_assert_eq_double(q1, ref[250]);
+		igt_assert_eq_double(q2, ref[500]);
+		igt_assert_eq_double(q3, ref[750]);
+		igt_assert(igt_stats_get_min(&stats) == ref[0]);
+		igt_assert(igt_stats_get_max(&stats) == ref[n - 1]);
+
+		igt_stats_fini(&stats);
+	}
+
+	free(ref);
+}
+
 igt_simple_main
 {
 	test_init_zero();
@@ -235,9 +421,13 @@ igt_simple_main
 	test_min_max();
 	test_range();
 	test_quartiles();
+	test_quartiles_large();
 	test_invalidate_sorted();
 	test_mean();
 	test_invalidate_mean();
 	test_std_deviation();
 	test_reallocation();
+	test_histogram_exact();
+	test_histogram_error();
+	test_histogram_merge();
 }
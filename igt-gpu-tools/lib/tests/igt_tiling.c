@@ -0,0 +1,217 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "igt_core.h"
+#include "igt_rand.h"
+#include "igt_tiling.h"
+#include "i915_drm.h"
+#include "intel_batchbuffer.h"
+
+#define ARRAY_SIZE(arr) (sizeof(arr)/sizeof(arr[0]))
+
+static uint32_t seed = 0x1234;
+
+static uint32_t rnd(uint32_t max)
+{
+	return hars_petruska_f54_1_random(&seed) % max;
+}
+
+static unsigned long ref_swizzle(unsigned long addr, uint32_t swizzle)
+{
+	unsigned long bit6 = 0;
+
+	switch (swizzle) {
+	case I915_BIT_6_SWIZZLE_9_10_11:
+		bit6 ^= addr >> 11;
+		/* fallthrough */
+	case I915_BIT_6_SWIZZLE_9_10:
+		bit6 ^= addr >> 10;
+		/* fallthrough */
+	case I915_BIT_6_SWIZZLE_9:
+		bit6 ^= addr >> 9;
+		break;
+	case I915_BIT_6_SWIZZLE_9_11:
+		bit6 = (addr >> 9) ^ (addr >> 11);
+		break;
+	}
+
+	return addr ^ ((bit6 & 1) << 6);
+}
+
+/* Yf tile addresses, written out bit by bit for each pixel size */
+static unsigned long ref_yf(unsigned int cpp, unsigned int xb, unsigned int y)
+{
+	unsigned long addr;
+
+	addr = (xb & 15) | (y & 3) << 4 |
+	       (xb >> 4 & 1) << 6 | (y >> 2 & 1) << 7 |
+	       (xb >> 5 & 1) << 8 | (y >> 3 & 1) << 9;
+
+	if (cpp == 1)
+		addr |= (y >> 4 & 1) << 10 | (y >> 5 & 1) << 11;
+	else if (cpp <= 4)
+		addr |= (xb >> 6 & 1) << 10 | (y >> 4 & 1) << 11;
+	else
+		addr |= (xb >> 6 & 1) << 10 | (xb >> 7 & 1) << 11;
+
+	return addr;
+}
+
+/* The offset of a pixel, computed one pixel at a time */
+static size_t ref_offset(uint32_t tiling, uint32_t swizzle, unsigned int cpp,
+			 uint32_t stride, int x, int y)
+{
+	unsigned int xb = x * cpp, tile_width, tile_height;
+	size_t tile;
+
+	switch (tiling) {
+	case I915_TILING_X:
+		tile = (y / 8 * (stride / 512) + xb / 512) * 4096;
+		return ref_swizzle(tile + (y % 8) * 512 + xb % 512, swizzle);
+	case I915_TILING_Y:
+		tile = (y / 32 * (stride / 128) + xb / 128) * 4096;
+		return ref_swizzle(tile + (xb % 128 / 16) * 512 +
+				   (y % 32) * 16 + xb % 16, swizzle);
+	case I915_TILING_Yf:
+		tile_width = cpp == 1 ? 64 : cpp <= 4 ? 128 : 256;
+		tile_height = 4096 / tile_width;
+		tile = (y / tile_height * (stride / tile_width) +
+			xb / tile_width) * 4096;
+		return tile + ref_yf(cpp, xb % tile_width, y % tile_height);
+	default:
+		return (size_t)y * stride + xb;
+	}
+}
+
+static void test_layout(uint32_t tiling, uint32_t swizzle, int bpp)
+{
+	unsigned int cpp = bpp / 8;
+	struct igt_tiling t;
+	uint32_t stride;
+	int width, height, x, y, w, h, i, j;
+	uint8_t *tiled, *expected, *linear;
+	size_t size;
+
+	igt_tiling_init(&t, tiling, swizzle, bpp, 0);
+	stride = t.tile_width * (1 + rnd(4));
+	if (tiling == I915_TILING_NONE)
+		stride = (1 + rnd(1024)) * cpp + rnd(16);
+	igt_tiling_init(&t, tiling, swizzle, bpp, stride);
+
+	width = stride / cpp;
+	height = t.tile_height * (1 + rnd(3));
+	size = (size_t)stride * height;
+
+	tiled = malloc(size);
+	expected = malloc(size);
+	linear = malloc((size_t)width * cpp * height);
+
+	for (i = 0; i < size; i++)
+		tiled[i] = rnd(256);
+
+	for (y = 0; y < height; y++)
+		for (x = 0; x < width; x++)
+			igt_assert_eq(igt_tiling_offset(&t, x, y),
+				      ref_offset(tiling, swizzle, cpp,
+						 stride, x, y));
+
+	for (i = 0; i < 16; i++) {
+		uint64_t color = (uint64_t)rnd(~0u) << 32 | rnd(~0u);
+
+		x = rnd(width);
+		y = rnd(height);
+		w = rnd(width - x + 1);
+		h = rnd(height - y + 1);
+
+		/* from_tiled reads exactly the pixels of the rectangle */
+		memset(linear, 0, (size_t)width * cpp * height);
+		igt_tiling_from_tiled(&t, linear, width * cpp, tiled,
+				      x, y, w, h);
+		for (j = 0; j < w * h; j++)
+			igt_assert(!memcmp(linear + (j / w * width + j % w) * cpp,
+					   tiled + ref_offset(tiling, swizzle,
+							      cpp, stride,
+							      x + j % w,
+							      y + j / w),
+					   cpp));
+
+		/* to_tiled writes them, and nothing else */
+		for (j = 0; j < width * cpp * height; j++)
+			linear[j] = rnd(256);
+		memcpy(expected, tiled, size);
+		for (j = 0; j < w * h; j++)
+			memcpy(expected + ref_offset(tiling, swizzle, cpp, stride,
+						     x + j % w, y + j / w),
+			       linear + (j / w * width + j % w) * cpp, cpp);
+		igt_tiling_to_tiled(&t, tiled, linear, width * cpp,
+				    x, y, w, h);
+		igt_assert(!memcmp(tiled, expected, size));
+
+		if (cpp > 8)
+			continue;
+
+		for (j = 0; j < w * h; j++)
+			memcpy(expected + ref_offset(tiling, swizzle, cpp, stride,
+						     x + j % w, y + j / w),
+			       &color, cpp);
+		igt_tiling_fill(&t, tiled, color, x, y, w, h);
+		igt_assert(!memcmp(tiled, expected, size));
+	}
+
+	free(linear);
+	free(expected);
+	free(tiled);
+}
+
+igt_simple_main
+{
+	static const uint32_t swizzles[] = {
+		I915_BIT_6_SWIZZLE_NONE,
+		I915_BIT_6_SWIZZLE_9,
+		I915_BIT_6_SWIZZLE_9_10,
+		I915_BIT_6_SWIZZLE_9_11,
+		I915_BIT_6_SWIZZLE_9_10_11,
+	};
+	static const int bpps[] = { 8, 16, 32, 64, 128 };
+	int i, j, n;
+
+	for (n = 0; n < 4; n++) {
+		for (i = 0; i < ARRAY_SIZE(bpps); i++) {
+			test_layout(I915_TILING_NONE, I915_BIT_6_SWIZZLE_NONE,
+				    bpps[i]);
+			test_layout(I915_TILING_Yf, I915_BIT_6_SWIZZLE_NONE,
+				    bpps[i]);
+
+			for (j = 0; j < ARRAY_SIZE(swizzles); j++) {
+				test_layout(I915_TILING_X, swizzles[j],
+					    bpps[i]);
+				test_layout(I915_TILING_Y, swizzles[j],
+					    bpps[i]);
+			}
+		}
+	}
+}
@@ -22,10 +22,8 @@
  *
  */
 
-#include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
-#include <fcntl.h>
 #include <string.h>
 #include <errno.h>
 
@@ -37,45 +35,43 @@ int cpu_top_init(struct cpu_top *cpu)
 
 	cpu->nr_cpu = sysconf(_SC_NPROCESSORS_ONLN);
 
-	return 0;
+	return sample_file_open(&cpu->file, "/proc/stat");
 }
 
 int cpu_top_update(struct cpu_top *cpu)
 {
 	struct cpu_stat *s = &cpu->stat[cpu->count++&1];
 	struct cpu_stat *d = &cpu->stat[cpu->count&1];
-	uint64_t d_total, d_idle;
-	char buf[4096], *b;
-	int fd, len = -1;
-
-	fd = open("/proc/stat", 0);
-	if (fd < 0)
-		return errno;
+	uint64_t d_total, d_idle, running;
+	const char *b;
+	int ret;
 
-	len = read(fd, buf, sizeof(buf)-1);
-	close(fd);
+	ret = sample_file_read(&cpu->file);
+	if (ret)
+		return ret;
 
-	if (len < 0)
+	b = sample_skip(cpu->file.buf, "cpu");
+	b = sample_parse_u64(b, &s->user);
+	b = sample_parse_u64(b, &s->nice);
+	b = sample_parse_u64(b, &s->sys);
+	b = sample_parse_u64(b, &s->idle);
+	if (b == NULL)
 		return EIO;
-	buf[len] = '\0';
-
-#ifdef __x86_64__
-	sscanf(buf, "cpu %lu %lu %lu %lu",
-	       &s->user, &s->nice, &s->sys, &s->idle);
-#else
-	sscanf(buf, "cpu %llu %llu %llu %llu",
-	       &s->user, &s->nice, &s->sys, &s->idle);
-#endif
 
-	b = strstr(buf, "procs_running");
-	if (b)
-		cpu->nr_running = atoi(b+sizeof("procs_running")) - 1;
+	b = sample_file_find(&cpu->file, &cpu->hint, "procs_running");
+	if (b && sample_parse_u64(b + sizeof("procs_running") - 1, &running))
+		cpu->nr_running = running - 1;
 
 	s->total = s->user + s->nice + s->sys + s->idle;
 	if (cpu->count == 1)
 		return EAGAIN;
 
 	d_total = s->total - d->total;
+	if (d_total == 0) {
+		cpu->count--;
+		return EAGAIN;
+	}
+
 	d_idle = s->idle - d->idle;
 	cpu->busy = 100 - 100 * d_idle / d_total;
 
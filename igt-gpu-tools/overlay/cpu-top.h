@@ -25,8 +25,11 @@
 #ifndef CPU_TOP_H
 #define CPU_TOP_H
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include "sample.h"
+
 struct cpu_top {
 	uint8_t busy;
 	int nr_cpu;
@@ -37,6 +40,9 @@ struct cpu_top {
 		uint64_t user, nice, sys, idle;
 		uint64_t total;
 	} stat[2];
+
+	struct sample_file file;
+	size_t hint;
 };
 
 int cpu_top_init(struct cpu_top *cpu);
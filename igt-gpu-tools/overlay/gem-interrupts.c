@@ -29,84 +29,89 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
 #include "igt_perf.h"
 
 #include "gem-interrupts.h"
 #include "debugfs.h"
 
-static long long debugfs_read(void)
+static long long debugfs_read(struct gem_interrupts *irqs)
 {
-	char buf[8192], *b;
-	int fd, len;
+	const char *b;
+	uint64_t val;
 
-	sprintf(buf, "%s/i915_gem_interrupt", debugfs_dri_path);
-	fd = open(buf, 0);
-	if (fd < 0)
+	if (sample_file_read(&irqs->file))
 		return -1;
 
-	len = read(fd, buf, sizeof(buf)-1);
-	close(fd);
-
-	if (len < 0)
+	b = sample_file_find(&irqs->file, &irqs->hint,
+			     "Interrupts received:");
+	if (b == NULL)
 		return -1;
 
-	buf[len] = '\0';
-
-	b = strstr(buf, "Interrupts received:");
-	if (b == NULL)
+	if (sample_parse_u64(b + sizeof("Interrupts received:") - 1,
+			     &val) == NULL)
 		return -1;
 
-	return strtoull(b + sizeof("Interrupts received:"), 0, 0);
+	return val;
 }
 
-static long long procfs_read(void)
+static long long procfs_read(struct gem_interrupts *irqs)
 {
-	char buf[8192], *b;
-	int fd, len;
-	unsigned long long val;
+	const char *b, *end;
+	uint64_t val, sum;
 
 /* 44:         51      42446          0          0   PCI-MSI-edge      i915*/
-	fd = open("/proc/interrupts", 0);
-	if (fd < 0)
+	if (sample_file_read(&irqs->file))
 		return -1;
 
-	len = read(fd, buf, sizeof(buf)-1);
-	close(fd);
-
-	if (len < 0)
+	b = sample_file_find(&irqs->file, &irqs->hint, "i915");
+	if (b == NULL)
 		return -1;
 
-	buf[len] = '\0';
+	end = b;
+	while (b > irqs->file.buf && b[-1] != '\n')
+		b--;
 
-	b = strstr(buf, "i915");
+	b = memchr(b, ':', end - b);
 	if (b == NULL)
 		return -1;
-	while (*--b != ':')
-		;
 
-	val = 0;
-	do {
-		while (isspace(*++b))
-			;
-		if (!isdigit(*b))
-			break;
+	/* The per-cpu counts, up to the name of the interrupt chip */
+	sum = 0;
+	for (b++; (b = sample_parse_u64(b, &val)) != NULL; )
+		sum += val;
 
-		val += strtoull(b, &b, 0);
-	} while(1);
+	return sum;
+}
 
-	return val;
+static long long interrupts_read(struct gem_interrupts *irqs)
+{
+	if (irqs->procfs)
+		return procfs_read(irqs);
+	else
+		return debugfs_read(irqs);
 }
 
-static long long interrupts_read(void)
+static int interrupts_open(struct gem_interrupts *irqs)
 {
-	long long val;
+	char path[256];
 
-	val = debugfs_read();
-	if (val < 0)
-		val = procfs_read();
-	return val;
+	sprintf(path, "%s/i915_gem_interrupt", debugfs_dri_path);
+	if (sample_file_open(&irqs->file, path) == 0) {
+		if (debugfs_read(irqs) >= 0)
+			return 0;
+		sample_file_close(&irqs->file);
+	}
+
+	irqs->procfs = 1;
+	irqs->hint = 0;
+	if (sample_file_open(&irqs->file, "/proc/interrupts") == 0) {
+		if (procfs_read(irqs) >= 0)
+			return 0;
+		sample_file_close(&irqs->file);
+	}
+
+	return ENODEV;
 }
 
 int gem_interrupts_init(struct gem_interrupts *irqs)
@@ -114,8 +119,8 @@ int gem_interrupts_init(struct gem_interrupts *irqs)
 	memset(irqs, 0, sizeof(*irqs));
 
 	irqs->fd = perf_i915_open(I915_PMU_INTERRUPTS);
-	if (irqs->fd < 0 && interrupts_read() < 0)
-		irqs->error = ENODEV;
+	if (irqs->fd < 0)
+		irqs->error = interrupts_open(irqs);
 
 	return irqs->error;
 }
@@ -130,7 +135,7 @@ int gem_interrupts_update(struct gem_interrupts *irqs)
 
 	if (irqs->fd < 0) {
 		long long ret;
-		ret = interrupts_read();
+		ret = interrupts_read(irqs);
 		if (ret < 0)
 			return irqs->error = ENODEV;
 		else
@@ -25,12 +25,20 @@
 #ifndef GEM_INTERRUPTS_H
 #define GEM_INTERRUPTS_H
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include "sample.h"
+
 struct gem_interrupts {
 	long unsigned last_count, count, delta;
 	int error;
 	int fd;
+
+	/* Text fallback when the PMU is not available */
+	struct sample_file file;
+	size_t hint;
+	int procfs;
 };
 
 int gem_interrupts_init(struct gem_interrupts *irqs);
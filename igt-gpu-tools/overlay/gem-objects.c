@@ -22,8 +22,6 @@
  *
  */
 
-#include <unistd.h>
-#include <fcntl.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -46,40 +44,6 @@
  *	Xorg: 35 objects, 16347136 bytes (0 active, 12103680 inactive, 0 unbound)
  */
 
-int gem_objects_init(struct gem_objects *obj)
-{
-	char buf[8192], *b;
-	int fd, len;
-
-	memset(obj, 0, sizeof(*obj));
-
-	sprintf(buf, "%s/i915_gem_objects", debugfs_dri_path);
-	fd = open(buf, 0);
-	if (fd < 0)
-		return errno;
-	len = read(fd, buf+1, sizeof(buf)-2);
-	close(fd);
-
-	if (len < 0)
-		return EIO;
-
-	/* Add sentinel values for the string searches */
-	buf[0] = '\n';
-	buf[len+1] = '\0';
-
-	b = strstr(buf, "gtt total");
-	if (b == NULL)
-		return EIO;
-
-	while (*b != '\n')
-		b--;
-
-	sscanf(b, "%ld [%ld]",
-	       &obj->max_gtt, &obj->max_aperture);
-
-	return 0;
-}
-
 static void insert_sorted(struct gem_objects *obj,
 			  struct gem_objects_comm *comm)
 {
@@ -93,54 +57,70 @@ static void insert_sorted(struct gem_objects *obj,
 	*prev = comm;
 }
 
-int gem_objects_update(struct gem_objects *obj)
+static void parse_totals(struct gem_objects *obj, const char *b)
 {
-	char buf[8192], *b;
-	struct gem_objects_comm *comm;
-	struct gem_objects_comm *freed;
-	int fd, len, ret;
-
-	freed = obj->comm;
-	obj->comm = NULL;
-
-	sprintf(buf, "%s/i915_gem_objects", debugfs_dri_path);
-	fd = open(buf, 0);
-	if (fd < 0) {
-		ret = errno;
-		goto done;
+	uint64_t count, bytes, gtt, aperture;
+	const char *s;
+
+	/* 46 objects, 20107264 bytes */
+	s = sample_parse_u64(b, &count);
+	s = sample_skip(s, "objects,");
+	s = sample_parse_u64(s, &bytes);
+	if (s) {
+		obj->total_count = count;
+		obj->total_bytes = bytes;
 	}
-	len = read(fd, buf, sizeof(buf)-1);
-	close(fd);
 
-	if (len < 0) {
-		ret = EIO;
-		goto done;
+	/* 42 [42] objects, 15863808 [15863808] bytes in gtt */
+	b = sample_next_line(b);
+	if (b == NULL)
+		return;
+
+	s = sample_parse_u64(b, &count);
+	s = sample_skip(s, "[");
+	s = sample_parse_u64(s, &count);
+	s = sample_skip(s, "] objects,");
+	s = sample_parse_u64(s, &gtt);
+	s = sample_skip(s, "[");
+	s = sample_parse_u64(s, &aperture);
+	if (s) {
+		obj->total_gtt = gtt;
+		obj->total_aperture = aperture;
 	}
+}
 
-	buf[len] = '\0';
-	while (buf[--len] == '\n')
-		buf[len] = '\0';
-
-	b = buf;
-
-	sscanf(b, "%lu objects, %lu bytes",
-	       &obj->total_count, &obj->total_bytes);
+static void parse_objects(struct gem_objects *obj)
+{
+	struct gem_objects_comm *comm;
+	struct gem_objects_comm *freed;
+	const char *b, *next;
 
-	b = strchr(b, '\n');
-	sscanf(b, "%*d [%*d] objects, %lu [%lu] bytes in gtt",
-	       &obj->total_gtt, &obj->total_aperture);
+	b = obj->file.buf;
+	parse_totals(obj, b);
 
-	ret = 0;
 	b = strchr(b, ':');
 	if (b == NULL)
-		goto done;
+		return;
 
-	while (*b != '\n')
+	while (b > obj->file.buf && b[-1] != '\n')
 		b--;
-	b++;
 
-	do {
-		char *eol, *colon;
+	/* Reuse the entries of the previous sample for this one. */
+	freed = obj->comm;
+	obj->comm = NULL;
+
+	for (; b; b = next) {
+		const char *eol, *colon, *s;
+		uint64_t count, bytes;
+		size_t len;
+
+		next = sample_next_line(b);
+		eol = next ? next - 1 : b + strlen(b);
+
+		/* Xorg: 35 objects, 16347136 bytes (0 active, 12103680 inactive, 0 unbound) */
+		colon = memchr(b, ':', eol - b);
+		if (colon == NULL)
+			continue;
 
 		comm = freed;
 		if (comm)
@@ -150,31 +130,82 @@ int gem_objects_update(struct gem_objects *obj)
 		if (comm == NULL)
 			break;
 
-		/* Xorg: 35 objects, 16347136 bytes (0 active, 12103680 inactive, 0 unbound) */
-		eol = strchr(b, '\n');
-		if (eol) {
-			do {
-			*eol++ = '\0';
-			} while (*eol == '\n');
-		}
-
-		colon = strchr(b, ':');
-		memcpy(comm->name, b, colon-b+1);
-		comm->name[colon-b+1] = '\0';
+		len = colon - b + 1;
+		if (len > sizeof(comm->name) - 1)
+			len = sizeof(comm->name) - 1;
+		memcpy(comm->name, b, len);
+		comm->name[len] = '\0';
 
-		sscanf(colon + 1, "%lu objects, %lu bytes",
-		       &comm->count, &comm->bytes);
+		s = sample_parse_u64(colon + 1, &count);
+		s = sample_skip(s, "objects,");
+		s = sample_parse_u64(s, &bytes);
+		comm->count = s ? count : 0;
+		comm->bytes = s ? bytes : 0;
 
 		insert_sorted(obj, comm);
-		b = eol;
-	} while (b != NULL);
+	}
 
-done:
 	while (freed) {
 		comm = freed;
 		freed = comm->next;
 		free(comm);
 	}
+}
+
+int gem_objects_init(struct gem_objects *obj)
+{
+	uint64_t max_gtt, max_aperture;
+	char path[256];
+	const char *b;
+	int ret;
+
+	memset(obj, 0, sizeof(*obj));
+
+	sprintf(path, "%s/i915_gem_objects", debugfs_dri_path);
+	ret = sample_file_open(&obj->file, path);
+	if (ret)
+		return ret;
+
+	ret = sample_file_read(&obj->file);
+	if (ret)
+		goto err;
+
+	ret = EIO;
+	b = strstr(obj->file.buf, "gtt total");
+	if (b == NULL)
+		goto err;
+
+	while (b > obj->file.buf && b[-1] != '\n')
+		b--;
+
+	b = sample_parse_u64(b, &max_gtt);
+	b = sample_skip(b, "[");
+	b = sample_parse_u64(b, &max_aperture);
+	if (b == NULL)
+		goto err;
+
+	obj->max_gtt = max_gtt;
+	obj->max_aperture = max_aperture;
+
+	parse_objects(obj);
+	return 0;
 
+err:
+	sample_file_close(&obj->file);
 	return ret;
 }
+
+int gem_objects_update(struct gem_objects *obj)
+{
+	int ret;
+
+	ret = sample_file_read(&obj->file);
+	if (ret)
+		return ret;
+
+	/* Most frames nothing was allocated or freed, keep the last parse. */
+	if (sample_file_changed(&obj->file))
+		parse_objects(obj);
+
+	return 0;
+}
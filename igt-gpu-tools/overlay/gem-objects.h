@@ -27,7 +27,10 @@
 
 #include <stdint.h>
 
+#include "sample.h"
+
 struct gem_objects {
+	struct sample_file file;
 	long unsigned total_bytes, total_count;
 	long unsigned total_gtt, total_aperture;
 	long unsigned max_gtt, max_aperture;
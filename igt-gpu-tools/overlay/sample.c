@@ -0,0 +1,148 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "sample.h"
+
+#define SAMPLE_MAX_SIZE (1 << 20)
+
+int sample_file_open(struct sample_file *f, const char *path)
+{
+	memset(f, 0, sizeof(*f));
+
+	f->fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (f->fd < 0)
+		return errno;
+
+	f->size = 4096;
+	f->buf = malloc(f->size);
+	f->prev = malloc(f->size);
+	if (f->buf == NULL || f->prev == NULL) {
+		sample_file_close(f);
+		return ENOMEM;
+	}
+
+	f->buf[0] = f->prev[0] = '\0';
+	return 0;
+}
+
+static int sample_file_grow(struct sample_file *f)
+{
+	size_t size = 2 * f->size;
+	char *buf, *prev;
+
+	if (size > SAMPLE_MAX_SIZE)
+		return EFBIG;
+
+	buf = realloc(f->buf, size);
+	if (buf == NULL)
+		return ENOMEM;
+	f->buf = buf;
+
+	prev = realloc(f->prev, size);
+	if (prev == NULL)
+		return ENOMEM;
+	f->prev = prev;
+
+	f->size = size;
+	return 0;
+}
+
+int sample_file_read(struct sample_file *f)
+{
+	size_t len = 0;
+	ssize_t r;
+	char *tmp;
+	int err;
+
+	if (f->fd < 0)
+		return ENODEV;
+
+	tmp = f->prev;
+	f->prev = f->buf;
+	f->prev_len = f->len;
+	f->buf = tmp;
+
+	/*
+	 * Read on until the end of the file, as procfs and sysfs files
+	 * may return no more than a page per read.
+	 */
+	do {
+		if (len == f->size - 1) {
+			err = sample_file_grow(f);
+			if (err)
+				return err;
+		}
+
+		r = pread(f->fd, f->buf + len, f->size - 1 - len, len);
+		if (r < 0)
+			return errno;
+		len += r;
+	} while (r);
+
+	f->buf[len] = '\0';
+	f->len = len;
+	return 0;
+}
+
+int sample_file_changed(const struct sample_file *f)
+{
+	return f->len != f->prev_len || memcmp(f->buf, f->prev, f->len);
+}
+
+/*
+ * Look for str in the sample, first at the offset it was last found at,
+ * as lines tend to stay in place between samples.
+ */
+const char *sample_file_find(const struct sample_file *f,
+			     size_t *hint, const char *str)
+{
+	size_t len = strlen(str);
+	const char *s;
+
+	if (*hint + len <= f->len && !memcmp(f->buf + *hint, str, len))
+		return f->buf + *hint;
+
+	s = strstr(f->buf, str);
+	if (s)
+		*hint = s - f->buf;
+
+	return s;
+}
+
+void sample_file_close(struct sample_file *f)
+{
+	if (f->fd >= 0)
+		close(f->fd);
+	free(f->buf);
+	free(f->prev);
+
+	memset(f, 0, sizeof(*f));
+	f->fd = -1;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A text file in procfs, sysfs or debugfs that is sampled every frame. The
+ * file is kept open and re-read from offset 0, into a buffer that is kept
+ * along with the previous sample so that an unchanged file need not be
+ * parsed again.
+ */
+struct sample_file {
+	int fd;
+	char *buf, *prev;
+	size_t len, prev_len;
+	size_t size;
+};
+
+int sample_file_open(struct sample_file *f, const char *path);
+int sample_file_read(struct sample_file *f);
+int sample_file_changed(const struct sample_file *f);
+const char *sample_file_find(const struct sample_file *f,
+			     size_t *hint, const char *str);
+void sample_file_close(struct sample_file *f);
+
+/*
+ * Tokenizer over the NUL terminated sample: each helper returns the
+ * position following what it consumed, or NULL if the text does not match.
+ */
+
+static inline const char *sample_skip_blank(const char *s)
+{
+	while (*s == ' ' || *s == '\t')
+		s++;
+	return s;
+}
+
+static inline const char *sample_parse_u64(const char *s, uint64_t *v)
+{
+	uint64_t x = 0;
+
+	if (s == NULL)
+		return NULL;
+
+	s = sample_skip_blank(s);
+	if (*s < '0' || *s > '9')
+		return NULL;
+
+	do
+		x = x * 10 + *s++ - '0';
+	while (*s >= '0' && *s <= '9');
+
+	*v = x;
+	return s;
+}
+
+static inline const char *sample_skip(const char *s, const char *str)
+{
+	if (s == NULL)
+		return NULL;
+
+	s = sample_skip_blank(s);
+	while (*str)
+		if (*s++ != *str++)
+			return NULL;
+
+	return s;
+}
+
+static inline const char *sample_next_line(const char *s)
+{
+	while (*s != '\n') {
+		if (*s == '\0')
+			return NULL;
+		s++;
+	}
+
+	return s + 1;
+}
+
+#endif /* SAMPLE_H */
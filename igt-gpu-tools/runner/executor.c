@@ -6,7 +6,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
 #include <sys/signalfd.h>
 #include <sys/stat.h>
 #include <sys/time.h>
@@ -419,6 +419,162 @@ static bool kill_child(int sig, pid_t child)
 	return true;
 }
 
+/*
+ * Incremental scanner for the test's stdout. Only lines that can be
+ * subtest start or result lines are copied aside, everything else is
+ * skipped over with memchr() without touching the bytes again.
+ */
+struct output_scanner {
+	char line[4096];
+	size_t linelen;
+	bool midline;
+	bool keep;
+	char current_subtest[256];
+};
+
+static bool has_prefix(const char *buf, size_t len, const char *prefix)
+{
+	size_t prefixlen = strlen(prefix);
+
+	return !memcmp(buf, prefix, len < prefixlen ? len : prefixlen);
+}
+
+static void handle_output_line(struct output_scanner *scanner,
+			       const char *line, size_t linelen,
+			       int *outputs,
+			       struct settings *settings)
+{
+	if (linelen > strlen(STARTING_SUBTEST) &&
+	    !memcmp(line, STARTING_SUBTEST, strlen(STARTING_SUBTEST))) {
+		size_t namelen = linelen - strlen(STARTING_SUBTEST);
+
+		write(outputs[_F_JOURNAL], line + strlen(STARTING_SUBTEST), namelen);
+		if (namelen >= sizeof(scanner->current_subtest))
+			namelen = sizeof(scanner->current_subtest) - 1;
+		memcpy(scanner->current_subtest, line + strlen(STARTING_SUBTEST), namelen);
+		scanner->current_subtest[namelen] = '\0';
+
+		if (settings->log_level >= LOG_LEVEL_VERBOSE) {
+			fwrite(line, 1, linelen, stdout);
+		}
+	}
+	if (linelen > strlen(SUBTEST_RESULT) &&
+	    !memcmp(line, SUBTEST_RESULT, strlen(SUBTEST_RESULT))) {
+		const char *delim = memchr(line, ':', linelen);
+
+		if (delim != NULL) {
+			size_t subtestlen = delim - line - strlen(SUBTEST_RESULT);
+			if (memcmp(scanner->current_subtest, line + strlen(SUBTEST_RESULT),
+				   subtestlen)) {
+				/* Result for a test that didn't ever start */
+				write(outputs[_F_JOURNAL],
+				      line + strlen(SUBTEST_RESULT),
+				      subtestlen);
+				write(outputs[_F_JOURNAL], "\n", 1);
+				if (settings->sync) {
+					fdatasync(outputs[_F_JOURNAL]);
+				}
+				scanner->current_subtest[0] = '\0';
+			}
+
+			if (settings->log_level >= LOG_LEVEL_VERBOSE) {
+				fwrite(line, 1, linelen, stdout);
+			}
+		}
+	}
+}
+
+static void scan_output(struct output_scanner *scanner,
+			const char *buf, size_t size,
+			int *outputs,
+			struct settings *settings)
+{
+	const char *p = buf, *end = buf + size;
+
+	while (p < end) {
+		const char *newline = memchr(p, '\n', end - p);
+		const char *segment_end = newline ? newline + 1 : end;
+		size_t seglen = segment_end - p;
+
+		if (!scanner->midline) {
+			scanner->linelen = 0;
+			scanner->keep = has_prefix(p, seglen, STARTING_SUBTEST) ||
+				has_prefix(p, seglen, SUBTEST_RESULT);
+		} else if (scanner->keep && scanner->linelen < strlen(STARTING_SUBTEST)) {
+			/* Only part of the prefix was seen so far */
+			memcpy(scanner->line + scanner->linelen, p,
+			       seglen < strlen(STARTING_SUBTEST) ? seglen : strlen(STARTING_SUBTEST));
+			scanner->keep =
+				has_prefix(scanner->line, scanner->linelen + seglen, STARTING_SUBTEST) ||
+				has_prefix(scanner->line, scanner->linelen + seglen, SUBTEST_RESULT);
+		}
+
+		if (scanner->keep) {
+			if (scanner->linelen + seglen > sizeof(scanner->line)) {
+				/* Too long to be anything we're interested in */
+				scanner->keep = false;
+			} else {
+				memcpy(scanner->line + scanner->linelen, p, seglen);
+				scanner->linelen += seglen;
+			}
+		}
+
+		if (newline) {
+			if (scanner->keep)
+				handle_output_line(scanner, scanner->line, scanner->linelen,
+						   outputs, settings);
+			scanner->midline = false;
+			scanner->keep = false;
+		} else {
+			scanner->midline = true;
+		}
+
+		p = segment_end;
+	}
+}
+
+/*
+ * Moves data from a pipe to an output file, without copying through
+ * userspace if the kernel can splice to the file.
+ */
+static ssize_t pipe_to_file(int pipefd, int filefd,
+			    char *buf, size_t bufsize,
+			    bool *use_splice)
+{
+	ssize_t s;
+
+	if (*use_splice) {
+		s = splice(pipefd, NULL, filefd, NULL, bufsize,
+			   SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (s >= 0 || errno != EINVAL)
+			return s;
+
+		/* Output file doesn't support splicing */
+		*use_splice = false;
+	}
+
+	s = read(pipefd, buf, bufsize);
+	if (s > 0)
+		write(filefd, buf, s);
+
+	return s;
+}
+
+static void epoll_add(int epfd, int fd)
+{
+	struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+
+	if (fd >= 0)
+		epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static void epoll_remove(int epfd, int *fd)
+{
+	epoll_ctl(epfd, EPOLL_CTL_DEL, *fd, NULL);
+	close(*fd);
+	*fd = -1;
+}
+
 /*
  * Returns:
  *  =0 - Success
@@ -431,15 +587,15 @@ static int monitor_output(pid_t child,
 			   double *time_spent,
 			   struct settings *settings)
 {
-	fd_set set;
-	char buf[2048];
-	char *outbuf = NULL;
-	size_t outbufsize = 0;
-	char current_subtest[256] = {};
+	struct epoll_event events[4];
+	const size_t bufsize = 64 << 10;
+	char *buf;
+	struct output_scanner scanner = {};
+	bool use_splice = true;
 	struct signalfd_siginfo siginfo;
 	ssize_t s;
-	int n, status;
-	int nfds = outfd;
+	int i, n, status;
+	int epfd;
 	int timeout = settings->inactivity_timeout;
 	int timeout_intervals = 1, intervals_left;
 	int wd_extra = 10;
@@ -450,13 +606,18 @@ static int monitor_output(pid_t child,
 
 	igt_gettime(&time_beg);
 
-	if (errfd > nfds)
-		nfds = errfd;
-	if (kmsgfd > nfds)
-		nfds = kmsgfd;
-	if (sigfd > nfds)
-		nfds = sigfd;
-	nfds++;
+	if ((epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+		fprintf(stderr, "Error creating epoll instance: %s\n",
+			strerror(errno));
+		return -1;
+	}
+
+	epoll_add(epfd, outfd);
+	epoll_add(epfd, errfd);
+	epoll_add(epfd, kmsgfd);
+	epoll_add(epfd, sigfd);
+
+	buf = malloc(bufsize);
 
 	if (timeout > 0) {
 		/*
@@ -483,21 +644,15 @@ static int monitor_output(pid_t child,
 	}
 
 	while (outfd >= 0 || errfd >= 0 || sigfd >= 0) {
-		struct timeval tv = { .tv_sec = timeout };
-
-		FD_ZERO(&set);
-		if (outfd >= 0)
-			FD_SET(outfd, &set);
-		if (errfd >= 0)
-			FD_SET(errfd, &set);
-		if (kmsgfd >= 0)
-			FD_SET(kmsgfd, &set);
-		if (sigfd >= 0)
-			FD_SET(sigfd, &set);
-
-		n = select(nfds, &set, NULL, NULL, timeout == 0 ? NULL : &tv);
+		bool out_ready = false, err_ready = false;
+		bool kmsg_ready = false, sig_ready = false;
+
+		n = epoll_wait(epfd, events, sizeof(events) / sizeof(events[0]),
+			       timeout == 0 ? -1 : timeout * 1000);
 		if (n < 0) {
 			/* TODO */
+			free(buf);
+			close(epfd);
 			return -1;
 		}
 
@@ -556,7 +711,8 @@ static int monitor_output(pid_t child,
 						taints);
 				}
 				close_watchdogs(settings);
-				free(outbuf);
+				free(buf);
+				close(epfd);
 				close(outfd);
 				close(errfd);
 				close(kmsgfd);
@@ -570,102 +726,56 @@ static int monitor_output(pid_t child,
 		intervals_left = timeout_intervals;
 		ping_watchdogs();
 
-		/* TODO: Refactor these handlers to their own functions */
-		if (outfd >= 0 && FD_ISSET(outfd, &set)) {
-			char *newline;
+		for (i = 0; i < n; i++) {
+			int fd = events[i].data.fd;
+
+			out_ready |= fd == outfd;
+			err_ready |= fd == errfd;
+			kmsg_ready |= fd == kmsgfd;
+			sig_ready |= fd == sigfd;
+		}
 
-			s = read(outfd, buf, sizeof(buf));
+		if (outfd >= 0 && out_ready) {
+			s = read(outfd, buf, bufsize);
 			if (s <= 0) {
 				if (s < 0) {
 					fprintf(stderr, "Error reading test's stdout: %s\n",
 						strerror(errno));
 				}
 
-				close(outfd);
-				outfd = -1;
-				goto out_end;
-			}
-
-			write(outputs[_F_OUT], buf, s);
-			if (settings->sync) {
-				fdatasync(outputs[_F_OUT]);
-			}
-
-			outbuf = realloc(outbuf, outbufsize + s);
-			memcpy(outbuf + outbufsize, buf, s);
-			outbufsize += s;
-
-			while ((newline = memchr(outbuf, '\n', outbufsize)) != NULL) {
-				size_t linelen = newline - outbuf + 1;
-
-				if (linelen > strlen(STARTING_SUBTEST) &&
-				    !memcmp(outbuf, STARTING_SUBTEST, strlen(STARTING_SUBTEST))) {
-					write(outputs[_F_JOURNAL], outbuf + strlen(STARTING_SUBTEST),
-					      linelen - strlen(STARTING_SUBTEST));
-					memcpy(current_subtest, outbuf + strlen(STARTING_SUBTEST),
-					       linelen - strlen(STARTING_SUBTEST));
-					current_subtest[linelen - strlen(STARTING_SUBTEST)] = '\0';
-
-					if (settings->log_level >= LOG_LEVEL_VERBOSE) {
-						fwrite(outbuf, 1, linelen, stdout);
-					}
-				}
-				if (linelen > strlen(SUBTEST_RESULT) &&
-				    !memcmp(outbuf, SUBTEST_RESULT, strlen(SUBTEST_RESULT))) {
-					char *delim = memchr(outbuf, ':', linelen);
-
-					if (delim != NULL) {
-						size_t subtestlen = delim - outbuf - strlen(SUBTEST_RESULT);
-						if (memcmp(current_subtest, outbuf + strlen(SUBTEST_RESULT),
-							   subtestlen)) {
-							/* Result for a test that didn't ever start */
-							write(outputs[_F_JOURNAL],
-							      outbuf + strlen(SUBTEST_RESULT),
-							      subtestlen);
-							write(outputs[_F_JOURNAL], "\n", 1);
-							if (settings->sync) {
-								fdatasync(outputs[_F_JOURNAL]);
-							}
-							current_subtest[0] = '\0';
-						}
-
-						if (settings->log_level >= LOG_LEVEL_VERBOSE) {
-							fwrite(outbuf, 1, linelen, stdout);
-						}
-					}
+				epoll_remove(epfd, &outfd);
+			} else {
+				write(outputs[_F_OUT], buf, s);
+				if (settings->sync) {
+					fdatasync(outputs[_F_OUT]);
 				}
 
-				memmove(outbuf, newline + 1, outbufsize - linelen);
-				outbufsize -= linelen;
+				scan_output(&scanner, buf, s, outputs, settings);
 			}
 		}
-	out_end:
 
-		if (errfd >= 0 && FD_ISSET(errfd, &set)) {
-			s = read(errfd, buf, sizeof(buf));
+		if (errfd >= 0 && err_ready) {
+			s = pipe_to_file(errfd, outputs[_F_ERR], buf, bufsize, &use_splice);
 			if (s <= 0) {
 				if (s < 0) {
 					fprintf(stderr, "Error reading test's stderr: %s\n",
 						strerror(errno));
 				}
-				close(errfd);
-				errfd = -1;
+				epoll_remove(epfd, &errfd);
 			} else {
-				write(outputs[_F_ERR], buf, s);
 				if (settings->sync) {
 					fdatasync(outputs[_F_ERR]);
 				}
 			}
 		}
 
-		if (kmsgfd >= 0 && FD_ISSET(kmsgfd, &set)) {
-			s = read(kmsgfd, buf, sizeof(buf));
+		if (kmsgfd >= 0 && kmsg_ready) {
+			s = read(kmsgfd, buf, bufsize);
 			if (s < 0) {
 				if (errno != EPIPE && errno != EINVAL) {
 					fprintf(stderr, "Error reading from kmsg, stopping monitoring: %s\n",
 						strerror(errno));
-					close(kmsgfd);
-					kmsgfd = -1;
+					epoll_remove(epfd, &kmsgfd);
 				} else if (errno == EINVAL) {
 					fprintf(stderr, "Warning: Buffer too small for kernel log record, record lost.\n");
 				}
@@ -677,7 +787,7 @@ static int monitor_output(pid_t child,
 			}
 		}
 
-		if (sigfd >= 0 && FD_ISSET(sigfd, &set)) {
+		if (sigfd >= 0 && sig_ready) {
 			double time;
 
 			s = read(sigfd, &siginfo, sizeof(siginfo));
@@ -731,8 +841,7 @@ static int monitor_output(pid_t child,
 					*time_spent = time;
 			}
 
-			close(sigfd);
-			sigfd = -1;
+			epoll_remove(epfd, &sigfd);
 			child = 0;
 		}
 	}
@@ -741,7 +850,8 @@ static int monitor_output(pid_t child,
 	if (settings->sync)
 		fdatasync(outputs[_F_DMESG]);
 
-	free(outbuf);
+	free(buf);
+	close(epfd);
 	close(outfd);
 	close(errfd);
 	close(kmsgfd);
@@ -905,7 +1015,10 @@ static int execute_next_entry(struct execute_state *state,
 		return -1;
 	}
 
-	if ((kmsgfd = open("/dev/kmsg", O_RDONLY | O_CLOEXEC)) < 0) {
+	if (settings->jobs > 1) {
+		/* Captured by execute_concurrently() for all jobs */
+		kmsgfd = -1;
+	} else if ((kmsgfd = open("/dev/kmsg", O_RDONLY | O_CLOEXEC)) < 0) {
 		fprintf(stderr, "Warning: Cannot open /dev/kmsg\n");
 	} else {
 		/* TODO: Checking of abort conditions in pre-execute dmesg */
@@ -1081,7 +1194,7 @@ bool initialize_execute_state_from_resume(int dirfd,
 					  struct job_list *list)
 {
 	struct job_list_entry *entry;
-	int resdirfd, fd, i;
+	int resdirfd, fd, i, last;
 
 	free_settings(settings);
 	free_job_list(list);
@@ -1096,39 +1209,48 @@ bool initialize_execute_state_from_resume(int dirfd,
 
 	init_time_left(state, settings);
 
-	for (i = list->size; i >= 0; i--) {
+	for (last = list->size; last >= 0; last--) {
 		char name[32];
 
-		snprintf(name, sizeof(name), "%d", i);
-		if ((resdirfd = openat(dirfd, name, O_DIRECTORY | O_RDONLY)) >= 0)
+		snprintf(name, sizeof(name), "%d", last);
+		if (faccessat(dirfd, name, F_OK, 0) == 0)
 			break;
 	}
 
-	if (i < 0)
-		/* Nothing has been executed yet, state is fine as is */
-		goto success;
+	/*
+	 * With concurrent jobs, any number of entries before the last
+	 * one with a result directory can be incomplete or not even
+	 * started, so every journal up to that point is checked.
+	 * Entries that need no further execution are marked by
+	 * making the binary name invalid.
+	 */
+	for (i = 0; i <= last; i++) {
+		char name[32];
 
-	entry = &list->entries[i];
-	state->next = i;
-	if ((fd = openat(resdirfd, filenames[_F_JOURNAL], O_RDONLY)) >= 0) {
-		if (!prune_from_journal(entry, fd)) {
-			/*
-			 * The test does not have subtests, or
-			 * incompleted before the first subtest
-			 * began. Either way, not suitable to
-			 * re-run.
-			 */
-			state->next = i + 1;
-		} else if (entry->binary[0] == '\0') {
-			/* This test is fully completed */
-			state->next = i + 1;
+		snprintf(name, sizeof(name), "%d", i);
+		if ((resdirfd = openat(dirfd, name, O_DIRECTORY | O_RDONLY)) < 0)
+			continue;
+
+		entry = &list->entries[i];
+		if ((fd = openat(resdirfd, filenames[_F_JOURNAL], O_RDONLY)) >= 0) {
+			if (!prune_from_journal(entry, fd)) {
+				/*
+				 * The test does not have subtests, or
+				 * incompleted before the first subtest
+				 * began. Either way, not suitable to
+				 * re-run.
+				 */
+				entry->binary[0] = '\0';
+			}
 		}
 
-		close(fd);
+		close(resdirfd);
 	}
 
- success:
-	close(resdirfd);
+	while (state->next < list->size &&
+	       list->entries[state->next].binary[0] == '\0')
+		state->next++;
+
 	close(dirfd);
 
 	return true;
@@ -1195,6 +1317,533 @@ static void write_abort_file(int resdirfd,
 	}
 }
 
+static bool is_exclusive(struct job_list_entry *entry,
+			 char **exclusive, size_t num_exclusive)
+{
+	size_t i;
+
+	for (i = 0; i < num_exclusive; i++) {
+		if (!strcmp(entry->binary, exclusive[i]))
+			return true;
+	}
+
+	return false;
+}
+
+static size_t read_exclusive_list(int testdirfd, char ***exclusive)
+{
+	FILE *f;
+	int fd;
+	char buf[128];
+	size_t num = 0;
+
+	*exclusive = NULL;
+
+	/*
+	 * Binaries that drive the hardware in a way that cannot be
+	 * shared with other tests list themselves in
+	 * exclusive-list.txt in the test root, whitespace separated.
+	 */
+	if ((fd = openat(testdirfd, "exclusive-list.txt", O_RDONLY)) < 0)
+		return 0;
+
+	f = fdopen(fd, "r");
+	if (!f) {
+		close(fd);
+		return 0;
+	}
+
+	while (fscanf(f, "%127s", buf) == 1) {
+		num++;
+		*exclusive = realloc(*exclusive, num * sizeof(**exclusive));
+		(*exclusive)[num - 1] = strdup(buf);
+	}
+
+	fclose(f);
+
+	return num;
+}
+
+static bool reload_entry_from_journal(struct job_list_entry *entry,
+				      const struct job_list_entry *orig,
+				      int resdirfd, size_t idx)
+{
+	char name[32];
+	size_t i;
+	int dirfd, fd;
+	bool pruned;
+
+	/* Drop the copy made by the previous reload, if any */
+	if (entry->binary != orig->binary) {
+		free(entry->binary);
+		for (i = 0; i < entry->subtest_count; i++)
+			free(entry->subtests[i]);
+		free(entry->subtests);
+	}
+
+	entry->binary = strdup(orig->binary);
+	entry->subtest_count = orig->subtest_count;
+	entry->subtests = NULL;
+	if (orig->subtest_count) {
+		entry->subtests = malloc(orig->subtest_count * sizeof(*entry->subtests));
+		for (i = 0; i < orig->subtest_count; i++)
+			entry->subtests[i] = strdup(orig->subtests[i]);
+	}
+
+	snprintf(name, sizeof(name), "%zd", idx);
+	if ((dirfd = openat(resdirfd, name, O_DIRECTORY | O_RDONLY)) < 0)
+		return false;
+
+	if ((fd = openat(dirfd, filenames[_F_JOURNAL], O_RDONLY)) < 0) {
+		close(dirfd);
+		return false;
+	}
+
+	pruned = prune_from_journal(entry, fd);
+	close(dirfd);
+
+	return pruned && entry->binary[0] != '\0';
+}
+
+/*
+ * Runs in a forked child that supervises a single job list entry,
+ * including re-executions after timeouts. Never returns.
+ */
+static void execute_entry_in_slot(struct execute_state *state,
+				  size_t idx,
+				  struct settings *settings,
+				  struct job_list *job_list,
+				  int testdirfd, int resdirfd)
+{
+	struct job_list_entry orig = job_list->entries[idx];
+	struct job_list_entry entry = orig;
+	double time_spent = 0.0;
+	int result;
+
+	state->next = idx;
+
+	while ((result = execute_next_entry(state, job_list->size,
+					    &time_spent, settings,
+					    &entry, testdirfd, resdirfd)) > 0) {
+		/* Timeouted, continue from the subtests not yet started */
+		if (!reload_entry_from_journal(&entry, &orig, resdirfd, idx)) {
+			result = 0;
+			break;
+		}
+	}
+
+	exit(result < 0 ? 1 : 0);
+}
+
+struct job_slot {
+	pid_t pid;
+	size_t idx;
+	int dmesgfd;
+	/* When the job started, on the clock of the kernel log */
+	unsigned long long start;
+	/* Sequence number of the last [IGT] record of the job's binary */
+	unsigned long long announced;
+};
+
+static unsigned long long kmsg_clock_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static int open_job_dmesg(int resdirfd, size_t idx)
+{
+	char name[32];
+	int dirfd, fd;
+
+	snprintf(name, sizeof(name), "%zd", idx);
+	mkdirat(resdirfd, name, 0777);
+	if ((dirfd = openat(resdirfd, name, O_DIRECTORY | O_RDONLY | O_CLOEXEC)) < 0)
+		return -1;
+
+	fd = openat(dirfd, filenames[_F_DMESG],
+		    O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+	close(dirfd);
+
+	return fd;
+}
+
+static bool names_subtest_of(const char *message, struct job_list_entry *entry)
+{
+	size_t i;
+
+	for (i = 0; i < entry->subtest_count; i++) {
+		if (strstr(message, entry->subtests[i]))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Picks the running job a kernel log record belongs to. Tests announce
+ * themselves with "[IGT] <binary>:" records, so such a record belongs to
+ * the job running that binary, or when several jobs run it, to the one
+ * whose subtest the record names. Any other record belongs to the job
+ * that was running when it was logged, and when several were, to the
+ * one that announced itself last, as the record most likely comes from
+ * what that test just did.
+ */
+static struct job_slot *kmsg_record_owner(struct job_slot *slots, int num_slots,
+					  struct job_list *job_list,
+					  const char *message,
+					  unsigned long long seq,
+					  unsigned long long usec)
+{
+	struct job_slot *owner = NULL;
+	int i;
+
+	if (!strncmp(message, "[IGT] ", strlen("[IGT] "))) {
+		const char *name = message + strlen("[IGT] ");
+		size_t len = strcspn(name, ":");
+
+		for (i = 0; i < num_slots; i++) {
+			struct job_list_entry *entry;
+
+			if (!slots[i].pid)
+				continue;
+
+			entry = &job_list->entries[slots[i].idx];
+			if (strlen(entry->binary) != len ||
+			    strncmp(entry->binary, name, len))
+				continue;
+
+			/*
+			 * A record naming no subtest, such as the one
+			 * the test starts with, goes to the job that
+			 * started first among those yet to announce.
+			 */
+			if (names_subtest_of(name + len, entry)) {
+				owner = &slots[i];
+				break;
+			}
+
+			if (!owner ||
+			    (!slots[i].announced && owner->announced) ||
+			    (!slots[i].announced == !owner->announced &&
+			     slots[i].start < owner->start))
+				owner = &slots[i];
+		}
+
+		if (owner) {
+			owner->announced = seq;
+			return owner;
+		}
+	}
+
+	for (i = 0; i < num_slots; i++) {
+		bool running = slots[i].start <= usec;
+
+		if (!slots[i].pid)
+			continue;
+
+		if (!owner) {
+			owner = &slots[i];
+			continue;
+		}
+
+		/* Records from before any job started go to one of them */
+		if (running != (owner->start <= usec)) {
+			if (running)
+				owner = &slots[i];
+			continue;
+		}
+
+		if (slots[i].announced > owner->announced ||
+		    (slots[i].announced == owner->announced &&
+		     slots[i].start < owner->start))
+			owner = &slots[i];
+	}
+
+	return owner;
+}
+
+/* Hands out all kernel log records available now to the running jobs */
+static void read_kmsg_records(int kmsgfd, struct job_slot *slots, int num_slots,
+			      struct job_list *job_list,
+			      struct settings *settings)
+{
+	unsigned long long seq, usec;
+	struct job_slot *owner;
+	unsigned flags;
+	char buf[2048];
+	char cont;
+	ssize_t r;
+	int n;
+
+	while (kmsgfd >= 0) {
+		r = read(kmsgfd, buf, sizeof(buf) - 1);
+		if (r < 0) {
+			if (errno == EPIPE)
+				continue;
+			if (errno == EINVAL) {
+				fprintf(stderr, "Warning: Buffer too small for kernel log record, record lost.\n");
+				continue;
+			}
+
+			/* EAGAIN when all is read */
+			return;
+		}
+
+		buf[r] = '\0';
+		if (sscanf(buf, "%u,%llu,%llu,%c;%n",
+			   &flags, &seq, &usec, &cont, &n) != 4)
+			continue;
+
+		owner = kmsg_record_owner(slots, num_slots, job_list,
+					  buf + n, seq, usec);
+		if (!owner || owner->dmesgfd < 0)
+			continue;
+
+		write(owner->dmesgfd, buf, r);
+		if (settings->sync)
+			fdatasync(owner->dmesgfd);
+	}
+}
+
+static bool execute_concurrently(struct execute_state *state,
+				 struct settings *settings,
+				 struct job_list *job_list,
+				 int testdirfd, int resdirfd)
+{
+	struct job_slot *slots;
+	struct signalfd_siginfo siginfo;
+	struct epoll_event events[2];
+	struct timespec time_last, time_now;
+	char **exclusive;
+	size_t num_exclusive, running = 0, i;
+	bool running_exclusive = false;
+	bool stopping = false;
+	bool status = true;
+	sigset_t mask, oldmask;
+	int sigfd, kmsgfd, epfd = -1;
+	int n;
+
+	num_exclusive = read_exclusive_list(testdirfd, &exclusive);
+	slots = calloc(settings->jobs, sizeof(*slots));
+
+	/*
+	 * The kernel log is read once here for all jobs rather than by
+	 * each job, which would give every job every record logged
+	 * while it ran, see kmsg_record_owner().
+	 */
+	if ((kmsgfd = open("/dev/kmsg", O_RDONLY | O_NONBLOCK | O_CLOEXEC)) < 0)
+		fprintf(stderr, "Warning: Cannot open /dev/kmsg\n");
+	else
+		lseek(kmsgfd, 0, SEEK_END);
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGQUIT);
+	sigprocmask(SIG_BLOCK, &mask, &oldmask);
+	sigfd = signalfd(-1, &mask, O_CLOEXEC);
+
+	if (sigfd < 0) {
+		fprintf(stderr, "Cannot monitor job processes with signalfd\n");
+		status = false;
+		goto out;
+	}
+
+	if ((epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+		fprintf(stderr, "Error creating epoll instance: %s\n",
+			strerror(errno));
+		close(sigfd);
+		status = false;
+		goto out;
+	}
+
+	epoll_add(epfd, sigfd);
+	epoll_add(epfd, kmsgfd);
+
+	igt_gettime(&time_last);
+
+	while (true) {
+		while (!stopping && !running_exclusive &&
+		       state->next < job_list->size &&
+		       running < settings->jobs) {
+			struct job_list_entry *entry = &job_list->entries[state->next];
+			bool exclusive_entry;
+			pid_t pid;
+
+			if (entry->binary[0] == '\0') {
+				/* Already completed before a resume */
+				state->next++;
+				continue;
+			}
+
+			exclusive_entry = is_exclusive(entry, exclusive, num_exclusive);
+			if (exclusive_entry && running > 0)
+				break;
+
+			for (i = 0; slots[i].pid; i++)
+				;
+
+			/*
+			 * Flush outputs before forking so our
+			 * (buffered) output won't get duplicated.
+			 */
+			fflush(stdout);
+			fflush(stderr);
+
+			slots[i].dmesgfd = kmsgfd < 0 ? -1 :
+				open_job_dmesg(resdirfd, state->next);
+			slots[i].start = kmsg_clock_now();
+			slots[i].announced = 0;
+
+			if ((pid = fork()) == 0) {
+				close(epfd);
+				close(sigfd);
+				close(kmsgfd);
+				execute_entry_in_slot(state, state->next, settings,
+						      job_list, testdirfd, resdirfd);
+			}
+
+			if (pid < 0) {
+				fprintf(stderr, "Error forking a job process: %s\n",
+					strerror(errno));
+				close(slots[i].dmesgfd);
+				status = false;
+				stopping = true;
+				break;
+			}
+
+			slots[i].pid = pid;
+			slots[i].idx = state->next;
+			running++;
+			running_exclusive = exclusive_entry;
+			state->next++;
+		}
+
+		if (running == 0)
+			break;
+
+		if ((n = epoll_wait(epfd, events, 2, -1)) < 0) {
+			if (errno == EINTR)
+				continue;
+
+			fprintf(stderr, "Error waiting for job processes: %s\n",
+				strerror(errno));
+			siginfo.ssi_signo = SIGTERM;
+		} else {
+			bool sig_ready = false;
+
+			while (n--)
+				sig_ready |= events[n].data.fd == sigfd;
+
+			read_kmsg_records(kmsgfd, slots, settings->jobs,
+					  job_list, settings);
+			if (!sig_ready)
+				continue;
+
+			if (read(sigfd, &siginfo, sizeof(siginfo)) < 0) {
+				if (errno == EINTR)
+					continue;
+
+				fprintf(stderr, "Error reading from signalfd: %s\n",
+					strerror(errno));
+				siginfo.ssi_signo = SIGTERM;
+			}
+		}
+
+		if (siginfo.ssi_signo != SIGCHLD) {
+			if (settings->log_level >= LOG_LEVEL_NORMAL)
+				printf("Abort requested, terminating jobs\n");
+
+			/* Each job process kills its own test on SIGTERM */
+			for (i = 0; i < settings->jobs; i++) {
+				if (slots[i].pid)
+					kill(slots[i].pid, SIGTERM);
+			}
+
+			status = false;
+			stopping = true;
+			continue;
+		}
+
+		while (running > 0) {
+			char *reason;
+			int wstatus;
+			pid_t pid;
+
+			if ((pid = waitpid(-1, &wstatus, WNOHANG)) <= 0)
+				break;
+
+			for (i = 0; i < settings->jobs; i++) {
+				if (slots[i].pid == pid)
+					break;
+			}
+			if (i == settings->jobs)
+				continue;
+
+			/* Everything the job logged is there by now */
+			read_kmsg_records(kmsgfd, slots, settings->jobs,
+					  job_list, settings);
+			close(slots[i].dmesgfd);
+			slots[i].pid = 0;
+			running--;
+			running_exclusive = false;
+
+			if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+				status = false;
+				stopping = true;
+			}
+
+			/*
+			 * With concurrent execution the overall
+			 * timeout is consumed by wall clock time
+			 * rather than the sum of test runtimes.
+			 */
+			igt_gettime(&time_now);
+			reduce_time_left(settings, state,
+					 igt_time_elapsed(&time_last, &time_now));
+			time_last = time_now;
+
+			if (!stopping && overall_timeout_exceeded(state)) {
+				if (settings->log_level >= LOG_LEVEL_NORMAL) {
+					printf("Overall timeout time exceeded, stopping.\n");
+				}
+
+				stopping = true;
+			}
+
+			if (!stopping && (reason = need_to_abort(settings)) != NULL) {
+				char *prev = entry_display_name(&job_list->entries[slots[i].idx]);
+				char *next = (state->next < job_list->size ?
+					      entry_display_name(&job_list->entries[state->next]) :
+					      strdup("nothing"));
+				write_abort_file(resdirfd, reason, prev, next);
+				free(prev);
+				free(next);
+				free(reason);
+				status = false;
+				stopping = true;
+			}
+		}
+	}
+
+	close(epfd);
+	close(sigfd);
+
+ out:
+	close(kmsgfd);
+	sigprocmask(SIG_SETMASK, &oldmask, NULL);
+	for (i = 0; i < num_exclusive; i++)
+		free(exclusive[i]);
+	free(exclusive);
+	free(slots);
+
+	return status;
+}
+
 bool execute(struct execute_state *state,
 	     struct settings *settings,
 	     struct job_list *job_list)
@@ -1267,11 +1916,22 @@ bool execute(struct execute_state *state,
 		}
 	}
 
+	if (settings->jobs > 1) {
+		status = execute_concurrently(state, settings, job_list,
+					      testdirfd, resdirfd);
+		goto endtime;
+	}
+
 	for (; state->next < job_list->size;
 	     state->next++) {
 		char *reason;
 		int result;
 
+		if (job_list->entries[state->next].binary[0] == '\0') {
+			/* Already completed before a resume */
+			continue;
+		}
+
 		result = execute_next_entry(state,
 					    job_list->size,
 					    &time_spent,
@@ -1318,6 +1978,7 @@ bool execute(struct execute_state *state,
 		}
 	}
 
+ endtime:
 	if ((timefd = openat(resdirfd, "endtime.txt", O_CREAT | O_WRONLY | O_EXCL, 0666)) >= 0) {
 		dprintf(timefd, "%f\n", timeofday_double());
 		close(timefd);
@@ -11,11 +11,19 @@
 
 #include "job_list.h"
 #include "igt_core.h"
+#include "matcher.h"
+#include "subtest_cache.h"
 
 static bool matches_any(const char *str, struct regex_list *list)
 {
 	size_t i;
 
+	if (!list->matcher)
+		list->matcher = matcher_create(list->regex_strings, list->size);
+
+	if (list->matcher)
+		return matcher_match(list->matcher, str);
+
 	for (i = 0; i < list->size; i++) {
 		if (regexec(list->regexes[i], str,
 			    (size_t)0, NULL, 0) == 0) {
@@ -43,51 +51,24 @@ static void add_job_list_entry(struct job_list *job_list,
 }
 
 static void add_subtests(struct job_list *job_list, struct settings *settings,
-			 char *binary,
+			 char *binary, struct subtest_list *listing,
 			 struct regex_list *include, struct regex_list *exclude)
 {
-	FILE *p;
-	char cmd[256] = {};
-	char *subtestname;
 	char **subtests = NULL;
 	size_t num_subtests = 0;
-	int s;
-
-	s = snprintf(cmd, sizeof(cmd), "%s/%s --list-subtests",
-		     settings->test_root, binary);
-	if (s < 0) {
-		fprintf(stderr, "Failure generating command string, this shouldn't happen.\n");
-		return;
-	}
-
-	if (s >= sizeof(cmd)) {
-		fprintf(stderr, "Path to binary too long, ignoring: %s/%s\n",
-			settings->test_root, binary);
-		return;
-	}
-
-	p = popen(cmd, "r");
-	if (!p) {
-		fprintf(stderr, "popen failed when executing %s: %s\n",
-			cmd,
-			strerror(errno));
-		return;
-	}
+	size_t i;
 
-	while (fscanf(p, "%ms", &subtestname) == 1) {
+	for (i = 0; i < listing->size; i++) {
+		char *subtestname = listing->names[i];
 		char piglitname[256];
 
 		generate_piglit_name(binary, subtestname, piglitname, sizeof(piglitname));
 
-		if (exclude && exclude->size && matches_any(piglitname, exclude)) {
-			free(subtestname);
+		if (exclude && exclude->size && matches_any(piglitname, exclude))
 			continue;
-		}
 
-		if (include && include->size && !matches_any(piglitname, include)) {
-			free(subtestname);
+		if (include && include->size && !matches_any(piglitname, include))
 			continue;
-		}
 
 		if (settings->multiple_mode) {
 			num_subtests++;
@@ -99,40 +80,40 @@ static void add_subtests(struct job_list *job_list, struct settings *settings,
 			add_job_list_entry(job_list, strdup(binary), subtests, 1);
 			subtests = NULL;
 		}
-
-		free(subtestname);
 	}
 
 	if (num_subtests)
 		add_job_list_entry(job_list, strdup(binary), subtests, num_subtests);
 
-	s = pclose(p);
-	if (s == 0) {
-		return;
-	} else if (s == -1) {
-		fprintf(stderr, "popen error when executing %s: %s\n", binary, strerror(errno));
-	} else if (WIFEXITED(s)) {
-		if (WEXITSTATUS(s) == IGT_EXIT_INVALID) {
-			/* No subtests on this one */
-			if (exclude && exclude->size && matches_any(binary, exclude)) {
-				return;
-			}
-			if (!include || !include->size || matches_any(binary, include)) {
-				add_job_list_entry(job_list, strdup(binary), NULL, 0);
-				return;
-			}
+	if (listing->status == SUBTESTS_NONE) {
+		/* No subtests on this one */
+		if (exclude && exclude->size && matches_any(binary, exclude)) {
+			return;
+		}
+		if (!include || !include->size || matches_any(binary, include)) {
+			add_job_list_entry(job_list, strdup(binary), NULL, 0);
+			return;
 		}
-	} else {
-		fprintf(stderr, "Test binary %s died unexpectedly\n", binary);
 	}
 }
 
+enum {
+	FILTER_WHOLE_BINARY,
+	FILTER_EXCLUDE_ONLY,
+	FILTER_INCLUDE_EXCLUDE,
+};
+
 static bool filtered_job_list(struct job_list *job_list,
 			      struct settings *settings,
 			      int fd)
 {
 	FILE *f;
 	char buf[128];
+	char **binaries = NULL, **to_list = NULL;
+	int *filters = NULL;
+	struct subtest_list *lists;
+	size_t num_binaries = 0, num_to_list = 0;
+	size_t i, k;
 
 	if (job_list->entries != NULL) {
 		fprintf(stderr, "Caller didn't clear the job list, this shouldn't happen\n");
@@ -142,6 +123,8 @@ static bool filtered_job_list(struct job_list *job_list,
 	f = fdopen(fd, "r");
 
 	while (fscanf(f, "%127s", buf) == 1) {
+		int filter;
+
 		if (!strcmp(buf, "TESTLIST") || !(strcmp(buf, "END")))
 			continue;
 
@@ -164,21 +147,62 @@ static bool filtered_job_list(struct job_list *job_list,
 				 * get to omit executing
 				 * --list-subtests.
 				 */
-				add_job_list_entry(job_list, strdup(buf), NULL, 0);
+				filter = FILTER_WHOLE_BINARY;
 			else
-				add_subtests(job_list, settings, buf,
-					     NULL, &settings->exclude_regexes);
-			continue;
+				filter = FILTER_EXCLUDE_ONLY;
+		} else {
+			/*
+			 * Binary name doesn't match exclude or include filters.
+			 */
+			filter = FILTER_INCLUDE_EXCLUDE;
 		}
 
-		/*
-		 * Binary name doesn't match exclude or include filters.
-		 */
-		add_subtests(job_list, settings, buf,
-			     &settings->include_regexes,
-			     &settings->exclude_regexes);
+		num_binaries++;
+		binaries = realloc(binaries, num_binaries * sizeof(*binaries));
+		filters = realloc(filters, num_binaries * sizeof(*filters));
+		binaries[num_binaries - 1] = strdup(buf);
+		filters[num_binaries - 1] = filter;
+
+		if (filter != FILTER_WHOLE_BINARY) {
+			num_to_list++;
+			to_list = realloc(to_list, num_to_list * sizeof(*to_list));
+			to_list[num_to_list - 1] = binaries[num_binaries - 1];
+		}
+	}
+
+	/*
+	 * List all needed subtests in one go so uncached listings can
+	 * run concurrently, then build the job list in test-list
+	 * order.
+	 */
+	lists = calloc(num_to_list, sizeof(*lists));
+	list_subtests(settings, to_list, num_to_list, lists);
+
+	for (i = 0, k = 0; i < num_binaries; i++) {
+		switch (filters[i]) {
+		case FILTER_WHOLE_BINARY:
+			add_job_list_entry(job_list, strdup(binaries[i]), NULL, 0);
+			break;
+		case FILTER_EXCLUDE_ONLY:
+			add_subtests(job_list, settings, binaries[i], &lists[k++],
+				     NULL, &settings->exclude_regexes);
+			break;
+		case FILTER_INCLUDE_EXCLUDE:
+			add_subtests(job_list, settings, binaries[i], &lists[k++],
+				     &settings->include_regexes,
+				     &settings->exclude_regexes);
+			break;
+		}
+
+		free(binaries[i]);
 	}
 
+	free_subtest_lists(lists, num_to_list);
+	free(lists);
+	free(to_list);
+	free(filters);
+	free(binaries);
+
 	return job_list->size != 0;
 }
 
@@ -0,0 +1,494 @@
+#include <ctype.h>
+#include <regex.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "matcher.h"
+
+struct ac_edge {
+	unsigned char c;
+	int next;
+};
+
+struct ac_state {
+	struct ac_edge *edges;
+	int num_edges;
+	/* Longest proper suffix that is also in the trie */
+	int fail;
+	/* First pattern whose literal ends here, -1 if none */
+	int out;
+	/* Nearest state on the fail chain with an output, 0 if none */
+	int dict;
+};
+
+struct matcher_pattern {
+	regex_t regex;
+	/* false if the pattern is a plain literal */
+	bool compiled;
+	/* Next pattern with the same literal, -1 if none */
+	int next_same;
+};
+
+struct matcher {
+	struct matcher_pattern *patterns;
+	size_t num_patterns;
+
+	/* Patterns without a literal, always run */
+	int *unfiltered;
+	size_t num_unfiltered;
+
+	/* State 0 is the root, its edges are in root_next */
+	struct ac_state *states;
+	size_t num_states;
+	int root_next[256];
+};
+
+/* Returns the character after the bracket expression starting at p */
+static const char *skip_bracket(const char *p)
+{
+	p++;
+	if (*p == '^')
+		p++;
+	if (*p == ']')
+		p++;
+
+	while (*p && *p != ']') {
+		if (*p == '[' && (p[1] == ':' || p[1] == '.' || p[1] == '=')) {
+			char close = p[1];
+
+			p += 2;
+			while (*p && !(*p == close && p[1] == ']'))
+				p++;
+			if (!*p)
+				return NULL;
+			p += 2;
+		} else {
+			p++;
+		}
+	}
+
+	return *p ? p + 1 : NULL;
+}
+
+/* Returns the character after the group starting at p */
+static const char *skip_group(const char *p)
+{
+	int depth = 0;
+
+	while (*p) {
+		switch (*p) {
+		case '\\':
+			if (!p[1])
+				return NULL;
+			p += 2;
+			continue;
+		case '[':
+			if ((p = skip_bracket(p)) == NULL)
+				return NULL;
+			continue;
+		case '(':
+			depth++;
+			break;
+		case ')':
+			if (--depth == 0)
+				return p + 1;
+			break;
+		}
+		p++;
+	}
+
+	return NULL;
+}
+
+/*
+ * Calls the callback for each top-level alternative of the pattern.
+ * Returns the number of alternatives, or 0 if the pattern cannot be
+ * taken apart.
+ */
+static size_t split_alternation(const char *pattern,
+				void (*cb)(const char *alt, size_t len, void *data),
+				void *data)
+{
+	const char *p = pattern, *start = pattern;
+	size_t count = 0;
+
+	while (*p) {
+		switch (*p) {
+		case '\\':
+			if (!p[1])
+				return 0;
+			p += 2;
+			continue;
+		case '[':
+			if ((p = skip_bracket(p)) == NULL)
+				return 0;
+			continue;
+		case '(':
+			if ((p = skip_group(p)) == NULL)
+				return 0;
+			continue;
+		case '|':
+			if (cb)
+				cb(start, p - start, data);
+			count++;
+			start = p + 1;
+			break;
+		}
+		p++;
+	}
+
+	if (cb)
+		cb(start, p - start, data);
+
+	return count + 1;
+}
+
+/* '\' followed by these is a GNU operator, not a literal character */
+static bool is_escaped_literal(char c)
+{
+	return c && !isalnum((unsigned char)c) && !strchr("<>`'", c);
+}
+
+/*
+ * Finds the longest run of literal characters that every match of
+ * the pattern contains, and stores it in literal. Returns its length,
+ * 0 if none was found. *pure is set if the pattern is nothing but
+ * that literal.
+ *
+ * Anything not understood ends the current run, so the result may be
+ * shorter than possible, but is never wrong.
+ */
+static size_t required_literal(const char *pattern, char *literal, bool *pure)
+{
+	const char *p = pattern;
+	char *run = malloc(strlen(pattern) + 1);
+	size_t runlen = 0, bestlen = 0;
+	bool last_literal = false, broken = false, complete = false;
+
+	*pure = false;
+
+	if (split_alternation(pattern, NULL, NULL) != 1) {
+		free(run);
+		return 0;
+	}
+
+#define END_RUN() do {					\
+		if (runlen > bestlen) {			\
+			memcpy(literal, run, runlen);	\
+			bestlen = runlen;		\
+		}					\
+		runlen = 0;				\
+		broken = true;				\
+		last_literal = false;			\
+	} while (0)
+
+	while (*p) {
+		switch (*p) {
+		case '\\':
+			if (is_escaped_literal(p[1])) {
+				run[runlen++] = p[1];
+				last_literal = true;
+				p += 2;
+				continue;
+			}
+			if (!p[1])
+				goto done;
+			END_RUN();
+			p += 2;
+			continue;
+		case '*':
+		case '?':
+		case '{':
+			/* The previous character is optional */
+			if (last_literal)
+				runlen--;
+			END_RUN();
+			if (*p == '{' && (p = strchr(p, '}')) == NULL)
+				goto done;
+			p++;
+			continue;
+		case '[':
+			END_RUN();
+			if ((p = skip_bracket(p)) == NULL)
+				goto done;
+			continue;
+		case '(':
+			END_RUN();
+			if ((p = skip_group(p)) == NULL)
+				goto done;
+			continue;
+		case '+':
+			/* Required, unless followed by an optional quantifier */
+			while (*++p == '+')
+				;
+			if (last_literal && (*p == '*' || *p == '?' || *p == '{'))
+				runlen--;
+			END_RUN();
+			continue;
+		case '.':
+		case '^':
+		case '$':
+		case ')':
+		case ']':
+		case '}':
+			END_RUN();
+			p++;
+			continue;
+		default:
+			run[runlen++] = *p++;
+			last_literal = true;
+			continue;
+		}
+	}
+	complete = true;
+
+ done:
+	*pure = complete && !broken && runlen > 0;
+	END_RUN();
+
+#undef END_RUN
+
+	free(run);
+	literal[bestlen] = '\0';
+
+	return bestlen;
+}
+
+static int ac_goto(const struct ac_state *state, unsigned char c)
+{
+	int i;
+
+	for (i = 0; i < state->num_edges; i++)
+		if (state->edges[i].c == c)
+			return state->edges[i].next;
+
+	return -1;
+}
+
+static int ac_step(const struct matcher *matcher, int state, unsigned char c)
+{
+	for (;;) {
+		int next;
+
+		if (state == 0)
+			return matcher->root_next[c];
+
+		if ((next = ac_goto(&matcher->states[state], c)) >= 0)
+			return next;
+
+		state = matcher->states[state].fail;
+	}
+}
+
+static int ac_new_state(struct matcher *matcher)
+{
+	struct ac_state *state;
+
+	matcher->states = realloc(matcher->states,
+				  (matcher->num_states + 1) * sizeof(*matcher->states));
+	state = &matcher->states[matcher->num_states];
+	memset(state, 0, sizeof(*state));
+	state->out = -1;
+
+	return matcher->num_states++;
+}
+
+static void ac_add(struct matcher *matcher, const char *literal, int pattern)
+{
+	const unsigned char *p = (const unsigned char *)literal;
+	int state = 0, next;
+
+	for (; *p; p++) {
+		if (state == 0) {
+			if ((next = matcher->root_next[*p]) == 0) {
+				next = ac_new_state(matcher);
+				matcher->root_next[*p] = next;
+			}
+		} else if ((next = ac_goto(&matcher->states[state], *p)) < 0) {
+			struct ac_state *s;
+
+			next = ac_new_state(matcher);
+			s = &matcher->states[state];
+			s->edges = realloc(s->edges, (s->num_edges + 1) * sizeof(*s->edges));
+			s->edges[s->num_edges].c = *p;
+			s->edges[s->num_edges].next = next;
+			s->num_edges++;
+		}
+		state = next;
+	}
+
+	matcher->patterns[pattern].next_same = matcher->states[state].out;
+	matcher->states[state].out = pattern;
+}
+
+static void ac_link(struct matcher *matcher)
+{
+	int *queue = malloc(matcher->num_states * sizeof(*queue));
+	size_t head = 0, tail = 0;
+	int c, i;
+
+	for (c = 0; c < 256; c++) {
+		int child = matcher->root_next[c];
+
+		if (child) {
+			matcher->states[child].fail = 0;
+			matcher->states[child].dict = 0;
+			queue[tail++] = child;
+		}
+	}
+
+	/* Breadth first, so fail states are always done before */
+	while (head < tail) {
+		int u = queue[head++];
+
+		for (i = 0; i < matcher->states[u].num_edges; i++) {
+			struct ac_edge *edge = &matcher->states[u].edges[i];
+			struct ac_state *v = &matcher->states[edge->next];
+			int f = ac_step(matcher, matcher->states[u].fail, edge->c);
+
+			v->fail = f;
+			v->dict = matcher->states[f].out >= 0 ? f : matcher->states[f].dict;
+			queue[tail++] = edge->next;
+		}
+	}
+
+	free(queue);
+}
+
+struct matcher *matcher_create(char **patterns, size_t num_patterns)
+{
+	struct matcher *matcher = calloc(1, sizeof(*matcher));
+	size_t i;
+
+	matcher->patterns = calloc(num_patterns, sizeof(*matcher->patterns));
+	matcher->unfiltered = calloc(num_patterns, sizeof(*matcher->unfiltered));
+	ac_new_state(matcher);
+
+	for (i = 0; i < num_patterns; i++) {
+		struct matcher_pattern *pattern = &matcher->patterns[i];
+		char *literal = malloc(strlen(patterns[i]) + 1);
+		bool pure;
+
+		matcher->num_patterns++;
+		pattern->next_same = -1;
+
+		if (required_literal(patterns[i], literal, &pure) == 0) {
+			matcher->unfiltered[matcher->num_unfiltered++] = i;
+		} else {
+			ac_add(matcher, literal, i);
+		}
+		free(literal);
+
+		if (pure)
+			continue;
+
+		if (regcomp(&pattern->regex, patterns[i], REG_EXTENDED | REG_NOSUB)) {
+			matcher_free(matcher);
+			return NULL;
+		}
+		pattern->compiled = true;
+	}
+
+	ac_link(matcher);
+
+	return matcher;
+}
+
+struct alternatives {
+	char **patterns;
+	size_t size;
+};
+
+static void add_alternative(const char *alt, size_t len, void *data)
+{
+	struct alternatives *alts = data;
+
+	alts->patterns[alts->size++] = strndup(alt, len);
+}
+
+struct matcher *matcher_create_alternation(const char *pattern)
+{
+	struct alternatives alts = {};
+	struct matcher *matcher;
+	char *inner = strdup(pattern);
+	const char *end;
+	size_t count, i;
+
+	/* A group around the whole pattern doesn't change what matches */
+	while (inner[0] == '(' &&
+	       (end = skip_group(inner)) != NULL && *end == '\0') {
+		memmove(inner, inner + 1, end - inner - 2);
+		inner[end - inner - 2] = '\0';
+	}
+
+	if ((count = split_alternation(inner, NULL, NULL)) == 0) {
+		matcher = matcher_create((char **)&pattern, 1);
+		free(inner);
+		return matcher;
+	}
+
+	alts.patterns = calloc(count, sizeof(*alts.patterns));
+	split_alternation(inner, add_alternative, &alts);
+	matcher = matcher_create(alts.patterns, alts.size);
+
+	for (i = 0; i < alts.size; i++)
+		free(alts.patterns[i]);
+	free(alts.patterns);
+	free(inner);
+
+	return matcher;
+}
+
+static bool pattern_matches(const struct matcher_pattern *pattern, const char *str)
+{
+	return !pattern->compiled ||
+		regexec(&pattern->regex, str, (size_t)0, NULL, 0) == 0;
+}
+
+bool matcher_match(const struct matcher *matcher, const char *str)
+{
+	const unsigned char *p;
+	int state = 0;
+	size_t i;
+
+	for (p = (const unsigned char *)str; *p; p++) {
+		int s;
+
+		state = ac_step(matcher, state, *p);
+
+		s = matcher->states[state].out >= 0 ? state : matcher->states[state].dict;
+		for (; s > 0; s = matcher->states[s].dict) {
+			int k;
+
+			for (k = matcher->states[s].out; k >= 0; k = matcher->patterns[k].next_same)
+				if (pattern_matches(&matcher->patterns[k], str))
+					return true;
+		}
+	}
+
+	for (i = 0; i < matcher->num_unfiltered; i++)
+		if (pattern_matches(&matcher->patterns[matcher->unfiltered[i]], str))
+			return true;
+
+	return false;
+}
+
+void matcher_free(struct matcher *matcher)
+{
+	size_t i;
+
+	if (!matcher)
+		return;
+
+	for (i = 0; i < matcher->num_patterns; i++)
+		if (matcher->patterns[i].compiled)
+			regfree(&matcher->patterns[i].regex);
+
+	for (i = 0; i < matcher->num_states; i++)
+		free(matcher->states[i].edges);
+
+	free(matcher->states);
+	free(matcher->unfiltered);
+	free(matcher->patterns);
+	free(matcher);
+}
@@ -0,0 +1,38 @@
+#ifndef RUNNER_MATCHER_H
+#define RUNNER_MATCHER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Matches a string against a list of POSIX extended regular
+ * expressions at once, with the same result as running regexec()
+ * with each of them (compiled with REG_EXTENDED | REG_NOSUB) and
+ * checking if any matched.
+ *
+ * A literal substring that every match of a pattern must contain is
+ * extracted from each pattern, and all of them are searched for in a
+ * single pass over the string with an Aho-Corasick automaton. Only
+ * patterns whose literal was found are then run with regexec(), and
+ * patterns that are just a literal string don't need regexec() at
+ * all. Patterns without a usable literal are always run.
+ *
+ * Matching does not modify the matcher, so a matcher can be used from
+ * several threads at once.
+ */
+struct matcher;
+
+/* Returns NULL if any of the patterns fails to compile. */
+struct matcher *matcher_create(char **patterns, size_t num_patterns);
+
+/*
+ * Creates a matcher from a single pattern, split to its top-level
+ * alternatives.
+ */
+struct matcher *matcher_create_alternation(const char *pattern);
+
+bool matcher_match(const struct matcher *matcher, const char *str);
+
+void matcher_free(struct matcher *matcher);
+
+#endif
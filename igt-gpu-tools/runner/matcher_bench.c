@@ -0,0 +1,167 @@
+/*
+ * Compares matching piglit names against a list of include/exclude
+ * patterns one regexec() at a time with the combined matcher. The
+ * patterns and names are synthetic but shaped like a typical
+ * blocklist and test list. Both paths must give the same results.
+ */
+
+#include <getopt.h>
+#include <regex.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "matcher.h"
+
+static const char *binaries[] = {
+	"kms_atomic", "kms_cursor_crc", "kms_flip", "kms_plane",
+	"gem_exec_whisper", "gem_ctx_persistence", "gem_mmap_gtt",
+	"perf_pmu", "i915_pm_rpm", "prime_vgem",
+};
+
+static const char *subtests[] = {
+	"basic", "pipe-%c-cursor-%dx%d-onscreen", "flip-vs-suspend-%d",
+	"plane-panning-bottom-right-pipe-%c", "hang-%d", "busy-check-all-%d",
+	"fault-concurrent-%d", "modeset-stress-extra-wait-%d",
+};
+
+static char *make_pattern(unsigned int i)
+{
+	const char *binary = binaries[i % (sizeof(binaries) / sizeof(binaries[0]))];
+	char *pattern;
+
+	switch (i % 5) {
+	case 0:
+		asprintf(&pattern, "igt@%s@pipe-%c-cursor-%ux%u-onscreen",
+			 binary, 'a' + i % 6, 64 << (i % 3), 21 + i);
+		break;
+	case 1:
+		asprintf(&pattern, "igt@%s@flip-vs-suspend-%u", binary, i);
+		break;
+	case 2:
+		asprintf(&pattern, "%s@.*-pipe-[a-f]-%u", binary, i);
+		break;
+	case 3:
+		asprintf(&pattern, "^igt@%s@hang-(%u|%u)$", binary, i, i + 1);
+		break;
+	default:
+		asprintf(&pattern, "busy-check-all-%u", i);
+		break;
+	}
+
+	return pattern;
+}
+
+static char *make_name(unsigned int i)
+{
+	const char *binary = binaries[(i / 7) % (sizeof(binaries) / sizeof(binaries[0]))];
+	char subtest[128];
+	char *name;
+
+	snprintf(subtest, sizeof(subtest),
+		 subtests[i % (sizeof(subtests) / sizeof(subtests[0]))],
+		 'a' + i % 6, i % 500, i % 500);
+	asprintf(&name, "igt@%s@%s", binary, subtest);
+
+	return name;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int num_patterns = 500, num_names = 20000, i, j;
+	unsigned int slow_matches = 0, fast_matches = 0;
+	char **patterns, **names;
+	regex_t *regexes;
+	struct matcher *matcher;
+	bool *results;
+	double start, slow, fast;
+	int c;
+
+	while ((c = getopt(argc, argv, "p:n:")) != -1) {
+		switch (c) {
+		case 'p':
+			num_patterns = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			num_names = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p patterns] [-n names]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	patterns = calloc(num_patterns, sizeof(*patterns));
+	regexes = calloc(num_patterns, sizeof(*regexes));
+	for (i = 0; i < num_patterns; i++) {
+		patterns[i] = make_pattern(i);
+		if (regcomp(&regexes[i], patterns[i], REG_EXTENDED | REG_NOSUB)) {
+			fprintf(stderr, "Cannot compile %s\n", patterns[i]);
+			return 1;
+		}
+	}
+
+	names = calloc(num_names, sizeof(*names));
+	for (i = 0; i < num_names; i++)
+		names[i] = make_name(i);
+
+	results = calloc(num_names, sizeof(*results));
+
+	start = now();
+	for (i = 0; i < num_names; i++) {
+		for (j = 0; j < num_patterns; j++) {
+			if (regexec(&regexes[j], names[i], (size_t)0, NULL, 0) == 0) {
+				results[i] = true;
+				slow_matches++;
+				break;
+			}
+		}
+	}
+	slow = now() - start;
+
+	start = now();
+	if ((matcher = matcher_create(patterns, num_patterns)) == NULL) {
+		fprintf(stderr, "Cannot create matcher\n");
+		return 1;
+	}
+	for (i = 0; i < num_names; i++) {
+		bool match = matcher_match(matcher, names[i]);
+
+		if (match != results[i]) {
+			fprintf(stderr, "Mismatch for %s: regexec %d, matcher %d\n",
+				names[i], results[i], match);
+			return 1;
+		}
+		fast_matches += match;
+	}
+	fast = now() - start;
+
+	printf("%u patterns, %u names, %u matched\n",
+	       num_patterns, num_names, slow_matches);
+	printf("regexec: %.3fs\n", slow);
+	printf("matcher: %.3fs (including build), %.1fx\n", fast, slow / fast);
+
+	matcher_free(matcher);
+	for (i = 0; i < num_patterns; i++) {
+		regfree(&regexes[i]);
+		free(patterns[i]);
+	}
+	for (i = 0; i < num_names; i++)
+		free(names[i]);
+	free(results);
+	free(names);
+	free(regexes);
+	free(patterns);
+
+	return fast_matches == slow_matches ? 0 : 1;
+}
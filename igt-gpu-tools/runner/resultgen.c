@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <ctype.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/mman.h>
@@ -14,6 +15,7 @@
 #include "resultgen.h"
 #include "settings.h"
 #include "executor.h"
+#include "matcher.h"
 #include "output_strings.h"
 
 #define INCOMPLETE_EXITCODE -1
@@ -500,7 +502,7 @@ static const char igt_dmesg_whitelist[] =
 static const char igt_piglit_style_dmesg_blacklist[] =
 	"(\\[drm:|drm_|intel_|i915_)";
 
-static regex_t re;
+static struct matcher *re;
 
 static int init_regex_whitelist(struct settings *settings)
 {
@@ -511,7 +513,8 @@ static int init_regex_whitelist(struct settings *settings)
 			igt_piglit_style_dmesg_blacklist :
 			igt_dmesg_whitelist;
 
-		if (regcomp(&re, regex, REG_EXTENDED | REG_NOSUB) != 0) {
+		/* Each alternative is prefiltered by its literal text */
+		if ((re = matcher_create_alternation(regex)) == NULL) {
 			fprintf(stderr, "Cannot compile dmesg regexp\n");
 			status = 1;
 			return false;
@@ -637,12 +640,12 @@ static bool fill_from_dmesg(int fd,
 
 		if (settings->piglit_style_dmesg) {
 			if ((flags & 0x07) <= 5 && continuation != 'c' &&
-			    regexec(&re, message, (size_t)0, NULL, 0) != REG_NOMATCH) {
+			    matcher_match(re, message)) {
 				append_line(&warnings, &warningslen, formatted);
 			}
 		} else {
 			if ((flags & 0x07) <= 4 && continuation != 'c' &&
-			    regexec(&re, message, (size_t)0, NULL, 0) == REG_NOMATCH) {
+			    !matcher_match(re, message)) {
 				append_line(&warnings, &warningslen, formatted);
 			}
 		}
@@ -1002,34 +1005,53 @@ static void create_result_root_nodes(struct json_object *root,
 	json_object_object_add(root, "runtimes", results->runtimes);
 }
 
-struct json_object *generate_results_json(int dirfd)
+static void init_results(struct results *results)
 {
-	struct settings settings;
-	struct job_list job_list;
-	struct json_object *obj, *elapsed;
-	struct results results;
-	int testdirfd, fd;
-	size_t i;
+	results->tests = json_object_new_object();
+	results->totals = json_object_new_object();
+	results->runtimes = json_object_new_object();
+}
 
-	init_settings(&settings);
-	init_job_list(&job_list);
+static void free_results(struct results *results)
+{
+	json_object_put(results->tests);
+	json_object_put(results->totals);
+	json_object_put(results->runtimes);
+}
+
+static bool read_run_info(int dirfd,
+			  struct settings *settings,
+			  struct job_list *job_list)
+{
+	init_settings(settings);
+	init_job_list(job_list);
 
-	if (!read_settings(&settings, dirfd)) {
+	if (!read_settings(settings, dirfd)) {
 		fprintf(stderr, "resultgen: Cannot parse settings\n");
-		return NULL;
+		return false;
 	}
 
-	if (!read_job_list(&job_list, dirfd)) {
+	if (!read_job_list(job_list, dirfd)) {
 		fprintf(stderr, "resultgen: Cannot parse job list\n");
-		return NULL;
+		free_settings(settings);
+		return false;
 	}
 
+	return true;
+}
+
+static struct json_object *create_result_root(int dirfd,
+					      struct settings *settings)
+{
+	struct json_object *obj, *elapsed;
+	int fd;
+
 	obj = json_object_new_object();
 	json_object_object_add(obj, "__type__", json_object_new_string("TestrunResult"));
 	json_object_object_add(obj, "results_version", json_object_new_int(9));
 	json_object_object_add(obj, "name",
-			       settings.name ?
-			       json_object_new_string(settings.name) :
+			       settings->name ?
+			       json_object_new_string(settings->name) :
 			       json_object_new_string(""));
 
 	if ((fd = openat(dirfd, "uname.txt", O_RDONLY)) >= 0) {
@@ -1060,8 +1082,6 @@ struct json_object *generate_results_json(int dirfd)
 	}
 	json_object_object_add(obj, "time_elapsed", elapsed);
 
-	create_result_root_nodes(obj, &results);
-
 	/*
 	 * Result fields that won't be added:
 	 *
@@ -1075,72 +1095,787 @@ struct json_object *generate_results_json(int dirfd)
 	 * - options
 	 */
 
-	for (i = 0; i < job_list.size; i++) {
+	return obj;
+}
+
+static void add_aborted_test(int dirfd, struct results *results)
+{
+	char buf[4096];
+	char piglit_name[] = "igt@runner@aborted";
+	struct subtests abortsub = {};
+	struct json_object *aborttest;
+	ssize_t s;
+	int fd;
+
+	if ((fd = openat(dirfd, "aborted.txt", O_RDONLY)) < 0)
+		return;
+
+	aborttest = get_or_create_json_object(results->tests, piglit_name);
+
+	add_subtest(&abortsub, strdup("aborted"));
+
+	s = read(fd, buf, sizeof(buf));
+	close(fd);
+
+	json_object_object_add(aborttest, "out",
+			       json_object_new_string_len(buf, s));
+	json_object_object_add(aborttest, "err",
+			       json_object_new_string(""));
+	json_object_object_add(aborttest, "dmesg",
+			       json_object_new_string(""));
+	json_object_object_add(aborttest, "result",
+			       json_object_new_string("fail"));
+
+	add_to_totals("runner", &abortsub, results);
+
+	free_subtests(&abortsub);
+}
+
+/*
+ * Streaming generation. Each test directory is parsed into its own
+ * small set of json objects and serialized, then written to the
+ * output and freed, so only the totals and runtimes are kept for the
+ * whole run.
+ *
+ * In incremental mode, the serialized tests of each directory are
+ * also stored in a cache file in that directory, stamped with the
+ * sizes and modification times of its output files. A later
+ * generation copies the cached text as is if the stamp still
+ * matches, and only parses directories that changed.
+ */
+
+#define RESULTGEN_CACHE "resultgen-cache.txt"
+#define RESULTGEN_CACHE_VERSION 1
+
+static void write_json_member(FILE *f, const char *indent,
+			      const char *key, struct json_object *val,
+			      bool *first)
+{
+	struct json_object *keyobj = json_object_new_string(key);
+
+	fprintf(f, "%s\n%s%s: %s", *first ? "" : ",", indent,
+		json_object_to_json_string(keyobj),
+		json_object_to_json_string_ext(val, JSON_C_TO_STRING_PRETTY));
+	json_object_put(keyobj);
+
+	*first = false;
+}
+
+static void merge_totals(struct json_object *totals,
+			 struct json_object *dirtotals)
+{
+	json_object_iter iter, resultiter;
+
+	json_object_object_foreachC(dirtotals, iter) {
+		struct json_object *total = get_totals_object(totals, iter.key);
+
+		json_object_object_foreachC(iter.val, resultiter) {
+			struct json_object *numobj;
+			int old = 0;
+
+			if (json_object_object_get_ex(total, resultiter.key, &numobj))
+				old = json_object_get_int(numobj);
+
+			json_object_object_add(total, resultiter.key,
+					       json_object_new_int(old + json_object_get_int(resultiter.val)));
+		}
+	}
+}
+
+static void merge_runtimes(struct json_object *runtimes,
+			   struct json_object *dirruntimes)
+{
+	json_object_iter iter;
+
+	json_object_object_foreachC(dirruntimes, iter) {
+		struct json_object *timeobj, *endobj;
+
+		if (!json_object_object_get_ex(iter.val, "time", &timeobj) ||
+		    !json_object_object_get_ex(timeobj, "end", &endobj))
+			continue;
+
+		add_runtime(get_or_create_json_object(runtimes, iter.key),
+			    json_object_get_double(endobj));
+	}
+}
+
+static bool get_output_stamp(int testdirfd, char *stamp, size_t len)
+{
+	int fds[_F_LAST];
+	struct stat statbuf;
+	size_t pos;
+	int i;
+
+	if (!open_output_files(testdirfd, fds, false))
+		return false;
+
+	pos = snprintf(stamp, len, "v%d", RESULTGEN_CACHE_VERSION);
+	for (i = 0; i < _F_LAST && pos < len; i++) {
+		if (fstat(fds[i], &statbuf)) {
+			close_outputs(fds);
+			return false;
+		}
+
+		pos += snprintf(stamp + pos, len - pos, " %lld.%09ld:%lld",
+				(long long)statbuf.st_mtim.tv_sec,
+				statbuf.st_mtim.tv_nsec,
+				(long long)statbuf.st_size);
+	}
+
+	close_outputs(fds);
+
+	return pos < len;
+}
+
+static struct json_object *parse_cached_line(char **line, char *bufend)
+{
+	char *end = memchr(*line, '\n', bufend - *line);
+	struct json_tokener *tok;
+	struct json_object *obj;
+
+	if (!end)
+		return NULL;
+
+	tok = json_tokener_new();
+	obj = json_tokener_parse_ex(tok, *line, end - *line);
+	if (json_tokener_get_error(tok) != json_tokener_success) {
+		json_object_put(obj);
+		obj = NULL;
+	}
+	json_tokener_free(tok);
+
+	*line = end + 1;
+
+	return obj;
+}
+
+/*
+ * A directory parsed by a worker, waiting to be merged into the
+ * results in job list order. For a cache hit, text points into the
+ * mapped cache file and results.tests is not used.
+ */
+struct parsed_dir
+{
+	bool done;
+	bool ok;
+	struct results results;
+	char *text;
+	size_t textlen;
+	char *map;
+	size_t maplen;
+};
+
+static void free_parsed_dir(struct parsed_dir *dir)
+{
+	free_results(&dir->results);
+
+	if (dir->map)
+		munmap(dir->map, dir->maplen);
+	else
+		free(dir->text);
+}
+
+static bool use_cached_tests(int testdirfd, const char *stamp,
+			     struct parsed_dir *dir)
+{
+	char *buf, *bufend, *line, *end;
+	struct stat statbuf;
+	int fd;
+
+	if ((fd = openat(testdirfd, RESULTGEN_CACHE, O_RDONLY)) < 0)
+		return false;
+
+	if (fstat(fd, &statbuf) || statbuf.st_size == 0) {
+		close(fd);
+		return false;
+	}
+
+	buf = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (buf == MAP_FAILED)
+		return false;
+
+	bufend = buf + statbuf.st_size;
+
+	/* Stamp, totals and runtimes lines, followed by the tests */
+	line = buf;
+	end = memchr(line, '\n', bufend - line);
+	if (!end || end - line != strlen(stamp) || memcmp(line, stamp, end - line))
+		goto fail;
+	line = end + 1;
+
+	if ((dir->results.totals = parse_cached_line(&line, bufend)) == NULL ||
+	    (dir->results.runtimes = parse_cached_line(&line, bufend)) == NULL)
+		goto fail;
+
+	dir->map = buf;
+	dir->maplen = statbuf.st_size;
+	dir->text = line;
+	dir->textlen = bufend - line;
+
+	return true;
+
+ fail:
+	json_object_put(dir->results.totals);
+	dir->results.totals = NULL;
+	munmap(buf, statbuf.st_size);
+
+	return false;
+}
+
+static void write_cached_tests(int testdirfd, const char *stamp,
+			       struct results *dirresults,
+			       const char *text, size_t textlen)
+{
+	const char *tmpname = RESULTGEN_CACHE ".tmp";
+	FILE *f;
+	bool ok;
+	int fd;
+
+	if ((fd = openat(testdirfd, tmpname, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+		return;
+
+	if ((f = fdopen(fd, "w")) == NULL) {
+		close(fd);
+		unlinkat(testdirfd, tmpname, 0);
+		return;
+	}
+
+	fprintf(f, "%s\n", stamp);
+	fprintf(f, "%s\n", json_object_to_json_string_ext(dirresults->totals,
+							  JSON_C_TO_STRING_PLAIN));
+	fprintf(f, "%s\n", json_object_to_json_string_ext(dirresults->runtimes,
+							  JSON_C_TO_STRING_PLAIN));
+	fwrite(text, 1, textlen, f);
+
+	ok = !ferror(f);
+	if (fclose(f))
+		ok = false;
+
+	if (!ok || renameat(testdirfd, tmpname, testdirfd, RESULTGEN_CACHE))
+		unlinkat(testdirfd, tmpname, 0);
+}
+
+
+static bool parse_dir(int testdirfd,
+		      struct job_list_entry *entry,
+		      struct settings *settings,
+		      bool incremental, bool serialize,
+		      struct parsed_dir *dir)
+{
+	json_object_iter iter;
+	char stamp[256];
+	bool first = true;
+	FILE *f;
+
+	if (incremental) {
+		if (!get_output_stamp(testdirfd, stamp, sizeof(stamp)))
+			incremental = false;
+		else if (use_cached_tests(testdirfd, stamp, dir))
+			return true;
+	}
+
+	init_results(&dir->results);
+
+	if (!parse_test_directory(testdirfd, entry, settings, &dir->results))
+		return false;
+
+	if (!serialize)
+		return true;
+
+	if ((f = open_memstream(&dir->text, &dir->textlen)) == NULL)
+		return false;
+
+	json_object_object_foreachC(dir->results.tests, iter)
+		write_json_member(f, "    ", iter.key, iter.val, &first);
+	fclose(f);
+
+	if (incremental)
+		write_cached_tests(testdirfd, stamp, &dir->results,
+				   dir->text, dir->textlen);
+
+	/* The text is all that's needed from now on */
+	json_object_put(dir->results.tests);
+	dir->results.tests = NULL;
+
+	return true;
+}
+
+/*
+ * Calls fn with the name of every test a directory has results for, the
+ * same names fill_from_journal() creates.
+ */
+static void for_each_test_name(int testdirfd, struct job_list_entry *entry,
+			       void (*fn)(const char *name, void *data),
+			       void *data)
+{
+	struct subtests subtests = {};
+	char piglit_name[256];
+	char *line = NULL;
+	size_t linelen = 0;
+	int fds[_F_LAST];
+	FILE *f;
+	size_t i;
+
+	if (!open_output_files(testdirfd, fds, false))
+		return;
+
+	if ((f = fdopen(dup(fds[_F_JOURNAL]), "r")) != NULL) {
+		while (getline(&line, &linelen, f) > 0) {
+			if (!strncmp(line, "exit:", strlen("exit:")) ||
+			    !strncmp(line, "timeout:", strlen("timeout:")))
+				continue;
+
+			add_subtest(&subtests, strdup(line));
+		}
+		free(line);
+		fclose(f);
+	}
+	close_outputs(fds);
+
+	if (subtests.size == 0) {
+		generate_piglit_name(entry->binary,
+				     entry->subtest_count ? entry->subtests[0] : NULL,
+				     piglit_name, sizeof(piglit_name));
+		fn(piglit_name, data);
+	}
+
+	for (i = 0; i < subtests.size; i++) {
+		generate_piglit_name(entry->binary, subtests.names[i],
+				     piglit_name, sizeof(piglit_name));
+		fn(piglit_name, data);
+	}
+
+	free_subtests(&subtests);
+}
+
+struct name_owners
+{
+	struct json_object *owners;
+	size_t dir;
+	bool *serial;
+};
+
+static void check_test_name(const char *name, void *data)
+{
+	struct name_owners *names = data;
+	struct json_object *owner;
+	size_t first;
+
+	if (!json_object_object_get_ex(names->owners, name, &owner)) {
+		json_object_object_add(names->owners, name,
+				       json_object_new_int(names->dir));
+		return;
+	}
+
+	first = json_object_get_int(owner);
+	if (first != names->dir)
+		names->serial[first] = names->serial[names->dir] = true;
+}
+
+/*
+ * Marks the directories with results for a test that another directory
+ * has results for as well. Each directory is parsed on its own into a
+ * fresh tree, which is only the same as parsing it on top of the results
+ * of the directories before it if none of its tests were seen before.
+ */
+static void find_shared_tests(int dirfd, struct job_list *job_list,
+			      size_t count, bool *serial)
+{
+	struct name_owners names = {
+		.owners = json_object_new_object(),
+		.serial = serial,
+	};
+
+	for (names.dir = 0; names.dir < count; names.dir++) {
 		char name[16];
+		int testdirfd;
 
+		snprintf(name, 16, "%zd", names.dir);
+		if ((testdirfd = openat(dirfd, name, O_DIRECTORY | O_RDONLY)) < 0)
+			continue;
+
+		for_each_test_name(testdirfd, &job_list->entries[names.dir],
+				   check_test_name, &names);
+		close(testdirfd);
+	}
+
+	json_object_put(names.owners);
+}
+
+/*
+ * Test directories are parsed by a pool of worker threads, and handed
+ * to the consumer strictly in job list order so the output does not
+ * depend on the scheduling. Workers stay at most a window of
+ * directories ahead of the consumer, keeping memory use bounded.
+ */
+struct parse_pool
+{
+	int dirfd;
+	struct settings *settings;
+	struct job_list *job_list;
+	bool incremental;
+	bool serialize;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	size_t count;
+	size_t next;
+	size_t consumed;
+	size_t window;
+	struct parsed_dir *dirs;
+	bool *serial;
+};
+
+static void *parse_worker(void *arg)
+{
+	struct parse_pool *pool = arg;
+
+	for (;;) {
+		struct parsed_dir *dir;
+		char name[16];
+		int testdirfd;
+		size_t i;
+
+		pthread_mutex_lock(&pool->mutex);
+		while (pool->next < pool->count &&
+		       pool->next >= pool->consumed + pool->window)
+			pthread_cond_wait(&pool->cond, &pool->mutex);
+
+		if (pool->next >= pool->count) {
+			pthread_mutex_unlock(&pool->mutex);
+			break;
+		}
+
+		i = pool->next++;
+		pthread_mutex_unlock(&pool->mutex);
+
+		dir = &pool->dirs[i];
 		snprintf(name, 16, "%zd", i);
-		if ((testdirfd = openat(dirfd, name, O_DIRECTORY | O_RDONLY)) < 0) {
+		if (pool->serial && pool->serial[i]) {
+			/* Left for the consumer to parse in order */
+			dir->ok = true;
+		} else if ((testdirfd = openat(pool->dirfd, name, O_DIRECTORY | O_RDONLY)) >= 0) {
+			dir->ok = parse_dir(testdirfd, &pool->job_list->entries[i],
+					    pool->settings, pool->incremental,
+					    pool->serialize, dir);
+			close(testdirfd);
+		}
+
+		pthread_mutex_lock(&pool->mutex);
+		dir->done = true;
+		pthread_cond_broadcast(&pool->cond);
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	return NULL;
+}
+
+static size_t count_result_directories(int dirfd, struct job_list *job_list)
+{
+	struct stat statbuf;
+	size_t i;
+
+	for (i = 0; i < job_list->size; i++) {
+		char name[16];
+
+		snprintf(name, 16, "%zd", i);
+		if (fstatat(dirfd, name, &statbuf, 0) || !S_ISDIR(statbuf.st_mode)) {
 			fprintf(stderr, "Warning: Cannot open result directory %s\n", name);
 			break;
 		}
+	}
 
-		if (!parse_test_directory(testdirfd, &job_list.entries[i], &settings, &results)) {
-			close(testdirfd);
-			return NULL;
+	return i;
+}
+
+/*
+ * Directories sharing a test with another directory are not parsed by
+ * the workers, but parsed in order right into the shared results, so
+ * that the results for the same test are combined as they always were.
+ */
+static bool parse_test_directories(int dirfd,
+				   struct settings *settings,
+				   struct job_list *job_list,
+				   bool incremental, bool serialize,
+				   struct results *shared,
+				   void (*consume)(struct parsed_dir *dir, void *data),
+				   void *data)
+{
+	struct parse_pool pool = {
+		.dirfd = dirfd,
+		.settings = settings,
+		.job_list = job_list,
+		.incremental = incremental,
+		.serialize = serialize,
+	};
+	pthread_t *threads;
+	long nthreads, started = 0;
+	bool status = true;
+	size_t i;
+
+	pool.count = count_result_directories(dirfd, job_list);
+	if (pool.count == 0)
+		return true;
+
+	pool.dirs = calloc(pool.count, sizeof(*pool.dirs));
+	pool.serial = calloc(pool.count, sizeof(*pool.serial));
+	find_shared_tests(dirfd, job_list, pool.count, pool.serial);
+	pthread_mutex_init(&pool.mutex, NULL);
+	pthread_cond_init(&pool.cond, NULL);
+
+	/* Compile the dmesg regex before the workers need it */
+	init_regex_whitelist(settings);
+
+	nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads < 1)
+		nthreads = 1;
+	if (nthreads > pool.count)
+		nthreads = pool.count;
+	pool.window = 4 * nthreads;
+
+	threads = calloc(nthreads, sizeof(*threads));
+	for (started = 0; started < nthreads; started++) {
+		if (pthread_create(&threads[started], NULL, parse_worker, &pool))
+			break;
+	}
+
+	if (started == 0) {
+		/* No threads to be had, parse everything right here */
+		pool.window = pool.count;
+		parse_worker(&pool);
+	}
+
+	for (i = 0; i < pool.count; i++) {
+		struct parsed_dir *dir = &pool.dirs[i];
+
+		pthread_mutex_lock(&pool.mutex);
+		while (!dir->done)
+			pthread_cond_wait(&pool.cond, &pool.mutex);
+		pthread_mutex_unlock(&pool.mutex);
+
+		if (dir->ok && pool.serial[i]) {
+			char name[16];
+			int testdirfd;
+
+			snprintf(name, 16, "%zd", i);
+			dir->ok = (testdirfd = openat(dirfd, name, O_DIRECTORY | O_RDONLY)) >= 0 &&
+				parse_test_directory(testdirfd, &job_list->entries[i],
+						     settings, shared);
+			if (testdirfd >= 0)
+				close(testdirfd);
 		}
-		close(testdirfd);
+
+		if (!dir->ok) {
+			fprintf(stderr, "resultgen: Cannot parse result directory %zd\n", i);
+			status = false;
+			break;
+		}
+
+		if (!pool.serial[i])
+			consume(dir, data);
+		free_parsed_dir(dir);
+
+		pthread_mutex_lock(&pool.mutex);
+		pool.consumed = i + 1;
+		pthread_cond_broadcast(&pool.cond);
+		pthread_mutex_unlock(&pool.mutex);
+	}
+
+	if (!status) {
+		/* Let the workers finish what they have, and stop */
+		pthread_mutex_lock(&pool.mutex);
+		pool.count = pool.next;
+		pthread_cond_broadcast(&pool.cond);
+		pthread_mutex_unlock(&pool.mutex);
 	}
 
-	if ((fd = openat(dirfd, "aborted.txt", O_RDONLY)) >= 0) {
-		char buf[4096];
-		char piglit_name[] = "igt@runner@aborted";
-		struct subtests abortsub = {};
-		struct json_object *aborttest = get_or_create_json_object(results.tests, piglit_name);
-		ssize_t s;
+	while (started > 0)
+		pthread_join(threads[--started], NULL);
+
+	if (!status)
+		for (; i < pool.count; i++)
+			free_parsed_dir(&pool.dirs[i]);
+
+	free(threads);
+	free(pool.serial);
+	free(pool.dirs);
+	pthread_cond_destroy(&pool.cond);
+	pthread_mutex_destroy(&pool.mutex);
+
+	return status;
+}
+
+/*
+ * The tests of a directory handed here are not in any other directory,
+ * see parse_test_directories(), so they are added as they are.
+ */
+static void merge_into_tree(struct parsed_dir *dir, void *data)
+{
+	struct results *results = data;
+	json_object_iter iter;
+
+	json_object_object_foreachC(dir->results.tests, iter)
+		json_object_object_add(results->tests, iter.key,
+				       json_object_get(iter.val));
 
-		add_subtest(&abortsub, strdup("aborted"));
+	merge_totals(results->totals, dir->results.totals);
+	merge_runtimes(results->runtimes, dir->results.runtimes);
+}
 
-		s = read(fd, buf, sizeof(buf));
+struct json_object *generate_results_json(int dirfd)
+{
+	struct settings settings;
+	struct job_list job_list;
+	struct json_object *obj;
+	struct results results;
 
-		json_object_object_add(aborttest, "out",
-				       json_object_new_string_len(buf, s));
-		json_object_object_add(aborttest, "err",
-				       json_object_new_string(""));
-		json_object_object_add(aborttest, "dmesg",
-				       json_object_new_string(""));
-		json_object_object_add(aborttest, "result",
-				       json_object_new_string("fail"));
+	if (!read_run_info(dirfd, &settings, &job_list))
+		return NULL;
 
-		add_to_totals("runner", &abortsub, &results);
+	obj = create_result_root(dirfd, &settings);
+	create_result_root_nodes(obj, &results);
 
-		free_subtests(&abortsub);
+	if (!parse_test_directories(dirfd, &settings, &job_list, false, false,
+				    &results, merge_into_tree, &results)) {
+		json_object_put(obj);
+		obj = NULL;
+		goto out;
 	}
 
+	add_aborted_test(dirfd, &results);
+
+ out:
 	free_settings(&settings);
 	free_job_list(&job_list);
 
 	return obj;
 }
 
-bool generate_results(int dirfd)
+struct stream_state
 {
-	struct json_object *obj = generate_results_json(dirfd);
-	const char *json_string;
-	int resultsfd;
+	FILE *out;
+	bool first;
+	struct results *results;
+};
+
+static void write_streamed(struct parsed_dir *dir, void *data)
+{
+	struct stream_state *state = data;
+
+	if (dir->textlen) {
+		if (!state->first)
+			fputc(',', state->out);
+		fwrite(dir->text, 1, dir->textlen, state->out);
+		state->first = false;
+	}
+
+	merge_totals(state->results->totals, dir->results.totals);
+	merge_runtimes(state->results->runtimes, dir->results.runtimes);
+}
 
-	if (obj == NULL)
+bool generate_results_fd(int dirfd, int outfd, bool incremental)
+{
+	struct settings settings;
+	struct job_list job_list;
+	struct json_object *root;
+	struct results results;
+	struct stream_state state;
+	json_object_iter iter;
+	bool first = true, status = true;
+	FILE *out;
+	int fd;
+
+	if (!read_run_info(dirfd, &settings, &job_list))
 		return false;
 
+	if ((fd = dup(outfd)) < 0 || (out = fdopen(fd, "w")) == NULL) {
+		fprintf(stderr, "resultgen: Cannot open results file for writing\n");
+		if (fd >= 0)
+			close(fd);
+		free_settings(&settings);
+		free_job_list(&job_list);
+		return false;
+	}
+
+	root = create_result_root(dirfd, &settings);
+	init_results(&results);
+
+	fputc('{', out);
+	json_object_object_foreachC(root, iter)
+		write_json_member(out, "  ", iter.key, iter.val, &first);
+	fputs(",\n  \"tests\": {", out);
+
+	state.out = out;
+	state.first = true;
+	state.results = &results;
+	if (!parse_test_directories(dirfd, &settings, &job_list, incremental, true,
+				    &results, write_streamed, &state)) {
+		status = false;
+		goto out;
+	}
+
+	/*
+	 * results.tests only has the tests of the directories parsed in
+	 * order, and the abort
+	 */
+	add_aborted_test(dirfd, &results);
+	json_object_object_foreachC(results.tests, iter)
+		write_json_member(out, "    ", iter.key, iter.val, &state.first);
+
+	fputs("\n  }", out);
+	write_json_member(out, "  ", "totals", results.totals, &first);
+	write_json_member(out, "  ", "runtimes", results.runtimes, &first);
+	fputs("\n}\n", out);
+
+ out:
+	if (ferror(out))
+		status = false;
+	if (fclose(out))
+		status = false;
+
+	json_object_put(root);
+	free_results(&results);
+	free_settings(&settings);
+	free_job_list(&job_list);
+
+	return status;
+}
+
+static bool write_results(int dirfd, bool incremental)
+{
+	const char *tmpname = "results.json.tmp";
+	int resultsfd;
+	bool status;
+
 	/* TODO: settings.overwrite */
-	if ((resultsfd = openat(dirfd, "results.json", O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+	if ((resultsfd = openat(dirfd, tmpname, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
 		fprintf(stderr, "resultgen: Cannot create results file\n");
 		return false;
 	}
 
-	json_string = json_object_to_json_string_ext(obj, JSON_C_TO_STRING_PRETTY);
-	write(resultsfd, json_string, strlen(json_string));
+	status = generate_results_fd(dirfd, resultsfd, incremental);
 	close(resultsfd);
-	return true;
+
+	if (status && renameat(dirfd, tmpname, dirfd, "results.json")) {
+		fprintf(stderr, "resultgen: Cannot rename results file\n");
+		status = false;
+	}
+
+	if (!status)
+		unlinkat(dirfd, tmpname, 0);
+
+	return status;
+}
+
+bool generate_results(int dirfd)
+{
+	return write_results(dirfd, false);
+}
+
+bool generate_results_incremental(int dirfd)
+{
+	return write_results(dirfd, true);
 }
 
 bool generate_results_path(char *resultspath)
@@ -6,6 +6,19 @@
 bool generate_results(int dirfd);
 bool generate_results_path(char *resultspath);
 
+/*
+ * Like generate_results(), but keeps the serialized tests of each
+ * test directory cached in that directory, and only parses the
+ * directories whose output files changed since the last generation.
+ */
+bool generate_results_incremental(int dirfd);
+
+/*
+ * Streams the results json to outfd, one test directory at a time.
+ * Used by generate_results() and generate_results_incremental().
+ */
+bool generate_results_fd(int dirfd, int outfd, bool incremental);
+
 struct json_object *generate_results_json(int dirfd);
 
 #endif
@@ -1,4 +1,5 @@
 #include <fcntl.h>
+#include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
@@ -6,18 +7,46 @@
 
 #include "resultgen.h"
 
+static const char *usage_str =
+	"usage: igt_results [options] results-path\n\n"
+	"Options:\n"
+	"  -i, --incremental     Only parse test directories whose output changed\n"
+	"                        since the last generation. Parsed tests are\n"
+	"                        cached in each test directory.\n"
+	"  -h, --help            Show this help message and exit\n";
+
 int main(int argc, char **argv)
 {
-	int dirfd;
+	static struct option long_options[] = {
+		{"incremental", no_argument, NULL, 'i'},
+		{"help", no_argument, NULL, 'h'},
+		{ 0, 0, 0, 0},
+	};
+	bool incremental = false;
+	int dirfd, c;
+
+	while ((c = getopt_long(argc, argv, "ih", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'i':
+			incremental = true;
+			break;
+		case 'h':
+			printf("%s", usage_str);
+			exit(0);
+		default:
+			fprintf(stderr, "%s", usage_str);
+			exit(1);
+		}
+	}
 
-	if (argc < 2)
+	if (optind >= argc)
 		exit(1);
 
-	dirfd = open(argv[1], O_DIRECTORY | O_RDONLY);
+	dirfd = open(argv[optind], O_DIRECTORY | O_RDONLY);
 	if (dirfd < 0)
 		exit(1);
 
-	if (generate_results(dirfd)) {
+	if (incremental ? generate_results_incremental(dirfd) : generate_results(dirfd)) {
 		printf("Results generated\n");
 		exit(0);
 	}
@@ -0,0 +1,214 @@
+/*
+ * Measures the CPU time the runner itself spends capturing the output
+ * of a test. The benchmark executes itself as a synthetic test that
+ * writes a configurable amount of output with subtest markers to
+ * stdout and stderr.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "igt_core.h"
+
+#include "settings.h"
+#include "job_list.h"
+#include "executor.h"
+
+#define CHATTY_NAME "runner_bench_chatty"
+
+static int chatty(void)
+{
+	const char *env;
+	size_t total, line_len, written = 0;
+	char *line;
+	int subtest = 0;
+
+	env = getenv("RUNNER_BENCH_BYTES");
+	total = env ? strtoull(env, NULL, 0) : 0;
+	env = getenv("RUNNER_BENCH_LINE");
+	line_len = env ? strtoull(env, NULL, 0) : 80;
+
+	line = malloc(line_len + 1);
+	memset(line, 'x', line_len);
+	line[line_len - 1] = '\n';
+	line[line_len] = '\0';
+
+	while (written < total) {
+		printf("Starting subtest: subtest-%d\n", subtest);
+
+		/* Mostly stdout with some stderr, like --debug output */
+		for (; written < total && written < (subtest + 1) * (total / 16 + 1);
+		     written += line_len) {
+			if (written % (8 * line_len))
+				fputs(line, stdout);
+			else
+				fputs(line, stderr);
+		}
+
+		printf("Subtest subtest-%d: SUCCESS (0.000s)\n", subtest);
+		subtest++;
+	}
+
+	free(line);
+
+	return 0;
+}
+
+static void clear_directory(const char *name)
+{
+	DIR *d;
+	struct dirent *dirent;
+	int dirfd;
+
+	if ((dirfd = open(name, O_DIRECTORY | O_RDONLY)) < 0)
+		return;
+
+	d = fdopendir(dirfd);
+	while ((dirent = readdir(d)) != NULL) {
+		char path[PATH_MAX];
+
+		if (!strcmp(dirent->d_name, ".") || !strcmp(dirent->d_name, ".."))
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", name, dirent->d_name);
+		if (dirent->d_type == DT_DIR)
+			clear_directory(path);
+		else
+			unlink(path);
+	}
+
+	closedir(d);
+	rmdir(name);
+}
+
+static double tv_seconds(const struct timeval *tv)
+{
+	return tv->tv_sec + 1e-6 * tv->tv_usec;
+}
+
+int main(int argc, char **argv)
+{
+	char testroot[] = "/tmp/runner_bench_rootXXXXXX";
+	char resultsdir[] = "/tmp/runner_bench_resultsXXXXXX";
+	char path[PATH_MAX], self[PATH_MAX];
+	char testlist[PATH_MAX + 16];
+	unsigned long mib = 256, line_len = 80;
+	int reps = 3, c, i;
+	ssize_t len;
+	FILE *f;
+
+	if (!strcmp(basename(argv[0]), CHATTY_NAME))
+		return chatty();
+
+	while ((c = getopt(argc, argv, "s:l:r:")) != -1) {
+		switch (c) {
+		case 's':
+			mib = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			line_len = strtoul(optarg, NULL, 0);
+			if (line_len < 2)
+				line_len = 2;
+			break;
+		case 'r':
+			reps = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-s MiB of output] [-l line length] [-r repetitions]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+	if (len < 0 || !mkdtemp(testroot) || !mkdtemp(resultsdir)) {
+		fprintf(stderr, "Cannot set up test root: %s\n", strerror(errno));
+		return 1;
+	}
+	self[len] = '\0';
+
+	snprintf(path, sizeof(path), "%s/" CHATTY_NAME, testroot);
+	if (symlink(self, path)) {
+		fprintf(stderr, "Cannot set up test root: %s\n", strerror(errno));
+		clear_directory(testroot);
+		return 1;
+	}
+
+	snprintf(path, sizeof(path), "%s/test-list.txt", testroot);
+	f = fopen(path, "w");
+	fprintf(f, "TESTLIST\n" CHATTY_NAME "\nEND TESTLIST\n");
+	fclose(f);
+
+	snprintf(testlist, sizeof(testlist), "%s/bench.testlist", testroot);
+	f = fopen(testlist, "w");
+	fprintf(f, "igt@" CHATTY_NAME "\n");
+	fclose(f);
+
+	snprintf(path, sizeof(path), "%lu", mib << 20);
+	setenv("RUNNER_BENCH_BYTES", path, 1);
+	snprintf(path, sizeof(path), "%lu", line_len);
+	setenv("RUNNER_BENCH_LINE", path, 1);
+
+	for (i = 0; i < reps; i++) {
+		const char *runner_argv[] = { "runner",
+					      "--test-list", testlist,
+					      "--log-level", "quiet",
+					      "--overwrite",
+					      testroot,
+					      resultsdir,
+		};
+		struct settings settings;
+		struct job_list list;
+		struct execute_state state;
+		struct rusage before, after;
+		struct timespec start, end;
+		double wall, user, sys;
+
+		init_settings(&settings);
+		init_job_list(&list);
+
+		if (!parse_options(sizeof(runner_argv) / sizeof(runner_argv[0]),
+				   (char **)runner_argv, &settings) ||
+		    !create_job_list(&list, &settings) ||
+		    !initialize_execute_state(&state, &settings, &list)) {
+			fprintf(stderr, "Cannot initialize the runner\n");
+			break;
+		}
+
+		getrusage(RUSAGE_SELF, &before);
+		igt_gettime(&start);
+
+		if (!execute(&state, &settings, &list))
+			fprintf(stderr, "Execution failed\n");
+
+		igt_gettime(&end);
+		getrusage(RUSAGE_SELF, &after);
+
+		wall = igt_time_elapsed(&start, &end);
+		user = tv_seconds(&after.ru_utime) - tv_seconds(&before.ru_utime);
+		sys = tv_seconds(&after.ru_stime) - tv_seconds(&before.ru_stime);
+
+		printf("%lu MiB in %lu byte lines: %.3fs wall, %.0f MiB/s; runner CPU %.3fs user, %.3fs sys (%.1f us/MiB)\n",
+		       mib, line_len, wall, mib / wall, user, sys,
+		       1e6 * (user + sys) / mib);
+
+		free_job_list(&list);
+		free_settings(&settings);
+		clear_directory(resultsdir);
+	}
+
+	clear_directory(testroot);
+
+	return 0;
+}
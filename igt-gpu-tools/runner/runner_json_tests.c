@@ -147,6 +147,36 @@ static void run_results_and_compare(int dirfd, const char *dirname)
 	igt_assert_eq(json_object_put(referenceobj), 1);
 }
 
+static void stream_results_and_compare(int dirfd, const char *dirname)
+{
+	int testdirfd = openat(dirfd, dirname, O_RDONLY | O_DIRECTORY);
+	FILE *f = tmpfile();
+	int reference;
+	struct json_object *resultsobj, *referenceobj;
+
+	igt_assert_fd(testdirfd);
+	igt_assert(f != NULL);
+
+	igt_assert(generate_results_fd(testdirfd, fileno(f), false));
+	igt_assert_eq(lseek(fileno(f), 0, SEEK_SET), 0);
+	resultsobj = read_json(fileno(f));
+	fclose(f);
+	igt_assert(resultsobj != NULL);
+
+	reference = openat(testdirfd, "reference.json", O_RDONLY);
+	close(testdirfd);
+
+	igt_assert_fd(reference);
+	referenceobj = read_json(reference);
+	close(reference);
+	igt_assert(referenceobj != NULL);
+
+	igt_debug("Root object\n");
+	compare(resultsobj, referenceobj);
+	igt_assert_eq(json_object_put(resultsobj), 1);
+	igt_assert_eq(json_object_put(referenceobj), 1);
+}
+
 static const char *dirnames[] = {
 	"normal-run",
 	"warnings",
@@ -156,6 +186,7 @@ static const char *dirnames[] = {
 	"dmesg-results",
 	"aborted-on-boot",
 	"aborted-after-a-test",
+	"duplicate-names",
 };
 
 igt_main
@@ -169,5 +200,9 @@ igt_main
 		igt_subtest(dirnames[i]) {
 			run_results_and_compare(dirfd, dirnames[i]);
 		}
+
+		igt_subtest_f("%s-streaming", dirnames[i]) {
+			stream_results_and_compare(dirfd, dirnames[i]);
+		}
 	}
 }
@@ -1,5 +1,6 @@
 #include <dirent.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -117,7 +118,8 @@ static void clear_directory_fd(int dirfd)
 	while ((dirent = readdir(d)) != NULL) {
 		if (strcmp(dirent->d_name, ".") &&
 		    strcmp(dirent->d_name, "..")) {
-			if (dirent->d_type == DT_REG) {
+			if (dirent->d_type == DT_REG ||
+			    dirent->d_type == DT_LNK) {
 				unlinkat(dirfd, dirent->d_name, 0);
 			} else if (dirent->d_type == DT_DIR) {
 				clear_directory_fd(openat(dirfd, dirent->d_name, O_DIRECTORY | O_RDONLY));
@@ -152,6 +154,7 @@ static void assert_settings_equal(struct settings *one, struct settings *two)
 	igt_assert_eq(one->multiple_mode, two->multiple_mode);
 	igt_assert_eq(one->inactivity_timeout, two->inactivity_timeout);
 	igt_assert_eq(one->use_watchdog, two->use_watchdog);
+	igt_assert_eq(one->jobs, two->jobs);
 	igt_assert_eqstr(one->test_root, two->test_root);
 	igt_assert_eqstr(one->results_path, two->results_path);
 	igt_assert_eq(one->piglit_style_dmesg, two->piglit_style_dmesg);
@@ -221,6 +224,7 @@ igt_main
 		igt_assert_eq(settings.inactivity_timeout, 0);
 		igt_assert_eq(settings.overall_timeout, 0);
 		igt_assert(!settings.use_watchdog);
+		igt_assert_eq(settings.jobs, 0);
 		igt_assert(strstr(settings.test_root, "test-root-dir") != NULL);
 		igt_assert(strstr(settings.results_path, "path-to-results") != NULL);
 		igt_assert(!settings.piglit_style_dmesg);
@@ -467,6 +471,33 @@ igt_main
 
 	}
 
+	igt_subtest("jobs") {
+		const char *argv[] = { "runner",
+				       "--jobs", "4",
+				       "test-root-dir",
+				       "results-path",
+		};
+		const char *watchdog_argv[] = { "runner",
+						"-j", "2",
+						"--use-watchdog",
+						"test-root-dir",
+						"results-path",
+		};
+
+		igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, &settings));
+		igt_assert_eq(settings.jobs, 4);
+
+		argv[1] = "-j";
+		argv[2] = "2";
+		igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, &settings));
+		igt_assert_eq(settings.jobs, 2);
+
+		argv[2] = "0";
+		igt_assert(!parse_options(ARRAY_SIZE(argv), (char**)argv, &settings));
+
+		igt_assert(!parse_options(ARRAY_SIZE(watchdog_argv), (char**)watchdog_argv, &settings));
+	}
+
 	igt_subtest("parse-clears-old-data") {
 		const char *argv[] = { "runner",
 				       "-n", "foo",
@@ -567,6 +598,72 @@ igt_main
 	job_list_filter_test("piglit-names", "-t", "igt@successtest", 2, 1);
 	job_list_filter_test("piglit-names-subtest", "-t", "igt@successtest@first", 1, 1);
 
+	igt_subtest_group {
+		struct job_list uncached, cached;
+
+		igt_fixture {
+			init_job_list(&uncached);
+			init_job_list(&cached);
+		}
+
+		igt_subtest("job-list-subtest-cache") {
+			const char *argv[] = { "runner",
+					       "-x", "second-subtest",
+					       testdatadir,
+					       "path-to-results",
+			};
+			char cache[4096], *entry;
+			int dirfd, fd;
+			ssize_t len;
+			size_t i;
+
+			igt_assert((dirfd = open(testdatadir, O_DIRECTORY | O_RDONLY)) >= 0);
+			unlinkat(dirfd, "subtest-cache.txt", 0);
+
+			igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, &settings));
+			igt_assert(create_job_list(&uncached, &settings));
+
+			igt_assert_f(faccessat(dirfd, "subtest-cache.txt", F_OK, 0) == 0,
+				     "Job list creation didn't cache subtests\n");
+
+			igt_assert(create_job_list(&cached, &settings));
+			assert_job_list_equal(&uncached, &cached);
+
+			/* A listing changed in the cache shows up in the job list */
+			igt_assert((fd = openat(dirfd, "subtest-cache.txt", O_RDWR)) >= 0);
+			igt_assert((len = read(fd, cache, sizeof(cache) - 1)) > 0);
+			cache[len] = '\0';
+			igt_assert((entry = strstr(cache, "\tfirst-subtest")) != NULL);
+			memcpy(entry + 1, "other", strlen("other"));
+			igt_assert_eq(pwrite(fd, cache, len, 0), len);
+			close(fd);
+
+			free_job_list(&cached);
+			igt_assert(create_job_list(&cached, &settings));
+			igt_assert_eq(cached.size, uncached.size);
+			for (i = 0; i < cached.size; i++) {
+				if (cached.entries[i].subtest_count &&
+				    !strcmp(cached.entries[i].subtests[0], "other-subtest"))
+					break;
+			}
+			igt_assert_f(i < cached.size,
+				     "Job list creation didn't use the cache\n");
+
+			/* and is listed again once the binary changes */
+			igt_assert(utimensat(dirfd, "successtest", NULL, 0) == 0);
+			free_job_list(&cached);
+			igt_assert(create_job_list(&cached, &settings));
+			assert_job_list_equal(&uncached, &cached);
+
+			close(dirfd);
+		}
+
+		igt_fixture {
+			free_job_list(&uncached);
+			free_job_list(&cached);
+		}
+	}
+
 	igt_subtest_group {
 		char filename[] = "tmplistXXXXXX";
 		char testlisttext[] = "igt@successtest@first-subtest\n"
@@ -1101,6 +1198,329 @@ igt_main
 		}
 	}
 
+	igt_subtest_group {
+		struct job_list list;
+		int dirfd = -1, subdirfd = -1;
+		char dirname[] = "tmpdirXXXXXX";
+
+		igt_fixture {
+			init_job_list(&list);
+			igt_require(mkdtemp(dirname) != NULL);
+			rmdir(dirname);
+		}
+
+		igt_subtest("execute-subtests-concurrent") {
+			struct execute_state state;
+			const char *argv[] = { "runner",
+					       "--jobs", "2",
+					       "-t", "-subtest",
+					       testdatadir,
+					       dirname,
+			};
+			char testdirname[16];
+			char *dump;
+			size_t expected_tests = 3;
+			size_t i;
+
+			igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, &settings));
+			igt_assert(create_job_list(&list, &settings));
+			igt_assert(initialize_execute_state(&state, &settings, &list));
+
+			igt_assert(execute(&state, &settings, &list));
+			igt_assert_f((dirfd = open(dirname, O_DIRECTORY | O_RDONLY)) >= 0,
+				     "Execute didn't create the results directory\n");
+
+			for (i = 0; i < expected_tests; i++) {
+				snprintf(testdirname, 16, "%zd", i);
+
+				igt_assert_f((subdirfd = openat(dirfd, testdirname, O_DIRECTORY | O_RDONLY)) >= 0,
+					     "Execute didn't create result directory '%s'\n", testdirname);
+				assert_execution_results_exist(subdirfd);
+
+				dump = dump_file(subdirfd, "journal.txt");
+				igt_assert_f(dump != NULL && strstr(dump, "exit:") != NULL,
+					     "Test in '%s' didn't complete\n", testdirname);
+				free(dump);
+				close(subdirfd);
+				subdirfd = -1;
+			}
+
+			snprintf(testdirname, 16, "%zd", expected_tests);
+			igt_assert_f((subdirfd = openat(dirfd, testdirname, O_DIRECTORY | O_RDONLY)) < 0,
+				     "Execute created too many directories\n");
+		}
+
+		igt_fixture {
+			close(subdirfd);
+			close(dirfd);
+			clear_directory(dirname);
+			free_job_list(&list);
+		}
+	}
+
+	igt_subtest_group {
+		struct job_list list;
+		int dirfd = -1, subdirfd = -1, rootfd = -1;
+		char dirname[] = "tmpdirXXXXXX";
+		char rootname[] = "tmprootXXXXXX";
+
+		igt_fixture {
+			const char *files[] = { "test-list.txt", "successtest",
+						"no-subtests", "skippers" };
+			char *testroot, target[PATH_MAX];
+			int fd;
+			size_t i;
+
+			init_job_list(&list);
+			igt_require(mkdtemp(dirname) != NULL);
+			rmdir(dirname);
+
+			/* A test root like testdatadir, with successtest exclusive */
+			igt_require(mkdtemp(rootname) != NULL);
+			igt_assert((rootfd = open(rootname, O_DIRECTORY | O_RDONLY)) >= 0);
+			igt_assert((testroot = realpath(testdatadir, NULL)) != NULL);
+			for (i = 0; i < ARRAY_SIZE(files); i++) {
+				snprintf(target, sizeof(target), "%s/%s", testroot, files[i]);
+				igt_assert_eq(symlinkat(target, rootfd, files[i]), 0);
+			}
+			free(testroot);
+
+			igt_assert((fd = openat(rootfd, "exclusive-list.txt",
+						O_CREAT | O_WRONLY | O_EXCL, 0660)) >= 0);
+			igt_assert_eq(write(fd, "successtest\n", 12), 12);
+			close(fd);
+		}
+
+		igt_subtest("execute-exclusive-concurrent") {
+			struct execute_state state;
+			const char *argv[] = { "runner",
+					       "--jobs", "2",
+					       "-t", "-subtest",
+					       rootname,
+					       dirname,
+			};
+			struct timespec start[3], end[3];
+			char testdirname[16];
+			struct stat st;
+			size_t i, k;
+
+			igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, &settings));
+			igt_assert(create_job_list(&list, &settings));
+			igt_assert_eq(list.size, 3);
+			igt_assert(initialize_execute_state(&state, &settings, &list));
+
+			igt_assert(execute(&state, &settings, &list));
+			igt_assert_f((dirfd = open(dirname, O_DIRECTORY | O_RDONLY)) >= 0,
+				     "Execute didn't create the results directory\n");
+
+			/*
+			 * The result directory is last modified when
+			 * the job creates its output files, the
+			 * journal when the job finishes.
+			 */
+			for (i = 0; i < list.size; i++) {
+				snprintf(testdirname, 16, "%zd", i);
+				igt_assert((subdirfd = openat(dirfd, testdirname, O_DIRECTORY | O_RDONLY)) >= 0);
+				igt_assert_eq(fstat(subdirfd, &st), 0);
+				start[i] = st.st_mtim;
+				igt_assert_eq(fstatat(subdirfd, "journal.txt", &st, 0), 0);
+				end[i] = st.st_mtim;
+				close(subdirfd);
+				subdirfd = -1;
+			}
+
+			for (i = 0; i < list.size; i++) {
+				if (strcmp(list.entries[i].binary, "successtest"))
+					continue;
+
+				for (k = 0; k < list.size; k++) {
+					if (k == i)
+						continue;
+
+					igt_assert_f(igt_time_elapsed(&end[k], &start[i]) >= 0 ||
+						     igt_time_elapsed(&end[i], &start[k]) >= 0,
+						     "Job %zd ran alongside the exclusive job %zd\n",
+						     k, i);
+				}
+			}
+		}
+
+		igt_fixture {
+			close(subdirfd);
+			close(dirfd);
+			close(rootfd);
+			clear_directory(dirname);
+			clear_directory(rootname);
+			free_job_list(&list);
+		}
+	}
+
+	igt_subtest_group {
+		struct job_list list;
+		int dirfd = -1, subdirfd = -1, fd = -1;
+		char dirname[] = "tmpdirXXXXXX";
+
+		igt_fixture {
+			init_job_list(&list);
+			igt_require(mkdtemp(dirname) != NULL);
+		}
+
+		igt_subtest("execute-resume-concurrent") {
+			struct execute_state state;
+			const char *argv[] = { "runner",
+					       "--jobs", "2",
+					       "-t", "-subtest",
+					       testdatadir,
+					       dirname,
+			};
+			char journaltext[] = "second-subtest\nexit:0 (0.000s)\n";
+			char testdirname[16];
+			char *dump;
+			size_t i;
+
+			igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, &settings));
+			igt_assert(create_job_list(&list, &settings));
+			igt_assert_eq(list.size, 3);
+			igt_assert_eqstr(list.entries[1].binary, "successtest");
+			igt_assert_eqstr(list.entries[1].subtests[0], "second-subtest");
+
+			igt_assert(serialize_settings(&settings));
+			igt_assert(serialize_job_list(&list, &settings));
+
+			/* The second entry completed, the others never started */
+			igt_assert((dirfd = open(dirname, O_DIRECTORY | O_RDONLY)) >= 0);
+			igt_assert_eq(mkdirat(dirfd, "1", 0770), 0);
+			igt_assert((subdirfd = openat(dirfd, "1", O_DIRECTORY | O_RDONLY)) >= 0);
+			igt_assert((fd = openat(subdirfd, "journal.txt", O_CREAT | O_WRONLY | O_EXCL, 0660)) >= 0);
+			igt_assert_eq(write(fd, journaltext, strlen(journaltext)), strlen(journaltext));
+			close(fd);
+			fd = -1;
+
+			free_job_list(&list);
+			free_settings(&settings);
+			igt_assert(initialize_execute_state_from_resume(dup(dirfd), &state, &settings, &list));
+			igt_assert_eq(state.next, 0);
+
+			igt_assert(execute(&state, &settings, &list));
+
+			dump = dump_file(subdirfd, "journal.txt");
+			igt_assert_eqstr(dump, journaltext);
+			free(dump);
+			igt_assert_f(faccessat(subdirfd, "out.txt", F_OK, 0) != 0,
+				     "Completed entry was executed again\n");
+			close(subdirfd);
+			subdirfd = -1;
+
+			for (i = 0; i < 3; i += 2) {
+				snprintf(testdirname, 16, "%zd", i);
+				igt_assert_f((subdirfd = openat(dirfd, testdirname, O_DIRECTORY | O_RDONLY)) >= 0,
+					     "Execute didn't create result directory '%s'\n", testdirname);
+				dump = dump_file(subdirfd, "journal.txt");
+				igt_assert_f(dump != NULL && strstr(dump, "exit:") != NULL,
+					     "Test in '%s' didn't complete\n", testdirname);
+				free(dump);
+				close(subdirfd);
+				subdirfd = -1;
+			}
+		}
+
+		igt_fixture {
+			close(fd);
+			close(subdirfd);
+			close(dirfd);
+			clear_directory(dirname);
+			free_job_list(&list);
+		}
+	}
+
+	igt_subtest_group {
+		struct job_list list;
+		int dirfd = -1, subdirfd = -1;
+		char dirname[] = "tmpdirXXXXXX";
+
+		igt_fixture {
+			init_job_list(&list);
+			igt_require(mkdtemp(dirname) != NULL);
+			rmdir(dirname);
+		}
+
+		igt_subtest("execute-dmesg-concurrent") {
+			struct execute_state state;
+			const char *argv[] = { "runner",
+					       "--jobs", "2",
+					       "-t", "-subtest",
+					       testdatadir,
+					       dirname,
+			};
+			char testdirname[16];
+			char *line = NULL;
+			size_t linelen = 0;
+			size_t i;
+
+			/* Tests log to the kernel only when they can */
+			igt_require(access("/dev/kmsg", W_OK) == 0);
+
+			igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, &settings));
+			igt_assert(create_job_list(&list, &settings));
+			igt_assert(initialize_execute_state(&state, &settings, &list));
+
+			igt_assert(execute(&state, &settings, &list));
+			igt_assert((dirfd = open(dirname, O_DIRECTORY | O_RDONLY)) >= 0);
+
+			for (i = 0; i < list.size; i++) {
+				struct job_list_entry *entry = &list.entries[i];
+				const char *subtest_start = ": starting subtest ";
+				size_t own = 0;
+				FILE *f;
+				int fd;
+
+				snprintf(testdirname, 16, "%zd", i);
+				igt_assert((subdirfd = openat(dirfd, testdirname, O_DIRECTORY | O_RDONLY)) >= 0);
+				igt_assert((fd = openat(subdirfd, "dmesg.txt", O_RDONLY)) >= 0);
+				igt_assert((f = fdopen(fd, "r")) != NULL);
+
+				while (getline(&line, &linelen, f) >= 0) {
+					char *name = strstr(line, "[IGT] ");
+					char *subtest;
+
+					if (!name)
+						continue;
+
+					name += strlen("[IGT] ");
+					igt_assert_f(!strncmp(name, entry->binary, strlen(entry->binary)) &&
+						     name[strlen(entry->binary)] == ':',
+						     "Job %zd running %s got '%s'", i, entry->binary, line);
+
+					subtest = strstr(name, subtest_start);
+					if (subtest && entry->subtest_count) {
+						subtest += strlen(subtest_start);
+						igt_assert_f(!strncmp(subtest, entry->subtests[0],
+								      strlen(entry->subtests[0])),
+							     "Job %zd running %s got '%s'",
+							     i, entry->subtests[0], line);
+					}
+
+					own++;
+				}
+
+				fclose(f);
+				close(subdirfd);
+				subdirfd = -1;
+
+				igt_assert_f(own > 0, "Job %zd got none of its own kernel messages\n", i);
+			}
+
+			free(line);
+		}
+
+		igt_fixture {
+			close(subdirfd);
+			close(dirfd);
+			clear_directory(dirname);
+			free_job_list(&list);
+		}
+	}
+
 	igt_subtest("file-descriptor-leakage") {
 		int i;
 
@@ -1,4 +1,5 @@
 #include "settings.h"
+#include "matcher.h"
 
 #include <errno.h>
 #include <fcntl.h>
@@ -29,6 +30,7 @@ enum {
 	OPT_MULTIPLE = 'm',
 	OPT_TIMEOUT = 'c',
 	OPT_WATCHDOG = 'g',
+	OPT_JOBS = 'j',
 };
 
 static struct {
@@ -159,6 +161,12 @@ static const char *usage_str =
 	"  --use-watchdog        Use hardware watchdog for lethal enforcement of the\n"
 	"                        above timeout. Killing the test process is still\n"
 	"                        attempted at timeout trigger.\n"
+	"  -j <count>, --jobs <count>\n"
+	"                        Execute up to <count> test binaries concurrently. Each\n"
+	"                        execution still gets its own result directory and\n"
+	"                        journal. Binaries listed in exclusive-list.txt in the\n"
+	"                        test root are hardware-exclusive and are executed\n"
+	"                        alone. Cannot be combined with --use-watchdog\n"
 	"  --piglit-style-dmesg  Filter dmesg like piglit does. Piglit considers matches\n"
 	"                        against a short filter list to mean the test result\n"
 	"                        should be changed to dmesg-warn/dmesg-fail. Without\n"
@@ -167,7 +175,9 @@ static const char *usage_str =
 	"                        change.\n"
 	"  [test_root]           Directory that contains the IGT tests. The environment\n"
 	"                        variable IGT_TEST_ROOT will be used if set, overriding\n"
-	"                        this option if given.\n"
+	"                        this option if given. Subtest listings of the test\n"
+	"                        binaries are cached in subtest-cache.txt in this\n"
+	"                        directory when it is writable.\n"
 	;
 
 static void usage(const char *extra_message, FILE *f)
@@ -208,6 +218,10 @@ static bool add_regex(struct regex_list *list, char *new)
 	list->regex_strings[list->size] = new;
 	list->size++;
 
+	/* Rebuilt with the new pattern on next use */
+	matcher_free(list->matcher);
+	list->matcher = NULL;
+
 	return true;
 }
 
@@ -222,6 +236,7 @@ static void free_regexes(struct regex_list *regexes)
 	}
 	free(regexes->regex_strings);
 	free(regexes->regexes);
+	matcher_free(regexes->matcher);
 }
 
 static bool readable_file(char *filename)
@@ -269,6 +284,7 @@ bool parse_options(int argc, char **argv,
 		{"inactivity-timeout", required_argument, NULL, OPT_TIMEOUT},
 		{"overall-timeout", required_argument, NULL, OPT_OVERALL_TIMEOUT},
 		{"use-watchdog", no_argument, NULL, OPT_WATCHDOG},
+		{"jobs", required_argument, NULL, OPT_JOBS},
 		{"piglit-style-dmesg", no_argument, NULL, OPT_PIGLIT_DMESG},
 		{ 0, 0, 0, 0},
 	};
@@ -277,7 +293,7 @@ bool parse_options(int argc, char **argv,
 
 	optind = 1;
 
-	while ((c = getopt_long(argc, argv, "hn:dt:x:sl:om", long_options, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "hn:dt:x:sl:omj:", long_options, NULL)) != -1) {
 		switch (c) {
 		case OPT_HELP:
 			usage(NULL, stdout);
@@ -330,6 +346,13 @@ bool parse_options(int argc, char **argv,
 		case OPT_WATCHDOG:
 			settings->use_watchdog = true;
 			break;
+		case OPT_JOBS:
+			settings->jobs = atoi(optarg);
+			if (settings->jobs <= 0) {
+				usage("Job count must be a positive number", stderr);
+				goto error;
+			}
+			break;
 		case OPT_PIGLIT_DMESG:
 			settings->piglit_style_dmesg = true;
 			break;
@@ -342,6 +365,11 @@ bool parse_options(int argc, char **argv,
 		}
 	}
 
+	if (settings->jobs > 1 && settings->use_watchdog) {
+		usage("Hardware watchdog cannot be used with concurrent jobs", stderr);
+		goto error;
+	}
+
 	switch (argc - optind) {
 	case 2:
 		settings->test_root = absolute_path(argv[optind]);
@@ -524,6 +552,7 @@ bool serialize_settings(struct settings *settings)
 	SERIALIZE_LINE(f, settings, inactivity_timeout, "%d");
 	SERIALIZE_LINE(f, settings, overall_timeout, "%d");
 	SERIALIZE_LINE(f, settings, use_watchdog, "%d");
+	SERIALIZE_LINE(f, settings, jobs, "%d");
 	SERIALIZE_LINE(f, settings, piglit_style_dmesg, "%d");
 	SERIALIZE_LINE(f, settings, test_root, "%s");
 	SERIALIZE_LINE(f, settings, results_path, "%s");
@@ -579,6 +608,7 @@ bool read_settings(struct settings *settings, int dirfd)
 		PARSE_LINE(settings, name, val, inactivity_timeout, numval);
 		PARSE_LINE(settings, name, val, overall_timeout, numval);
 		PARSE_LINE(settings, name, val, use_watchdog, numval);
+		PARSE_LINE(settings, name, val, jobs, numval);
 		PARSE_LINE(settings, name, val, piglit_style_dmesg, numval);
 		PARSE_LINE(settings, name, val, test_root, val ? strdup(val) : NULL);
 		PARSE_LINE(settings, name, val, results_path, val ? strdup(val) : NULL);
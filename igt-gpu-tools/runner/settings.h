@@ -18,10 +18,14 @@ enum {
 
 _Static_assert(ABORT_ALL == (ABORT_TAINT | ABORT_LOCKDEP), "ABORT_ALL must be all conditions bitwise or'd");
 
+struct matcher;
+
 struct regex_list {
 	char **regex_strings;
 	regex_t** regexes;
 	size_t size;
+	/* All of the above combined, built on first use */
+	struct matcher *matcher;
 };
 
 struct settings {
@@ -38,6 +42,7 @@ struct settings {
 	int inactivity_timeout;
 	int overall_timeout;
 	bool use_watchdog;
+	int jobs;
 	char *test_root;
 	char *results_path;
 	bool piglit_style_dmesg;
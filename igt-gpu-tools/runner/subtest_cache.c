@@ -0,0 +1,531 @@
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "igt_core.h"
+#include "subtest_cache.h"
+
+static const char cache_filename[] = "subtest-cache.txt";
+
+struct cache_key {
+	char *path;
+	long long mtime_sec;
+	long mtime_nsec;
+	long long size;
+	char *build_id;
+};
+
+struct cache_entry {
+	struct cache_key key;
+	struct subtest_list list;
+};
+
+struct cache {
+	struct cache_entry *entries;
+	size_t size;
+};
+
+#define NOTE_ALIGN(x) (((x) + 3) & ~(size_t)3)
+
+/*
+ * Returns the GNU build-id of an ELF binary as a hex string, or
+ * "none" if the file is not a 64-bit ELF or carries no build-id.
+ */
+static char *read_build_id(const char *path)
+{
+	const unsigned char *map;
+	const Elf64_Ehdr *ehdr;
+	struct stat st;
+	char *id = NULL;
+	size_t i, k;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+		return strdup("none");
+
+	if (fstat(fd, &st) || st.st_size < sizeof(*ehdr)) {
+		close(fd);
+		return strdup("none");
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return strdup("none");
+
+	ehdr = (const Elf64_Ehdr *)map;
+	if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) ||
+	    ehdr->e_ident[EI_CLASS] != ELFCLASS64 ||
+	    ehdr->e_phentsize < sizeof(Elf64_Phdr) ||
+	    ehdr->e_phoff + (size_t)ehdr->e_phnum * ehdr->e_phentsize > st.st_size)
+		goto out;
+
+	for (i = 0; i < ehdr->e_phnum && !id; i++) {
+		const Elf64_Phdr *phdr = (const Elf64_Phdr *)(map + ehdr->e_phoff +
+							      i * ehdr->e_phentsize);
+		size_t off = phdr->p_offset;
+		size_t end = off + phdr->p_filesz;
+
+		if (phdr->p_type != PT_NOTE || end > st.st_size || end < off)
+			continue;
+
+		while (off + sizeof(Elf64_Nhdr) <= end) {
+			const Elf64_Nhdr *nhdr = (const Elf64_Nhdr *)(map + off);
+			size_t name = off + sizeof(*nhdr);
+			size_t desc = name + NOTE_ALIGN(nhdr->n_namesz);
+
+			off = desc + NOTE_ALIGN(nhdr->n_descsz);
+			if (off > end)
+				break;
+
+			if (nhdr->n_type != NT_GNU_BUILD_ID ||
+			    nhdr->n_namesz != sizeof("GNU") ||
+			    memcmp(map + name, "GNU", sizeof("GNU")))
+				continue;
+
+			id = malloc(2 * nhdr->n_descsz + 1);
+			for (k = 0; k < nhdr->n_descsz; k++)
+				sprintf(id + 2 * k, "%02x", map[desc + k]);
+			id[2 * k] = '\0';
+			break;
+		}
+	}
+
+ out:
+	munmap((void *)map, st.st_size);
+
+	return id ?: strdup("none");
+}
+
+static bool init_cache_key(struct cache_key *key, const char *path)
+{
+	struct stat st;
+
+	memset(key, 0, sizeof(*key));
+
+	if (stat(path, &st))
+		return false;
+
+	key->path = strdup(path);
+	key->mtime_sec = st.st_mtim.tv_sec;
+	key->mtime_nsec = st.st_mtim.tv_nsec;
+	key->size = st.st_size;
+	key->build_id = read_build_id(path);
+
+	return true;
+}
+
+static void free_cache_key(struct cache_key *key)
+{
+	free(key->path);
+	free(key->build_id);
+}
+
+static bool cache_key_equal(const struct cache_key *one,
+			    const struct cache_key *two)
+{
+	return !strcmp(one->path, two->path) &&
+		one->mtime_sec == two->mtime_sec &&
+		one->mtime_nsec == two->mtime_nsec &&
+		one->size == two->size &&
+		!strcmp(one->build_id, two->build_id);
+}
+
+static void copy_subtest_list(struct subtest_list *dst,
+			      const struct subtest_list *src)
+{
+	size_t i;
+
+	dst->status = src->status;
+	dst->size = src->size;
+	dst->names = src->size ? malloc(src->size * sizeof(*dst->names)) : NULL;
+	for (i = 0; i < src->size; i++)
+		dst->names[i] = strdup(src->names[i]);
+}
+
+static void free_subtest_list(struct subtest_list *list)
+{
+	size_t i;
+
+	for (i = 0; i < list->size; i++)
+		free(list->names[i]);
+	free(list->names);
+	memset(list, 0, sizeof(*list));
+}
+
+static void free_cache(struct cache *cache)
+{
+	size_t i;
+
+	for (i = 0; i < cache->size; i++) {
+		free_cache_key(&cache->entries[i].key);
+		free_subtest_list(&cache->entries[i].list);
+	}
+	free(cache->entries);
+	memset(cache, 0, sizeof(*cache));
+}
+
+static void add_cache_entry(struct cache *cache,
+			    struct cache_key *key,
+			    struct subtest_list *list)
+{
+	struct cache_entry *entry;
+
+	cache->size++;
+	cache->entries = realloc(cache->entries, cache->size * sizeof(*cache->entries));
+	entry = &cache->entries[cache->size - 1];
+
+	entry->key = *key;
+	entry->list = *list;
+}
+
+static bool parse_number(const char *str, long long *value)
+{
+	char *end;
+
+	if (!str || !*str)
+		return false;
+
+	errno = 0;
+	*value = strtoll(str, &end, 10);
+
+	return !*end && !errno;
+}
+
+static bool parse_cache_line(char *line, struct cache_key *key,
+			     struct subtest_list *list)
+{
+	char *fields[7], *name;
+	long long nsec, status, count;
+	size_t i;
+
+	memset(key, 0, sizeof(*key));
+	memset(list, 0, sizeof(*list));
+
+	line[strcspn(line, "\n")] = '\0';
+
+	for (i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+		if (!(fields[i] = strsep(&line, "\t")))
+			return false;
+	}
+
+	if (!*fields[0] || !*fields[4] ||
+	    !parse_number(fields[1], &key->mtime_sec) ||
+	    !parse_number(fields[2], &nsec) ||
+	    !parse_number(fields[3], &key->size) ||
+	    !parse_number(fields[5], &status) ||
+	    !parse_number(fields[6], &count) || count < 0)
+		return false;
+
+	key->mtime_nsec = nsec;
+	list->status = status;
+	list->names = count ? calloc(count, sizeof(*list->names)) : NULL;
+
+	for (i = 0; i < count; i++) {
+		if (!(name = strsep(&line, "\t")) || !*name)
+			break;
+		list->names[list->size++] = strdup(name);
+	}
+
+	if (i < count || line) {
+		free_subtest_list(list);
+		return false;
+	}
+
+	key->path = strdup(fields[0]);
+	key->build_id = strdup(fields[4]);
+
+	return true;
+}
+
+/*
+ * Each line of the cache file is the tab separated
+ *
+ *   path mtime_sec mtime_nsec size build-id status count subtest...
+ *
+ * Lines that don't parse are ignored.
+ */
+static void read_cache(struct cache *cache, int testdirfd)
+{
+	struct cache_key key;
+	struct subtest_list list;
+	char *line = NULL;
+	size_t linelen = 0;
+	FILE *f;
+	int fd;
+
+	memset(cache, 0, sizeof(*cache));
+
+	if ((fd = openat(testdirfd, cache_filename, O_RDONLY | O_CLOEXEC)) < 0)
+		return;
+
+	f = fdopen(fd, "r");
+	if (!f) {
+		close(fd);
+		return;
+	}
+
+	while (getline(&line, &linelen, f) >= 0) {
+		if (parse_cache_line(line, &key, &list))
+			add_cache_entry(cache, &key, &list);
+	}
+
+	free(line);
+	fclose(f);
+}
+
+/* Tabs and newlines would break up the line, don't cache such entries */
+static bool cacheable(const struct cache_entry *entry)
+{
+	size_t i;
+
+	if (strpbrk(entry->key.path, "\t\n"))
+		return false;
+
+	for (i = 0; i < entry->list.size; i++) {
+		if (!*entry->list.names[i] ||
+		    strpbrk(entry->list.names[i], "\t\n"))
+			return false;
+	}
+
+	return true;
+}
+
+static void write_cache(struct cache *cache, int testdirfd)
+{
+	char tmpname[64];
+	size_t i, k;
+	FILE *f;
+	int fd;
+
+	snprintf(tmpname, sizeof(tmpname), "%s.%d", cache_filename, (int)getpid());
+
+	if ((fd = openat(testdirfd, tmpname, O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0666)) < 0)
+		return;
+
+	f = fdopen(fd, "w");
+	if (!f) {
+		close(fd);
+		unlinkat(testdirfd, tmpname, 0);
+		return;
+	}
+
+	for (i = 0; i < cache->size; i++) {
+		struct cache_entry *entry = &cache->entries[i];
+
+		if (!cacheable(entry))
+			continue;
+
+		fprintf(f, "%s\t%lld\t%ld\t%lld\t%s\t%d\t%zu",
+			entry->key.path,
+			entry->key.mtime_sec, entry->key.mtime_nsec,
+			entry->key.size, entry->key.build_id,
+			entry->list.status, entry->list.size);
+		for (k = 0; k < entry->list.size; k++)
+			fprintf(f, "\t%s", entry->list.names[k]);
+		fprintf(f, "\n");
+	}
+
+	if (fclose(f) || renameat(testdirfd, tmpname, testdirfd, cache_filename))
+		unlinkat(testdirfd, tmpname, 0);
+}
+
+static FILE *start_listing(const char *binary)
+{
+	const char *path = binary;
+	char cmd[256] = {};
+	size_t s = 0;
+	FILE *p;
+
+	/* Single quote the path, so that the shell passes it on verbatim */
+	cmd[s++] = '\'';
+	for (; *path && s < sizeof(cmd) - 5; path++) {
+		if (*path == '\'') {
+			memcpy(cmd + s, "'\\''", 4);
+			s += 4;
+		} else {
+			cmd[s++] = *path;
+		}
+	}
+
+	if (*path ||
+	    snprintf(cmd + s, sizeof(cmd) - s, "' --list-subtests") >= sizeof(cmd) - s) {
+		fprintf(stderr, "Path to binary too long, ignoring: %s\n", binary);
+		return NULL;
+	}
+
+	p = popen(cmd, "r");
+	if (!p) {
+		fprintf(stderr, "popen failed when executing %s: %s\n",
+			cmd,
+			strerror(errno));
+	}
+
+	return p;
+}
+
+static void finish_listing(FILE *p, const char *binary,
+			   struct subtest_list *list)
+{
+	char *line = NULL;
+	size_t linelen = 0;
+	ssize_t len;
+	int s;
+
+	memset(list, 0, sizeof(*list));
+	list->status = SUBTESTS_FAILED;
+
+	if (!p)
+		return;
+
+	/* One subtest name per line */
+	while ((len = getline(&line, &linelen, p)) >= 0) {
+		if (len && line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (!len)
+			continue;
+
+		list->size++;
+		list->names = realloc(list->names, list->size * sizeof(*list->names));
+		list->names[list->size - 1] = strdup(line);
+	}
+	free(line);
+
+	s = pclose(p);
+	if (s == 0) {
+		list->status = SUBTESTS_LISTED;
+	} else if (s == -1) {
+		fprintf(stderr, "popen error when executing %s: %s\n", binary, strerror(errno));
+	} else if (WIFEXITED(s)) {
+		if (WEXITSTATUS(s) == IGT_EXIT_INVALID)
+			list->status = SUBTESTS_NONE;
+	} else {
+		fprintf(stderr, "Test binary %s died unexpectedly\n", binary);
+	}
+}
+
+void list_subtests(struct settings *settings,
+		   char **binaries, size_t num_binaries,
+		   struct subtest_list *lists)
+{
+	struct cache cache, newcache = {};
+	struct cache_key *keys;
+	FILE **pipes;
+	size_t *misses;
+	size_t num_misses = 0, started = 0;
+	size_t i, k;
+	long window;
+	int testdirfd;
+
+	if ((testdirfd = open(settings->test_root, O_DIRECTORY | O_RDONLY | O_CLOEXEC)) < 0) {
+		fprintf(stderr, "Test directory %s cannot be opened\n", settings->test_root);
+		for (i = 0; i < num_binaries; i++) {
+			memset(&lists[i], 0, sizeof(lists[i]));
+			lists[i].status = SUBTESTS_FAILED;
+		}
+		return;
+	}
+
+	read_cache(&cache, testdirfd);
+
+	keys = calloc(num_binaries, sizeof(*keys));
+	misses = calloc(num_binaries, sizeof(*misses));
+	pipes = calloc(num_binaries, sizeof(*pipes));
+
+	for (i = 0; i < num_binaries; i++) {
+		char *path;
+
+		memset(&lists[i], 0, sizeof(lists[i]));
+		lists[i].status = SUBTESTS_FAILED;
+
+		asprintf(&path, "%s/%s", settings->test_root, binaries[i]);
+		init_cache_key(&keys[i], path);
+		free(path);
+
+		for (k = 0; keys[i].path && k < cache.size; k++) {
+			if (cache_key_equal(&keys[i], &cache.entries[k].key)) {
+				copy_subtest_list(&lists[i], &cache.entries[k].list);
+				break;
+			}
+		}
+
+		if (!keys[i].path || k == cache.size)
+			misses[num_misses++] = i;
+	}
+
+	/*
+	 * Keep a window of listings in flight, reading their output in
+	 * order. The binaries initialize concurrently while we wait
+	 * for the first one. Listing time is mostly spent loading
+	 * libraries, so oversubscribe the CPUs a little.
+	 */
+	window = 2 * sysconf(_SC_NPROCESSORS_ONLN);
+	if (window < 4)
+		window = 4;
+
+	for (i = 0; i < num_misses; i++) {
+		size_t idx = misses[i];
+		char *path;
+
+		for (; started < num_misses && started < i + window; started++) {
+			asprintf(&path, "%s/%s", settings->test_root, binaries[misses[started]]);
+			pipes[started] = start_listing(path);
+			free(path);
+		}
+
+		finish_listing(pipes[i], binaries[idx], &lists[idx]);
+	}
+
+	if (num_misses) {
+		/* Keep entries of binaries not part of this listing */
+		for (k = 0; k < cache.size; k++) {
+			for (i = 0; i < num_binaries; i++) {
+				if (keys[i].path && !strcmp(keys[i].path, cache.entries[k].key.path))
+					break;
+			}
+
+			if (i == num_binaries) {
+				add_cache_entry(&newcache, &cache.entries[k].key, &cache.entries[k].list);
+				memset(&cache.entries[k], 0, sizeof(cache.entries[k]));
+			}
+		}
+
+		for (i = 0; i < num_binaries; i++) {
+			struct subtest_list list;
+
+			if (!keys[i].path || lists[i].status == SUBTESTS_FAILED)
+				continue;
+
+			copy_subtest_list(&list, &lists[i]);
+			add_cache_entry(&newcache, &keys[i], &list);
+			memset(&keys[i], 0, sizeof(keys[i]));
+		}
+
+		write_cache(&newcache, testdirfd);
+	}
+
+	for (i = 0; i < num_binaries; i++)
+		free_cache_key(&keys[i]);
+	free(keys);
+	free(misses);
+	free(pipes);
+	free_cache(&newcache);
+	free_cache(&cache);
+	close(testdirfd);
+}
+
+void free_subtest_lists(struct subtest_list *lists, size_t num_lists)
+{
+	size_t i;
+
+	for (i = 0; i < num_lists; i++)
+		free_subtest_list(&lists[i]);
+}
@@ -0,0 +1,38 @@
+#ifndef RUNNER_SUBTEST_CACHE_H
+#define RUNNER_SUBTEST_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "settings.h"
+
+enum {
+	SUBTESTS_LISTED,
+	/* The binary exited with IGT_EXIT_INVALID, it has no subtests */
+	SUBTESTS_NONE,
+	SUBTESTS_FAILED,
+};
+
+struct subtest_list {
+	char **names;
+	size_t size;
+	int status;
+};
+
+/*
+ * Lists the subtests of the given binaries in the test root, filling
+ * lists[i] for binaries[i].
+ *
+ * Results of --list-subtests are cached in subtest-cache.txt in the
+ * test root, keyed on the binary path, modification time, size and
+ * GNU build-id. Binaries missing from the cache are executed
+ * concurrently. If the cache cannot be written, listing still
+ * succeeds, just without caching.
+ */
+void list_subtests(struct settings *settings,
+		   char **binaries, size_t num_binaries,
+		   struct subtest_list *lists);
+
+void free_subtest_lists(struct subtest_list *lists, size_t num_lists);
+
+#endif
@@ -60,6 +60,17 @@ static void assert_cmd_success(int exec_return)
 	igt_assert_eq(exec_return, IGT_EXIT_SUCCESS);
 }
 
+/*
+ * An error state whose rcs0 batch of MI_NOOPs and MI_BATCH_BUFFER_END has
+ * ACTHD at its third dword.
+ */
+static const char error_state[] =
+	"PCI ID: 0x1916\n"
+	"rcs0 command stream:\n"
+	"  ACTHD: 0x00100008\n"
+	"rcs0 (pid 42) --- gtt_offset = 0x00000000 00100000\n"
+	"~zzzz\"TSN&\n";
+
 static bool chdir_to_tools_dir(void)
 {
 	char path[PATH_MAX];
@@ -145,6 +156,88 @@ igt_main
 		igt_assert_eq(line.found, 1);
 	}
 
+	igt_subtest("error_decode_json_acthd") {
+		char dir[] = "/tmp/error_decodeXXXXXX";
+		char cmd[256], path[64], buf[64];
+		char *line = NULL;
+		size_t linelen = 0;
+		long acthd = -1;
+		FILE *f;
+
+		igt_require(access("intel_error_decode", X_OK) == 0);
+		igt_assert(mkdtemp(dir) != NULL);
+
+		snprintf(path, sizeof(path), "%s/error", dir);
+		igt_assert((f = fopen(path, "w")) != NULL);
+		fputs(error_state, f);
+		fclose(f);
+
+		snprintf(cmd, sizeof(cmd),
+			 "./intel_error_decode -J -o %s/out.json -i %s/index.json %s",
+			 dir, dir, path);
+		igt_assert_eq(igt_system_quiet(cmd), IGT_EXIT_SUCCESS);
+
+		/* The index points at the instruction at ACTHD in the output */
+		snprintf(path, sizeof(path), "%s/index.json", dir);
+		igt_assert((f = fopen(path, "r")) != NULL);
+		while (getline(&line, &linelen, f) > 0) {
+			char *p = strstr(line, "\"acthd\":");
+
+			if (strstr(line, "\"buffer\":\"batch\"") && p)
+				sscanf(p, "\"acthd\":%ld", &acthd);
+		}
+		free(line);
+		fclose(f);
+		igt_assert_lte(0, acthd);
+
+		snprintf(path, sizeof(path), "%s/out.json", dir);
+		igt_assert((f = fopen(path, "r")) != NULL);
+		igt_assert_eq(fseek(f, acthd, SEEK_SET), 0);
+		igt_assert(fgets(buf, sizeof(buf), f) != NULL);
+		fclose(f);
+		igt_assert_f(!strncmp(buf, "{\"offset\":\"0x00100008\"",
+				      strlen("{\"offset\":\"0x00100008\"")),
+			     "ACTHD indexed at '%s'\n", buf);
+
+		unlink(path);
+		snprintf(path, sizeof(path), "%s/index.json", dir);
+		unlink(path);
+		snprintf(path, sizeof(path), "%s/error", dir);
+		unlink(path);
+		rmdir(dir);
+	}
+
+	igt_subtest("igt_stats_parse") {
+		/* Each input is given on three lines, to be its own trimean */
+		static const struct {
+			const char *line, *trimean;
+		} tests[] = {
+			{ "0x1f", "31.000000" },
+			{ "017", "15.000000" },
+			{ ".5", "0.500000" },
+			{ "0.25", "0.250000" },
+			{ "2.5e3", "2500.000000" },
+			{ "5.0E-1", "0.500000" },
+			{ "1234567890123456789", "1234567890123456768.000000" },
+			{ "12345678901234567890", "12345678901234567168.000000" },
+			{ "0x10 010 2.5e1", "16.250000" },
+		};
+
+		igt_require(access("igt_stats", X_OK) == 0);
+
+		for (unsigned int i = 0; i < ARRAY_SIZE(tests); i++) {
+			const char *line = tests[i].line;
+			char cmd[256];
+
+			snprintf(cmd, sizeof(cmd),
+				 "test \"$(printf '%%s\\n' '%s' '%s' '%s' | ./igt_stats -j 1)\" = %s",
+				 line, line, line, tests[i].trimean);
+			igt_assert_f(igt_system_quiet(cmd) == 0,
+				     "'%s' not parsed to a trimean of %s\n",
+				     line, tests[i].trimean);
+		}
+	}
+
 	igt_subtest("tools_test") {
 		igt_require(access("intel_reg", X_OK) == 0);
 
@@ -29,75 +29,430 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <float.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "igt_stats.h"
 
-static void statify(FILE *file, const char *name)
-{
+/* Below this, a chunk is not worth a thread */
+#define MIN_CHUNK (1 << 20)
+
+enum input {
+	INPUT_TEXT,
+	INPUT_U64,
+	INPUT_F64,
+};
+
+struct chunk {
+	pthread_t thread;
+	bool threaded;
+	enum input input;
+	const char *start, *end;
 	igt_stats_t stats;
-	char *line = NULL;
-	size_t line_len = 0;
-
-	igt_stats_init(&stats);
-	while (getline(&line, &line_len, file) != -1) {
-		char *end, *start = line;
-		union {
-			unsigned long long u64;
-			double fp;
-		} u;
-		int is_float;
-
-		is_float = 0;
-		u.u64 = strtoull(start, &end, 0);
-		if (*end == '.') {
-			u.fp = strtod(start, &end);
-			is_float = 1;
+};
+
+static bool is_space(char c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static bool is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+/* Whether all 8 bytes of @v are ASCII digits */
+static bool is_8digits(uint64_t v)
+{
+	return ((v & 0xf0f0f0f0f0f0f0f0ull) |
+		(((v + 0x0606060606060606ull) & 0xf0f0f0f0f0f0f0f0ull) >> 4)) ==
+		0x3333333333333333ull;
+}
+
+/* The 8 ASCII digits in @v, first digit in the lowest byte, as a number */
+static uint32_t parse_8digits(uint64_t v)
+{
+	v -= 0x3030303030303030ull;
+	v = v * 10 + (v >> 8);
+	v = ((v & 0x000000ff000000ffull) * (100 + (1000000ull << 32)) +
+	     ((v >> 16) & 0x000000ff000000ffull) * (1 + (10000ull << 32))) >> 32;
+
+	return v;
+}
+#endif
+
+/*
+ * The previous line by line parser, which is kept for what parse_fast()
+ * does not handle: signs, hexadecimal and octal numbers, exponents, and
+ * numbers too long to be converted exactly. Returns where the number ends,
+ * or NULL if there is none. @blank tells whether whitespace was skipped
+ * before @str.
+ */
+static const char *
+parse_slow(igt_stats_t *stats, const char *str, const char *eol, bool blank)
+{
+	char buf[64], *start = buf, *end;
+	const char *ret = NULL;
+	union {
+		unsigned long long u64;
+		double fp;
+	} u;
+	int is_float;
+	size_t len;
+
+	/* numbers stop at whitespace, nul terminate a copy for strtoull() */
+	for (len = 0; str + len < eol && !is_space(str[len]); len++)
+		;
+	if (len >= sizeof(buf)) {
+		start = malloc(len + 1);
+		if (!start) {
+			fprintf(stderr, "Out of memory.\n");
+			exit(1);
 		}
-		while (start != end) {
-			if (is_float)
-				igt_stats_push_float(&stats, u.fp);
-			else
-				igt_stats_push(&stats, u.u64);
-
-			is_float = 0;
-			u.u64 = strtoull(start = end, &end, 0);
-			if (*end == '.') {
-				u.fp = strtod(start, &end);
-				is_float = 1;
+	}
+	memcpy(start, str, len);
+	start[len] = '\0';
+
+	is_float = 0;
+	u.u64 = strtoull(start, &end, 0);
+	/* without a number strtoull() rewinds over the whitespace, to no '.' */
+	if (*end == '.' && !(end == start && blank)) {
+		u.fp = strtod(start, &end);
+		is_float = 1;
+	}
+	if (start != end) {
+		if (is_float)
+			igt_stats_push_float(stats, u.fp);
+		else
+			igt_stats_push(stats, u.u64);
+
+		ret = str + (end - start);
+	}
+
+	if (start != buf)
+		free(start);
+
+	return ret;
+}
+
+/*
+ * Decimal integers and floats without exponent whose digits fit in 19
+ * decimal digits. A float is converted exactly as by strtod() when its
+ * digits fit in 53 bits, as both the digits and the power of ten are then
+ * exact doubles and a single division is correctly rounded.
+ */
+static const char *
+parse_fast(igt_stats_t *stats, const char *str, const char *eol)
+{
+	static const double pow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+		1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+	};
+	const char *p = str;
+	unsigned int digits = 0, frac;
+	uint64_t v = 0;
+
+	if (!is_digit(*p))
+		return NULL;
+
+	/* leading 0 is octal or hexadecimal */
+	if (*p == '0' && p + 1 < eol &&
+	    (is_digit(p[1]) || p[1] == 'x' || p[1] == 'X'))
+		return NULL;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	while (eol - p >= 8 && digits + 8 <= 19) {
+		uint64_t w;
+
+		memcpy(&w, p, sizeof(w));
+		if (!is_8digits(w))
+			break;
+
+		v = v * 100000000 + parse_8digits(w);
+		digits += 8;
+		p += 8;
+	}
+#endif
+	for (; p < eol && is_digit(*p); p++) {
+		if (++digits > 19)
+			return NULL;
+		v = v * 10 + *p - '0';
+	}
+
+	if (p == eol || *p != '.') {
+		igt_stats_push(stats, v);
+		return p;
+	}
+
+	for (frac = 0, p++; p < eol && is_digit(*p); frac++, p++) {
+		if (++digits > 19)
+			return NULL;
+		v = v * 10 + *p - '0';
+	}
+
+	if (FLT_EVAL_METHOD != 0 || v >> DBL_MANT_DIG ||
+	    (p < eol && (*p == 'e' || *p == 'E')))
+		return NULL;
+
+	igt_stats_push_float(stats, v / pow10[frac]);
+	return p;
+}
+
+/*
+ * Numbers are read from the start of each line up to the first token which
+ * is not a number.
+ */
+static void parse_text(igt_stats_t *stats, const char *str, const char *end)
+{
+	while (str < end) {
+		const char *eol = memchr(str, '\n', end - str) ?: end;
+
+		while (str) {
+			const char *blank = str;
+
+			while (str < eol && is_space(*str))
+				str++;
+			if (str == eol)
+				break;
+
+			str = parse_fast(stats, str, eol) ?:
+			      parse_slow(stats, str, eol, str != blank);
+		}
+
+		str = eol + 1;
+	}
+}
+
+static void *parse_chunk(void *data)
+{
+	struct chunk *chunk = data;
+	const char *str;
+
+	switch (chunk->input) {
+	case INPUT_TEXT:
+		parse_text(&chunk->stats, chunk->start, chunk->end);
+		break;
+	case INPUT_U64:
+		for (str = chunk->start; str < chunk->end; str += 8) {
+			uint64_t v;
+
+			memcpy(&v, str, sizeof(v));
+			igt_stats_push(&chunk->stats, v);
+		}
+		break;
+	case INPUT_F64:
+		for (str = chunk->start; str < chunk->end; str += 8) {
+			double v;
+
+			memcpy(&v, str, sizeof(v));
+			igt_stats_push_float(&chunk->stats, v);
+		}
+		break;
+	}
+
+	return NULL;
+}
+
+/* Maps regular files, and reads anything else, e.g. a pipe, into memory */
+static char *read_input(int fd, size_t *len, bool *mapped)
+{
+	size_t size = 1 << 20;
+	struct stat st;
+	char *buf = NULL;
+	ssize_t ret;
+
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (buf != MAP_FAILED) {
+			madvise(buf, st.st_size, MADV_SEQUENTIAL);
+			*len = st.st_size;
+			*mapped = true;
+			return buf;
+		}
+		buf = NULL;
+	}
+
+	*len = 0;
+	*mapped = false;
+	for (;;) {
+		if (*len == size || !buf) {
+			size *= 2;
+			buf = realloc(buf, size);
+			if (buf == NULL) {
+				fprintf(stderr, "Out of memory.\n");
+				exit(1);
 			}
 		}
+
+		ret = read(fd, buf + *len, size - *len);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			break;
+
+		*len += ret;
 	}
-	free(line);
+
+	return buf;
+}
+
+static void statify(int fd, const char *name, enum input input,
+		    int num_threads)
+{
+	struct chunk *chunks;
+	const char *start;
+	size_t len, size;
+	bool mapped;
+	char *buf;
+	int n;
+
+	buf = read_input(fd, &size, &mapped);
+	len = size;
+
+	if (input != INPUT_TEXT && len % 8) {
+		fprintf(stderr, "%s: ignoring %zu trailing bytes\n",
+			name ?: "stdin", len % 8);
+		len -= len % 8;
+	}
+
+	if ((size_t)num_threads > len / MIN_CHUNK + 1)
+		num_threads = len / MIN_CHUNK + 1;
+	if (num_threads < 1)
+		num_threads = 1;
+
+	chunks = calloc(num_threads, sizeof(*chunks));
+	if (!chunks) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(1);
+	}
+
+	/* text chunks end after a newline, binary ones on a whole value */
+	start = buf;
+	for (n = 0; n < num_threads; n++) {
+		struct chunk *chunk = &chunks[n];
+		size_t end = len / num_threads * (n + 1);
+
+		if (n == num_threads - 1) {
+			end = len;
+		} else if (input == INPUT_TEXT) {
+			const char *eol;
+
+			if (end < start - buf)
+				end = start - buf;
+			eol = memchr(buf + end, '\n', len - end);
+			end = eol ? eol - buf + 1 : len;
+		} else {
+			end -= end % 8;
+		}
+
+		chunk->input = input;
+		chunk->start = start;
+		chunk->end = buf + end;
+		start = chunk->end;
+
+		if (input == INPUT_TEXT)
+			igt_stats_init(&chunk->stats);
+		else
+			igt_stats_init_with_size(&chunk->stats,
+						 (chunk->end - chunk->start) / 8);
+
+		/* the first chunk is parsed by this thread */
+		if (n && pthread_create(&chunk->thread, NULL,
+					parse_chunk, chunk) == 0)
+			chunk->threaded = true;
+		else if (n)
+			parse_chunk(chunk);
+	}
+	parse_chunk(&chunks[0]);
+
+	for (n = 1; n < num_threads; n++) {
+		if (chunks[n].threaded)
+			pthread_join(chunks[n].thread, NULL);
+
+		igt_stats_merge(&chunks[0].stats, &chunks[n].stats);
+		igt_stats_fini(&chunks[n].stats);
+	}
+
+	if (mapped)
+		munmap(buf, size);
+	else
+		free(buf);
 
 	if (name)
 		printf("%s: ", name);
 
-	printf("%f\n", igt_stats_get_trimean(&stats));
+	printf("%f\n", igt_stats_get_trimean(&chunks[0].stats));
 
-	igt_stats_fini(&stats);
+	igt_stats_fini(&chunks[0].stats);
+	free(chunks);
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+		"Usage: %s [-j <threads>] [-b u64|f64] [<file>...]\n"
+		"\n"
+		"Prints the trimean of the numbers in each file, or in the\n"
+		"standard input if no file is given. Every line is read up to\n"
+		"the first token which is not a number.\n"
+		"\n"
+		"With -b the input is a raw array of native endian unsigned\n"
+		"64 bit integers or doubles instead. The input is parsed by\n"
+		"<threads> threads, one per CPU by default.\n",
+		argv0);
 }
 
 int main(int argc, char **argv)
 {
-	if (argc == 1) {
-		statify(stdin, NULL);
+	int num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	enum input input = INPUT_TEXT;
+	int c;
+
+	while ((c = getopt(argc, argv, "j:b:h")) != -1) {
+		switch (c) {
+		case 'j':
+			num_threads = atoi(optarg);
+			break;
+		case 'b':
+			if (!strcmp(optarg, "u64")) {
+				input = INPUT_U64;
+				break;
+			}
+			if (!strcmp(optarg, "f64")) {
+				input = INPUT_F64;
+				break;
+			}
+			/* fallthrough */
+		default:
+			usage(argv[0]);
+			return c != 'h';
+		}
+	}
+
+	if (optind == argc) {
+		statify(STDIN_FILENO, NULL, input, num_threads);
 	} else {
 		int i;
 
-		for (i = 1; i < argc; i++) {
-			FILE *file;
+		for (i = optind; i < argc; i++) {
+			int fd;
 
-			file = fopen(argv[i], "r");
-			if (file == NULL) {
+			fd = open(argv[i], O_RDONLY);
+			if (fd < 0) {
 				perror(argv[i]);
 				continue;
 			}
 
-			statify(file, argv[i]);
-			fclose(file);
+			statify(fd, argv[i], input, num_threads);
+			close(fd);
 		}
 	}
 
@@ -52,6 +52,7 @@
 #include <intel_bufmgr.h>
 #include <zlib.h>
 #include <ctype.h>
+#include <pthread.h>
 
 #include "intel_chipset.h"
 #include "intel_io.h"
@@ -445,36 +446,223 @@ static bool maybe_ascii(const void *data, int check)
 	return true;
 }
 
-static void decode(struct drm_intel_decode *ctx,
-		   const char *buffer_name,
-		   const char *ring_name,
-		   uint64_t gtt_offset,
-		   uint32_t head_offset,
-		   uint32_t *data, int *count,
-		   int decode)
+/*
+ * The error state is decoded in two passes. The first splits the file into
+ * sections of plain text and of buffer contents, recording for each buffer
+ * the state it is decoded with. The buffers are then inflated and decoded
+ * by a pool of workers into memory, while the main thread prints the text
+ * and the decoded buffers in the original order.
+ */
+struct section {
+	char **lines;
+	int num_lines;
+	bool text;
+
+	/* buffer state */
+	uint32_t devid;
+	const char *buffer_name;
+	const char *ring_name;
+	uint64_t gtt_offset;
+	uint32_t head_offset;
+	uint32_t acthd;
+	bool have_devid;
+	bool have_acthd;
+	int do_decode;
+
+	char *out;
+	size_t out_len;
+	int num_dwords;
+	long acthd_pos; /* of the instruction at ACTHD in out, or -1 */
+	bool done;
+};
+
+/* Sections decoded ahead of the output at most, to bound memory use. */
+#define DECODE_AHEAD 64
+
+static struct {
+	struct section *sections;
+	int num_sections;
+	int next, written;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+} decoder = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+/*
+ * The libdrm decoder keeps its state in globals, so batches are decoded one
+ * at a time, each with a fresh context.
+ */
+static pthread_mutex_t decode_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static char **filter_rings, **filter_buffers;
+static bool json_output;
+static FILE *index_file;
+
+/*
+ * Writes all @len bytes of @str, NULs included. Anything outside of
+ * printable ASCII is escaped, so that binary buffers still make valid
+ * JSON, with bytes above 0x7f becoming the code point of the same value.
+ */
+static void json_string(FILE *out, const char *str, size_t len)
+{
+	const unsigned char *c = (const unsigned char *)str;
+
+	fputc('"', out);
+	for (; len--; c++) {
+		if (*c == '"' || *c == '\\')
+			fprintf(out, "\\%c", *c);
+		else if (*c < ' ' || *c >= 0x7f)
+			fprintf(out, "\\u%04x", *c);
+		else
+			fputc(*c, out);
+	}
+	fputc('"', out);
+}
+
+static void json_string_or_null(FILE *out, const char *str)
+{
+	if (str)
+		json_string(out, str, strlen(str));
+	else
+		fputs("null", out);
+}
+
+static void decode_batch(FILE *out, const struct section *s,
+			 uint32_t *data, int count)
+{
+	struct drm_intel_decode *ctx;
+
+	pthread_mutex_lock(&decode_lock);
+	ctx = drm_intel_decode_context_alloc(s->devid);
+	drm_intel_decode_set_output_file(ctx, out);
+	if (s->have_acthd)
+		drm_intel_decode_set_head_tail(ctx, s->acthd, 0xffffffff);
+	drm_intel_decode_set_batch_pointer(ctx, data, s->gtt_offset, count);
+	drm_intel_decode(ctx);
+	drm_intel_decode_context_free(ctx);
+	pthread_mutex_unlock(&decode_lock);
+}
+
+/*
+ * Splits a line of decoded instructions, "0x<offset>: <col> 0x<dword>: <text>"
+ * with the 4 character column marking the HEAD and TAIL, and returns where the
+ * text starts, or 0 for any other line.
+ */
+static int split_instruction(const char *line, const char *eol,
+			     unsigned int *offset, unsigned int *dword)
+{
+	int n = 0;
+
+	if (eol - line < 28 || sscanf(line, "0x%08x: ", offset) != 1 ||
+	    sscanf(line + 16, " 0x%08x:%n", dword, &n) != 1 || !n)
+		return 0;
+
+	n += 16;
+	while (line + n < eol && line[n] == ' ')
+		n++;
+
+	return n;
+}
+
+/*
+ * A buffer as one JSON object, with the instructions of decoded buffers split
+ * into offset, dword and text.
+ */
+static void json_decode(FILE *out, const struct section *s,
+			uint32_t *data, int count)
+{
+	fputs("{\"type\":\"buffer\",\"ring\":", out);
+	json_string_or_null(out, s->ring_name);
+	fprintf(out, ",\"buffer\":\"%s\",\"gtt_offset\":\"0x%016" PRIx64 "\"",
+		s->buffer_name, s->gtt_offset);
+	if (s->head_offset != -1)
+		fprintf(out, ",\"head\":\"0x%016" PRIx64 "\"",
+			s->gtt_offset + s->head_offset);
+	fprintf(out, ",\"dwords\":%d", count);
+
+	if (s->do_decode && s->have_devid) {
+		const char *sep = "";
+		char *text, *line, *eol;
+		size_t len;
+		FILE *f;
+
+		f = open_memstream(&text, &len);
+		if (!f) {
+			fprintf(stderr, "Out of memory.\n");
+			exit(1);
+		}
+		decode_batch(f, s, data, count);
+		fclose(f);
+
+		fputs(",\"instructions\":[", out);
+		for (line = text; line < text + len; line = eol + 1) {
+			unsigned int offset, dword;
+			int n;
+
+			eol = memchr(line, '\n', text + len - line);
+			if (!eol)
+				eol = text + len;
+
+			fputs(sep, out);
+			sep = ",";
+
+			n = split_instruction(line, eol, &offset, &dword);
+			if (n) {
+				fprintf(out,
+					"{\"offset\":\"0x%08x\",\"dword\":\"0x%08x\",\"text\":",
+					offset, dword);
+			} else {
+				fputs("{\"text\":", out);
+			}
+			json_string(out, line + n, eol - line - n);
+			fputc('}', out);
+		}
+		fputc(']', out);
+		free(text);
+	} else if (maybe_ascii(data, 16)) {
+		fputs(",\"ascii\":", out);
+		json_string(out, (char *)data, 4 * count);
+	} else {
+		fputs(",\"data\":\"", out);
+		for (int i = 0; i < count; i++)
+			fprintf(out, "%08x", data[i]);
+		fputc('"', out);
+	}
+
+	fputs("}\n", out);
+}
+
+static void decode(FILE *out, const struct section *s,
+		   uint32_t *data, int *count)
 {
 	if (!*count)
 		return;
 
-	printf("%s (%s) at 0x%08x_%08x", buffer_name, ring_name,
-	       (unsigned)(gtt_offset >> 32),
-	       (unsigned)(gtt_offset & 0xffffffff));
-	if (head_offset != -1)
-		printf("; HEAD points to: 0x%08x_%08x",
-		       (unsigned)((head_offset + gtt_offset) >> 32),
-		       (unsigned)((head_offset + gtt_offset) & 0xffffffff));
-	printf("\n");
-
-	if (decode) {
-		drm_intel_decode_set_batch_pointer(ctx, data, gtt_offset,
-						   *count);
-		drm_intel_decode(ctx);
+	if (json_output) {
+		json_decode(out, s, data, *count);
+		*count = 0;
+		return;
+	}
+
+	fprintf(out, "%s (%s) at 0x%08x_%08x", s->buffer_name, s->ring_name,
+		(unsigned)(s->gtt_offset >> 32),
+		(unsigned)(s->gtt_offset & 0xffffffff));
+	if (s->head_offset != -1)
+		fprintf(out, "; HEAD points to: 0x%08x_%08x",
+			(unsigned)((s->head_offset + s->gtt_offset) >> 32),
+			(unsigned)((s->head_offset + s->gtt_offset) & 0xffffffff));
+	fprintf(out, "\n");
+
+	if (s->do_decode && s->have_devid) {
+		decode_batch(out, s, data, *count);
 	} else if (maybe_ascii(data, 16)) {
-		printf("%*s\n", 4 * *count, (char *)data);
+		fprintf(out, "%*s\n", 4 * *count, (char *)data);
 	} else {
 		for (int i = 0; i + 4 <= *count; i += 4)
-			printf("[%04x] %08x %08x %08x %08x\n",
-			       4*i, data[i], data[i+1], data[i+2], data[i+3]);
+			fprintf(out, "[%04x] %08x %08x %08x %08x\n",
+				4*i, data[i], data[i+1], data[i+2], data[i+3]);
 	}
 	*count = 0;
 }
@@ -563,38 +751,194 @@ static int ascii85_decode(const char *in, uint32_t **out, bool inflate)
 	return zlib_inflate(out, len);
 }
 
-static void
-read_data_file(FILE *file)
+/* Locate the decoded instruction at ACTHD, for the index. */
+static void find_acthd(struct section *s)
+{
+	uint32_t start = s->gtt_offset, acthd = s->acthd & ~3;
+	const char *p = s->out, *end = s->out + s->out_len;
+	char needle[64];
+	int len;
+
+	s->acthd_pos = -1;
+	if (!s->have_acthd || !s->do_decode || !s->have_devid ||
+	    acthd - start >= 4u * s->num_dwords)
+		return;
+
+	len = snprintf(needle, sizeof(needle),
+		       json_output ? "{\"offset\":\"0x%08x\"" : "0x%08x:",
+		       acthd);
+
+	while ((p = memmem(p, end - p, needle, len))) {
+		if (json_output || p == s->out || p[-1] == '\n') {
+			s->acthd_pos = p - s->out;
+			break;
+		}
+		p += len;
+	}
+}
+
+static void decode_section(struct section *s)
 {
-	struct drm_intel_decode *decode_ctx = NULL;
-	uint32_t devid = PCI_CHIP_I855_GM;
 	uint32_t *data = NULL;
+	int count = 0;
+	FILE *out;
+
+	out = open_memstream(&s->out, &s->out_len);
+	if (!out) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(1);
+	}
+
+	if (s->lines[0][0] == ':' || s->lines[0][0] == '~') {
+		count = ascii85_decode(s->lines[0] + 1, &data,
+				       s->lines[0][0] == ':');
+		if (count == 0)
+			fprintf(stderr, "ASCII85 decode failed (%s - %s).\n",
+				s->ring_name, s->buffer_name);
+	} else {
+		data = malloc(s->num_lines * sizeof(uint32_t));
+		if (data == NULL) {
+			fprintf(stderr, "Out of memory.\n");
+			exit(1);
+		}
+
+		for (int i = 0; i < s->num_lines; i++) {
+			uint32_t offset;
+
+			sscanf(s->lines[i], "%08x : %08x", &offset, &data[i]);
+		}
+		count = s->num_lines;
+	}
+
+	s->num_dwords = count;
+	decode(out, s, data, &count);
+
+	fclose(out);
+	free(data);
+
+	if (index_file)
+		find_acthd(s);
+}
+
+static void *decode_worker(void *arg)
+{
+	pthread_mutex_lock(&decoder.mutex);
+	for (;;) {
+		struct section *s;
+
+		while (decoder.next < decoder.num_sections &&
+		       decoder.sections[decoder.next].text)
+			decoder.next++;
+
+		if (decoder.next == decoder.num_sections)
+			break;
+
+		if (decoder.next >= decoder.written + DECODE_AHEAD) {
+			pthread_cond_wait(&decoder.cond, &decoder.mutex);
+			continue;
+		}
+
+		s = &decoder.sections[decoder.next++];
+		pthread_mutex_unlock(&decoder.mutex);
+
+		decode_section(s);
+
+		pthread_mutex_lock(&decoder.mutex);
+		s->done = true;
+		pthread_cond_broadcast(&decoder.cond);
+	}
+	pthread_mutex_unlock(&decoder.mutex);
+
+	return NULL;
+}
+
+static bool match_filter(char **filter, const char *name, bool exact)
+{
+	if (!filter)
+		return true;
+
+	if (!name)
+		return false;
+
+	for (; *filter; filter++) {
+		if (exact ? !strcasecmp(name, *filter) :
+			    !!strcasestr(name, *filter))
+			return true;
+	}
+
+	return false;
+}
+
+static struct section *
+add_section(struct section **sections, int *num, int *max)
+{
+	if (*num == *max) {
+		*max = *max ? 2 * *max : 256;
+		*sections = realloc(*sections, *max * sizeof(**sections));
+		if (*sections == NULL) {
+			fprintf(stderr, "Out of memory.\n");
+			exit(1);
+		}
+	}
+
+	memset(&(*sections)[*num], 0, sizeof(**sections));
+	return &(*sections)[(*num)++];
+}
+
+/* Returns the length of the engine name if the line starts its registers. */
+static int engine_header(const char *line)
+{
+	static const char suffix[] = " command stream:";
+	int len = strlen(line) - (sizeof(suffix) - 1);
+
+	if (len > 0 && !strcmp(line + len, suffix))
+		return len;
+
+	return -1;
+}
+
+/*
+ * First pass: split the lines into sections and track the state needed to
+ * decode the buffers.
+ */
+static int
+index_sections(char **lines, int num_lines, struct section **sections)
+{
+	struct section state = {
+		.buffer_name = "batch buffer",
+		.head_offset = -1,
+		.do_decode = 1,
+	};
+	struct section *s = NULL;
+	struct {
+		const char *name;
+		int len;
+		uint32_t acthd;
+	} engines[MAX_RINGS], *engine = NULL;
 	uint32_t head[MAX_RINGS];
-	int head_idx = 0;
-	int num_rings = 0;
-	long long unsigned fence;
-	int data_size = 0, count = 0, matched;
-	char *line = NULL;
-	size_t line_size;
-	uint32_t offset, value, ring_length = 0;
-	uint64_t gtt_offset = 0;
-	uint32_t head_offset = -1;
-	const char *buffer_name = "batch buffer";
-	char *ring_name = NULL;
-	int do_decode = 1;
-
-	while (getline(&line, &line_size, file) > 0) {
+	int head_idx = 0, num_rings = 0, num_engines = 0;
+	int num = 0, max = 0;
+	bool selected;
+
+	*sections = NULL;
+	selected = match_filter(filter_rings, NULL, false) &&
+		   match_filter(filter_buffers, state.buffer_name, true);
+
+	for (int i = 0; i < num_lines; i++) {
+		char *line = lines[i];
+		uint32_t offset, value;
+		unsigned int reg;
 		char *dashes;
+		int matched;
 
 		if (line[0] == ':' || line[0] == '~') {
-			count = ascii85_decode(line+1, &data, line[0] == ':');
-			if (count == 0)
-				fprintf(stderr, "ASCII85 decode failed (%s - %s).\n",
-					ring_name, buffer_name);
-			decode(decode_ctx,
-			       buffer_name, ring_name,
-			       gtt_offset, head_offset,
-			       data, &count, do_decode);
+			if (selected) {
+				s = add_section(sections, &num, &max);
+				*s = state;
+				s->lines = &lines[i];
+				s->num_lines = 1;
+			}
+			s = NULL;
 			continue;
 		}
 
@@ -616,21 +960,18 @@ read_data_file(FILE *file)
 				{ "guc log buffer", "GuC log", 0 },
 				{ },
 			}, *b;
-			char *new_ring_name;
 
-			new_ring_name = malloc(dashes - line);
-			strncpy(new_ring_name, line, dashes - line);
-			new_ring_name[dashes - line - 1] = '\0';
-
-			decode(decode_ctx,
-			       buffer_name, ring_name,
-			       gtt_offset, head_offset,
-			       data, &count, do_decode);
-			gtt_offset = 0;
-			head_offset = -1;
+			/* The header is not printed, keep the name in place. */
+			if (dashes > line) {
+				dashes[-1] = '\0';
+				state.ring_name = line;
+			} else {
+				state.ring_name = "";
+			}
 
-			free(ring_name);
-			ring_name = new_ring_name;
+			s = NULL;
+			state.gtt_offset = 0;
+			state.head_offset = -1;
 
 			dashes += 4;
 			for (b = buffers; b->match; b++) {
@@ -647,119 +988,390 @@ read_data_file(FILE *file)
 				matched = sscanf(dashes, "= 0x%08x %08x\n",
 						 &hi, &lo);
 				if (matched > 0) {
-					gtt_offset = hi;
+					state.gtt_offset = hi;
 					if (matched == 2) {
-						gtt_offset <<= 32;
-						gtt_offset |= lo;
+						state.gtt_offset <<= 32;
+						state.gtt_offset |= lo;
 					}
 				}
 
-				do_decode = b->do_decode;
-				buffer_name = b->name;
+				state.do_decode = b->do_decode;
+				state.buffer_name = b->name;
 				if (b == buffers)
-					head_offset = head[head_idx++];
+					state.head_offset = head[head_idx++];
 				break;
 			}
 
+			/* Use the ACTHD of the engine owning the buffer. */
+			for (int e = 0; e < num_engines; e++) {
+				const char *end = line + engines[e].len;
+
+				if (!strncmp(line, engines[e].name,
+					     engines[e].len) &&
+				    (*end == ' ' || *end == '\0')) {
+					state.acthd = engines[e].acthd;
+					state.have_acthd = true;
+					break;
+				}
+			}
+
+			selected = match_filter(filter_rings,
+						state.ring_name, false) &&
+				   match_filter(filter_buffers,
+						state.buffer_name, true);
 			continue;
 		}
 
 		matched = sscanf(line, "%08x : %08x", &offset, &value);
-		if (matched != 2) {
-			unsigned int reg, reg2;
-
-			/* display reg section is after the ringbuffers, don't mix them */
-			decode(decode_ctx,
-			       buffer_name, ring_name,
-			       gtt_offset, head_offset,
-			       data, &count, do_decode);
-
-			printf("%s", line);
-
-			matched = sscanf(line, "PCI ID: 0x%04x\n", &reg);
-			if (matched == 0)
-				matched = sscanf(line, " PCI ID: 0x%04x\n", &reg);
-			if (matched == 0) {
-				const char *pci_id_start = strstr(line, "PCI ID");
-				if (pci_id_start)
-					matched = sscanf(pci_id_start, "PCI ID: 0x%04x\n", &reg);
+		if (matched == 2) {
+			if (!selected)
+				continue;
+
+			if (!s || s->text) {
+				s = add_section(sections, &num, &max);
+				*s = state;
+				s->lines = &lines[i];
 			}
-			if (matched == 1) {
-				devid = reg;
-				printf("Detected GEN%i chipset\n",
-						intel_gen(devid));
+			s->num_lines++;
+			continue;
+		}
 
-				decode_ctx = drm_intel_decode_context_alloc(devid);
-			}
+		if (!s || !s->text) {
+			s = add_section(sections, &num, &max);
+			s->text = true;
+			s->lines = &lines[i];
+		}
+		s->num_lines++;
+
+		matched = engine_header(line);
+		if (matched > 0 && num_engines < MAX_RINGS) {
+			engine = &engines[num_engines++];
+			engine->name = line;
+			engine->len = matched;
+			engine->acthd = 0xffffffff;
+		} else if (line[0] && !isspace(line[0])) {
+			engine = NULL;
+		}
 
-			matched = sscanf(line, "  CTL: 0x%08x\n", &reg);
-			if (matched == 1)
-				ring_length = print_ctl(reg);
+		matched = sscanf(line, "PCI ID: 0x%04x\n", &reg);
+		if (matched == 0)
+			matched = sscanf(line, " PCI ID: 0x%04x\n", &reg);
+		if (matched == 0) {
+			const char *pci_id_start = strstr(line, "PCI ID");
+			if (pci_id_start)
+				matched = sscanf(pci_id_start, "PCI ID: 0x%04x\n", &reg);
+		}
+		if (matched == 1) {
+			state.devid = reg;
+			state.have_devid = true;
+			state.have_acthd = false;
+		}
 
-			matched = sscanf(line, "  HEAD: 0x%08x\n", &reg);
-			if (matched == 1) {
-				head[num_rings++] = print_head(reg);
-			}
+		matched = sscanf(line, "  HEAD: 0x%08x\n", &reg);
+		if (matched == 1 && num_rings < MAX_RINGS)
+			head[num_rings++] = reg & (0x7ffff<<2);
 
-			matched = sscanf(line, "  ACTHD: 0x%08x\n", &reg);
-			if (matched == 1) {
-				print_acthd(reg, ring_length);
-				drm_intel_decode_set_head_tail(decode_ctx, reg, 0xffffffff);
-			}
+		matched = sscanf(line, "  ACTHD: 0x%08x\n", &reg);
+		if (matched == 1) {
+			state.acthd = reg;
+			state.have_acthd = true;
+			if (engine)
+				engine->acthd = reg;
+		}
+	}
 
-			matched = sscanf(line, "  PGTBL_ER: 0x%08x\n", &reg);
-			if (matched == 1 && reg)
-				print_pgtbl_err(reg, devid);
+	return num;
+}
 
-			matched = sscanf(line, "  ERROR: 0x%08x\n", &reg);
-			if (matched == 1 && reg)
-				print_error(reg, devid);
+/* Print a line of the error state with the registers explained. */
+static void print_line(const char *line, uint32_t *devid,
+		       uint32_t *ring_length)
+{
+	long long unsigned fence;
+	unsigned int reg, reg2;
+	int matched;
+
+	printf("%s\n", line);
+
+	matched = sscanf(line, "PCI ID: 0x%04x\n", &reg);
+	if (matched == 0)
+		matched = sscanf(line, " PCI ID: 0x%04x\n", &reg);
+	if (matched == 0) {
+		const char *pci_id_start = strstr(line, "PCI ID");
+		if (pci_id_start)
+			matched = sscanf(pci_id_start, "PCI ID: 0x%04x\n", &reg);
+	}
+	if (matched == 1) {
+		*devid = reg;
+		printf("Detected GEN%i chipset\n",
+				intel_gen(*devid));
+	}
 
-			matched = sscanf(line, "  INSTDONE: 0x%08x\n", &reg);
-			if (matched == 1)
-				print_instdone(devid, reg, -1);
+	matched = sscanf(line, "  CTL: 0x%08x\n", &reg);
+	if (matched == 1)
+		*ring_length = print_ctl(reg);
 
-			matched = sscanf(line, "  INSTDONE1: 0x%08x\n", &reg);
-			if (matched == 1)
-				print_instdone(devid, -1, reg);
+	matched = sscanf(line, "  HEAD: 0x%08x\n", &reg);
+	if (matched == 1)
+		print_head(reg);
 
-			matched = sscanf(line, "  fence[%i] = %Lx\n", &reg, &fence);
-			if (matched == 2)
-				print_fence(devid, fence);
+	matched = sscanf(line, "  ACTHD: 0x%08x\n", &reg);
+	if (matched == 1)
+		print_acthd(reg, *ring_length);
 
-			matched = sscanf(line, "  FAULT_REG: 0x%08x\n", &reg);
-			if (matched == 1 && reg)
-				print_fault_reg(devid, reg);
+	matched = sscanf(line, "  PGTBL_ER: 0x%08x\n", &reg);
+	if (matched == 1 && reg)
+		print_pgtbl_err(reg, *devid);
 
-			matched = sscanf(line, "  FAULT_TLB_DATA: 0x%08x 0x%08x\n", &reg, &reg2);
-			if (matched == 2)
-				print_fault_data(devid, reg, reg2);
+	matched = sscanf(line, "  ERROR: 0x%08x\n", &reg);
+	if (matched == 1 && reg)
+		print_error(reg, *devid);
 
-			continue;
+	matched = sscanf(line, "  INSTDONE: 0x%08x\n", &reg);
+	if (matched == 1)
+		print_instdone(*devid, reg, -1);
+
+	matched = sscanf(line, "  INSTDONE1: 0x%08x\n", &reg);
+	if (matched == 1)
+		print_instdone(*devid, -1, reg);
+
+	matched = sscanf(line, "  fence[%i] = %Lx\n", &reg, &fence);
+	if (matched == 2)
+		print_fence(*devid, fence);
+
+	matched = sscanf(line, "  FAULT_REG: 0x%08x\n", &reg);
+	if (matched == 1 && reg)
+		print_fault_reg(*devid, reg);
+
+	matched = sscanf(line, "  FAULT_TLB_DATA: 0x%08x 0x%08x\n", &reg, &reg2);
+	if (matched == 2)
+		print_fault_data(*devid, reg, reg2);
+}
+
+static const char *trim(const char *str, const char *end, int *len)
+{
+	while (str < end && isspace(*str))
+		str++;
+	while (end > str && isspace(end[-1]))
+		end--;
+
+	*len = end - str;
+	return str;
+}
+
+/*
+ * A line of the error state as a JSON object: "name: value" lines become
+ * registers of the engine they are listed under, or fields of the error
+ * state outside of the engines.
+ */
+static void json_line(const char *line, const char *engine, int engine_len,
+		      uint32_t *devid)
+{
+	const char *colon = strchr(line, ':');
+	const char *name, *value;
+	int name_len, value_len;
+	unsigned int reg;
+
+	if (engine_header(line) >= 0) {
+		printf("{\"type\":\"engine\",\"ring\":");
+		json_string(stdout, engine, engine_len);
+		printf("}\n");
+		return;
+	}
+
+	name = trim(line, colon ? colon : line + strlen(line), &name_len);
+	if (!colon || !name_len) {
+		if (!name_len)
+			return;
+
+		printf("{\"type\":\"text\",\"text\":");
+		json_string(stdout, line, strlen(line));
+		printf("}\n");
+		return;
+	}
+
+	value = trim(colon + 1, colon + strlen(colon), &value_len);
+
+	if (engine && isspace(line[0])) {
+		printf("{\"type\":\"register\",\"ring\":");
+		json_string(stdout, engine, engine_len);
+		printf(",");
+	} else {
+		printf("{\"type\":\"field\",");
+	}
+	printf("\"name\":");
+	json_string(stdout, name, name_len);
+	printf(",\"value\":");
+	json_string(stdout, value, value_len);
+	printf("}\n");
+
+	if (!strncmp(name, "PCI ID", name_len) &&
+	    sscanf(value, "0x%04x", &reg) == 1) {
+		*devid = reg;
+		printf("{\"type\":\"device\",\"devid\":\"0x%04x\",\"gen\":%d}\n",
+		       *devid, intel_gen(*devid));
+	}
+}
+
+/*
+ * The index lists where each engine and buffer starts in the output, and for
+ * decoded buffers containing ACTHD where the instruction at ACTHD is.
+ */
+static void index_engine(const char *engine, int engine_len)
+{
+	fprintf(index_file, "{\"type\":\"engine\",\"ring\":");
+	json_string(index_file, engine, engine_len);
+	fprintf(index_file, ",\"offset\":%ld}\n", ftell(stdout));
+}
+
+static void index_buffer(const struct section *s, long offset)
+{
+	fprintf(index_file, "{\"type\":\"buffer\",\"ring\":");
+	json_string_or_null(index_file, s->ring_name);
+	fprintf(index_file,
+		",\"buffer\":\"%s\",\"gtt_offset\":\"0x%016" PRIx64 "\",\"dwords\":%d,\"offset\":%ld,\"length\":%zu,\"acthd\":",
+		s->buffer_name, s->gtt_offset, s->num_dwords,
+		offset, s->out_len);
+	if (s->acthd_pos >= 0)
+		fprintf(index_file, "%ld}\n", offset + s->acthd_pos);
+	else
+		fprintf(index_file, "null}\n");
+}
+
+static char *read_file(FILE *file, size_t *len)
+{
+	size_t size = 1 << 20;
+	char *buf = NULL;
+	size_t ret;
+
+	*len = 0;
+	do {
+		size *= 2;
+		buf = realloc(buf, size + 1);
+		if (buf == NULL) {
+			fprintf(stderr, "Out of memory.\n");
+			exit(1);
 		}
 
-		count++;
+		ret = fread(buf + *len, 1, size - *len, file);
+		*len += ret;
+	} while (*len == size);
+
+	buf[*len] = '\0';
+	return buf;
+}
+
+static char **split_lines(char *buf, size_t len, int *num_lines)
+{
+	char **lines = NULL;
+	int num = 0, max = 0;
+	char *end = buf + len;
+
+	while (buf < end) {
+		char *eol = memchr(buf, '\n', end - buf);
 
-		if (count > data_size) {
-			data_size = data_size ? data_size * 2 : 1024;
-			data = realloc(data, data_size * sizeof (uint32_t));
-			if (data == NULL) {
+		if (num == max) {
+			max = max ? 2 * max : 4096;
+			lines = realloc(lines, max * sizeof(*lines));
+			if (lines == NULL) {
 				fprintf(stderr, "Out of memory.\n");
 				exit(1);
 			}
 		}
 
-		data[count-1] = value;
+		lines[num++] = buf;
+		if (!eol)
+			break;
+
+		*eol = '\0';
+		buf = eol + 1;
 	}
 
-	decode(decode_ctx,
-	       buffer_name, ring_name,
-	       gtt_offset, head_offset,
-	       data, &count, do_decode);
+	*num_lines = num;
+	return lines;
+}
 
-	free(data);
-	free(line);
-	free(ring_name);
+static void
+read_data_file(FILE *file, int num_threads)
+{
+	uint32_t devid = PCI_CHIP_I855_GM;
+	uint32_t ring_length = 0;
+	const char *engine = NULL;
+	int engine_len = 0;
+	pthread_t *threads;
+	int num_lines, n;
+	char **lines;
+	size_t len;
+	char *buf;
+
+	buf = read_file(file, &len);
+	lines = split_lines(buf, len, &num_lines);
+
+	decoder.num_sections = index_sections(lines, num_lines,
+					      &decoder.sections);
+	decoder.next = decoder.written = 0;
+
+	threads = calloc(num_threads, sizeof(*threads));
+	for (n = 0; threads && n < num_threads; n++) {
+		if (pthread_create(&threads[n], NULL, decode_worker, NULL))
+			break;
+	}
+	num_threads = n;
+
+	for (int i = 0; i < decoder.num_sections; i++) {
+		struct section *s = &decoder.sections[i];
+
+		if (s->text) {
+			for (int l = 0; l < s->num_lines; l++) {
+				const char *line = s->lines[l];
+				int len = engine_header(line);
+
+				if (len >= 0) {
+					engine = line;
+					engine_len = len;
+					if (index_file)
+						index_engine(engine, engine_len);
+				} else if (line[0] && !isspace(line[0])) {
+					engine = NULL;
+				}
+
+				if (json_output)
+					json_line(line, engine, engine_len,
+						  &devid);
+				else
+					print_line(line, &devid, &ring_length);
+			}
+		} else {
+			if (!num_threads) {
+				decode_section(s);
+			} else {
+				pthread_mutex_lock(&decoder.mutex);
+				while (!s->done)
+					pthread_cond_wait(&decoder.cond,
+							  &decoder.mutex);
+				pthread_mutex_unlock(&decoder.mutex);
+			}
+
+			if (index_file && s->out_len)
+				index_buffer(s, ftell(stdout));
+
+			fwrite(s->out, 1, s->out_len, stdout);
+			free(s->out);
+		}
+
+		pthread_mutex_lock(&decoder.mutex);
+		decoder.written = i + 1;
+		pthread_cond_broadcast(&decoder.cond);
+		pthread_mutex_unlock(&decoder.mutex);
+	}
+
+	for (n = 0; n < num_threads; n++)
+		pthread_join(threads[n], NULL);
+	free(threads);
+
+	free(decoder.sections);
+	free(lines);
+	free(buf);
 }
 
 static void setup_pager(void)
@@ -786,35 +1398,116 @@ static void setup_pager(void)
 	}
 }
 
+static char **split_list(char *str)
+{
+	char **list = NULL;
+	int num = 0;
+	char *tok;
+
+	for (tok = strtok(str, ","); tok; tok = strtok(NULL, ",")) {
+		list = realloc(list, (num + 2) * sizeof(*list));
+		assert(list);
+		list[num++] = tok;
+		list[num] = NULL;
+	}
+
+	return list;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+			"intel_gpu_decode: Parse an Intel GPU i915_error_state\n"
+			"Usage:\n"
+			"\t%s [-j <threads>] [-r <ring>,...] [-b <buffer>,...]\n"
+			"\t\t[-J] [-o <output>] [-i <index>] [<file>]\n"
+			"\n"
+			"With no arguments, debugfs-dri-directory is probed for in "
+			"/debug and \n"
+			"/sys/kernel/debug.  Otherwise, it may be "
+			"specified.  If a file is given,\n"
+			"it is parsed as an GPU dump in the format of "
+			"/debug/dri/0/i915_error_state.\n"
+			"\n"
+			"Buffers are decoded by <threads> threads, one per CPU by default.\n"
+			"With -r only the buffers of rings whose name contains one of the\n"
+			"given strings are decoded, and with -b only the given kinds of\n"
+			"buffers (ring, batch, \"HW context\", user, ...).\n"
+			"\n"
+			"With -J the error state is written as one JSON object per line,\n"
+			"to <output> with -o. With -i an index of where each engine and\n"
+			"buffer, and the instruction at ACTHD, are found in the output is\n"
+			"written to <index>; this requires -o.\n",
+			argv0);
+}
+
 int
 main(int argc, char *argv[])
 {
 	FILE *file;
 	const char *path;
 	char *filename = NULL;
+	const char *output = NULL, *index = NULL;
 	struct stat st;
-	int error;
-
-	if (argc > 2) {
-		fprintf(stderr,
-				"intel_gpu_decode: Parse an Intel GPU i915_error_state\n"
-				"Usage:\n"
-				"\t%s [<file>]\n"
-				"\n"
-				"With no arguments, debugfs-dri-directory is probed for in "
-				"/debug and \n"
-				"/sys/kernel/debug.  Otherwise, it may be "
-				"specified.  If a file is given,\n"
-				"it is parsed as an GPU dump in the format of "
-				"/debug/dri/0/i915_error_state.\n",
-				argv[0]);
+	int num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int error, c;
+
+	while ((c = getopt(argc, argv, "j:r:b:Jo:i:h")) != -1) {
+		switch (c) {
+		case 'j':
+			num_threads = atoi(optarg);
+			break;
+		case 'r':
+			filter_rings = split_list(optarg);
+			break;
+		case 'b':
+			filter_buffers = split_list(optarg);
+			break;
+		case 'J':
+			json_output = true;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'i':
+			index = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return c != 'h';
+		}
+	}
+
+	if (argc - optind > 1 || (index && !output)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (output && !freopen(output, "w", stdout)) {
+		fprintf(stderr, "Failed to open %s: %s\n",
+			output, strerror(errno));
 		return 1;
 	}
 
+	if (index) {
+		index_file = fopen(index, "w");
+		if (!index_file) {
+			fprintf(stderr, "Failed to open %s: %s\n",
+				index, strerror(errno));
+			return 1;
+		}
+	}
+
+	/* The main thread prints, the others decode. */
+	if (num_threads > 1)
+		num_threads--;
+	else
+		num_threads = 0;
+
 	if (isatty(1))
 		setup_pager();
 
-	if (argc == 1) {
+	if (optind == argc) {
 		if (isatty(0)) {
 			path = "/sys/class/drm/card0/error";
 			error = stat(path, &st);
@@ -833,11 +1526,13 @@ main(int argc, char *argv[])
 				     "\tsudo mount -t debugfs debugfs /sys/kernel/debug\n");
 			}
 		} else {
-			read_data_file(stdin);
+			read_data_file(stdin, num_threads);
+			if (index_file)
+				fclose(index_file);
 			exit(0);
 		}
 	} else {
-		path = argv[1];
+		path = argv[optind];
 		error = stat(path, &st);
 		if (error != 0) {
 			fprintf(stderr, "Error opening %s: %s\n",
@@ -878,8 +1573,10 @@ main(int argc, char *argv[])
 		}
 	}
 
-	read_data_file(file);
+	read_data_file(file, num_threads);
 	fclose(file);
+	if (index_file)
+		fclose(index_file);
 
 	if (filename != path)
 		free(filename);
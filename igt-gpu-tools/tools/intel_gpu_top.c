@@ -41,9 +41,15 @@
 #include <errno.h>
 #include <math.h>
 #include <locale.h>
+#include <signal.h>
+#include <sys/timerfd.h>
+#include <sys/mman.h>
+#include <time.h>
 
 #include "igt_perf.h"
 
+struct clients;
+
 struct pmu_pair {
 	uint64_t cur;
 	uint64_t prev;
@@ -70,12 +76,49 @@ struct engine {
 	struct pmu_counter sema;
 };
 
+/*
+ * Raw samples are kept in a ring, each one the PMU timestamp, the number of
+ * timer expirations missed before it and then the value of every counter at
+ * the counter's idx. Rates are only computed from two samples when they are
+ * displayed or written out.
+ */
+struct samples {
+	unsigned int size; /* power of two */
+	unsigned int stride;
+	unsigned long count;
+	uint64_t *data;
+};
+
+#define SAMPLE_TS	0
+#define SAMPLE_MISSED	1
+#define SAMPLE_VAL	2
+
+/* A value written out in the JSON and CSV records */
+struct field {
+	const char *group;
+	const char *name;
+	const char *unit;
+	struct pmu_counter *cnt;
+	double d, s;
+	bool engine;
+};
+
 struct engines {
 	unsigned int num_engines;
 	unsigned int num_counters;
+	unsigned int num_values;
 	DIR *root;
 	int fd;
 	struct pmu_pair ts;
+	uint64_t missed;
+
+	struct samples samples;
+	unsigned long written;
+
+	struct field *fields;
+	unsigned int num_fields;
+
+	struct clients *clients;
 
 	int rapl_fd;
 	double rapl_scale;
@@ -86,6 +129,7 @@ struct engines {
 	const char *imc_reads_unit;
 	double imc_writes_scale;
 	const char *imc_writes_unit;
+	char imc_bandwidth_unit[32];
 
 	struct pmu_counter freq_req;
 	struct pmu_counter freq_act;
@@ -478,6 +522,9 @@ static int pmu_init(struct engines *engines)
 		}
 	}
 
+	/* RAPL and IMC values are stored after the i915 group in a sample. */
+	engines->num_values = engines->num_counters;
+
 	engines->rapl_fd = -1;
 	if (rapl_type_id()) {
 		engines->rapl_scale = rapl_gpu_power_scale();
@@ -495,11 +542,12 @@ static int pmu_init(struct engines *engines)
 			return -1;
 
 		engines->rapl.present = true;
+		engines->rapl.idx = engines->num_values++;
 	}
 
 	engines->imc_fd = -1;
 	if (imc_type_id()) {
-		unsigned int num = 0;
+		unsigned int num = engines->num_values;
 
 		engines->imc_reads_scale = imc_data_reads_scale();
 		engines->imc_writes_scale = imc_data_writes_scale();
@@ -529,6 +577,7 @@ static int pmu_init(struct engines *engines)
 
 		engines->imc_reads.present = true;
 		engines->imc_writes.present = true;
+		engines->num_values = num;
 	}
 
 	return 0;
@@ -619,50 +668,892 @@ static uint64_t pmu_read_single(int fd)
 	return __pmu_read_single(fd, NULL);
 }
 
-static void __update_sample(struct pmu_counter *counter, uint64_t val)
+static uint64_t *sample_ptr(struct samples *samples, unsigned long n)
 {
-	counter->val.prev = counter->val.cur;
-	counter->val.cur = val;
+	return samples->data + (n & (samples->size - 1)) * samples->stride;
 }
 
-static void update_sample(struct pmu_counter *counter, uint64_t *val)
+static int samples_init(struct engines *engines, unsigned int depth)
 {
-	if (counter->present)
-		__update_sample(counter, val[counter->idx]);
+	struct samples *samples = &engines->samples;
+
+	samples->size = 2;
+	while (samples->size < depth)
+		samples->size <<= 1;
+
+	samples->stride = SAMPLE_VAL + engines->num_values;
+	samples->count = 0;
+	samples->data = calloc(samples->size, samples->stride *
+			       sizeof(*samples->data));
+
+	return samples->data ? 0 : -1;
 }
 
-static void pmu_sample(struct engines *engines)
+/* One read per PMU, straight into the next slot of the ring. */
+static void pmu_sample(struct engines *engines, uint64_t missed)
 {
-	const int num_val = engines->num_counters;
-	uint64_t val[2 + num_val];
-	unsigned int i;
+	struct samples *samples = &engines->samples;
+	uint64_t *s = sample_ptr(samples, samples->count);
+	uint64_t *val = s + SAMPLE_VAL;
 
-	engines->ts.prev = engines->ts.cur;
+	s[SAMPLE_TS] = pmu_read_multi(engines->fd, engines->num_counters, val);
+	s[SAMPLE_MISSED] = missed;
 
 	if (engines->rapl_fd >= 0)
-		__update_sample(&engines->rapl,
-				pmu_read_single(engines->rapl_fd));
+		val[engines->rapl.idx] = pmu_read_single(engines->rapl_fd);
 
-	if (engines->imc_fd >= 0) {
-		pmu_read_multi(engines->imc_fd, 2, val);
-		update_sample(&engines->imc_reads, val);
-		update_sample(&engines->imc_writes, val);
+	if (engines->imc_fd >= 0)
+		pmu_read_multi(engines->imc_fd, 2,
+			       val + engines->imc_reads.idx);
+
+	samples->count++;
+}
+
+static void update_sample(struct pmu_counter *counter,
+			  const uint64_t *prev, const uint64_t *cur)
+{
+	if (counter->present) {
+		counter->val.prev = prev[counter->idx];
+		counter->val.cur = cur[counter->idx];
+	}
+}
+
+/* Load the counters with the interval ending at sample n. */
+static void pmu_interval(struct engines *engines, unsigned long n)
+{
+	const uint64_t *prev = sample_ptr(&engines->samples, n - 1);
+	const uint64_t *cur = sample_ptr(&engines->samples, n);
+	unsigned int i;
+
+	engines->ts.prev = prev[SAMPLE_TS];
+	engines->ts.cur = cur[SAMPLE_TS];
+	engines->missed = cur[SAMPLE_MISSED];
+
+	prev += SAMPLE_VAL;
+	cur += SAMPLE_VAL;
+
+	update_sample(&engines->freq_req, prev, cur);
+	update_sample(&engines->freq_act, prev, cur);
+	update_sample(&engines->irq, prev, cur);
+	update_sample(&engines->rc6, prev, cur);
+	update_sample(&engines->rapl, prev, cur);
+	update_sample(&engines->imc_reads, prev, cur);
+	update_sample(&engines->imc_writes, prev, cur);
+
+	for (i = 0; i < engines->num_engines; i++) {
+		struct engine *engine = engine_ptr(engines, i);
+
+		update_sample(&engine->busy, prev, cur);
+		update_sample(&engine->sema, prev, cur);
+		update_sample(&engine->wait, prev, cur);
 	}
+}
+
+static const char *per_second(char *buf, size_t len, const char *unit)
+{
+	if (!unit || snprintf(buf, len, "%s/s", unit) >= len)
+		return NULL;
+
+	return buf;
+}
+
+static int fields_init(struct engines *engines)
+{
+	const char *power = "power", *imc = "imc-bandwidth";
+	const char *freq = "frequency", *rc6 = "rc6";
+	const char *irq = "interrupts";
+	const char *bandwidth =
+		per_second(engines->imc_bandwidth_unit,
+			   sizeof(engines->imc_bandwidth_unit),
+			   engines->imc_reads_unit);
+	struct field *f;
+	unsigned int i;
+
+	f = calloc(7 + 3 * engines->num_engines, sizeof(*f));
+	if (!f)
+		return -1;
+
+	engines->fields = f;
 
-	engines->ts.cur = pmu_read_multi(engines->fd, num_val, val);
+#define add_field(g, n, u, c, d_, s_, e) \
+	*f++ = (struct field){ .group = (g), .name = (n), .unit = (u), \
+			       .cnt = (c), .d = (d_), .s = (s_), .engine = (e) }
 
-	update_sample(&engines->freq_req, val);
-	update_sample(&engines->freq_act, val);
-	update_sample(&engines->irq, val);
-	update_sample(&engines->rc6, val);
+	add_field(freq, "requested", "MHz", &engines->freq_req, 1.0, 1, false);
+	add_field(freq, "actual", "MHz", &engines->freq_act, 1.0, 1, false);
+	add_field(irq, "count", "irq/s", &engines->irq, 1.0, 1, false);
+	add_field(rc6, "value", "%", &engines->rc6, 1e9, 100, false);
+	add_field(power, "value", engines->rapl_unit, &engines->rapl,
+		  1.0, engines->rapl_scale, false);
+	add_field(imc, "reads", bandwidth, &engines->imc_reads,
+		  1.0, engines->imc_reads_scale, false);
+	add_field(imc, "writes", bandwidth, &engines->imc_writes,
+		  1.0, engines->imc_writes_scale, false);
 
 	for (i = 0; i < engines->num_engines; i++) {
 		struct engine *engine = engine_ptr(engines, i);
+		const char *name = engine->display_name;
+
+		if (!engine->num_counters)
+			continue;
+
+		add_field(name, "busy", "%", &engine->busy, 1e9, 100, true);
+		add_field(name, "sema", "%", &engine->sema, 1e9, 100, true);
+		add_field(name, "wait", "%", &engine->wait, 1e9, 100, true);
+	}
+
+#undef add_field
+
+	engines->num_fields = f - engines->fields;
+
+	return 0;
+}
+
+/*
+ * Per client accounting from the i915 request tracepoints. The process
+ * owning a context is learnt from request_add, which is emitted from the
+ * submitting process, and the engines are considered busy with the request
+ * at the head of their execlist ports between request_in and request_out.
+ */
+
+#define CLIENT_CLASSES (I915_ENGINE_CLASS_VIDEO_ENHANCE + 1)
+#define CLIENT_HASH 256
+#define CLIENT_PORTS 8
+#define CLIENT_PAGES 64
+#define CLIENT_IDLE_NS (30 * 1000000000ull)
+
+enum {
+	TP_REQUEST_ADD,
+	TP_REQUEST_IN,
+	TP_REQUEST_OUT,
+
+	TP_NB
+};
+
+struct tracepoint {
+	const char *name;
+	int id;
+	int ctx, class, instance, seqno; /* field offsets */
+};
+
+struct client {
+	struct client *next;
+	pid_t pid;
+	char name[24];
+	unsigned int num_ctx;
+	uint64_t busy[CLIENT_CLASSES];
+	double total;
+};
+
+struct client_ctx {
+	struct client_ctx *next;
+	uint32_t ctx;
+	unsigned int inflight;
+	uint64_t last_seen;
+	struct client *client;
+};
+
+struct client_event {
+	uint64_t time;
+	uint32_t ctx;
+	uint32_t seqno;
+	uint16_t class;
+	uint16_t instance;
+	uint32_t pid;
+	unsigned int type;
+};
+
+struct clients {
+	int nr_cpus;
+	int page_size;
+	int *fd;
+	void **map;
+	unsigned int num_fd;
+
+	struct tracepoint tp[TP_NB];
+
+	struct client_ctx *hash[CLIENT_HASH];
+	struct client *list;
+	unsigned int num_clients;
+	struct client **sorted;
+
+	struct {
+		uint64_t last;
+		unsigned int count;
+		struct {
+			struct client_ctx *ctx;
+			uint32_t seqno;
+		} port[CLIENT_PORTS];
+	} queue[CLIENT_CLASSES][8];
+	unsigned int num_class_engines[CLIENT_CLASSES];
+
+	struct client_event *events;
+	unsigned int num_events;
+	unsigned int max_events;
+
+	uint8_t *buffer;
+	unsigned int buffer_size;
+
+	uint64_t start, period;
+	uint64_t lost;
+};
+
+static const char *tracefs_roots[] = {
+	"/sys/kernel/debug/tracing/events",
+	"/sys/kernel/tracing/events",
+	NULL
+};
+
+static int tracepoint_init(struct tracepoint *tp)
+{
+	const char **root;
+	char buf[256];
+	FILE *f = NULL;
 
-		update_sample(&engine->busy, val);
-		update_sample(&engine->sema, val);
-		update_sample(&engine->wait, val);
+	for (root = tracefs_roots; *root && !f; root++) {
+		snprintf(buf, sizeof(buf), "%s/%s/format", *root, tp->name);
+		f = fopen(buf, "r");
 	}
+	if (!f)
+		return -1;
+
+	tp->id = 0;
+	tp->ctx = tp->class = tp->instance = tp->seqno = -1;
+
+	while (fgets(buf, sizeof(buf), f)) {
+		char decl[128], *name;
+		int offset, size;
+
+		if (sscanf(buf, "ID: %d", &tp->id) == 1)
+			continue;
+
+		if (sscanf(buf, " field:%127[^;]; offset:%d; size:%d;",
+			   decl, &offset, &size) != 3)
+			continue;
+
+		name = strrchr(decl, ' ');
+		name = name ? name + 1 : decl;
+
+		if (!strcmp(name, "ctx") && size == 4)
+			tp->ctx = offset;
+		else if (!strcmp(name, "class") && size == 2)
+			tp->class = offset;
+		else if (!strcmp(name, "instance") && size == 2)
+			tp->instance = offset;
+		else if (!strcmp(name, "seqno") && size == 4)
+			tp->seqno = offset;
+	}
+
+	fclose(f);
+
+	if (!tp->id || tp->ctx < 0 || tp->class < 0 || tp->instance < 0 ||
+	    tp->seqno < 0) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int clients_open(struct clients *clients)
+{
+	const size_t size = (1 + CLIENT_PAGES) * clients->page_size;
+	unsigned int i, cpu;
+
+	clients->fd = calloc(TP_NB * clients->nr_cpus, sizeof(*clients->fd));
+	clients->map = calloc(clients->nr_cpus, sizeof(*clients->map));
+	if (!clients->fd || !clients->map)
+		return -1;
+
+	for (i = 0; i < TP_NB; i++) {
+		struct perf_event_attr attr = { };
+
+		attr.type = PERF_TYPE_TRACEPOINT;
+		attr.config = clients->tp[i].id;
+		attr.sample_period = 1;
+		attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_TIME |
+				   PERF_SAMPLE_RAW;
+		attr.use_clockid = 1;
+		attr.clockid = CLOCK_MONOTONIC;
+
+		for (cpu = 0; cpu < clients->nr_cpus; cpu++) {
+			int fd = perf_event_open(&attr, -1, cpu, -1, 0);
+
+			if (fd < 0)
+				return -1;
+
+			clients->fd[clients->num_fd++] = fd;
+
+			/* All tracepoints of a CPU share one ring. */
+			if (i == 0) {
+				clients->map[cpu] = mmap(NULL, size,
+							 PROT_READ | PROT_WRITE,
+							 MAP_SHARED, fd, 0);
+				if (clients->map[cpu] == MAP_FAILED) {
+					clients->map[cpu] = NULL;
+					return -1;
+				}
+			} else if (ioctl(fd, PERF_EVENT_IOC_SET_OUTPUT,
+					 clients->fd[cpu])) {
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static struct clients *clients_init(struct engines *engines)
+{
+	struct clients *clients;
+	unsigned int i;
+
+	clients = calloc(1, sizeof(*clients));
+	if (!clients)
+		return NULL;
+
+	clients->tp[TP_REQUEST_ADD].name = "i915/i915_request_add";
+	clients->tp[TP_REQUEST_IN].name = "i915/i915_request_in";
+	clients->tp[TP_REQUEST_OUT].name = "i915/i915_request_out";
+
+	for (i = 0; i < TP_NB; i++) {
+		if (tracepoint_init(&clients->tp[i]))
+			return NULL;
+	}
+
+	clients->nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	clients->page_size = getpagesize();
+
+	if (clients_open(clients))
+		return NULL;
+
+	for (i = 0; i < engines->num_engines; i++) {
+		struct engine *engine = engine_ptr(engines, i);
+
+		if (engine->class < CLIENT_CLASSES)
+			clients->num_class_engines[engine->class]++;
+	}
+
+	clients->start = monotonic_ns();
+
+	return clients;
+}
+
+static struct client *lookup_client(struct clients *clients, pid_t pid)
+{
+	struct client *client;
+	char buf[64];
+
+	for (client = clients->list; client; client = client->next) {
+		if (client->pid == pid)
+			return client;
+	}
+
+	client = calloc(1, sizeof(*client));
+	if (!client)
+		return NULL;
+
+	client->pid = pid;
+	snprintf(buf, sizeof(buf), "/proc/%d/comm", pid);
+	if (!pid || filename_to_buf(buf, client->name, sizeof(client->name)))
+		strcpy(client->name, "[unknown]");
+
+	client->next = clients->list;
+	clients->list = client;
+	clients->num_clients++;
+
+	return client;
+}
+
+static void set_client(struct client_ctx *ctx, struct client *client)
+{
+	if (ctx->client)
+		ctx->client->num_ctx--;
+
+	ctx->client = client;
+	if (client)
+		client->num_ctx++;
+}
+
+static struct client_ctx *
+lookup_ctx(struct clients *clients, uint32_t id, uint64_t time)
+{
+	struct client_ctx **head = &clients->hash[id % CLIENT_HASH];
+	struct client_ctx *ctx;
+
+	for (ctx = *head; ctx; ctx = ctx->next) {
+		if (ctx->ctx == id)
+			break;
+	}
+
+	if (!ctx) {
+		ctx = calloc(1, sizeof(*ctx));
+		if (!ctx)
+			return NULL;
+
+		ctx->ctx = id;
+		ctx->next = *head;
+		*head = ctx;
+	}
+
+	/* Contexts submitted before we started belong to no known process. */
+	if (!ctx->client)
+		set_client(ctx, lookup_client(clients, 0));
+
+	ctx->last_seen = time;
+
+	return ctx;
+}
+
+/* Charge the time since the last event to the request running on the engine. */
+static void
+queue_advance(struct clients *clients, unsigned int class,
+	      unsigned int instance, uint64_t time)
+{
+	typeof(clients->queue[0][0]) *q = &clients->queue[class][instance];
+
+	if (time <= q->last)
+		return;
+
+	if (q->count && q->port[0].ctx->client)
+		q->port[0].ctx->client->busy[class] += time - q->last;
+
+	q->last = time;
+}
+
+static void process_event(struct clients *clients,
+			  const struct client_event *ev)
+{
+	typeof(clients->queue[0][0]) *q;
+	struct client_ctx *ctx;
+	unsigned int i;
+
+	if (ev->class >= CLIENT_CLASSES || ev->instance >= 8)
+		return;
+
+	ctx = lookup_ctx(clients, ev->ctx, ev->time);
+	if (!ctx)
+		return;
+
+	q = &clients->queue[ev->class][ev->instance];
+
+	switch (ev->type) {
+	case TP_REQUEST_ADD:
+		if (ctx->client && ctx->client->pid == ev->pid)
+			break;
+
+		set_client(ctx, lookup_client(clients, ev->pid));
+		break;
+
+	case TP_REQUEST_IN:
+		queue_advance(clients, ev->class, ev->instance, ev->time);
+
+		/* Resubmission after preemption keeps its place. */
+		for (i = 0; i < q->count; i++) {
+			if (q->port[i].ctx == ctx &&
+			    q->port[i].seqno == ev->seqno)
+				return;
+		}
+
+		if (q->count == CLIENT_PORTS)
+			return;
+
+		q->port[q->count].ctx = ctx;
+		q->port[q->count].seqno = ev->seqno;
+		q->count++;
+		ctx->inflight++;
+		break;
+
+	case TP_REQUEST_OUT:
+		queue_advance(clients, ev->class, ev->instance, ev->time);
+
+		for (i = 0; i < q->count; i++) {
+			if (q->port[i].ctx == ctx &&
+			    q->port[i].seqno == ev->seqno)
+				break;
+		}
+		if (i == q->count)
+			break;
+
+		memmove(&q->port[i], &q->port[i + 1],
+			(q->count - i - 1) * sizeof(q->port[0]));
+		q->count--;
+		ctx->inflight--;
+		break;
+	}
+}
+
+static void add_event(struct clients *clients,
+		      const struct perf_event_header *header)
+{
+	const struct {
+		struct perf_event_header header;
+		uint32_t pid, tid;
+		uint64_t time;
+		uint32_t size;
+		uint8_t data[];
+	} *sample = (const void *)header;
+	struct client_event *ev;
+	const struct tracepoint *tp;
+	unsigned int type;
+
+	if (header->type == PERF_RECORD_LOST) {
+		clients->lost += ((const uint64_t *)(header + 1))[1];
+		return;
+	}
+
+	if (header->type != PERF_RECORD_SAMPLE)
+		return;
+
+	/* The tracepoint is identified by the common_type of the raw data. */
+	for (type = 0; type < TP_NB; type++) {
+		if (clients->tp[type].id == *(const uint16_t *)sample->data)
+			break;
+	}
+	if (type == TP_NB)
+		return;
+
+	if (clients->num_events == clients->max_events) {
+		unsigned int max = clients->max_events ? 2 * clients->max_events : 1024;
+
+		ev = realloc(clients->events, max * sizeof(*ev));
+		if (!ev)
+			return;
+
+		clients->events = ev;
+		clients->max_events = max;
+	}
+
+	tp = &clients->tp[type];
+	ev = &clients->events[clients->num_events++];
+	ev->type = type;
+	ev->time = sample->time;
+	ev->pid = sample->pid;
+	memcpy(&ev->ctx, sample->data + tp->ctx, sizeof(ev->ctx));
+	memcpy(&ev->seqno, sample->data + tp->seqno, sizeof(ev->seqno));
+	memcpy(&ev->class, sample->data + tp->class, sizeof(ev->class));
+	memcpy(&ev->instance, sample->data + tp->instance,
+	       sizeof(ev->instance));
+}
+
+static void clients_read(struct clients *clients, unsigned int cpu)
+{
+	struct perf_event_mmap_page *mmap = clients->map[cpu];
+	const uint64_t size = CLIENT_PAGES * clients->page_size;
+	const uint8_t *data = (const uint8_t *)mmap + clients->page_size;
+	uint64_t head, tail;
+
+	head = __atomic_load_n(&mmap->data_head, __ATOMIC_ACQUIRE);
+	tail = mmap->data_tail;
+
+	while (head - tail >= sizeof(struct perf_event_header)) {
+		const struct perf_event_header *header;
+		uint64_t offset = tail & (size - 1);
+
+		header = (const void *)(data + offset);
+		if (header->size > head - tail || !header->size)
+			break;
+
+		/* Records wrapping around the end of the ring are copied out. */
+		if (offset + header->size > size) {
+			uint64_t before = size - offset;
+
+			if (header->size > clients->buffer_size) {
+				uint8_t *b = realloc(clients->buffer,
+						     header->size);
+
+				if (!b)
+					break;
+
+				clients->buffer = b;
+				clients->buffer_size = header->size;
+			}
+
+			memcpy(clients->buffer, header, before);
+			memcpy(clients->buffer + before, data,
+			       header->size - before);
+			header = (const void *)clients->buffer;
+		}
+
+		add_event(clients, header);
+		tail += header->size;
+	}
+
+	__atomic_store_n(&mmap->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+static int event_cmp(const void *_a, const void *_b)
+{
+	const struct client_event *a = _a, *b = _b;
+
+	if (a->time != b->time)
+		return a->time < b->time ? -1 : 1;
+
+	return 0;
+}
+
+static int client_cmp(const void *_a, const void *_b)
+{
+	const struct client *a = *(struct client **)_a;
+	const struct client *b = *(struct client **)_b;
+
+	if (a->total != b->total)
+		return a->total < b->total ? 1 : -1;
+
+	return a->pid - b->pid;
+}
+
+static void clients_prune(struct clients *clients, uint64_t now)
+{
+	struct client **pc, *client;
+	unsigned int i;
+
+	for (i = 0; i < CLIENT_HASH; i++) {
+		struct client_ctx **pctx = &clients->hash[i], *ctx;
+
+		while ((ctx = *pctx)) {
+			if (!ctx->inflight &&
+			    now - ctx->last_seen > CLIENT_IDLE_NS) {
+				*pctx = ctx->next;
+				set_client(ctx, NULL);
+				free(ctx);
+			} else {
+				pctx = &ctx->next;
+			}
+		}
+	}
+
+	for (pc = &clients->list; (client = *pc); ) {
+		if (!client->num_ctx && client->total == 0.0) {
+			*pc = client->next;
+			clients->num_clients--;
+			free(client);
+		} else {
+			pc = &client->next;
+		}
+	}
+}
+
+/*
+ * Collect the events of all CPUs since the last update, replay them in time
+ * order and compute the busyness of every client over the period.
+ */
+static void clients_update(struct clients *clients)
+{
+	struct client *client;
+	unsigned int i, j;
+	uint64_t now;
+
+	for (client = clients->list; client; client = client->next)
+		memset(client->busy, 0, sizeof(client->busy));
+
+	clients->num_events = 0;
+	for (i = 0; i < clients->nr_cpus; i++)
+		clients_read(clients, i);
+
+	/* Everything recorded by now has been read. */
+	now = monotonic_ns();
+
+	qsort(clients->events, clients->num_events, sizeof(*clients->events),
+	      event_cmp);
+	for (i = 0; i < clients->num_events; i++)
+		process_event(clients, &clients->events[i]);
+
+	for (i = 0; i < CLIENT_CLASSES; i++) {
+		for (j = 0; j < 8; j++)
+			queue_advance(clients, i, j, now);
+	}
+
+	clients->period = now - clients->start;
+	clients->start = now;
+
+	for (client = clients->list; client; client = client->next) {
+		client->total = 0;
+		for (i = 0; i < CLIENT_CLASSES; i++)
+			client->total += client->busy[i];
+	}
+
+	clients_prune(clients, now);
+
+	free(clients->sorted);
+	clients->sorted = calloc(clients->num_clients + 1,
+				 sizeof(*clients->sorted));
+	if (!clients->sorted)
+		return;
+
+	i = 0;
+	for (client = clients->list; client; client = client->next)
+		clients->sorted[i++] = client;
+	qsort(clients->sorted, i, sizeof(*clients->sorted), client_cmp);
+}
+
+/* Busyness of a client as a share of all engines of the class. */
+static double
+client_busy(struct clients *clients, struct client *client, unsigned int class)
+{
+	if (!clients->period || !clients->num_class_engines[class])
+		return 0;
+
+	return 100.0 * client->busy[class] /
+	       clients->period / clients->num_class_engines[class];
+}
+
+enum output_mode {
+	INTERACTIVE,
+	JSON,
+	CSV,
+};
+
+static void json_close(FILE *out, const char *unit)
+{
+	if (unit)
+		fprintf(out, ",\"unit\":\"%s\"", unit);
+	fputc('}', out);
+}
+
+static void json_string(FILE *out, const char *str)
+{
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			fprintf(out, "\\%c", *str);
+		else if ((unsigned char)*str < ' ')
+			fprintf(out, "\\u%04x", *str);
+		else
+			fputc(*str, out);
+	}
+}
+
+static void json_clients(FILE *out, struct clients *clients)
+{
+	struct client **c;
+	unsigned int i;
+
+	fputs(",\"clients\":{", out);
+	for (c = clients->sorted; c && *c; c++) {
+		if ((*c)->total == 0.0)
+			break;
+
+		fprintf(out, "%s\"%d\":{\"name\":\"", c == clients->sorted ? "" : ",",
+			(*c)->pid);
+		json_string(out, (*c)->name);
+		fputs("\",\"engine-classes\":{", out);
+		for (i = 0; i < CLIENT_CLASSES; i++)
+			fprintf(out, "%s\"%s\":{\"busy\":%.2f,\"unit\":\"%%\"}",
+				i ? "," : "", class_display_name(i),
+				client_busy(clients, *c, i));
+		fputs("}}", out);
+	}
+	fputc('}', out);
+}
+
+static void json_record(FILE *out, struct engines *engines, double t)
+{
+	const char *group = NULL, *unit = NULL;
+	bool in_engines = false;
+	unsigned int i;
+
+	fprintf(out,
+		"{\"period\":{\"duration\":%.3f,\"missed\":%" PRIu64 ",\"unit\":\"ms\"}",
+		t * 1e3, engines->missed);
+
+	for (i = 0; i < engines->num_fields; i++) {
+		const struct field *f = &engines->fields[i];
+		const char *sep = ",";
+
+		if (f->group != group) {
+			if (group)
+				json_close(out, unit);
+
+			if (f->engine && !in_engines) {
+				fputs(",\"engines\":{", out);
+				in_engines = true;
+				sep = "";
+			}
+
+			fprintf(out, "%s\"%s\":{", sep, f->group);
+			group = f->group;
+			unit = f->unit;
+			sep = "";
+		}
+
+		if (f->cnt->present)
+			fprintf(out, "%s\"%s\":%.2f", sep, f->name,
+				__pmu_calc(&f->cnt->val, f->d, t, f->s));
+		else
+			fprintf(out, "%s\"%s\":null", sep, f->name);
+	}
+
+	if (group)
+		json_close(out, unit);
+	if (in_engines)
+		fputc('}', out);
+	if (engines->clients)
+		json_clients(out, engines->clients);
+	fputs("}\n", out);
+}
+
+static void csv_header(FILE *out, struct engines *engines)
+{
+	unsigned int i;
+
+	fputs("duration (ms),missed", out);
+
+	for (i = 0; i < engines->num_fields; i++) {
+		const struct field *f = &engines->fields[i];
+
+		fprintf(out, ",%s %s", f->group, f->name);
+		if (f->unit)
+			fprintf(out, " (%s)", f->unit);
+	}
+
+	fputc('\n', out);
+}
+
+static void csv_record(FILE *out, struct engines *engines, double t)
+{
+	unsigned int i;
+
+	fprintf(out, "%.3f,%" PRIu64, t * 1e3, engines->missed);
+
+	for (i = 0; i < engines->num_fields; i++) {
+		const struct field *f = &engines->fields[i];
+
+		if (f->cnt->present)
+			fprintf(out, ",%.2f",
+				__pmu_calc(&f->cnt->val, f->d, t, f->s));
+		else
+			fputc(',', out);
+	}
+
+	fputc('\n', out);
+}
+
+/* Write out all samples taken since the last call, with a single flush. */
+static void
+write_records(FILE *out, struct engines *engines, enum output_mode mode)
+{
+	while (engines->written + 1 < engines->samples.count) {
+		double t;
+
+		pmu_interval(engines, ++engines->written);
+		t = (double)(engines->ts.cur - engines->ts.prev) / 1e9;
+
+		if (mode == JSON)
+			json_record(out, engines, t);
+		else
+			csv_record(out, engines, t);
+	}
+
+	fflush(out);
 }
 
 static const char *bars[] = { " ", "▏", "▎", "▍", "▌", "▋", "▊", "▉", "█" };
@@ -697,25 +1588,204 @@ usage(const char *appname)
 		"\n"
 		"\tThe following parameters are optional:\n\n"
 		"\t[-s <ms>]       Refresh period in milliseconds (default %ums).\n"
+		"\t[-J]            Stream one JSON object per period instead of\n"
+		"\t                the interactive display.\n"
+		"\t[-c]            Stream CSV records instead of the interactive\n"
+		"\t                display.\n"
+		"\t[-o <file>]     Write the JSON or CSV records to a file.\n"
+		"\t[-p]            Show the GPU usage of each client process.\n"
 		"\t[-h]            Show this help text.\n"
 		"\n",
 		appname, DEFAULT_PERIOD_MS);
 }
 
+static void
+display_clients(struct clients *clients, int con_w, int con_h, int lines)
+{
+	struct client **c;
+	unsigned int i;
+	int len;
+
+	if (lines++ >= con_h)
+		return;
+
+	len = printf("\033[7m   PID             NAME");
+	for (i = 0; i < CLIENT_CLASSES; i++)
+		len += printf(" %12s", class_display_name(i));
+	printf("%*s\033[0m\n", len - 4 < con_w ? con_w - 1 - (len - 4) : 0, "");
+
+	for (c = clients->sorted; c && *c && lines < con_h; c++, lines++) {
+		if ((*c)->total == 0.0)
+			break;
+
+		printf("%6d %16s", (*c)->pid, (*c)->name);
+		for (i = 0; i < CLIENT_CLASSES; i++)
+			printf(" %11.1f%%", client_busy(clients, *c, i));
+		printf("\n");
+	}
+
+	if (clients->lost && lines < con_h)
+		printf("(%" PRIu64 " events lost, increase the period)\n",
+		       clients->lost);
+}
+
+static void display(struct engines *engines, int con_w, int con_h)
+{
+	double t;
+#define BUFSZ 16
+	char freq[BUFSZ];
+	char fact[BUFSZ];
+	char irq[BUFSZ];
+	char rc6[BUFSZ];
+	char power[BUFSZ];
+	char reads[BUFSZ];
+	char writes[BUFSZ];
+	int lines = 0;
+	unsigned int i;
+
+	t = (double)(engines->ts.cur - engines->ts.prev) / 1e9;
+
+	printf("\033[H\033[J");
+
+	pmu_calc(&engines->freq_req, freq, BUFSZ, 4, 0, 1.0, t, 1);
+	pmu_calc(&engines->freq_act, fact, BUFSZ, 4, 0, 1.0, t, 1);
+	pmu_calc(&engines->irq, irq, BUFSZ, 8, 0, 1.0, t, 1);
+	pmu_calc(&engines->rc6, rc6, BUFSZ, 3, 0, 1e9, t, 100);
+	pmu_calc(&engines->rapl, power, BUFSZ, 4, 2, 1.0, t,
+		 engines->rapl_scale);
+	pmu_calc(&engines->imc_reads, reads, BUFSZ, 6, 0, 1.0, t,
+		 engines->imc_reads_scale);
+	pmu_calc(&engines->imc_writes, writes, BUFSZ, 6, 0, 1.0, t,
+		 engines->imc_writes_scale);
+
+	if (lines++ < con_h)
+		printf("intel-gpu-top - %s/%s MHz;  %s%% RC6; %s %s; %s irqs/s\n",
+		       fact, freq, rc6, power, engines->rapl_unit, irq);
+
+	if (lines++ < con_h)
+		printf("\n");
+
+	if (engines->imc_fd >= 0) {
+		if (lines++ < con_h)
+			printf("      IMC reads:   %s %s/s\n",
+			       reads, engines->imc_reads_unit);
+
+		if (lines++ < con_h)
+			printf("     IMC writes:   %s %s/s\n",
+			       writes, engines->imc_writes_unit);
+
+		if (++lines < con_h)
+			printf("\n");
+	}
+
+	for (i = 0; i < engines->num_engines; i++) {
+		struct engine *engine = engine_ptr(engines, i);
+
+		if (engine->num_counters && lines < con_h) {
+			const char *a = "          ENGINE      BUSY ";
+			const char *b = " MI_SEMA MI_WAIT";
+
+			printf("\033[7m%s%*s%s\033[0m\n",
+			       a,
+			       (int)(con_w - 1 - strlen(a) - strlen(b)),
+			       " ", b);
+			lines++;
+			break;
+		}
+	}
+
+	for (i = 0; i < engines->num_engines && lines < con_h; i++) {
+		struct engine *engine = engine_ptr(engines, i);
+		unsigned int max_w = con_w - 1;
+		unsigned int len;
+		char sema[BUFSZ];
+		char wait[BUFSZ];
+		char busy[BUFSZ];
+		char buf[128];
+		double val;
+
+		if (!engine->num_counters)
+			continue;
+
+		pmu_calc(&engine->sema, sema, BUFSZ, 3, 0, 1e9, t, 100);
+		pmu_calc(&engine->wait, wait, BUFSZ, 3, 0, 1e9, t, 100);
+		len = snprintf(buf, sizeof(buf), "    %s%%    %s%%",
+			       sema, wait);
+
+		pmu_calc(&engine->busy, busy, BUFSZ, 6, 2, 1e9, t,
+			 100);
+		len += printf("%16s %s%% ", engine->display_name, busy);
+
+		val = __pmu_calc(&engine->busy.val, 1e9, t, 100);
+		print_percentage_bar(val, max_w - len);
+
+		printf("%s\n", buf);
+
+		lines++;
+	}
+
+	if (lines++ < con_h)
+		printf("\n");
+
+	if (engines->clients)
+		display_clients(engines->clients, con_w, con_h, lines);
+
+	/* stdout is fully buffered, so the whole frame goes out at once. */
+	fflush(stdout);
+}
+
+static volatile sig_atomic_t stop, resized;
+
+static void sighandler(int sig)
+{
+	if (sig == SIGWINCH)
+		resized = 1;
+	else
+		stop = 1;
+}
+
+static void update_console_size(int *con_w, int *con_h)
+{
+	struct winsize ws;
+
+	if (ioctl(0, TIOCGWINSZ, &ws) != -1) {
+		*con_w = ws.ws_col;
+		*con_h = ws.ws_row;
+	}
+}
+
 int main(int argc, char **argv)
 {
 	unsigned int period_us = DEFAULT_PERIOD_MS * 1000;
+	enum output_mode mode = INTERACTIVE;
+	const char *output_path = NULL;
+	bool show_clients = false;
 	int con_w = -1, con_h = -1;
+	struct itimerspec period = { };
+	unsigned int batch = 1;
+	struct sigaction sa = { };
 	struct engines *engines;
-	unsigned int i;
-	int ret, ch;
+	FILE *out = stdout;
+	int ret, ch, tfd;
 
 	/* Parse options */
-	while ((ch = getopt(argc, argv, "s:h")) != -1) {
+	while ((ch = getopt(argc, argv, "s:Jco:ph")) != -1) {
 		switch (ch) {
 		case 's':
 			period_us = atoi(optarg) * 1000;
 			break;
+		case 'J':
+			mode = JSON;
+			break;
+		case 'c':
+			mode = CSV;
+			break;
+		case 'o':
+			output_path = optarg;
+			break;
+		case 'p':
+			show_clients = true;
+			break;
 		case 'h':
 			usage(argv[0]);
 			exit(0);
@@ -726,6 +1796,24 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (!period_us) {
+		fprintf(stderr, "Invalid refresh period!\n");
+		usage(argv[0]);
+		exit(1);
+	}
+
+	if (show_clients && mode == CSV) {
+		fprintf(stderr, "Clients are not available in CSV output!\n");
+		usage(argv[0]);
+		exit(1);
+	}
+
+	if (output_path && mode == INTERACTIVE) {
+		fprintf(stderr, "Output file requires JSON or CSV output!\n");
+		usage(argv[0]);
+		exit(1);
+	}
+
 	engines = discover_engines();
 	if (!engines) {
 		fprintf(stderr,
@@ -741,114 +1829,104 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
-	pmu_sample(engines);
-
-	for (;;) {
-		double t;
-#define BUFSZ 16
-		char freq[BUFSZ];
-		char fact[BUFSZ];
-		char irq[BUFSZ];
-		char rc6[BUFSZ];
-		char power[BUFSZ];
-		char reads[BUFSZ];
-		char writes[BUFSZ];
-		struct winsize ws;
-		int lines = 0;
-
-		/* Update terminal size. */
-		if (ioctl(0, TIOCGWINSZ, &ws) != -1) {
-			con_w = ws.ws_col;
-			con_h = ws.ws_row;
+	if (show_clients) {
+		engines->clients = clients_init(engines);
+		if (!engines->clients) {
+			fprintf(stderr,
+				"Failed to open the i915 request tracepoints! (%s)\n",
+				strerror(errno));
+			return 1;
 		}
+	}
 
-		pmu_sample(engines);
-		t = (double)(engines->ts.cur - engines->ts.prev) / 1e9;
-
-		printf("\033[H\033[J");
-
-		pmu_calc(&engines->freq_req, freq, BUFSZ, 4, 0, 1.0, t, 1);
-		pmu_calc(&engines->freq_act, fact, BUFSZ, 4, 0, 1.0, t, 1);
-		pmu_calc(&engines->irq, irq, BUFSZ, 8, 0, 1.0, t, 1);
-		pmu_calc(&engines->rc6, rc6, BUFSZ, 3, 0, 1e9, t, 100);
-		pmu_calc(&engines->rapl, power, BUFSZ, 4, 2, 1.0, t,
-			 engines->rapl_scale);
-		pmu_calc(&engines->imc_reads, reads, BUFSZ, 6, 0, 1.0, t,
-			 engines->imc_reads_scale);
-		pmu_calc(&engines->imc_writes, writes, BUFSZ, 6, 0, 1.0, t,
-			 engines->imc_writes_scale);
-
-		if (lines++ < con_h)
-			printf("intel-gpu-top - %s/%s MHz;  %s%% RC6; %s %s; %s irqs/s\n",
-			       fact, freq, rc6, power, engines->rapl_unit, irq);
-
-		if (lines++ < con_h)
-			printf("\n");
-
-		if (engines->imc_fd) {
-			if (lines++ < con_h)
-				printf("      IMC reads:   %s %s/s\n",
-				       reads, engines->imc_reads_unit);
+	/*
+	 * Records are written out in batches of up to a second worth of
+	 * samples, so that short periods do not cost a write each. Client
+	 * usage is only kept for the last period, so it is written out as
+	 * soon as it is sampled.
+	 */
+	if (mode != INTERACTIVE && period_us < 1000000 && !show_clients)
+		batch = 1000000 / period_us;
 
-			if (lines++ < con_h)
-				printf("     IMC writes:   %s %s/s\n",
-				       writes, engines->imc_writes_unit);
+	if (samples_init(engines, batch + 2) ||
+	    (mode != INTERACTIVE && fields_init(engines))) {
+		fprintf(stderr, "Out of memory!\n");
+		return 1;
+	}
 
-			if (++lines < con_h)
-				printf("\n");
+	if (output_path) {
+		out = fopen(output_path, "w");
+		if (!out) {
+			fprintf(stderr, "Failed to open %s! (%s)\n",
+				output_path, strerror(errno));
+			return 1;
 		}
+	}
+	setvbuf(out, NULL, _IOFBF, 64 << 10);
 
-		for (i = 0; i < engines->num_engines; i++) {
-			struct engine *engine = engine_ptr(engines, i);
-
-			if (engine->num_counters && lines < con_h) {
-				const char *a = "          ENGINE      BUSY ";
-				const char *b = " MI_SEMA MI_WAIT";
-
-				printf("\033[7m%s%*s%s\033[0m\n",
-				       a,
-				       (int)(con_w - 1 - strlen(a) - strlen(b)),
-				       " ", b);
-				lines++;
-				break;
-			}
-		}
+	/*
+	 * The timer expires on the period grid from the start, however late
+	 * we are woken, so sampling does not drift. Expirations that we missed
+	 * completely are reported with the next sample.
+	 */
+	tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	if (tfd < 0) {
+		fprintf(stderr, "Failed to create timer! (%s)\n",
+			strerror(errno));
+		return 1;
+	}
 
-		for (i = 0; i < engines->num_engines && lines < con_h; i++) {
-			struct engine *engine = engine_ptr(engines, i);
-			unsigned int max_w = con_w - 1;
-			unsigned int len;
-			char sema[BUFSZ];
-			char wait[BUFSZ];
-			char busy[BUFSZ];
-			char buf[128];
-			double val;
+	period.it_interval.tv_sec = period_us / 1000000;
+	period.it_interval.tv_nsec = (period_us % 1000000) * 1000;
+	period.it_value = period.it_interval;
 
-			if (!engine->num_counters)
-				continue;
+	/* No SA_RESTART, so that signals interrupt waiting for the timer. */
+	sa.sa_handler = sighandler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGWINCH, &sa, NULL);
 
-			pmu_calc(&engine->sema, sema, BUFSZ, 3, 0, 1e9, t, 100);
-			pmu_calc(&engine->wait, wait, BUFSZ, 3, 0, 1e9, t, 100);
-			len = snprintf(buf, sizeof(buf), "    %s%%    %s%%",
-				       sema, wait);
+	if (mode == CSV)
+		csv_header(out, engines);
+	else if (mode == INTERACTIVE)
+		update_console_size(&con_w, &con_h);
 
-			pmu_calc(&engine->busy, busy, BUFSZ, 6, 2, 1e9, t,
-				 100);
-			len += printf("%16s %s%% ", engine->display_name, busy);
+	pmu_sample(engines, 0);
+	timerfd_settime(tfd, 0, &period, NULL);
 
-			val = __pmu_calc(&engine->busy.val, 1e9, t, 100);
-			print_percentage_bar(val, max_w - len);
+	while (!stop) {
+		uint64_t expired;
 
-			printf("%s\n", buf);
+		if (read(tfd, &expired, sizeof(expired)) == sizeof(expired)) {
+			pmu_sample(engines, expired - 1);
+			if (engines->clients)
+				clients_update(engines->clients);
+		} else if (errno != EINTR) {
+			break;
+		} else if (!resized || engines->samples.count < 2) {
+			continue;
+		}
 
-			lines++;
+		if (mode != INTERACTIVE) {
+			if (engines->samples.count - engines->written > batch)
+				write_records(out, engines, mode);
+			continue;
 		}
 
-		if (lines++ < con_h)
-			printf("\n");
+		if (resized) {
+			resized = 0;
+			update_console_size(&con_w, &con_h);
+		}
 
-		usleep(period_us);
+		pmu_interval(engines, engines->samples.count - 1);
+		display(engines, con_w, con_h);
 	}
 
+	if (mode != INTERACTIVE)
+		write_records(out, engines, mode);
+
+	if (out != stdout)
+		fclose(out);
+
 	return 0;
 }